@@ -20,15 +20,15 @@
 #pragma once
 #include "main.h"
 #include "aht20_api.h"
+#include "aht20_crc.h"
 
 /*
  * struct for holding measurment data
  */
 typedef struct {
 	uint8_t measured_data[7];
-	float humidity;
-	float temperature_c;
-	float temperature_f;
+	int32_t humidity_centi;
+	int32_t temperature_c_centi;
 } aht20_data_t;
 
 /*
@@ -52,6 +52,41 @@ aht20_status_t aht20_validate_calibration(I2C_HandleTypeDef *hi2c);
  */
 aht20_status_t aht20_measure(I2C_HandleTypeDef *hi2c, uint8_t *measured_data, uint16_t measured_data_size);
 
+/*
+ * sends measurment command and returns without waiting for the conversion.
+ * returns AHT20_STATUS_BUSY if a previous measurment or a queued soft reset is still in progress
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 2
+ */
+aht20_status_t aht20_start_measurement(I2C_HandleTypeDef *hi2c);
+
+/*
+ * checks the measurment started by aht20_start_measurement.
+ * returns AHT20_STATUS_BUSY until the conversion time has passed and
+ * the sensor has cleared the busy bit, then reads the data.
+ * returns AHT20_STATUS_BAD_CRC if the frame fails the crc check, a soft reset is queued
+ * and finished by the next calls, which return AHT20_STATUS_BUSY until the sensor is back
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 3
+ */
+aht20_status_t aht20_poll_measurement(I2C_HandleTypeDef *hi2c, uint8_t *measured_data, uint16_t measured_data_size);
+
+/*
+ * selects the transport used by aht20_start_measurement and aht20_poll_measurement.
+ * with AHT20_TRANSPORT_IT and AHT20_TRANSPORT_DMA the transfers run in background
+ * and finished frames are collected from the result queue by aht20_poll_measurement.
+ * returns AHT20_STATUS_BUSY if a measurment is in progress
+ */
+aht20_status_t aht20_set_transport(aht20_transport_t transport);
+
+/*
+ * sets callback called from interrupt context when a background transfer finishes,
+ * so the application can poll right away instead of on its next period. NULL disables it
+ */
+void aht20_set_result_callback(aht20_result_callback_t callback);
+
 /*
  * resets the sensor without turning off the power supply
  *
@@ -61,10 +96,66 @@ aht20_status_t aht20_measure(I2C_HandleTypeDef *hi2c, uint8_t *measured_data, ui
 aht20_status_t aht20_soft_reset(I2C_HandleTypeDef *hi2c);
 
 /*
- * calculates measured_data and writes the calculation in provided variables
+ * queues a soft reset without waiting for the sensor. the command is sent right away if the bus is free,
+ * aht20_start_measurement and aht20_poll_measurement finish the reset and return AHT20_STATUS_BUSY until then.
+ * returns AHT20_STATUS_BUSY if a measurment is in progress
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.5 Soft reset
+ */
+aht20_status_t aht20_start_soft_reset(I2C_HandleTypeDef *hi2c);
+
+/*
+ * releases a stuck bus and brings the sensor back.
+ * clocks out a slave holding SDA low, power cycles the sensor through I2C_VCC_Pin
+ * if that doesn't help, and initializes the I2C peripheral again.
+ * time spent is reported by aht20_get_recovery_stats
+ */
+aht20_status_t aht20_bus_recovery(I2C_HandleTypeDef *hi2c);
+
+/*
+ * copies bus recovery statistics
+ */
+void aht20_get_recovery_stats(aht20_recovery_stats_t *stats);
+
+/*
+ * calculates measured_data and writes the calculation in provided variables.
+ * temp_f can be NULL if fahrenheit is not needed
  *
  * Datasheet: AHT20 Product manuals
  * 6.1 Relative humidity transformation
  * 6.2 Temperature transformation
  */
 void aht20_calculate_measurments(uint8_t *measured_data, float *humidity, float *temp_c, float *temp_f);
+
+/*
+ * calculates measured_data without floating point.
+ * humidity is written in hundredths of percent, temp_c in hundredths of degree celsius
+ *
+ * Datasheet: AHT20 Product manuals
+ * 6.1 Relative humidity transformation
+ * 6.2 Temperature transformation
+ */
+void aht20_calculate_measurments_fixed(uint8_t *measured_data, int32_t *humidity, int32_t *temp_c);
+
+/*
+ * extracts 20 bit raw humidity and temperature values from measured_data
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 4
+ */
+void aht20_parse_raw(const uint8_t *measured_data, uint32_t *raw_humidity, uint32_t *raw_temperature);
+
+/*
+ * converts 20 bit raw values to hundredths of percent and hundredths of degree celsius
+ *
+ * Datasheet: AHT20 Product manuals
+ * 6.1 Relative humidity transformation
+ * 6.2 Temperature transformation
+ */
+void aht20_convert_raw_fixed(uint32_t raw_humidity, uint32_t raw_temperature, int32_t *humidity, int32_t *temp_c);
+
+/*
+ * converts hundredths of degree celsius to hundredths of degree fahrenheit
+ */
+int32_t aht20_celsius_to_fahrenheit_fixed(int32_t temp_c);
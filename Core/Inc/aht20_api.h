@@ -27,14 +27,50 @@ typedef enum {
 	AHT20_STATUS_NOT_TRANSMITTED,
 	AHT20_STATUS_NOT_RECEIVED,
 	AHT20_STATUS_NOT_MEASURED,
+	AHT20_STATUS_BUSY,
+	AHT20_STATUS_NOT_RECOVERED,
+	AHT20_STATUS_BAD_CRC,
 } aht20_status_t;
 
+/*
+ * enum for selecting how the measurment transfers use the bus
+ */
+typedef enum {
+	AHT20_TRANSPORT_BLOCKING = 0,
+	AHT20_TRANSPORT_IT,
+	AHT20_TRANSPORT_DMA,
+} aht20_transport_t;
+
+/*
+ * struct for holding bus recovery statistics
+ */
+typedef struct {
+	uint32_t recoveries;
+	uint32_t power_cycles;
+	uint32_t failures;
+	uint32_t last_latency_ms;
+	uint32_t max_latency_ms;
+} aht20_recovery_stats_t;
+
+/*
+ * callback called from interrupt context when a background frame is ready for aht20_poll_measurement
+ */
+typedef void (*aht20_result_callback_t)(void);
+
 /*
  * api for aht20 sensor
  */
 typedef struct {
 	aht20_status_t (*aht20_validate_calibration) (I2C_HandleTypeDef *hi2c);
 	aht20_status_t (*measure) (I2C_HandleTypeDef *hi2c, uint8_t *measured_data, uint16_t measured_data_size);
+	aht20_status_t (*start_measurement) (I2C_HandleTypeDef *hi2c);
+	aht20_status_t (*poll_measurement) (I2C_HandleTypeDef *hi2c, uint8_t *measured_data, uint16_t measured_data_size);
 	void (*calculate_measurments) (uint8_t *measured_data, float *humidity, float *temp_c, float *temp_f);
+	void (*calculate_measurments_fixed) (uint8_t *measured_data, int32_t *humidity, int32_t *temp_c);
 	aht20_status_t (*soft_reset) (I2C_HandleTypeDef *hi2c);
+	aht20_status_t (*start_soft_reset) (I2C_HandleTypeDef *hi2c);
+	aht20_status_t (*set_transport) (aht20_transport_t transport);
+	aht20_status_t (*bus_recovery) (I2C_HandleTypeDef *hi2c);
+	void (*get_recovery_stats) (aht20_recovery_stats_t *stats);
+	void (*set_result_callback) (aht20_result_callback_t callback);
 } aht20_sensor_api_t;
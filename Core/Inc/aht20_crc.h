@@ -0,0 +1,45 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+
+/*
+ * crc8 implementations for measurment frames.
+ * AHT20_CRC_TABLE uses 256 bytes of flash, AHT20_CRC_NIBBLE uses 16 bytes
+ * for flash constrained builds, AHT20_CRC_BITWISE uses no table
+ */
+#define AHT20_CRC_BITWISE 0
+#define AHT20_CRC_TABLE 1
+#define AHT20_CRC_NIBBLE 2
+
+/*
+ * selected crc8 implementation, can be overridden from the compiler command line
+ */
+#ifndef AHT20_CRC_IMPLEMENTATION
+#define AHT20_CRC_IMPLEMENTATION AHT20_CRC_TABLE
+#endif
+
+/*
+ * calculates crc8 of size bytes, polynomial x^8 + x^5 + x^4 + 1, initial value 0xff
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 4
+ */
+uint8_t aht20_crc8(const uint8_t *data, uint16_t size);
@@ -18,6 +18,9 @@
  */
 
 #include "main.h"
+#include "sensor_filter.h"
+#include "sample_rate.h"
+#include <stdbool.h>
 
 /*
  * return statuses for business logic
@@ -28,9 +31,28 @@ typedef enum {
 } bl_status_t;
 
 /*
- * initializes buttons
+ * scheduler events used by the business logic tasks.
+ * BL_EVENT_FRAME asks for the display frame to be rebuilt after the text layer moved
  */
-bl_status_t bl_init_buttons(void);
+typedef enum {
+	BL_EVENT_BUTTON = 0,
+	BL_EVENT_SENSOR,
+	BL_EVENT_DISPLAY,
+	BL_EVENT_FRAME,
+} bl_event_t;
+
+/*
+ * counters of display frames submitted and suppressed as unchanged
+ */
+typedef struct {
+	uint32_t submitted;
+	uint32_t suppressed;
+} bl_display_stats_t;
+
+/*
+ * initializes buttons, htim is the sampling timer ticking every BUTTON_SAMPLE_PERIOD_MS
+ */
+bl_status_t bl_init_buttons(TIM_HandleTypeDef *htim);
 
 /*
  * runs calibration check. if wasn't calibrated, calibrates the sensor
@@ -38,16 +60,73 @@ bl_status_t bl_init_buttons(void);
 bl_status_t bl_run_sensor(I2C_HandleTypeDef *hi2c);
 
 /*
- * processes and calculates sensor data
+ * selects filter applied to raw sensor values at the fastest sampling interval.
+ * window and ema weight are scaled with slower intervals. clears filter history
+ */
+bl_status_t bl_set_sensor_filter(const sensor_filter_config_t *filter_config);
+
+/*
+ * processes and calculates sensor data.
+ * starts a measurment or collects a finished one without waiting for the conversion
  */
 bl_status_t bl_process_sensor_data(I2C_HandleTypeDef *hi2c);
 
 /*
- * transmits formatted data to display via SPI
+ * registers sensor, button, display, frame and flash tasks in the scheduler.
+ * sensor must be running (bl_run_sensor) and scheduler initialized
+ */
+bl_status_t bl_start_tasks(I2C_HandleTypeDef *hi2c);
+
+/*
+ * measures sensor data, switches to error display if the sensor can't be recovered.
+ * runs periodically and when a background transfer finishes.
+ * time between measurements follows the rate of change of the readings, 1 s up to the slowest interval.
+ * unfiltered raw values are added to the sensor history and the flash log every 30 s,
+ * every sample is sent as a telemetry frame
+ */
+void bl_sensor_task(void);
+
+/*
+ * switches display mode and settings on button gestures. runs on recognized gestures and periodically.
+ * A/B short: next/previous mode, B double: Celsius/Fahrenheit, A long (repeats): brightness,
+ * B long: slowest sampling interval, A+B chord: display off.
+ * switches display off after 30 s without button activity, the next press switches it back on
+ */
+void bl_button_task(void);
+
+/*
+ * shows data of the current mode on the display.
+ * nothing is formatted nor sent while mode and displayed value stay the same
+ */
+void bl_display_task(void);
+
+/*
+ * erases the next flash log sector ahead of time while the display is off. runs every minute
  */
-void bl_spi_transmit_sensor_data(void);
+void bl_flash_task(void);
+
+/*
+ * returns true while the display is off, buttons are idle, the sensor bus is idle and telemetry is sent,
+ * used as Stop mode check
+ */
+bool bl_can_stop(void);
+
+/*
+ * copies display update counters
+ */
+void bl_get_display_stats(bl_display_stats_t *stats);
+
+/*
+ * writes sampling interval, effective sample rate and bus time saved
+ */
+void bl_get_sample_rate_stats(sample_rate_stats_t *stats);
 
 /*
  * interrupt callback
  */
 void HAL_GPIO_EXTI_Callback(uint16_t gpio_pin);
+
+/*
+ * timer interrupt callback, samples buttons
+ */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
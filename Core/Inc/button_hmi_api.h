@@ -33,6 +33,7 @@
  * - `b_hmi_check_button_state_change` - Checks button state on button state change
  * - `b_hmi_check_button_current_state` - Get current button state
  * - `read_button` - Handles GPIO interrupt triggered by button
+ * - `hmi_gestures_get_event` - Takes the oldest recognized gesture
  *
  * These functions are static and decribed in button_hmi_api.c file
  *
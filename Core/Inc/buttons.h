@@ -19,6 +19,13 @@
 
 #pragma once
 #include "main.h"
+#include <stdbool.h>
+
+/// Period of the sampling timer in milliseconds
+#define BUTTON_SAMPLE_PERIOD_MS 5
+
+/// Number of clean button events the queue holds
+#define BUTTON_EVENT_QUEUE_SIZE 16
 
 // @brief Status codes for button press
 typedef enum {
@@ -34,27 +41,64 @@ typedef struct {
 
 // @brief Grouped button data
 typedef struct Button {
-	uint32_t press_time; /// Last button press time
-	uint32_t release_time; /// Last button release time
+	uint32_t press_time; /// Last debounced press time
+	uint32_t release_time; /// Last debounced release time
 	Button_State button_state; /// Last saved button state
-	GPIO_PinState last_gpio_state; /// Last saved pin state
+	Button_State debounced_state; /// Debounced pin state, written by the sampler
+	uint8_t press_count; /// Debounced presses, written by the sampler
+	uint8_t seen_press_count; /// Presses already reported by check_button_state
 	Button_Gpio gpio; /// Button GPIO
-	volatile struct Button *next_button; /// Pointer to next button in linked list
 } Button;
 
+// @brief Clean button event types
+typedef enum {
+	BUTTON_EVENT_PRESS = 0, /// Button debounced to pressed
+	BUTTON_EVENT_RELEASE, /// Button debounced to released
+} Button_Event_Type;
+
+// @brief Clean button event
+typedef struct {
+	uint8_t line; /// EXTI line (pin number) of the button
+	Button_Event_Type type; /// Event type
+	uint32_t time; /// HAL tick when the state was confirmed
+} Button_Event;
+
 /**
- * @brief Initializes button and adds it to linked list
+ * @brief Initializes button and registers it for the EXTI line of its pin and for sampling
+ *
+ * A button registered later for the same EXTI line replaces the earlier one
  *
  * @param[out] button button to be initialized
  *
- * @param[in] gpio_pin GPIO pin that caused interrupt
+ * @param[in] gpio_port GPIO port button connected to
  *
  * @param gpio_pin GPIO pin button connected to
  */
 void button_init(volatile Button *button, GPIO_TypeDef* gpio_port, uint16_t gpio_pin);
 
 /**
- * @brief Checks button and returns detected button state
+ * @brief Sets timer driving button_sample every BUTTON_SAMPLE_PERIOD_MS
+ *
+ * The timer only runs while a button is pressed or bouncing,
+ * otherwise button EXTI lines are enabled to start it
+ *
+ * @param[in] htim sampling timer, its period elapsed callback must call button_sample
+ */
+void button_sampling_init(TIM_HandleTypeDef *htim);
+
+/**
+ * @brief Sets function called from sampling interrupt after each sample, it consumes queued events
+ *
+ * The callback returns true to keep sampling while it waits for a timeout
+ *
+ * @param callback function to call with the HAL tick, NULL to disable
+ */
+void button_set_sample_callback(bool (*callback)(uint32_t now));
+
+/**
+ * @brief Checks button and returns debounced button state
+ *
+ * A press shorter than the time between checks is still reported once
  *
  * @param[in]button is a button to check
  *
@@ -63,8 +107,50 @@ void button_init(volatile Button *button, GPIO_TypeDef* gpio_port, uint16_t gpio
 Button_State check_button_state(volatile Button *button);
 
 /**
- * @brief detect button GPIO state change using debouncing and save time when button pressed
+ * @brief Starts sampling on the first edge of an idle button, called from EXTI interrupt
+ *
+ * Button EXTI lines stay disabled while sampling, so a contact bouncing for
+ * less than BUTTON_SAMPLE_PERIOD_MS causes one EXTI interrupt per press.
+ * A longer bounce may stop sampling on a released sample and start it again
  *
  * @param gpio_pin is a pin that caused interrupt
  */
 void read_button(uint16_t gpio_pin);
+
+/**
+ * @brief Samples all button pins and debounces them, called from sampling timer interrupt
+ *
+ * Reads each port once and runs a 2-bit vertical counter per pin,
+ * a state change needs 4 equal samples in a row
+ */
+void button_sample(void);
+
+/**
+ * @brief Takes the oldest clean button event from the queue
+ *
+ * @param[out] event taken event
+ *
+ * @return false if the queue is empty
+ */
+bool button_get_event(Button_Event *event);
+
+/**
+ * @brief Checks whether button sampling is running
+ *
+ * @return true while a button is pressed or bouncing
+ */
+bool button_is_sampling(void);
+
+/**
+ * @brief Returns number of events lost because the queue was full
+ *
+ * @return dropped event count
+ */
+uint32_t button_get_dropped_events(void);
+
+/**
+ * @brief Returns number of interrupts from pins without a registered button
+ *
+ * @return unknown pin interrupt count
+ */
+uint32_t button_get_unknown_pin_count(void);
@@ -0,0 +1,134 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file char_gen_text.h
+ * @brief Text layer for the 7-segment character generator.
+ *
+ * Shows strings of arbitrary length on the 4-digit display. Decimal points are folded into the
+ * preceding digit, text longer than the display scrolls as a marquee. Scrolling is driven by
+ * char_gen_text_tick() from the 1 ms system tick, the frames are built by char_gen_text_render()
+ * in task context, so the application only submits text and runs the render on request.
+ */
+
+/**
+ * @addtogroup Character_Generator_Text
+ * @{
+ */
+
+#pragma once
+#include <stdint.h>
+#include "character_generator_api.h"
+
+/**
+ * @brief Maximum number of encoded glyphs (after folding decimal points) kept for one text.
+ */
+#define CHAR_GEN_TEXT_MAX_GLYPHS	32
+
+/**
+ * @brief Scroll step used until char_gen_text_set_scroll_period() is called, in milliseconds.
+ */
+#define CHAR_GEN_TEXT_DEFAULT_SCROLL_MS	300
+
+/**
+ * @brief Callback requesting a char_gen_text_render() call, runs in interrupt context.
+ */
+typedef void (*char_gen_text_redraw_callback_t)(void);
+
+/**
+ * @brief Submits text to be shown on the display.
+ *
+ * Encodes the whole string once. Text fitting the display is shown left aligned, longer text
+ * scrolls. Submitting text of the same encoded length keeps the scroll position, so a value
+ * refreshed in place does not restart the marquee. The display is updated by the render requested
+ * on the next tick.
+ *
+ * @param[in] text Null-terminated string, glyphs beyond CHAR_GEN_TEXT_MAX_GLYPHS are dropped.
+ * @param[in] brightness Array of 4 brightness levels, one per digit.
+ * @return char_generator_status_t Status of submission:
+ *         - CHAR_GEN_STATUS_OK: Text accepted.
+ *         - CHAR_GEN_STATUS_INVALID_PARAMETERS: @p text or @p brightness is NULL.
+ * @note Must be called from a single (non-interrupt) context.
+ */
+char_generator_status_t char_gen_text_show(const char *const text, const driver_7_seg_brightness_t *const brightness);
+
+/**
+ * @brief Submits pre-encoded segment codes to be shown on the display.
+ *
+ * Same as char_gen_text_show() for text already encoded, e.g. by a formatter writing segment codes.
+ *
+ * @param[in] codes Active-low segment codes, bit 7 is the decimal point.
+ * @param[in] length Number of codes, at most CHAR_GEN_TEXT_MAX_GLYPHS.
+ * @param[in] brightness Array of 4 brightness levels, one per digit.
+ * @return char_generator_status_t Status of submission:
+ *         - CHAR_GEN_STATUS_OK: Codes accepted.
+ *         - CHAR_GEN_STATUS_INVALID_PARAMETERS: NULL pointer or @p length too long.
+ * @note Must be called from the same context as char_gen_text_show().
+ */
+char_generator_status_t char_gen_text_show_codes(const uint8_t *const codes, const uint8_t length,
+                                                 const driver_7_seg_brightness_t *const brightness);
+
+/**
+ * @brief Sets the time between scroll steps.
+ *
+ * @param[in] period_ms Milliseconds per one-digit scroll step, 0 stops scrolling.
+ */
+void char_gen_text_set_scroll_period(const uint16_t period_ms);
+
+/**
+ * @brief Sets the function called when a frame must be rendered.
+ *
+ * @param[in] callback Called from char_gen_text_tick(), should only schedule char_gen_text_render().
+ *            NULL disables it.
+ */
+void char_gen_text_set_redraw_callback(const char_gen_text_redraw_callback_t callback);
+
+/**
+ * @brief Advances the text layer by 1 ms.
+ *
+ * Picks up newly submitted text and moves the scroll window when a step is due. When the window
+ * changed it flags a redraw and calls the redraw callback, the frame itself is not built here.
+ * Must be called every 1 ms from SysTick.
+ */
+void char_gen_text_tick(void);
+
+/**
+ * @brief Builds the frame for the current window and sends it to the driver.
+ *
+ * Does nothing unless the tick flagged a redraw. Only this function sends frames to the driver.
+ * @note Must be called from task context, the same one as char_gen_text_show().
+ */
+void char_gen_text_render(void);
+
+/**
+ * @brief Returns milliseconds until the tick that has work to do.
+ *
+ * @return uint32_t 1 if text is pending, ticks until the next scroll step, UINT32_MAX if the text is static.
+ * @note Used by the power manager to suppress ticks that would do nothing.
+ */
+uint32_t char_gen_text_get_idle_ms(void);
+
+/**
+ * @brief Accounts milliseconds that passed without char_gen_text_tick() calls.
+ *
+ * @param[in] elapsed_ms Skipped ticks, at most char_gen_text_get_idle_ms() - 1.
+ */
+void char_gen_text_skip_ms(const uint32_t elapsed_ms);
+
+/** @} */ // end of Character_Generator_Text
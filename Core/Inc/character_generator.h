@@ -78,11 +78,58 @@ char_generator_status_t char_gen_init(SPI_HandleTypeDef *const hspi, TIM_HandleT
  *         - CHAR_GEN_STATUS_INVALID_PARAMETERS: `config` is NULL or contains invalid characters.
  *         - CHAR_GEN_STATUS_NOT_TRANSMITTED: Driver failed to send data.
  * @pre char_gen_init must be called successfully prior to transmission.
- * @note Supported characters: '0'-'9', 'A', 'a', 'T', 't', 'P', 'p', '-'.
+ * @note Characters without a 7-segment glyph are displayed blank.
  * @note The `config->digits` array must contain exactly 4 elements.
  * @note The `config->periods` array must contain valid `period_status` values (PERIOD_ON or PERIOD_OFF).
  * @see char_gen_init
  */
 char_generator_status_t char_gen_transmit(const char_gen_data_t *const config);
 
+/**
+ * @brief Encodes a string and period mask into 16-bit driver words in one pass.
+ *
+ * Each output word holds the active-low segment data (including decimal point) in the upper 8 bits
+ * and the digit select bit in the lower 8 bits. Characters without a glyph are blank, positions
+ * past the end of the string are blank as well.
+ *
+ * @param[in] text Null-terminated string, characters beyond @p count are ignored.
+ * @param[in] period_mask Bit i set turns on the decimal point of digit i.
+ * @param[out] out Array of at least @p count driver words.
+ * @param[in] count Number of digits to encode (at most 8).
+ * @return char_generator_status_t Status of encoding:
+ *         - CHAR_GEN_STATUS_OK: Encoding successful.
+ *         - CHAR_GEN_STATUS_INVALID_PARAMETERS: @p count exceeds 8 digit select bits.
+ */
+char_generator_status_t char_gen_encode(const char *const text, const uint8_t period_mask,
+                                        uint16_t *const out, const uint8_t count);
+
+/**
+ * @brief Sends a 4-digit frame of driver words to the display unless it equals the last one sent.
+ *
+ * An identical frame costs only the comparison and is counted as suppressed.
+ *
+ * @param[in] data Array of 4 driver words.
+ * @param[in] brightness Array of 4 brightness levels.
+ * @return char_generator_status_t Status of transmission:
+ *         - CHAR_GEN_STATUS_OK: Frame sent or suppressed as unchanged.
+ *         - CHAR_GEN_STATUS_NOT_TRANSMITTED: Driver failed to send data.
+ * @note Must be called from a single context, the same one for all frames.
+ */
+char_generator_status_t char_gen_send_frame(const uint16_t *const data, const driver_7_seg_brightness_t *const brightness);
+
+/**
+ * @brief Copies counters of submitted and suppressed frames.
+ *
+ * @param[out] stats Pointer to the structure receiving the counters.
+ */
+void char_gen_get_stats(char_gen_stats_t *const stats);
+
+/**
+ * @brief Returns the 7-segment code of a single character.
+ *
+ * @param[in] ch Character to encode.
+ * @return uint8_t Active-low segment code (bit 7 is the decimal point), 0xFF for characters without a glyph.
+ */
+uint8_t char_gen_glyph(const char ch);
+
 /** @} */ // end of Character_Generator
@@ -74,6 +74,16 @@ typedef struct {
 	const driver_7_seg_brightness_t *const brightness;	/**< Pointer to the brightness setting for the display. */
 } char_gen_data_t;
 
+/**
+ * @struct char_gen_stats_t
+ * @brief Counters of frames sent to the driver and frames suppressed as identical to the last one.
+ */
+typedef struct
+{
+	uint32_t submitted;		/**< Frames passed to the driver. */
+	uint32_t suppressed;	/**< Frames equal to the last sent frame, not passed to the driver. */
+} char_gen_stats_t;
+
 /**
  * @struct char_gen_api_t
  * @brief API for character generator functions to initialize and transmit data to a 7-segment display.
@@ -112,10 +122,31 @@ typedef struct
 	 *         - CHAR_GEN_STATUS_INVALID_PARAMETERS if config is NULL, digits is not 4 characters,
 	 *           or contains unsupported characters.
 	 *         - CHAR_GEN_STATUS_NOT_TRANSMITTED if the driver fails to send the data.
-	 * @note Supported characters are: '0'-'9', 'A', 'a', 'T', 't', 'P', 'p', '-'.
+	 * @note Characters without a 7-segment glyph are displayed blank.
 	 * @note The digits string must be exactly 4 characters long, and periods must contain 4 elements.
 	 */
 	char_generator_status_t (*transmit)(const char_gen_data_t *const config);
+
+	/**
+	 * @brief Encodes a string and period mask into 16-bit driver words in one pass.
+	 *
+	 * @param text Null-terminated string, characters beyond count are ignored.
+	 * @param period_mask Bit i set turns on the decimal point of digit i.
+	 * @param out Array of at least count driver words.
+	 * @param count Number of digits to encode (at most 8).
+	 * @return char_generator_status_t The encoding status:
+	 *         - CHAR_GEN_STATUS_OK if successful.
+	 *         - CHAR_GEN_STATUS_INVALID_PARAMETERS if count exceeds 8 digit select bits.
+	 */
+	char_generator_status_t (*encode)(const char *const text, const uint8_t period_mask,
+			uint16_t *const out, const uint8_t count);
+
+	/**
+	 * @brief Copies counters of submitted and suppressed frames.
+	 *
+	 * @param stats Pointer to the structure receiving the counters.
+	 */
+	void (*get_stats)(char_gen_stats_t *const stats);
 } char_gen_api_t;
 
 /** @} */ // end of Character_Generator_API
@@ -0,0 +1,66 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+
+/*
+ * number of display digits written by the formatter
+ */
+#define DISPLAY_FORMAT_DIGITS 4
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	DISPLAY_FORMAT_STATUS_OK = 1,
+	DISPLAY_FORMAT_STATUS_HIGH,
+	DISPLAY_FORMAT_STATUS_LOW,
+} display_format_status_t;
+
+/*
+ * struct for holding the valid range of a value in hundredths.
+ * values outside of it are shown as "Hi"/"Lo"
+ */
+typedef struct {
+	int32_t min_centi;
+	int32_t max_centi;
+} display_format_range_t;
+
+/*
+ * writes unit glyph followed by value in hundredths into 4 segment codes.
+ * value is rounded to one decimal when it fits 3 digits ("C23.5", "C-9.9"),
+ * to an integer otherwise ("C-12", "F185"). values outside of range or
+ * of the 3 digits give unit followed by "Hi"/"Lo"
+ */
+display_format_status_t display_format_value(int32_t value_centi, char unit, const display_format_range_t *range,
+											 uint8_t codes[DISPLAY_FORMAT_DIGITS]);
+
+/*
+ * writes "----" into 4 segment codes
+ */
+void display_format_dashes(uint8_t codes[DISPLAY_FORMAT_DIGITS]);
+
+/*
+ * returns value in hundredths reduced to what the display can distinguish:
+ * rounded to tenths when shown with one decimal, to units times 10 when shown
+ * as an integer, INT32_MAX/INT32_MIN when shown as "Hi"/"Lo".
+ * equal results give equal segment codes for the same unit and the other way round
+ */
+int32_t display_format_quantize(int32_t value_centi, const display_format_range_t *range);
@@ -33,7 +33,22 @@ driver_7_seg_status_t driver_7_seg_init( SPI_HandleTypeDef *const hspi, TIM_Hand
  Sends a data buffer to the display with specified brightness levels.
  */
 driver_7_seg_status_t driver_7_seg_send_buffer(const uint16_t *const data, const driver_7_seg_brightness_t *const brightness_level, const uint8_t size);
+/*
+ Sets master brightness on the gamma-corrected 0-255 scale.
+ */
+driver_7_seg_status_t driver_7_seg_set_brightness( const uint8_t level );
 
+/*
+ Stops the refresh and blanks the display.
+ */
+driver_7_seg_status_t driver_7_seg_suspend( void );
 
+/*
+ Restarts the refresh stopped by driver_7_seg_suspend.
+ */
+driver_7_seg_status_t driver_7_seg_resume( void );
 
-
+/*
+ Returns number of DMA errors since init, the refresh is restarted after each.
+ */
+uint32_t driver_7_seg_get_dma_errors( void );
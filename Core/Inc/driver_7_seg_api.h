@@ -35,15 +35,17 @@ typedef enum
 
 /*
   Enum of brightness levels for the 7-segment display.
+  Levels are points on the gamma-corrected 0-255 scale, evenly spaced in
+  perceived brightness. Any value of the scale can be used as a level.
  */
 typedef enum
 {
-	LEVEL_5_MAX = 0,
-	LEVEL_4 = 1,
-	LEVEL_3 = 5,
-	LEVEL_2 = 15,
-	LEVEL_1_MIN = 30,
-	NOT_USED = 255,
+	LEVEL_5_MAX = 255,
+	LEVEL_4 = 200,
+	LEVEL_3 = 150,
+	LEVEL_2 = 100,
+	LEVEL_1_MIN = 50,
+	NOT_USED = 0,
 } driver_7_seg_brightness_t;
 
 /*
@@ -60,6 +62,18 @@ typedef struct
      Sends a data buffer to the display with specified brightness levels.
      */
     driver_7_seg_status_t (*send_buffer) (const uint16_t *const data, const driver_7_seg_brightness_t *const brightness_level, const uint8_t size);
+     /*
+     Sets master brightness on the gamma-corrected 0-255 scale, applied to all segment levels.
+     */
+    driver_7_seg_status_t (*set_brightness) (const uint8_t level);
+     /*
+     Stops the refresh and blanks the display, e.g. before entering Stop mode.
+     */
+    driver_7_seg_status_t (*suspend) (void);
+     /*
+     Restarts the refresh stopped by suspend.
+     */
+    driver_7_seg_status_t (*resume) (void);
 
 } driver_7_seg_api_t;
 
@@ -0,0 +1,117 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "sample_codec.h"
+
+/*
+ * bytes programmed at once, samples are collected in RAM until a page is full
+ */
+#define FLASH_LOG_PAGE_SIZE 256
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	FLASH_LOG_STATUS_OK = 1,
+	FLASH_LOG_STATUS_NOT_MOUNTED,
+	FLASH_LOG_STATUS_FLASH_ERROR,
+} flash_log_status_t;
+
+/*
+ * struct for holding one logged sample.
+ * boot counts resets since the log was formatted, time is HAL tick of that boot rounded down to seconds
+ */
+typedef struct {
+	uint32_t raw_humidity;
+	uint32_t raw_temperature;
+	uint16_t boot;
+	uint32_t time_ms;
+} flash_log_sample_t;
+
+/*
+ * struct for walking the log from the oldest sample, decoder reads the current page
+ */
+typedef struct {
+	uint8_t step;
+	uint16_t page;
+	uint8_t slot;
+	sample_codec_decoder_t decoder;
+} flash_log_iterator_t;
+
+/*
+ * struct for holding log statistics.
+ * cycles are core clock cycles measured with DWT
+ */
+typedef struct {
+	uint32_t mount_cycles;
+	uint32_t last_program_cycles;
+	uint32_t last_erase_cycles;
+	uint32_t last_encode_cycles;
+	uint32_t pages_written;
+	uint32_t samples_written;
+	uint32_t erases;
+	uint32_t erase_failures;
+	uint32_t max_erase_count;
+	uint16_t boot;
+} flash_log_stats_t;
+
+/*
+ * finds the active sector and the first free page, formats an empty log.
+ * the free page is found with a binary search, mount time doesn't grow with the log
+ */
+flash_log_status_t flash_log_mount(void);
+
+/*
+ * adds sample to the RAM page, programs the page when full.
+ * samples are compressed with sample_codec, time is kept in whole seconds.
+ * a full sector makes the log continue in the next one, erasing its oldest samples
+ */
+flash_log_status_t flash_log_append(uint32_t raw_humidity, uint32_t raw_temperature, uint32_t time_ms);
+
+/*
+ * programs the RAM page even if not full
+ */
+flash_log_status_t flash_log_flush(void);
+
+/*
+ * erases the next sector ahead of time when the active one is nearly full.
+ * the erase stalls the core for 1-2 s, it should run from a low priority task at a quiet moment.
+ * without it the erase happens in flash_log_append when the active sector is full.
+ * a failed erase isn't retried before a back-off time of 10 s, doubled on every failure up to 1 h
+ */
+flash_log_status_t flash_log_prepare(void);
+
+/*
+ * starts walking the log from the oldest sample
+ */
+void flash_log_iterator_init(flash_log_iterator_t *iterator);
+
+/*
+ * reads the next sample, returns false at the end of the log.
+ * pages with a bad CRC, left by a power loss while programming, are skipped
+ */
+bool flash_log_next(flash_log_iterator_t *iterator, flash_log_sample_t *sample);
+
+/*
+ * copies log statistics
+ */
+void flash_log_get_stats(flash_log_stats_t *stats);
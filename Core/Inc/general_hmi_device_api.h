@@ -27,8 +27,21 @@
 typedef enum {
 	HMI_NO_EVENT = 0, /// HMI no event code
 	HMI_SHORT_EVENT, /// HMI short event code
+	HMI_LONG_EVENT, /// HMI long event code
+	HMI_REPEAT_EVENT, /// HMI auto-repeat event code while long activation continues
+	HMI_DOUBLE_EVENT, /// HMI double activation event code
+	HMI_CHORD_EVENT, /// HMI event code for two devices activated together
 } HMI_Interact_Status_t;
 
+/// @brief Timestamped HMI gesture
+typedef struct {
+	HMI_Interact_Status_t type; /// Gesture type
+	uint16_t gpio_pins; /// Pins of the devices making the gesture, two pins for a chord
+	uint16_t repeat_count; /// Number of the repeat, 1 for the first HMI_REPEAT_EVENT
+	uint32_t press_time; /// HAL tick when the gesture started
+	uint32_t time; /// HAL tick when the gesture was recognized
+} HMI_Gesture_Event_t;
+
 /**
  * brief Interface for handling HMI device operation
  *
@@ -52,7 +65,6 @@ typedef struct {
 	 *
 	 * @return Interaction status change
 	 * @retval HMI_SHORT_EVENT On transition from deactivated state to activated state
-	 * @retval HMI_LONG_EVENT On transition from activated state to long activation state
 	 * @retval HMI_NO_EVENT When state doesn't change and on transition to deactivated state
 	 */
 	HMI_Interact_Status_t (*check_device_status_change)(void *device);
@@ -75,4 +87,13 @@ typedef struct {
 	 * @param gpio_pin GPIO pin that triggered the interrupt
 	 */
 	void (*device_interrupt_handle)(uint16_t gpio_pin);
+
+	/**
+	 * @brief Takes the oldest recognized gesture
+	 *
+	 * @param[out] event taken gesture
+	 *
+	 * @return false if no gesture is queued
+	 */
+	bool (*get_gesture)(HMI_Gesture_Event_t *event);
 } hmi_device_handler_t;
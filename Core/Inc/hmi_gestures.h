@@ -0,0 +1,76 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk, Eldar Vanin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "general_hmi_device_api.h"
+
+/// Press held this long is a long press, in milliseconds
+#define HMI_GESTURE_LONG_MS 800
+
+/// Delay from long press to the first repeat, in milliseconds
+#define HMI_GESTURE_REPEAT_DELAY_MS 400
+
+/// Period of repeats while the press is held, in milliseconds
+#define HMI_GESTURE_REPEAT_PERIOD_MS 200
+
+/// Second press must start within this time after the first release, in milliseconds
+#define HMI_GESTURE_DOUBLE_MS 300
+
+/// Presses of two buttons starting within this time make a chord, in milliseconds
+#define HMI_GESTURE_CHORD_MS 150
+
+/// Number of gestures the queue holds
+#define HMI_GESTURE_QUEUE_SIZE 16
+
+// @brief Gesture engine configuration
+typedef struct {
+	uint16_t double_click_pins; /// Pins recognizing double clicks, their short press is reported after HMI_GESTURE_DOUBLE_MS. A second press held for HMI_GESTURE_LONG_MS reports the first one as short and itself as long
+} HMI_Gesture_Config_t;
+
+/**
+ * @brief Starts recognizing gestures from debounced button events
+ *
+ * Recognition runs in the button sampling interrupt, gestures are queued
+ *
+ * @param[in] config engine configuration
+ */
+void hmi_gestures_init(const HMI_Gesture_Config_t *config);
+
+/**
+ * @brief Sets function called from interrupt after new gestures were queued
+ *
+ * @param callback function to call, NULL to disable
+ */
+void hmi_gestures_set_callback(void (*callback)(void));
+
+/**
+ * @brief Takes the oldest recognized gesture
+ *
+ * @param[out] event taken gesture
+ *
+ * @return false if no gesture is queued
+ */
+bool hmi_gestures_get_event(HMI_Gesture_Event_t *event);
+
+/**
+ * @brief Returns number of gestures lost because the queue was full
+ *
+ * @return dropped gesture count
+ */
+uint32_t hmi_gestures_get_dropped_events(void);
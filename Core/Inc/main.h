@@ -50,9 +50,14 @@ extern "C" {
 /* remove the comment to enable debugging messages via UART */
 //#define DEBUGGING
 
+/* remove the comment to enable interrupt cycle measurments with DWT, see profiler.h */
+//#define PROFILING
+
 /* USER CODE END EM */
 
 /* Exported functions prototypes ---------------------------------------------*/
+void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim);
+
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
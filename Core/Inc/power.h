@@ -0,0 +1,85 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	POWER_STATUS_OK = 1,
+	POWER_STATUS_INVALID_PARAMETERS,
+	POWER_STATUS_NO_LSI,
+} power_status_t;
+
+/*
+ * struct for holding power manager configuration.
+ * restore_clock brings back the system clock after Stop mode (wakeup runs on HSI).
+ * can_stop returns true when no peripheral needs clocks, NULL never allows Stop mode.
+ * tick_client_idle_ms/tick_client_skip_ms describe a module driven from SysTick:
+ * milliseconds until its tick has work and accounting of ticks suppressed during sleep. both can be NULL
+ */
+typedef struct {
+	void (*restore_clock)(void);
+	bool (*can_stop)(void);
+	uint32_t (*tick_client_idle_ms)(void);
+	void (*tick_client_skip_ms)(uint32_t elapsed_ms);
+} power_config_t;
+
+/*
+ * struct for holding time spent in each mode since power_init, in milliseconds
+ */
+typedef struct {
+	uint32_t active_ms;
+	uint32_t sleep_ms;
+	uint32_t stop_ms;
+	uint32_t sleeps;
+	uint32_t stops;
+	uint32_t suppressed_ticks;
+} power_stats_t;
+
+/*
+ * starts LSI and the RTC used as Stop mode wakeup and time reference,
+ * measures LSI frequency against the system clock
+ */
+power_status_t power_init(const power_config_t *config);
+
+/*
+ * scheduler idle hook, called with interrupts masked.
+ * sleeps until the next scheduler release: Stop mode if allowed, otherwise
+ * Sleep mode with SysTick stretched over the whole idle time. HAL_GetTick is compensated
+ */
+void power_idle(void);
+
+/*
+ * RTC wakeup interrupt handler, clears wakeup flags
+ */
+void power_rtc_wakeup_irq(void);
+
+/*
+ * copies time spent in each mode
+ */
+void power_get_stats(power_stats_t *stats);
+
+/*
+ * prints time spent in each mode and active share of each scheduler task with printf
+ */
+void power_dump(void);
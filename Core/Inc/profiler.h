@@ -0,0 +1,88 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "main.h"
+
+/*
+ * measured interrupt handlers and callbacks
+ */
+typedef enum {
+	PROFILER_TIM6_IRQ = 0,
+	PROFILER_SPI1_IRQ,
+	PROFILER_EXTI1_IRQ,
+	PROFILER_EXTI4_IRQ,
+	PROFILER_I2C1_EV_IRQ,
+	PROFILER_I2C1_ER_IRQ,
+	PROFILER_DMA1_STREAM0_IRQ,
+	PROFILER_DMA1_STREAM6_IRQ,
+	PROFILER_DMA1_STREAM7_IRQ,
+	PROFILER_DMA2_STREAM1_IRQ,
+	PROFILER_DISPLAY_FRAME_CALLBACK,
+	PROFILER_GPIO_EXTI_CALLBACK,
+	PROFILER_ID_COUNT,
+} profiler_id_t;
+
+/*
+ * struct for holding cycle statistics of one measured function
+ */
+typedef struct {
+	uint32_t count;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint32_t avg_cycles;
+	uint64_t total_cycles;
+	uint32_t load_permille; /* share of cpu time since reset, 1/1000 */
+} profiler_stats_t;
+
+/*
+ * macros for measuring a block of code. compiled out when PROFILING is not defined in main.h
+ */
+#ifdef PROFILING
+#define PROFILER_BEGIN(start) const uint32_t start = DWT->CYCCNT
+#define PROFILER_END(id, start) profiler_record((id), DWT->CYCCNT - (start))
+#else
+#define PROFILER_BEGIN(start)
+#define PROFILER_END(id, start)
+#endif
+
+/*
+ * enables DWT cycle counter and clears statistics
+ */
+void profiler_init(void);
+
+/*
+ * clears statistics
+ */
+void profiler_reset(void);
+
+/*
+ * adds one measurment of given function
+ */
+void profiler_record(profiler_id_t id, uint32_t cycles);
+
+/*
+ * copies statistics of given function
+ */
+void profiler_get_stats(profiler_id_t id, profiler_stats_t *stats);
+
+/*
+ * prints statistics of all functions with printf
+ */
+void profiler_dump(void);
@@ -0,0 +1,95 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * largest encoded sample in bits: both raw values and the time escaped
+ */
+#define SAMPLE_CODEC_MAX_SAMPLE_BITS 122
+
+/*
+ * channels of a sample: raw humidity, raw temperature, time in seconds
+ */
+#define SAMPLE_CODEC_CHANNELS 3
+
+/*
+ * struct for holding prediction state, kept the same by encoder and decoder.
+ * raw values are predicted by the previous value, time by the previous time step.
+ * mean is the running mean of the zigzag residual times 16, it selects the Rice parameter
+ */
+typedef struct {
+	uint32_t previous[SAMPLE_CODEC_CHANNELS];
+	uint32_t previous_step;
+	uint32_t mean[SAMPLE_CODEC_CHANNELS];
+	bool started;
+} sample_codec_state_t;
+
+/*
+ * struct for holding encoder state, bits are written LSB first into data
+ */
+typedef struct {
+	sample_codec_state_t state;
+	uint8_t *data;
+	uint32_t capacity;
+	uint32_t position;
+	uint32_t bits;
+	uint8_t bit_count;
+} sample_codec_encoder_t;
+
+/*
+ * struct for holding decoder state
+ */
+typedef struct {
+	sample_codec_state_t state;
+	const uint8_t *data;
+	uint32_t length;
+	uint32_t position;
+	uint32_t bits;
+	uint8_t bit_count;
+} sample_codec_decoder_t;
+
+/*
+ * starts a stream in data, capacity in bytes
+ */
+void sample_codec_encoder_init(sample_codec_encoder_t *encoder, uint8_t *data, uint32_t capacity);
+
+/*
+ * encodes one sample: 20 bit raw values and time in seconds.
+ * returns false without writing if a worst case sample might not fit
+ */
+bool sample_codec_encode(sample_codec_encoder_t *encoder, uint32_t raw_humidity, uint32_t raw_temperature, uint32_t time_s);
+
+/*
+ * writes the last partial byte, returns stream length in bytes
+ */
+uint32_t sample_codec_finish(sample_codec_encoder_t *encoder);
+
+/*
+ * starts reading a stream of length bytes
+ */
+void sample_codec_decoder_init(sample_codec_decoder_t *decoder, const uint8_t *data, uint32_t length);
+
+/*
+ * decodes the next sample, returns false when the stream ends.
+ * the stream doesn't mark its end, the caller keeps the number of samples
+ */
+bool sample_codec_decode(sample_codec_decoder_t *decoder, uint32_t *raw_humidity, uint32_t *raw_temperature, uint32_t *time_s);
@@ -0,0 +1,96 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	SAMPLE_RATE_STATUS_OK = 1,
+	SAMPLE_RATE_STATUS_INVALID_PARAMETERS,
+} sample_rate_status_t;
+
+/*
+ * struct for holding sampling controller configuration.
+ * intervals bound the time between measurements, in milliseconds.
+ * slopes are thresholds in centi-units per minute, changes below the noise bands are never fast.
+ * after stable_samples measurements without a fast change the interval is doubled.
+ * bus_us_per_sample and baseline_interval_ms are only used for the bus time saved statistic
+ */
+typedef struct {
+	uint32_t min_interval_ms;
+	uint32_t max_interval_ms;
+	uint32_t temperature_slope_centi;
+	uint32_t humidity_slope_centi;
+	uint32_t temperature_noise_centi;
+	uint32_t humidity_noise_centi;
+	uint8_t stable_samples;
+	uint32_t bus_us_per_sample;
+	uint32_t baseline_interval_ms;
+} sample_rate_config_t;
+
+/*
+ * struct for holding controller state.
+ * reference values are taken at the start of the current window, slopes are measured against them
+ */
+typedef struct {
+	sample_rate_config_t config;
+	uint32_t interval_ms;
+	int32_t reference_temperature_centi;
+	int32_t reference_humidity_centi;
+	uint32_t reference_time;
+	uint8_t stable_count;
+	bool has_reference;
+	uint32_t start_time;
+	uint32_t samples;
+} sample_rate_t;
+
+/*
+ * struct for holding controller statistics.
+ * effective rate is in samples per hour, bus time saved is compared to baseline_interval_ms cadence
+ */
+typedef struct {
+	uint32_t interval_ms;
+	uint32_t samples;
+	uint32_t samples_per_hour;
+	uint32_t bus_saved_ms;
+} sample_rate_stats_t;
+
+/*
+ * checks configuration and starts at the fastest interval
+ */
+sample_rate_status_t sample_rate_init(sample_rate_t *rate, const sample_rate_config_t *config, uint32_t now);
+
+/*
+ * changes the slowest interval, the current interval is clamped to it
+ */
+sample_rate_status_t sample_rate_set_max_interval(sample_rate_t *rate, uint32_t max_interval_ms);
+
+/*
+ * adds a measurement and returns the interval until the next one
+ */
+uint32_t sample_rate_update(sample_rate_t *rate, int32_t temperature_centi, int32_t humidity_centi, uint32_t now);
+
+/*
+ * writes current interval, effective rate and bus time saved
+ */
+void sample_rate_get_stats(const sample_rate_t *rate, uint32_t now, sample_rate_stats_t *stats);
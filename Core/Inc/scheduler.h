@@ -0,0 +1,136 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+
+/*
+ * max number of tasks and of events waiting for dispatch
+ */
+#define SCHEDULER_MAX_TASKS 8
+#define SCHEDULER_EVENT_QUEUE_SIZE 16
+
+/*
+ * events are numbered 0..31, a task subscribes with a mask of event bits
+ */
+#define SCHEDULER_EVENT_BIT(event) (1UL << (event))
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	SCHEDULER_STATUS_OK = 1,
+	SCHEDULER_STATUS_INVALID_PARAMETERS,
+	SCHEDULER_STATUS_FULL,
+} scheduler_status_t;
+
+/*
+ * task function, runs to completion
+ */
+typedef void (*scheduler_task_fn_t)(void);
+
+/*
+ * idle hook, called with interrupts masked when nothing is ready.
+ * an interrupt still wakes __WFI and is taken after the hook returns
+ */
+typedef void (*scheduler_idle_fn_t)(void);
+
+/*
+ * struct for holding task configuration.
+ * period_ms 0 makes the task event-only, event_mask 0 makes it periodic-only.
+ * deadline_ms is the allowed time from release to completion, 0 disables the check
+ */
+typedef struct {
+	const char *name;
+	scheduler_task_fn_t run;
+	uint32_t period_ms;
+	uint32_t deadline_ms;
+	uint32_t event_mask;
+} scheduler_task_config_t;
+
+/*
+ * struct for holding per task statistics, run time in cpu cycles
+ */
+typedef struct {
+	uint32_t runs;
+	uint32_t last_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+	uint32_t deadline_misses;
+	uint32_t max_latency_ms;
+} scheduler_task_stats_t;
+
+/*
+ * clears tasks, events and statistics, enables the cycle counter
+ */
+void scheduler_init(void);
+
+/*
+ * adds task, tasks added first run first when ready at the same time.
+ * task_id can be NULL
+ */
+scheduler_status_t scheduler_add_task(const scheduler_task_config_t *config, uint8_t *task_id);
+
+/*
+ * changes period of a task, next release is one new period from now
+ */
+scheduler_status_t scheduler_set_period(uint8_t task_id, uint32_t period_ms);
+
+/*
+ * queues event for subscribed tasks. safe to call from interrupts
+ */
+scheduler_status_t scheduler_post_event(uint8_t event);
+
+/*
+ * sets function called when nothing is ready, NULL restores default __WFI
+ */
+void scheduler_set_idle_hook(scheduler_idle_fn_t hook);
+
+/*
+ * dispatches queued events and runs every ready task once.
+ * an event run of a task whose period is due counts as the periodic run.
+ * calls idle hook if nothing was ready
+ */
+void scheduler_run_once(void);
+
+/*
+ * returns milliseconds until the next periodic release, 0 if a task or event is ready.
+ * UINT32_MAX if no task is periodic. used by the idle hook to choose how long to sleep
+ */
+uint32_t scheduler_get_idle_ms(void);
+
+/*
+ * runs the scheduler forever
+ */
+void scheduler_run(void);
+
+/*
+ * copies statistics of a task
+ */
+scheduler_status_t scheduler_get_stats(uint8_t task_id, scheduler_task_stats_t *stats);
+
+/*
+ * returns number of events lost because the queue was full
+ */
+uint32_t scheduler_get_dropped_events(void);
+
+/*
+ * prints statistics of all tasks with printf
+ */
+void scheduler_dump(void);
@@ -0,0 +1,97 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+
+/*
+ * max number of samples kept by the filter
+ */
+#define SENSOR_FILTER_MAX_SAMPLES 16
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	SENSOR_FILTER_STATUS_OK = 1,
+	SENSOR_FILTER_STATUS_INVALID_PARAMETERS,
+} sensor_filter_status_t;
+
+/*
+ * enum for filter selection
+ */
+typedef enum {
+	SENSOR_FILTER_NONE = 0,
+	SENSOR_FILTER_MOVING_AVERAGE,
+	SENSOR_FILTER_MEDIAN,
+	SENSOR_FILTER_EMA,
+} sensor_filter_mode_t;
+
+/*
+ * struct for holding filter configuration.
+ * window is used by moving average and median, 1..SENSOR_FILTER_MAX_SAMPLES.
+ * ema_alpha is the weight of a new sample in 1/256 units, 1..256
+ */
+typedef struct {
+	sensor_filter_mode_t mode;
+	uint8_t window;
+	uint16_t ema_alpha;
+} sensor_filter_config_t;
+
+/*
+ * struct for holding history of one measured value
+ */
+typedef struct {
+	uint32_t samples[SENSOR_FILTER_MAX_SAMPLES];
+	uint32_t sum;
+	uint32_t ema;
+} sensor_filter_channel_t;
+
+/*
+ * struct for holding filter state for raw humidity and raw temperature
+ */
+typedef struct {
+	sensor_filter_config_t config;
+	sensor_filter_channel_t humidity;
+	sensor_filter_channel_t temperature;
+	uint8_t head;
+	uint8_t count;
+} sensor_filter_t;
+
+/*
+ * checks configuration and clears filter history
+ */
+sensor_filter_status_t sensor_filter_init(sensor_filter_t *filter, const sensor_filter_config_t *config);
+
+/*
+ * changes configuration keeping the history.
+ * the newest samples that fit the new window stay, the ema state is kept
+ */
+sensor_filter_status_t sensor_filter_set_config(sensor_filter_t *filter, const sensor_filter_config_t *config);
+
+/*
+ * clears filter history, next sample starts the filter again
+ */
+void sensor_filter_reset(sensor_filter_t *filter);
+
+/*
+ * adds raw sample to the filter and writes filtered raw values
+ */
+void sensor_filter_push(sensor_filter_t *filter, uint32_t raw_humidity, uint32_t raw_temperature,
+						uint32_t *filtered_humidity, uint32_t *filtered_temperature);
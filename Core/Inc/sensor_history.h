@@ -0,0 +1,91 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+
+/*
+ * max number of samples kept, a multiple of the block size.
+ * appended every 30 s this covers 68 h in 48 KB
+ */
+#define SENSOR_HISTORY_CAPACITY 8192
+
+/*
+ * samples per summary block, oldest samples are dropped one block at a time
+ */
+#define SENSOR_HISTORY_BLOCK_SIZE 64
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	SENSOR_HISTORY_STATUS_OK = 1,
+	SENSOR_HISTORY_STATUS_INVALID_PARAMETERS,
+} sensor_history_status_t;
+
+/*
+ * struct for holding one sample, raw values are 20 bit as sent by the sensor
+ */
+typedef struct {
+	uint32_t raw_humidity;
+	uint32_t raw_temperature;
+	uint32_t time_ms;
+} sensor_history_sample_t;
+
+/*
+ * struct for holding raw value statistics of a window
+ */
+typedef struct {
+	uint32_t count;
+	uint32_t min_humidity;
+	uint32_t max_humidity;
+	uint32_t mean_humidity;
+	uint32_t min_temperature;
+	uint32_t max_temperature;
+	uint32_t mean_temperature;
+} sensor_history_summary_t;
+
+/*
+ * removes all samples
+ */
+void sensor_history_reset(void);
+
+/*
+ * adds sample, drops the oldest block when full. constant time.
+ * time gaps longer than 255 s are stored as 255 s
+ */
+void sensor_history_append(uint32_t raw_humidity, uint32_t raw_temperature, uint32_t time_ms);
+
+/*
+ * returns number of samples kept
+ */
+uint32_t sensor_history_count(void);
+
+/*
+ * reads sample by index, 0 is the oldest.
+ * not constant time: the time is rebuilt from the start of the block of the sample,
+ * adding up to SENSOR_HISTORY_BLOCK_SIZE - 1 one byte deltas, 63 at most
+ */
+sensor_history_status_t sensor_history_get(uint32_t index, sensor_history_sample_t *sample);
+
+/*
+ * computes min, max and mean of count samples starting at index first.
+ * whole blocks are taken from their summaries, only partial blocks at the ends are scanned
+ */
+sensor_history_status_t sensor_history_query(uint32_t first, uint32_t count, sensor_history_summary_t *summary);
@@ -56,11 +56,17 @@ void DebugMon_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
 void EXTI1_IRQHandler(void);
+void DMA1_Stream0_IRQHandler(void);
 void EXTI4_IRQHandler(void);
+void I2C1_EV_IRQHandler(void);
+void I2C1_ER_IRQHandler(void);
 void SPI1_IRQHandler(void);
 void TIM6_DAC_IRQHandler(void);
+void DMA1_Stream7_IRQHandler(void);
+void DMA2_Stream1_IRQHandler(void);
 /* USER CODE BEGIN EFP */
-
+void RTC_WKUP_IRQHandler(void);
+void DMA1_Stream6_IRQHandler(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
@@ -0,0 +1,78 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "telemetry_frame.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * bytes collected in each of the two transmit buffers
+ */
+#define TELEMETRY_BUFFER_SIZE 256
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	TELEMETRY_STATUS_OK = 1,
+	TELEMETRY_STATUS_INVALID_PARAMETERS,
+	TELEMETRY_STATUS_NOT_INITIALIZED,
+	TELEMETRY_STATUS_FULL,
+} telemetry_status_t;
+
+/*
+ * struct for holding transmit counters
+ */
+typedef struct {
+	uint32_t frames_queued;
+	uint32_t frames_dropped;
+	uint32_t bytes_sent;
+	uint32_t transfers;
+	uint32_t dma_errors;
+	uint16_t max_fill;
+} telemetry_stats_t;
+
+/*
+ * sets up USART2 transmitter on the USART_TX pin and DMA1 stream 6 channel 4 at baud_rate.
+ * pins are configured by MX_GPIO_Init, DMA clock by MX_DMA_Init
+ */
+telemetry_status_t telemetry_init(uint32_t baud_rate);
+
+/*
+ * queues sample frame and returns without waiting for the serial port.
+ * frames are collected in one buffer while DMA sends the other,
+ * a frame not fitting in the collecting buffer is dropped. sequence is set here
+ */
+telemetry_status_t telemetry_send_sample(const telemetry_sample_t *sample);
+
+/*
+ * returns true while a transfer runs or the last byte is still being shifted out, used as Stop mode check
+ */
+bool telemetry_is_busy(void);
+
+/*
+ * DMA1 stream 6 interrupt handler, starts the collected buffer when a transfer completes
+ */
+void telemetry_dma_irq(void);
+
+/*
+ * copies transmit counters
+ */
+void telemetry_get_stats(telemetry_stats_t *stats);
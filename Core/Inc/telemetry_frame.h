@@ -0,0 +1,89 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * size of the AHT20 frame carried in a sample: status, 5 data bytes, CRC
+ */
+#define TELEMETRY_RAW_FRAME_SIZE 7
+
+/*
+ * frame before COBS: type, sequence, time, raw frame, converted values, flags, CRC-16
+ */
+#define TELEMETRY_FRAME_PAYLOAD_SIZE (1 + 2 + 4 + TELEMETRY_RAW_FRAME_SIZE + 2 + 2 + 1 + 2)
+
+/*
+ * largest frame on the wire: COBS adds one byte per 254 and the zero delimiter ends the frame
+ */
+#define TELEMETRY_FRAME_MAX_SIZE (TELEMETRY_FRAME_PAYLOAD_SIZE + TELEMETRY_FRAME_PAYLOAD_SIZE / 254 + 2)
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	TELEMETRY_FRAME_STATUS_OK = 1,
+	TELEMETRY_FRAME_STATUS_BAD_FRAMING,
+	TELEMETRY_FRAME_STATUS_BAD_CRC,
+	TELEMETRY_FRAME_STATUS_BAD_TYPE,
+} telemetry_frame_status_t;
+
+/*
+ * frame types
+ */
+typedef enum {
+	TELEMETRY_FRAME_SAMPLE = 1,
+} telemetry_frame_type_t;
+
+/*
+ * sample status flags
+ */
+typedef enum {
+	TELEMETRY_FLAG_LOGGED = 0x01,
+	TELEMETRY_FLAG_FILTERED = 0x02,
+	TELEMETRY_FLAG_MIN_INTERVAL = 0x04,
+	TELEMETRY_FLAG_DISPLAY_ON = 0x08,
+} telemetry_flag_t;
+
+/*
+ * struct for holding one sample frame.
+ * sequence counts every frame offered for sending, a gap on the host means dropped frames.
+ * converted values are filtered, in hundredths of C and %RH
+ */
+typedef struct {
+	uint16_t sequence;
+	uint32_t time_ms;
+	uint8_t raw[TELEMETRY_RAW_FRAME_SIZE];
+	int16_t temperature_centi;
+	int16_t humidity_centi;
+	uint8_t flags;
+} telemetry_sample_t;
+
+/*
+ * writes COBS encoded frame with CRC and zero delimiter to out.
+ * returns bytes written, 0 if capacity is less than TELEMETRY_FRAME_MAX_SIZE
+ */
+uint16_t telemetry_frame_encode(const telemetry_sample_t *sample, uint8_t *out, uint16_t capacity);
+
+/*
+ * decodes one frame received between zero delimiters, the delimiter isn't included in length
+ */
+telemetry_frame_status_t telemetry_frame_decode(const uint8_t *frame, uint16_t length, telemetry_sample_t *sample);
@@ -73,20 +73,210 @@ static uint8_t ACK_CMD = 0x06;
  */
 static uint8_t NACK_CMD = 0x15;
 
+/*
+ * time needed for the sensor to finish the measurment
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 3
+ */
+static const uint32_t MEASURE_TIME_MS = 80;
+
+/*
+ * time between status reads while the sensor is still busy
+ */
+static const uint32_t BUSY_RETRY_MS = 10;
+
+/*
+ * time after which a measurment still reported as busy is dropped
+ */
+static const uint32_t MEASURE_TIMEOUT_MS = 200;
+
+/*
+ * time the sensor needs after a soft reset
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.5 Soft reset
+ */
+static const uint32_t SOFT_RESET_TIME_MS = 20;
+
+/*
+ * size of the frame read after the measurment
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 4
+ */
+#define FRAME_SIZE 7
+
+/*
+ * number of frames the transfer callbacks can queue before they are collected
+ */
+#define RESULT_QUEUE_SIZE 4
+
+/*
+ * bits on the bus per transferred byte, 8 data bits and acknowledge
+ */
+static const uint32_t BITS_PER_BYTE = 9;
+
+/*
+ * extra time added to every transfer for clock stretching and interrupt latency
+ */
+static const uint32_t TIMEOUT_MARGIN_MS = 2;
+
+/*
+ * half period of the clock generated during bus recovery, ~100 kHz
+ */
+static const uint32_t RECOVERY_HALF_PERIOD_US = 5;
+
+/*
+ * number of clock pulses needed to release a slave stuck in the middle of a byte
+ */
+static const uint8_t RECOVERY_CLOCK_PULSES = 9;
+
+/*
+ * time the sensor is kept without power during the power cycle
+ */
+static const uint32_t POWER_OFF_TIME_MS = 10;
+
+/*
+ * I2C_VCC_Pin levels. MX_GPIO_Init leaves the pin at GPIO_PIN_RESET while the sensor runs
+ */
+static const GPIO_PinState SENSOR_POWER_ON = GPIO_PIN_RESET;
+static const GPIO_PinState SENSOR_POWER_OFF = GPIO_PIN_SET;
+
+/*
+ * states of the measurment state machine
+ */
+typedef enum {
+	MEASUREMENT_IDLE,
+	MEASUREMENT_TRIGGERING,
+	MEASUREMENT_CONVERTING,
+	MEASUREMENT_READING,
+	MEASUREMENT_RESETTING,
+} aht20_measurement_state_t;
+
+/*
+ * struct for holding measurment state machine data
+ */
+typedef struct {
+	volatile aht20_measurement_state_t state;
+	aht20_transport_t transport;
+	I2C_HandleTypeDef *hi2c;
+	uint32_t start_tick;
+	uint32_t deadline_tick;
+	uint8_t reset_sent;
+} aht20_measurement_t;
+
+/*
+ * frame received in background together with its transfer status
+ */
+typedef struct {
+	uint8_t data[FRAME_SIZE];
+	aht20_status_t status;
+} aht20_result_t;
+
+/*
+ * queue filled by the transfer complete callbacks and emptied by aht20_poll_measurement.
+ * the callbacks only move head and the poll only moves tail
+ */
+typedef struct {
+	aht20_result_t results[RESULT_QUEUE_SIZE];
+	volatile uint8_t head;
+	volatile uint8_t tail;
+} aht20_result_queue_t;
+
+/*
+ * measurment in progress
+ */
+static aht20_measurement_t measurement = {
+		.state = MEASUREMENT_IDLE,
+		.transport = AHT20_TRANSPORT_BLOCKING,
+};
+
+/*
+ * frames finished in background
+ */
+static aht20_result_queue_t result_queue = {0};
+
+/*
+ * bus recovery statistics
+ */
+static aht20_recovery_stats_t recovery_stats = {0};
+
+/*
+ * called when a frame is pushed to the result queue
+ */
+static volatile aht20_result_callback_t result_callback = NULL;
+
 /*
  * aht20 api
  */
 const aht20_sensor_api_t aht20_api = {
 		.aht20_validate_calibration = aht20_validate_calibration,
 		.measure = aht20_measure,
+		.start_measurement = aht20_start_measurement,
+		.poll_measurement = aht20_poll_measurement,
 		.calculate_measurments = aht20_calculate_measurments,
+		.calculate_measurments_fixed = aht20_calculate_measurments_fixed,
 		.soft_reset = aht20_soft_reset,
+		.start_soft_reset = aht20_start_soft_reset,
+		.set_transport = aht20_set_transport,
+		.bus_recovery = aht20_bus_recovery,
+		.get_recovery_stats = aht20_get_recovery_stats,
+		.set_result_callback = aht20_set_result_callback,
 };
 
 /*
- * calculates crc8 for given data
+ * checks busy bit and crc of the received frame and finishes the measurment.
+ * a frame with wrong crc is refused and AHT20_STATUS_BAD_CRC returned, the data must not be used
+ */
+static aht20_status_t finish_measurement(I2C_HandleTypeDef *hi2c, uint8_t *measured_data);
+
+/*
+ * sends the queued soft reset once the bus is free and waits for it to finish.
+ * returns 1 while the reset is in progress
  */
-static uint8_t calculate_crc(uint8_t *data);
+static uint8_t continue_reset(I2C_HandleTypeDef *hi2c);
+
+/*
+ * sends a one byte command, only the blocking transport waits for the transfer
+ */
+static HAL_StatusTypeDef send_command(I2C_HandleTypeDef *hi2c, uint8_t *command);
+
+/*
+ * calculates timeout for a transfer of given size from the bus clock speed
+ */
+static uint32_t transfer_timeout_ms(I2C_HandleTypeDef *hi2c, uint16_t size);
+
+/*
+ * waits given number of microseconds without using the tick
+ */
+static void delay_us(uint32_t us);
+
+/*
+ * generates clock pulses on SCL until the slave releases SDA, then a stop condition.
+ * returns 1 if SDA is released
+ */
+static uint8_t clock_out_slave(void);
+
+/*
+ * starts a background transmit with the selected transport
+ */
+static HAL_StatusTypeDef transmit_async(I2C_HandleTypeDef *hi2c, uint8_t *data, uint16_t size);
+
+/*
+ * starts a background receive of one frame into the result queue
+ */
+static HAL_StatusTypeDef receive_async(I2C_HandleTypeDef *hi2c);
+
+/*
+ * pushes the frame being received to the result queue
+ */
+static void push_result(aht20_status_t status);
+
+/*
+ * empties the result queue
+ */
+static void drop_results(void);
 
 /*
  * sends reads status_word for further calibration verification
@@ -100,18 +290,18 @@ aht20_status_t aht20_validate_calibration(I2C_HandleTypeDef *hi2c) {
 
 	HAL_Delay(40);
 
-	if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, &GET_STATUS_CMD, (uint16_t)sizeof(GET_STATUS_CMD), HAL_MAX_DELAY)) {
+	if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, &GET_STATUS_CMD, (uint16_t)sizeof(GET_STATUS_CMD), transfer_timeout_ms(hi2c, (uint16_t)sizeof(GET_STATUS_CMD)))) {
 		return AHT20_STATUS_NOT_TRANSMITTED;
 	}
 
-	if (HAL_OK != HAL_I2C_Master_Receive(hi2c, DEVICE_ADDRESS, &status_word, (uint16_t)sizeof(status_word), HAL_MAX_DELAY)) {
+	if (HAL_OK != HAL_I2C_Master_Receive(hi2c, DEVICE_ADDRESS, &status_word, (uint16_t)sizeof(status_word), transfer_timeout_ms(hi2c, (uint16_t)sizeof(status_word)))) {
 		return AHT20_STATUS_NOT_RECEIVED;
 	}
 
 	if (status_word & (1 << 3)) {
 		return AHT20_STATUS_OK;
 	} else {
-		if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, INIT_CMD, (uint16_t)sizeof(INIT_CMD), HAL_MAX_DELAY)) {
+		if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, INIT_CMD, (uint16_t)sizeof(INIT_CMD), transfer_timeout_ms(hi2c, (uint16_t)sizeof(INIT_CMD)))) {
 			return AHT20_STATUS_NOT_TRANSMITTED;
 		}
 		HAL_Delay(10);
@@ -129,37 +319,162 @@ aht20_status_t aht20_measure(I2C_HandleTypeDef *hi2c, uint8_t *measured_data, ui
 	assert(hi2c != NULL);
 	assert(measured_data != NULL);
 
-	if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, MEASURE_CMD, (uint16_t)sizeof(MEASURE_CMD), HAL_MAX_DELAY)) {
-		return AHT20_STATUS_NOT_TRANSMITTED;
+	aht20_status_t status = aht20_start_measurement(hi2c);
+	if (status != AHT20_STATUS_OK) {
+		return status;
 	}
-	HAL_Delay(80);
 
-	if (HAL_OK != HAL_I2C_Master_Receive(hi2c, DEVICE_ADDRESS, measured_data, measured_data_size, HAL_MAX_DELAY)) {
-		return AHT20_STATUS_NOT_RECEIVED;
+	do {
+		status = aht20_poll_measurement(hi2c, measured_data, measured_data_size);
+	} while (status == AHT20_STATUS_BUSY);
+
+	return status;
+}
+
+/*
+ * sends measurment command and returns without waiting for the conversion.
+ * returns AHT20_STATUS_BUSY if a previous measurment or a queued soft reset is still in progress
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 2
+ */
+aht20_status_t aht20_start_measurement(I2C_HandleTypeDef *hi2c) {
+	assert(hi2c != NULL);
+
+	if (measurement.state == MEASUREMENT_RESETTING && continue_reset(hi2c)) {
+		return AHT20_STATUS_BUSY;
 	}
 
-	if (measured_data[0] & (1 << 7)) {
-		return AHT20_STATUS_NOT_MEASURED;
+	if (measurement.state != MEASUREMENT_IDLE || HAL_I2C_GetState(hi2c) != HAL_I2C_STATE_READY) {
+		return AHT20_STATUS_BUSY;
 	}
 
-	uint8_t calculated_crc = calculate_crc(measured_data);
-	if (calculated_crc == measured_data[6]) {
-		if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, &ACK_CMD, (uint16_t)sizeof(ACK_CMD), HAL_MAX_DELAY)) {
+	/* frames left from an aborted measurment must not be taken for this one */
+	drop_results();
+
+	measurement.hi2c = hi2c;
+	measurement.start_tick = HAL_GetTick();
+	measurement.deadline_tick = measurement.start_tick + MEASURE_TIME_MS;
+
+	if (measurement.transport == AHT20_TRANSPORT_BLOCKING) {
+		if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, MEASURE_CMD, (uint16_t)sizeof(MEASURE_CMD), transfer_timeout_ms(hi2c, (uint16_t)sizeof(MEASURE_CMD)))) {
 			return AHT20_STATUS_NOT_TRANSMITTED;
 		}
+		measurement.state = MEASUREMENT_CONVERTING;
 	} else {
-		if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, &NACK_CMD, (uint16_t)sizeof(NACK_CMD), HAL_MAX_DELAY)) {
+		measurement.state = MEASUREMENT_TRIGGERING;
+		if (HAL_OK != transmit_async(hi2c, MEASURE_CMD, (uint16_t)sizeof(MEASURE_CMD))) {
+			measurement.state = MEASUREMENT_IDLE;
 			return AHT20_STATUS_NOT_TRANSMITTED;
 		}
+	}
+
+	return AHT20_STATUS_OK;
+}
+
+/*
+ * checks the measurment started by aht20_start_measurement.
+ * returns AHT20_STATUS_BUSY until the conversion time has passed and
+ * the sensor has cleared the busy bit, then reads the data.
+ * returns AHT20_STATUS_BAD_CRC if the frame fails the crc check, a soft reset is queued
+ * and finished by the next calls, which return AHT20_STATUS_BUSY until the sensor is back
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 3
+ */
+aht20_status_t aht20_poll_measurement(I2C_HandleTypeDef *hi2c, uint8_t *measured_data, uint16_t measured_data_size) {
+	assert(hi2c != NULL);
+	assert(measured_data != NULL);
+	assert(measured_data_size >= FRAME_SIZE);
+	(void)measured_data_size;
+
+	if (result_queue.tail != result_queue.head) {
+		aht20_result_t *result = &result_queue.results[result_queue.tail];
+		aht20_status_t status = result->status;
+
+		memcpy(measured_data, result->data, FRAME_SIZE);
+		result_queue.tail = (uint8_t)((result_queue.tail + 1) % RESULT_QUEUE_SIZE);
+
+		if (status != AHT20_STATUS_OK) {
+			measurement.state = MEASUREMENT_IDLE;
+			return status;
+		}
+
+		return finish_measurement(hi2c, measured_data);
+	}
+
+	switch (measurement.state) {
+	case MEASUREMENT_IDLE:
+		return AHT20_STATUS_NOT_MEASURED;
+	case MEASUREMENT_TRIGGERING:
+	case MEASUREMENT_READING:
+		if (HAL_GetTick() - measurement.start_tick < MEASURE_TIMEOUT_MS) {
+			return AHT20_STATUS_BUSY;
+		}
+
+		aht20_status_t status = (measurement.state == MEASUREMENT_TRIGGERING) ? AHT20_STATUS_NOT_TRANSMITTED : AHT20_STATUS_NOT_RECEIVED;
+		measurement.state = MEASUREMENT_IDLE;
+		HAL_I2C_Master_Abort_IT(hi2c, DEVICE_ADDRESS);
+		drop_results();
+		return status;
+	case MEASUREMENT_RESETTING:
+		return continue_reset(hi2c) ? AHT20_STATUS_BUSY : AHT20_STATUS_NOT_MEASURED;
+	case MEASUREMENT_CONVERTING:
+		break;
+	}
+
+	if ((int32_t)(HAL_GetTick() - measurement.deadline_tick) < 0) {
+		return AHT20_STATUS_BUSY;
+	}
+
+	if (measurement.transport == AHT20_TRANSPORT_BLOCKING) {
+		if (HAL_OK != HAL_I2C_Master_Receive(hi2c, DEVICE_ADDRESS, measured_data, FRAME_SIZE, transfer_timeout_ms(hi2c, FRAME_SIZE))) {
+			measurement.state = MEASUREMENT_IDLE;
+			return AHT20_STATUS_NOT_RECEIVED;
+		}
+
+		return finish_measurement(hi2c, measured_data);
+	}
+
+	if ((uint8_t)((result_queue.head + 1) % RESULT_QUEUE_SIZE) == result_queue.tail) {
+		return AHT20_STATUS_BUSY;
+	}
 
-		aht20_soft_reset(hi2c);
+	measurement.state = MEASUREMENT_READING;
+	if (HAL_OK != receive_async(hi2c)) {
+		measurement.state = MEASUREMENT_IDLE;
+		return AHT20_STATUS_NOT_RECEIVED;
+	}
+
+	return AHT20_STATUS_BUSY;
+}
+
+/*
+ * selects the transport used by aht20_start_measurement and aht20_poll_measurement.
+ * with AHT20_TRANSPORT_IT and AHT20_TRANSPORT_DMA the transfers run in background
+ * and finished frames are collected from the result queue by aht20_poll_measurement.
+ * returns AHT20_STATUS_BUSY if a measurment is in progress
+ */
+aht20_status_t aht20_set_transport(aht20_transport_t transport) {
+	if (measurement.state != MEASUREMENT_IDLE) {
+		return AHT20_STATUS_BUSY;
 	}
 
+	measurement.transport = transport;
 	return AHT20_STATUS_OK;
 }
 
 /*
- * calculates measured_data and writes the calculation in provided variables
+ * sets callback called from interrupt context when a background transfer finishes.
+ * NULL disables it
+ */
+void aht20_set_result_callback(aht20_result_callback_t callback) {
+	result_callback = callback;
+}
+
+/*
+ * calculates measured_data and writes the calculation in provided variables.
+ * temp_f can be NULL if fahrenheit is not needed
  *
  * Datasheet: AHT20 Product manuals
  * 6.1 Relative humidity transformation
@@ -169,14 +484,82 @@ void aht20_calculate_measurments(uint8_t *measured_data, float *humidity, float
 	assert(measured_data != NULL);
 	assert(humidity != NULL);
 	assert(temp_c != NULL);
-	assert(temp_f != NULL);
 
-	uint32_t raw_humidity = ((measured_data[1] << 12) | (measured_data[2] << 4) | (measured_data[3] >> 4));
-	uint32_t raw_temperature = (((measured_data[3] & 0x0F) << 16) | (measured_data[4] << 8) | measured_data[5]);
+	uint32_t raw_humidity = 0;
+	uint32_t raw_temperature = 0;
+	aht20_parse_raw(measured_data, &raw_humidity, &raw_temperature);
+
+	*humidity = (float)raw_humidity * (100.0f / 1048576.0f); /* 2^20 */
+	*temp_c = (float)raw_temperature * (200.0f / 1048576.0f) - 50.0f;
+
+	if (temp_f != NULL) {
+		*temp_f = *temp_c * (9.0f / 5.0f) + 32.0f;
+	}
+}
+
+/*
+ * calculates measured_data without floating point.
+ * humidity is written in hundredths of percent, temp_c in hundredths of degree celsius
+ *
+ * Datasheet: AHT20 Product manuals
+ * 6.1 Relative humidity transformation
+ * 6.2 Temperature transformation
+ */
+void aht20_calculate_measurments_fixed(uint8_t *measured_data, int32_t *humidity, int32_t *temp_c) {
+	assert(measured_data != NULL);
+	assert(humidity != NULL);
+	assert(temp_c != NULL);
+
+	uint32_t raw_humidity = 0;
+	uint32_t raw_temperature = 0;
+	aht20_parse_raw(measured_data, &raw_humidity, &raw_temperature);
+	aht20_convert_raw_fixed(raw_humidity, raw_temperature, humidity, temp_c);
+}
 
-	*humidity = ((float)raw_humidity * 100.0) / 1048576.0; /* 2^20 */
-	*temp_c = (((float)raw_temperature * 200.0) / 1048576.0) - 50.0;
-	*temp_f = *temp_c * 9.0 / 5.0 + 32.0;
+/*
+ * extracts 20 bit raw humidity and temperature values from measured_data
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 4
+ */
+void aht20_parse_raw(const uint8_t *measured_data, uint32_t *raw_humidity, uint32_t *raw_temperature) {
+	assert(measured_data != NULL);
+	assert(raw_humidity != NULL);
+	assert(raw_temperature != NULL);
+
+	*raw_humidity = (((uint32_t)measured_data[1] << 12) | ((uint32_t)measured_data[2] << 4) | (measured_data[3] >> 4));
+	*raw_temperature = ((((uint32_t)measured_data[3] & 0x0F) << 16) | ((uint32_t)measured_data[4] << 8) | measured_data[5]);
+}
+
+/*
+ * converts 20 bit raw values to hundredths of percent and hundredths of degree celsius.
+ *
+ * RH = raw * 100 / 2^20 -> raw * 10000 / 2^20 = raw * 625 / 2^16
+ * T  = raw * 200 / 2^20 - 50 -> raw * 20000 / 2^20 - 5000 = raw * 1250 / 2^16 - 5000
+ * both products fit into 32 bits for 20 bit raw values, results are rounded
+ *
+ * Datasheet: AHT20 Product manuals
+ * 6.1 Relative humidity transformation
+ * 6.2 Temperature transformation
+ */
+void aht20_convert_raw_fixed(uint32_t raw_humidity, uint32_t raw_temperature, int32_t *humidity, int32_t *temp_c) {
+	assert(humidity != NULL);
+	assert(temp_c != NULL);
+
+	*humidity = (int32_t)((raw_humidity * 625U + (1U << 15)) >> 16);
+	*temp_c = (int32_t)((raw_temperature * 1250U + (1U << 15)) >> 16) - 5000;
+}
+
+/*
+ * converts hundredths of degree celsius to hundredths of degree fahrenheit
+ */
+int32_t aht20_celsius_to_fahrenheit_fixed(int32_t temp_c) {
+	int32_t scaled = temp_c * 9;
+
+	/* round half away from zero */
+	scaled += (scaled >= 0) ? 2 : -2;
+
+	return scaled / 5 + 3200;
 }
 
 /*
@@ -188,33 +571,328 @@ void aht20_calculate_measurments(uint8_t *measured_data, float *humidity, float
 aht20_status_t aht20_soft_reset(I2C_HandleTypeDef *hi2c) {
 	assert(hi2c != NULL);
 
-	if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, &SOFT_RESET_CMD, (uint16_t)sizeof(SOFT_RESET_CMD), HAL_MAX_DELAY)) {
+	if (HAL_OK != HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, &SOFT_RESET_CMD, (uint16_t)sizeof(SOFT_RESET_CMD), transfer_timeout_ms(hi2c, (uint16_t)sizeof(SOFT_RESET_CMD)))) {
 		return AHT20_STATUS_NOT_TRANSMITTED;
 	}
 
-	HAL_Delay(20);
+	measurement.state = MEASUREMENT_IDLE;
+
+	HAL_Delay(SOFT_RESET_TIME_MS);
 	return AHT20_STATUS_OK;
 }
 
 /*
- * calculates crc8 for given data
+ * queues a soft reset without waiting for the sensor. the command is sent right away if the bus is free,
+ * aht20_start_measurement and aht20_poll_measurement finish the reset and return AHT20_STATUS_BUSY until then.
+ * returns AHT20_STATUS_BUSY if a measurment is in progress
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.5 Soft reset
  */
-static uint8_t calculate_crc(uint8_t *data) {
-	assert(data != NULL);
+aht20_status_t aht20_start_soft_reset(I2C_HandleTypeDef *hi2c) {
+	assert(hi2c != NULL);
 
-    uint8_t crc = 0xFF;
-    uint8_t i = 0, j = 0;
+	if (measurement.state == MEASUREMENT_RESETTING) {
+		return AHT20_STATUS_OK;
+	}
 
-    for (; i < 6; ++i) {
-        crc ^= data[i];
-        for (j = 0; j < 8; ++j) {
-            if (crc & 0x80) {
-                crc = (crc << 1) ^ 0x31;
-            } else {
-                crc <<= 1;
-            }
-        }
-    }
+	if (measurement.state != MEASUREMENT_IDLE) {
+		return AHT20_STATUS_BUSY;
+	}
 
-    return crc;
+	measurement.hi2c = hi2c;
+	measurement.reset_sent = 0;
+	measurement.state = MEASUREMENT_RESETTING;
+	if (!continue_reset(hi2c)) {
+		return AHT20_STATUS_NOT_TRANSMITTED;
+	}
+
+	return AHT20_STATUS_OK;
+}
+
+/*
+ * releases a stuck bus and brings the sensor back.
+ * clocks out a slave holding SDA low, power cycles the sensor through I2C_VCC_Pin
+ * if that doesn't help, and initializes the I2C peripheral again
+ */
+aht20_status_t aht20_bus_recovery(I2C_HandleTypeDef *hi2c) {
+	assert(hi2c != NULL);
+
+	uint32_t start_tick = HAL_GetTick();
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+	aht20_status_t status = AHT20_STATUS_OK;
+	uint8_t power_cycled = 0;
+
+	HAL_I2C_DeInit(hi2c);
+	measurement.state = MEASUREMENT_IDLE;
+	result_queue.tail = result_queue.head;
+
+	HAL_GPIO_WritePin(I2C_SCL_GPIO_Port, I2C_SCL_Pin, GPIO_PIN_SET);
+	HAL_GPIO_WritePin(I2C_SDA_GPIO_Port, I2C_SDA_Pin, GPIO_PIN_SET);
+
+	GPIO_InitStruct.Pin = I2C_SCL_Pin | I2C_SDA_Pin;
+	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+	HAL_GPIO_Init(I2C_SCL_GPIO_Port, &GPIO_InitStruct);
+
+	if (!clock_out_slave()) {
+		HAL_GPIO_WritePin(I2C_SCL_GPIO_Port, I2C_SCL_Pin, GPIO_PIN_RESET);
+		HAL_GPIO_WritePin(I2C_SDA_GPIO_Port, I2C_SDA_Pin, GPIO_PIN_RESET);
+		HAL_GPIO_WritePin(I2C_VCC_GPIO_Port, I2C_VCC_Pin, SENSOR_POWER_OFF);
+		HAL_Delay(POWER_OFF_TIME_MS);
+
+		HAL_GPIO_WritePin(I2C_SCL_GPIO_Port, I2C_SCL_Pin, GPIO_PIN_SET);
+		HAL_GPIO_WritePin(I2C_SDA_GPIO_Port, I2C_SDA_Pin, GPIO_PIN_SET);
+		HAL_GPIO_WritePin(I2C_VCC_GPIO_Port, I2C_VCC_Pin, SENSOR_POWER_ON);
+		recovery_stats.power_cycles++;
+		power_cycled = 1;
+	}
+
+	if (HAL_OK != HAL_I2C_Init(hi2c)) {
+		status = AHT20_STATUS_NOT_RECOVERED;
+	} else if (power_cycled) {
+		/* sensor needs calibration check after power on */
+		status = aht20_validate_calibration(hi2c);
+	}
+
+	uint32_t latency_ms = HAL_GetTick() - start_tick;
+	recovery_stats.recoveries++;
+	recovery_stats.last_latency_ms = latency_ms;
+	if (latency_ms > recovery_stats.max_latency_ms) {
+		recovery_stats.max_latency_ms = latency_ms;
+	}
+	if (status != AHT20_STATUS_OK) {
+		recovery_stats.failures++;
+	}
+
+	return status;
+}
+
+/*
+ * copies bus recovery statistics
+ */
+void aht20_get_recovery_stats(aht20_recovery_stats_t *stats) {
+	assert(stats != NULL);
+
+	*stats = recovery_stats;
+}
+
+/*
+ * checks busy bit and crc of the received frame and finishes the measurment.
+ * a frame with wrong crc is refused and AHT20_STATUS_BAD_CRC returned, the data must not be used
+ */
+static aht20_status_t finish_measurement(I2C_HandleTypeDef *hi2c, uint8_t *measured_data) {
+	uint32_t current_tick = HAL_GetTick();
+
+	if (measured_data[0] & (1 << 7)) {
+		if (current_tick - measurement.start_tick >= MEASURE_TIMEOUT_MS) {
+			measurement.state = MEASUREMENT_IDLE;
+			return AHT20_STATUS_NOT_MEASURED;
+		}
+
+		measurement.deadline_tick = current_tick + BUSY_RETRY_MS;
+		measurement.state = MEASUREMENT_CONVERTING;
+		return AHT20_STATUS_BUSY;
+	}
+
+	measurement.state = MEASUREMENT_IDLE;
+
+	uint8_t calculated_crc = aht20_crc8(measured_data, FRAME_SIZE - 1);
+	if (calculated_crc != measured_data[6]) {
+		/* the reset waits 20 ms, it is sent and waited for by the next calls instead */
+		if (HAL_OK != send_command(hi2c, &NACK_CMD)) {
+			return AHT20_STATUS_NOT_TRANSMITTED;
+		}
+
+		measurement.reset_sent = 0;
+		measurement.state = MEASUREMENT_RESETTING;
+		return AHT20_STATUS_BAD_CRC;
+	}
+
+	if (HAL_OK != send_command(hi2c, &ACK_CMD)) {
+		return AHT20_STATUS_NOT_TRANSMITTED;
+	}
+
+	return AHT20_STATUS_OK;
+}
+
+/*
+ * sends the queued soft reset once the bus is free and waits for it to finish.
+ * returns 1 while the reset is in progress
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.5 Soft reset
+ */
+static uint8_t continue_reset(I2C_HandleTypeDef *hi2c) {
+	if (!measurement.reset_sent) {
+		/* NACK still on the bus */
+		if (HAL_I2C_GetState(hi2c) != HAL_I2C_STATE_READY) {
+			return 1;
+		}
+
+		if (HAL_OK != send_command(hi2c, &SOFT_RESET_CMD)) {
+			/* the sensor is measured again without the reset, a bad frame queues another one */
+			measurement.state = MEASUREMENT_IDLE;
+			return 0;
+		}
+
+		/* the current tick is already partly gone, one more keeps the whole reset time like HAL_Delay */
+		measurement.reset_sent = 1;
+		measurement.deadline_tick = HAL_GetTick() + SOFT_RESET_TIME_MS + 1U;
+		return 1;
+	}
+
+	if (HAL_I2C_GetState(hi2c) != HAL_I2C_STATE_READY || (int32_t)(HAL_GetTick() - measurement.deadline_tick) < 0) {
+		return 1;
+	}
+
+	measurement.state = MEASUREMENT_IDLE;
+	return 0;
+}
+
+/*
+ * calculates timeout for a transfer of given size from the bus clock speed
+ */
+static uint32_t transfer_timeout_ms(I2C_HandleTypeDef *hi2c, uint16_t size) {
+	/* address byte, data bytes, start and stop conditions */
+	uint32_t bits = (size + 1U) * BITS_PER_BYTE + 2U;
+	uint32_t clock_speed = hi2c->Init.ClockSpeed;
+
+	return (bits * 1000U + clock_speed - 1U) / clock_speed + TIMEOUT_MARGIN_MS;
+}
+
+/*
+ * waits given number of microseconds without using the tick
+ */
+static void delay_us(uint32_t us) {
+	/* a loop iteration takes at least 4 cycles */
+	volatile uint32_t cycles = (SystemCoreClock / 1000000U / 4U) * us;
+
+	while (cycles > 0) {
+		cycles--;
+	}
+}
+
+/*
+ * generates clock pulses on SCL until the slave releases SDA, then a stop condition.
+ * returns 1 if SDA is released
+ */
+static uint8_t clock_out_slave(void) {
+	for (uint8_t i = 0; i < RECOVERY_CLOCK_PULSES; ++i) {
+		if (HAL_GPIO_ReadPin(I2C_SDA_GPIO_Port, I2C_SDA_Pin) == GPIO_PIN_SET) {
+			break;
+		}
+
+		HAL_GPIO_WritePin(I2C_SCL_GPIO_Port, I2C_SCL_Pin, GPIO_PIN_RESET);
+		delay_us(RECOVERY_HALF_PERIOD_US);
+		HAL_GPIO_WritePin(I2C_SCL_GPIO_Port, I2C_SCL_Pin, GPIO_PIN_SET);
+		delay_us(RECOVERY_HALF_PERIOD_US);
+	}
+
+	/* stop condition, SDA rises while SCL is high */
+	HAL_GPIO_WritePin(I2C_SCL_GPIO_Port, I2C_SCL_Pin, GPIO_PIN_RESET);
+	delay_us(RECOVERY_HALF_PERIOD_US);
+	HAL_GPIO_WritePin(I2C_SDA_GPIO_Port, I2C_SDA_Pin, GPIO_PIN_RESET);
+	delay_us(RECOVERY_HALF_PERIOD_US);
+	HAL_GPIO_WritePin(I2C_SCL_GPIO_Port, I2C_SCL_Pin, GPIO_PIN_SET);
+	delay_us(RECOVERY_HALF_PERIOD_US);
+	HAL_GPIO_WritePin(I2C_SDA_GPIO_Port, I2C_SDA_Pin, GPIO_PIN_SET);
+	delay_us(RECOVERY_HALF_PERIOD_US);
+
+	return (HAL_GPIO_ReadPin(I2C_SDA_GPIO_Port, I2C_SDA_Pin) == GPIO_PIN_SET) &&
+		   (HAL_GPIO_ReadPin(I2C_SCL_GPIO_Port, I2C_SCL_Pin) == GPIO_PIN_SET);
+}
+
+/*
+ * starts a background transmit with the selected transport
+ */
+static HAL_StatusTypeDef transmit_async(I2C_HandleTypeDef *hi2c, uint8_t *data, uint16_t size) {
+	if (measurement.transport == AHT20_TRANSPORT_DMA) {
+		return HAL_I2C_Master_Transmit_DMA(hi2c, DEVICE_ADDRESS, data, size);
+	}
+
+	return HAL_I2C_Master_Transmit_IT(hi2c, DEVICE_ADDRESS, data, size);
+}
+
+/*
+ * sends a one byte command, only the blocking transport waits for the transfer
+ */
+static HAL_StatusTypeDef send_command(I2C_HandleTypeDef *hi2c, uint8_t *command) {
+	if (measurement.transport == AHT20_TRANSPORT_BLOCKING) {
+		return HAL_I2C_Master_Transmit(hi2c, DEVICE_ADDRESS, command, 1U, transfer_timeout_ms(hi2c, 1U));
+	}
+
+	return transmit_async(hi2c, command, 1U);
+}
+
+/*
+ * starts a background receive of one frame into the result queue
+ */
+static HAL_StatusTypeDef receive_async(I2C_HandleTypeDef *hi2c) {
+	uint8_t *frame = result_queue.results[result_queue.head].data;
+
+	if (measurement.transport == AHT20_TRANSPORT_DMA) {
+		return HAL_I2C_Master_Receive_DMA(hi2c, DEVICE_ADDRESS, frame, FRAME_SIZE);
+	}
+
+	return HAL_I2C_Master_Receive_IT(hi2c, DEVICE_ADDRESS, frame, FRAME_SIZE);
+}
+
+/*
+ * pushes the frame being received to the result queue
+ */
+static void push_result(aht20_status_t status) {
+	result_queue.results[result_queue.head].status = status;
+	result_queue.head = (uint8_t)((result_queue.head + 1) % RESULT_QUEUE_SIZE);
+
+	aht20_result_callback_t callback = result_callback;
+	if (callback != NULL) {
+		callback();
+	}
+}
+
+/*
+ * empties the result queue.
+ * called only while the state machine is idle, the callbacks push nothing then
+ */
+static void drop_results(void) {
+	result_queue.tail = result_queue.head;
+}
+
+/*
+ * I2C transmit complete callback.
+ * measurment command is sent, conversion time starts
+ */
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+	if (hi2c == measurement.hi2c && measurement.state == MEASUREMENT_TRIGGERING) {
+		measurement.state = MEASUREMENT_CONVERTING;
+	}
+}
+
+/*
+ * I2C receive complete callback.
+ * frame is in the result queue, waiting for aht20_poll_measurement.
+ * the state is left as is, aht20_poll_measurement changes it when it takes the frame
+ */
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+	if (hi2c == measurement.hi2c && measurement.state == MEASUREMENT_READING) {
+		push_result(AHT20_STATUS_OK);
+	}
+}
+
+/*
+ * I2C error callback.
+ * failed transfer is reported through the result queue
+ */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+	if (hi2c != measurement.hi2c) {
+		return;
+	}
+
+	if (measurement.state == MEASUREMENT_TRIGGERING) {
+		push_result(AHT20_STATUS_NOT_TRANSMITTED);
+	} else if (measurement.state == MEASUREMENT_READING) {
+		push_result(AHT20_STATUS_NOT_RECEIVED);
+	}
 }
@@ -0,0 +1,106 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "aht20_crc.h"
+#include <assert.h>
+#include <stddef.h>
+
+/*
+ * crc8 parameters, polynomial x^8 + x^5 + x^4 + 1, initial value 0xff
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 4
+ */
+#define CRC_POLYNOMIAL 0x31
+#define CRC_INIT 0xFF
+
+/*
+ * macros for generating crc tables at compile time.
+ * CRC_STEP shifts one bit through the polynomial without branches
+ */
+#define CRC_STEP(c) ((uint8_t)((((c) << 1) & 0xFF) ^ ((((c) >> 7) & 0x01) * CRC_POLYNOMIAL)))
+#define CRC_STEP_4(c) CRC_STEP(CRC_STEP(CRC_STEP(CRC_STEP(c))))
+#define CRC_STEP_8(c) CRC_STEP_4(CRC_STEP_4(c))
+#define CRC_ROW(n) \
+	CRC_STEP_8((n) + 0x0), CRC_STEP_8((n) + 0x1), CRC_STEP_8((n) + 0x2), CRC_STEP_8((n) + 0x3), \
+	CRC_STEP_8((n) + 0x4), CRC_STEP_8((n) + 0x5), CRC_STEP_8((n) + 0x6), CRC_STEP_8((n) + 0x7), \
+	CRC_STEP_8((n) + 0x8), CRC_STEP_8((n) + 0x9), CRC_STEP_8((n) + 0xA), CRC_STEP_8((n) + 0xB), \
+	CRC_STEP_8((n) + 0xC), CRC_STEP_8((n) + 0xD), CRC_STEP_8((n) + 0xE), CRC_STEP_8((n) + 0xF)
+
+#if AHT20_CRC_IMPLEMENTATION == AHT20_CRC_TABLE
+/*
+ * crc8 of every byte value, one lookup per byte
+ */
+static const uint8_t CRC_TABLE[256] = {
+	CRC_ROW(0x00), CRC_ROW(0x10), CRC_ROW(0x20), CRC_ROW(0x30),
+	CRC_ROW(0x40), CRC_ROW(0x50), CRC_ROW(0x60), CRC_ROW(0x70),
+	CRC_ROW(0x80), CRC_ROW(0x90), CRC_ROW(0xA0), CRC_ROW(0xB0),
+	CRC_ROW(0xC0), CRC_ROW(0xD0), CRC_ROW(0xE0), CRC_ROW(0xF0),
+};
+#elif AHT20_CRC_IMPLEMENTATION == AHT20_CRC_NIBBLE
+/*
+ * crc8 of every upper nibble value, two lookups per byte
+ */
+static const uint8_t CRC_NIBBLE_TABLE[16] = {
+	CRC_STEP_4(0x00), CRC_STEP_4(0x10), CRC_STEP_4(0x20), CRC_STEP_4(0x30),
+	CRC_STEP_4(0x40), CRC_STEP_4(0x50), CRC_STEP_4(0x60), CRC_STEP_4(0x70),
+	CRC_STEP_4(0x80), CRC_STEP_4(0x90), CRC_STEP_4(0xA0), CRC_STEP_4(0xB0),
+	CRC_STEP_4(0xC0), CRC_STEP_4(0xD0), CRC_STEP_4(0xE0), CRC_STEP_4(0xF0),
+};
+#endif
+
+/*
+ * calculates crc8 of size bytes, polynomial x^8 + x^5 + x^4 + 1, initial value 0xff
+ *
+ * Datasheet: AHT20 Product manuals
+ * 5.4 Sensor reading process, paragraph 4
+ */
+uint8_t aht20_crc8(const uint8_t *data, uint16_t size) {
+	assert(data != NULL);
+
+	uint8_t crc = CRC_INIT;
+	uint16_t i = 0;
+
+#if AHT20_CRC_IMPLEMENTATION == AHT20_CRC_TABLE
+	for (; i < size; ++i) {
+		crc = CRC_TABLE[crc ^ data[i]];
+	}
+#elif AHT20_CRC_IMPLEMENTATION == AHT20_CRC_NIBBLE
+	for (; i < size; ++i) {
+		crc ^= data[i];
+		crc = (uint8_t)(crc << 4) ^ CRC_NIBBLE_TABLE[crc >> 4];
+		crc = (uint8_t)(crc << 4) ^ CRC_NIBBLE_TABLE[crc >> 4];
+	}
+#else
+	uint8_t j = 0;
+
+	for (; i < size; ++i) {
+		crc ^= data[i];
+		for (j = 0; j < 8; ++j) {
+			if (crc & 0x80) {
+				crc = (crc << 1) ^ CRC_POLYNOMIAL;
+			} else {
+				crc <<= 1;
+			}
+		}
+	}
+#endif
+
+	return crc;
+}
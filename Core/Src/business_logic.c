@@ -20,8 +20,21 @@
 #include "business_logic.h"
 #include "aht20.h"
 #include "character_generator.h"
+#include "char_gen_text.h"
+#include "display_format.h"
 #include "button_hmi_api.h"
-#include <stdio.h>
+#include "hmi_gestures.h"
+#include "sensor_filter.h"
+#include "sample_rate.h"
+#include "sensor_history.h"
+#include "flash_log.h"
+#include "telemetry.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "driver_7_seg_api.h"
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
 
 /*
  * holds event statuses
@@ -30,6 +43,10 @@ typedef enum{
 	EVENT_NONE,
 	EVENT_BUTTON_A_SHORT,
 	EVENT_BUTTON_B_SHORT,
+	EVENT_BUTTON_B_DOUBLE,
+	EVENT_BUTTON_A_LONG,
+	EVENT_BUTTON_B_LONG,
+	EVENT_BUTTONS_AB_CHORD,
 }SystemEvent;
 
 /*
@@ -62,22 +79,172 @@ static bl_config config = {
 		.currentMainState = MAIN_STATE_DISPLAY_C,
 };
 
+/*
+ * mode shown before the sensor failed, restored by the first sample after a recovery
+ */
+static MainState resume_state = MAIN_STATE_DISPLAY_C;
+
+/*
+ * task timing in milliseconds. deadlines are counted from release to completion
+ */
+static const uint32_t BUTTON_TASK_PERIOD_MS = 1000;
+static const uint32_t BUTTON_TASK_DEADLINE_MS = 10;
+static const uint32_t SENSOR_TASK_PERIOD_MS = 100;
+static const uint32_t SENSOR_TASK_DEADLINE_MS = 20;
+static const uint32_t SENSOR_RETRY_PERIOD_MS = 5000;
+static const uint32_t DISPLAY_TASK_PERIOD_MS = 1000;
+static const uint32_t DISPLAY_TASK_DEADLINE_MS = 20;
+static const uint32_t FRAME_TASK_DEADLINE_MS = 5;
+static const uint32_t FLASH_TASK_PERIOD_MS = 60000;
+
+/*
+ * display is switched off after this time without button activity
+ */
+static const uint32_t DISPLAY_TIMEOUT_MS = 30000;
+
+/*
+ * display power state and time of the last button activity.
+ * button_activity is set from interrupt
+ */
+static bool display_on = true;
+static bool wake_press_pending = false;
+static uint32_t wake_ms = 0;
+static volatile bool button_activity = false;
+static uint32_t last_activity_ms = 0;
+
+/*
+ * bus used by the sensor task
+ */
+static I2C_HandleTypeDef *sensor_hi2c = NULL;
+
 /*
  * holds sensor data
  */
 static aht20_data_t sensor_data = {0};
 
 /*
- * detects buttons interrupts
+ * filter applied to raw sensor values before conversion, configured from base_filter_config
+ * by scale_filter before the first sample
+ */
+static sensor_filter_t sensor_filter = {0};
+
+/*
+ * filter selected for the fastest sampling interval. window and ema weight are scaled with
+ * the interval so the filter covers about the same time at any cadence: 8 samples over 8 s
+ * at 1 s, a single sample at 8 s and slower. a fixed window would lag the display by
+ * about 80 s at the 10 s interval
+ */
+static sensor_filter_config_t base_filter_config = {
+		.mode = SENSOR_FILTER_MOVING_AVERAGE,
+		.window = 8,
+		.ema_alpha = 64,
+};
+
+/*
+ * sampling interval the filter is currently scaled for, 0 forces scaling
+ */
+static uint32_t filter_interval_ms = 0;
+
+/*
+ * sampling cadence: 1 s while readings change faster than 0.3 C or 1 %RH per minute,
+ * doubled after 5 stable samples up to the selected slowest interval.
+ * bus time is one 100 kHz trigger, status and 7 byte read, compared to the old 180 ms loop
+ */
+static const sample_rate_config_t SAMPLE_RATE_CONFIG = {
+		.min_interval_ms = 1000,
+		.max_interval_ms = 10000,
+		.temperature_slope_centi = 30,
+		.humidity_slope_centi = 100,
+		.temperature_noise_centi = 10,
+		.humidity_noise_centi = 30,
+		.stable_samples = 5,
+		.bus_us_per_sample = 1400,
+		.baseline_interval_ms = 180,
+};
+static sample_rate_t sample_rate = {0};
+
+/*
+ * raw samples are kept in the history and in the flash log every HISTORY_INTERVAL_MS
+ */
+static const uint32_t HISTORY_INTERVAL_MS = 30000;
+static uint32_t last_history_ms = 0;
+static bool history_started = false;
+
+/*
+ * sends every sample over the telemetry port, never waits for it
  */
-static SystemEvent detect_events(void);
+static void send_telemetry(uint32_t time_ms, bool logged);
+
+/*
+ * scales the filter window and ema weight to the sampling interval, keeps the newest samples
+ */
+static void scale_filter(uint32_t interval_ms);
+
+/*
+ * measurement in progress, the sensor task polls it every SENSOR_TASK_PERIOD_MS
+ */
+static bool measurement_started = false;
+
+/*
+ * start was refused because the bus was busy, the sensor task retries after SENSOR_TASK_PERIOD_MS
+ */
+static bool start_retry = false;
+
+/*
+ * sensor couldn't be recovered by bl_process_sensor_data, the sensor task retries every SENSOR_RETRY_PERIOD_MS
+ */
+static bool sensor_lost = false;
+
+/*
+ * takes the next button gesture and maps it to an event.
+ * gesture_start is set to the time the gesture started
+ */
+static SystemEvent detect_events(uint32_t *gesture_start);
+
+/*
+ * timer sampling the buttons
+ */
+static TIM_HandleTypeDef *sampling_htim = NULL;
+
+/*
+ * gesture recognition: double click only on button B, button A reacts on release
+ */
+static const HMI_Gesture_Config_t GESTURE_CONFIG = {
+		.double_click_pins = BUTTON_S2_Pin,
+};
+
+/*
+ * display brightness steps selected by long press of button A
+ */
+static const driver_7_seg_brightness_t BRIGHTNESS_STEPS[] = {LEVEL_5_MAX, LEVEL_4, LEVEL_3, LEVEL_2, LEVEL_1_MIN};
+static uint8_t brightness_step = 0;
+
+/*
+ * slowest sampling intervals selected by long press of button B
+ */
+static const uint32_t SAMPLE_MAX_INTERVALS_MS[] = {10000, 2000, 5000};
+static uint8_t sample_max_interval_step = 0;
+static uint8_t sensor_task_id = 0;
+
+/*
+ * posts button event when gestures were recognized, called from interrupt
+ */
+static void button_events_ready(void) {
+	scheduler_post_event(BL_EVENT_BUTTON);
+}
 
 /*
  * initializes buttons
  */
-bl_status_t bl_init_buttons(void) {
+bl_status_t bl_init_buttons(TIM_HandleTypeDef *htim) {
+	assert(htim != NULL);
+	sampling_htim = htim;
+
 	button_hmi_api.init(&buttonA, BUTTON_S1_GPIO_Port, BUTTON_S1_Pin);
 	button_hmi_api.init(&buttonB, BUTTON_S2_GPIO_Port, BUTTON_S2_Pin);
+	button_sampling_init(htim);
+	hmi_gestures_init(&GESTURE_CONFIG);
+	hmi_gestures_set_callback(button_events_ready);
 
 	return BL_STATUS_OK;
 }
@@ -93,114 +260,581 @@ bl_status_t bl_run_sensor(I2C_HandleTypeDef *hi2c) {
 		return BL_STATUS_RUN_FAILED;
 	}
 
+	status = aht20_api.set_transport(AHT20_TRANSPORT_DMA);
+	if (status != AHT20_STATUS_OK) {
+		return BL_STATUS_RUN_FAILED;
+	}
+
+	return BL_STATUS_OK;
+}
+
+/*
+ * selects filter applied to raw sensor values at the fastest sampling interval.
+ * clears filter history
+ */
+bl_status_t bl_set_sensor_filter(const sensor_filter_config_t *filter_config) {
+	if (filter_config == NULL || SENSOR_FILTER_STATUS_OK != sensor_filter_init(&sensor_filter, filter_config)) {
+		return BL_STATUS_RUN_FAILED;
+	}
+
+	base_filter_config = *filter_config;
+	filter_interval_ms = 0;
+	scale_filter(sample_rate.interval_ms);
+
 	return BL_STATUS_OK;
 }
 
 /*
- * processes and calculates sensor data
+ * scales the filter window and ema weight to the sampling interval, keeps the newest samples.
+ * the window shrinks and the weight grows by the ratio of the interval to the fastest one
+ */
+static void scale_filter(uint32_t interval_ms) {
+	if (interval_ms == filter_interval_ms) {
+		return;
+	}
+
+	uint32_t steps = interval_ms / SAMPLE_RATE_CONFIG.min_interval_ms;
+	if (steps == 0) {
+		steps = 1;
+	}
+
+	/* ema weight is in 1/256 units */
+	uint32_t ema_alpha = base_filter_config.ema_alpha * steps;
+	sensor_filter_config_t scaled = base_filter_config;
+	scaled.window = (uint8_t)((base_filter_config.window > steps) ? base_filter_config.window / steps : 1U);
+	scaled.ema_alpha = (uint16_t)((ema_alpha < 256U) ? ema_alpha : 256U);
+
+	if (SENSOR_FILTER_STATUS_OK == sensor_filter_set_config(&sensor_filter, &scaled)) {
+		filter_interval_ms = interval_ms;
+	}
+}
+
+/*
+ * processes and calculates sensor data.
+ * starts a measurment or collects a finished one without waiting for the conversion
  */
 bl_status_t bl_process_sensor_data(I2C_HandleTypeDef *hi2c) {
 	aht20_status_t status = AHT20_STATUS_OK;
 
-	status = aht20_measure(hi2c, sensor_data.measured_data, (uint16_t)sizeof(sensor_data.measured_data));
-	if (status != AHT20_STATUS_OK) {
-		status = aht20_soft_reset(hi2c);
+	if (!measurement_started) {
+		status = aht20_api.start_measurement(hi2c);
+		start_retry = (status == AHT20_STATUS_BUSY);
+		if (status == AHT20_STATUS_OK) {
+			measurement_started = true;
+			return BL_STATUS_OK;
+		}
+
+		/* bus still finishing the previous transfer or an abort */
+		if (start_retry) {
+			return BL_STATUS_OK;
+		}
+	} else {
+		status = aht20_api.poll_measurement(hi2c, sensor_data.measured_data, (uint16_t)sizeof(sensor_data.measured_data));
+		if (status == AHT20_STATUS_BUSY) {
+			return BL_STATUS_OK;
+		}
+
+		measurement_started = false;
+		if (status == AHT20_STATUS_BAD_CRC) {
+			/* the sensor is being reset, the sample is dropped and the next start waits for the reset */
+			return BL_STATUS_OK;
+		}
+
+		if (status == AHT20_STATUS_OK) {
+			uint32_t raw_humidity = 0;
+			uint32_t raw_temperature = 0;
+
+			int32_t humidity_centi = 0;
+			int32_t temperature_centi = 0;
+
+			aht20_parse_raw(sensor_data.measured_data, &raw_humidity, &raw_temperature);
+
+			/* cadence follows unfiltered readings, the filter would hide the start of a change */
+			aht20_convert_raw_fixed(raw_humidity, raw_temperature, &humidity_centi, &temperature_centi);
+			uint32_t now = HAL_GetTick();
+			sample_rate_update(&sample_rate, temperature_centi, humidity_centi, now);
+
+			bool logged = !history_started || now - last_history_ms >= HISTORY_INTERVAL_MS;
+			if (logged) {
+				sensor_history_append(raw_humidity, raw_temperature, now);
+				flash_log_append(raw_humidity, raw_temperature, now);
+				last_history_ms = now;
+				history_started = true;
+			}
+
+			scale_filter(sample_rate.interval_ms);
+			sensor_filter_push(&sensor_filter, raw_humidity, raw_temperature, &raw_humidity, &raw_temperature);
+			aht20_convert_raw_fixed(raw_humidity, raw_temperature, &sensor_data.humidity_centi, &sensor_data.temperature_c_centi);
+			send_telemetry(now, logged);
+
+			/* the first sample after a recovery brings back the mode shown before the error */
+			if (config.currentMainState == MAIN_STATE_ERROR_DISPLAY) {
+				config.currentMainState = resume_state;
+			}
+			scheduler_post_event(BL_EVENT_DISPLAY);
+			return BL_STATUS_OK;
+		}
+	}
+
+	if (status == AHT20_STATUS_NOT_TRANSMITTED || status == AHT20_STATUS_NOT_RECEIVED) {
+		status = aht20_api.bus_recovery(hi2c);
 		if (status != AHT20_STATUS_OK) {
 			return BL_STATUS_RUN_FAILED;
 		}
+		return BL_STATUS_OK;
 	}
 
-	aht20_calculate_measurments(sensor_data.measured_data, &sensor_data.humidity, &sensor_data.temperature_c, &sensor_data.temperature_f);
+	/* the reset takes 20 ms, the next starts return busy until the sensor is back */
+	status = aht20_api.start_soft_reset(hi2c);
+	if (status != AHT20_STATUS_OK) {
+		return BL_STATUS_RUN_FAILED;
+	}
 
 	return BL_STATUS_OK;
 }
 
 /*
- * hardcoding data to transmit (bad approach)
+ * segment codes shown on display and their brightness
  */
-char t_data[5] = "";
-period_status periods[4] = {PERIOD_OFF, PERIOD_OFF, PERIOD_ON, PERIOD_OFF};
-driver_7_seg_brightness_t brightness[4] = {LEVEL_5_MAX, LEVEL_5_MAX, LEVEL_5_MAX, LEVEL_5_MAX};
-char_gen_data_t data = {
-		.digits = "",
-		.periods = periods,
-		.brightness = brightness,
-};
+static uint8_t display_codes[DISPLAY_FORMAT_DIGITS] = {0};
+static driver_7_seg_brightness_t brightness[4] = {LEVEL_5_MAX, LEVEL_5_MAX, LEVEL_5_MAX, LEVEL_5_MAX};
+
+/*
+ * sensor ranges in display units, values outside are shown as "Hi"/"Lo"
+ */
+static const display_format_range_t TEMPERATURE_C_RANGE = {.min_centi = -4000, .max_centi = 8500};
+static const display_format_range_t TEMPERATURE_F_RANGE = {.min_centi = -4000, .max_centi = 18500};
+static const display_format_range_t HUMIDITY_RANGE = {.min_centi = 0, .max_centi = 10000};
 
 /*
- * transmits formatted data to spi 7 seg display on pressing buttons
+ * last frame submitted to the display: mode and quantized value
  */
-void bl_spi_transmit_sensor_data(void) {
-	SystemEvent event = detect_events();
+static struct {
+	MainState state;
+	int32_t quantized;
+	bool shown;
+} last_display = {0};
+
+/*
+ * display update counters
+ */
+static bl_display_stats_t display_stats = {0};
+
+/*
+ * checks whether mode or quantized value changed since the last submitted frame and remembers them
+ */
+static bool display_changed(MainState state, int32_t quantized) {
+	if (last_display.shown && last_display.state == state && last_display.quantized == quantized) {
+		display_stats.suppressed++;
+		return false;
+	}
+
+	last_display.state = state;
+	last_display.quantized = quantized;
+	last_display.shown = true;
+	display_stats.submitted++;
+
+	return true;
+}
+
+/*
+ * formats value and submits it to the display when it changed
+ */
+static void show_value(int32_t value_centi, char unit, const display_format_range_t *range) {
+	if (!display_changed(config.currentMainState, display_format_quantize(value_centi, range))) {
+		return;
+	}
+
+	display_format_value(value_centi, unit, range, display_codes);
+	char_gen_text_show_codes(display_codes, DISPLAY_FORMAT_DIGITS, brightness);
+}
 
+/*
+ * shows data of the current mode on the display
+ */
+void bl_display_task(void) {
 	switch(config.currentMainState) {
 	case MAIN_STATE_DISPLAY_C:
-		snprintf(t_data, sizeof(t_data), "C%03d", (int16_t)(sensor_data.temperature_c * 10));
-		data.digits = t_data;
-		api_char_gen.transmit(&data);
-
-		if(event == EVENT_BUTTON_A_SHORT) {
-			config.currentMainState = MAIN_STATE_DISPLAY_F;
-		} else if(event == EVENT_BUTTON_B_SHORT) {
-			config.currentMainState = MAIN_STATE_DISPLAY_H;
-		}
+		show_value(sensor_data.temperature_c_centi, 'C', &TEMPERATURE_C_RANGE);
 		break;
 	case MAIN_STATE_DISPLAY_F:
-		snprintf(t_data, sizeof(t_data), "F%03d", (int16_t)(sensor_data.temperature_f * 10));
-		data.digits = t_data;
-		api_char_gen.transmit(&data);
-
-		if(event == EVENT_BUTTON_A_SHORT) {
-			config.currentMainState = MAIN_STATE_DISPLAY_H;
-		} else if(event == EVENT_BUTTON_B_SHORT) {
-			config.currentMainState = MAIN_STATE_DISPLAY_C;
-		}
+		show_value(aht20_celsius_to_fahrenheit_fixed(sensor_data.temperature_c_centi), 'F', &TEMPERATURE_F_RANGE);
 		break;
 	case MAIN_STATE_DISPLAY_H:
-		snprintf(t_data, sizeof(t_data), "H%03d", (int16_t)(sensor_data.humidity * 10));
-		data.digits = t_data;
-		api_char_gen.transmit(&data);
-
-		if(event == EVENT_BUTTON_A_SHORT) {
-			config.currentMainState = MAIN_STATE_DISPLAY_C;
-		} else if(event == EVENT_BUTTON_B_SHORT) {
-			config.currentMainState = MAIN_STATE_DISPLAY_F;
-		}
+		show_value(sensor_data.humidity_centi, 'H', &HUMIDITY_RANGE);
 		break;
 	case MAIN_STATE_ERROR_DISPLAY:
-		snprintf(t_data, sizeof(t_data), "----");
-		data.digits = t_data;
-		api_char_gen.transmit(&data);
+		if (display_changed(MAIN_STATE_ERROR_DISPLAY, 0)) {
+			display_format_dashes(display_codes);
+			char_gen_text_show_codes(display_codes, DISPLAY_FORMAT_DIGITS, brightness);
+		}
 		break;
 	}
 }
 
 /*
- * detects buttons events
+ * switches display off after DISPLAY_TIMEOUT_MS without button activity and back on at the next press
+ */
+static void update_display_power(void) {
+	uint32_t now = HAL_GetTick();
+
+	if (button_activity) {
+		button_activity = false;
+		last_activity_ms = now;
+
+		if (!display_on && DRIVER_7_SEG_STATUS_OK == api_7_seg.resume()) {
+			display_on = true;
+			wake_press_pending = true;
+			wake_ms = now;
+		}
+	}
+
+	if (display_on && now - last_activity_ms >= DISPLAY_TIMEOUT_MS) {
+		if (DRIVER_7_SEG_STATUS_OK == api_7_seg.suspend()) {
+			display_on = false;
+		}
+	}
+}
+
+/*
+ * steps brightness down, wraps around to maximum. the shown value is sent again
+ */
+static void step_brightness(void) {
+	brightness_step = (uint8_t)((brightness_step + 1) % (sizeof(BRIGHTNESS_STEPS) / sizeof(BRIGHTNESS_STEPS[0])));
+
+	for (uint8_t i = 0; i < sizeof(brightness) / sizeof(brightness[0]); ++i) {
+		brightness[i] = BRIGHTNESS_STEPS[brightness_step];
+	}
+
+	last_display.shown = false;
+	scheduler_post_event(BL_EVENT_DISPLAY);
+}
+
+/*
+ * selects the next slowest sampling interval
+ */
+static void step_sensor_period(void) {
+	sample_max_interval_step = (uint8_t)((sample_max_interval_step + 1) % (sizeof(SAMPLE_MAX_INTERVALS_MS) / sizeof(SAMPLE_MAX_INTERVALS_MS[0])));
+	sample_rate_set_max_interval(&sample_rate, SAMPLE_MAX_INTERVALS_MS[sample_max_interval_step]);
+}
+
+/*
+ * switches display mode and settings on button gestures
+ */
+void bl_button_task(void) {
+	MainState previous_state = config.currentMainState;
+	uint32_t gesture_start = 0;
+	SystemEvent event;
+
+	update_display_power();
+
+	while ((event = detect_events(&gesture_start)) != EVENT_NONE) {
+		/* gestures started before the display was switched on only switch it on */
+		if (!display_on || (wake_press_pending && (int32_t)(gesture_start - wake_ms) <= (int32_t)HMI_GESTURE_CHORD_MS)) {
+			continue;
+		}
+		wake_press_pending = false;
+
+		switch(event) {
+		case EVENT_BUTTON_A_LONG:
+			step_brightness();
+			continue;
+		case EVENT_BUTTON_B_LONG:
+			step_sensor_period();
+			continue;
+		case EVENT_BUTTONS_AB_CHORD:
+			if (DRIVER_7_SEG_STATUS_OK == api_7_seg.suspend()) {
+				display_on = false;
+			}
+			continue;
+		default:
+			break;
+		}
+
+		switch(config.currentMainState) {
+		case MAIN_STATE_DISPLAY_C:
+			if(event == EVENT_BUTTON_A_SHORT || event == EVENT_BUTTON_B_DOUBLE) {
+				config.currentMainState = MAIN_STATE_DISPLAY_F;
+			} else if(event == EVENT_BUTTON_B_SHORT) {
+				config.currentMainState = MAIN_STATE_DISPLAY_H;
+			}
+			break;
+		case MAIN_STATE_DISPLAY_F:
+			if(event == EVENT_BUTTON_A_SHORT) {
+				config.currentMainState = MAIN_STATE_DISPLAY_H;
+			} else if(event == EVENT_BUTTON_B_SHORT || event == EVENT_BUTTON_B_DOUBLE) {
+				config.currentMainState = MAIN_STATE_DISPLAY_C;
+			}
+			break;
+		case MAIN_STATE_DISPLAY_H:
+			if(event == EVENT_BUTTON_A_SHORT || event == EVENT_BUTTON_B_DOUBLE) {
+				config.currentMainState = MAIN_STATE_DISPLAY_C;
+			} else if(event == EVENT_BUTTON_B_SHORT) {
+				config.currentMainState = MAIN_STATE_DISPLAY_F;
+			}
+			break;
+		case MAIN_STATE_ERROR_DISPLAY:
+			break;
+		}
+	}
+
+	if (wake_press_pending && !button_is_sampling()) {
+		wake_press_pending = false;
+	}
+
+	if (config.currentMainState != previous_state) {
+		scheduler_post_event(BL_EVENT_DISPLAY);
+	}
+}
+
+/*
+ * recovers the bus and checks the calibration again as bl_run_sensor does at start.
+ * blocks for the power cycle of the recovery and the power up wait of the sensor
  */
-static SystemEvent detect_events(void) {
+static bool recover_sensor(void) {
+	if (AHT20_STATUS_OK != aht20_api.bus_recovery(sensor_hi2c)) {
+		return false;
+	}
+
+	return BL_STATUS_OK == bl_run_sensor(sensor_hi2c);
+}
+
+/*
+ * sets the sensor task period for the next sample, the poll of a conversion or the next recovery
+ */
+static void update_sensor_period(void) {
+	static uint32_t task_period_ms = 0;
+	uint32_t period_ms = SENSOR_TASK_PERIOD_MS;
 
-	HMI_Interact_Status_t stateOnReleaseA = button_hmi_api.check_device_status_change(&buttonA);
-	HMI_Interact_Status_t stateOnReleaseB = button_hmi_api.check_device_status_change(&buttonB);
-	HMI_Interact_Status_t currentStateB = button_hmi_api.check_device_current_status(&buttonB);
+	/* poll a running conversion or retry a refused start, otherwise wait for the next sample.
+	   an interval shorter than the poll period is sampled every poll period */
+	if (sensor_lost) {
+		period_ms = SENSOR_RETRY_PERIOD_MS;
+	} else if (!measurement_started && !start_retry && sample_rate.interval_ms > 2U * SENSOR_TASK_PERIOD_MS) {
+		period_ms = sample_rate.interval_ms - SENSOR_TASK_PERIOD_MS;
+	}
 
-	SystemEvent detected_event = EVENT_NONE;
+	if (period_ms != task_period_ms && SCHEDULER_STATUS_OK == scheduler_set_period(sensor_task_id, period_ms)) {
+		task_period_ms = period_ms;
+	}
+}
 
-	if (stateOnReleaseA == HMI_SHORT_EVENT) {
-		detected_event = EVENT_BUTTON_A_SHORT;
+/*
+ * measures sensor data, switches to error display if the sensor can't be recovered.
+ * a lost sensor is recovered every SENSOR_RETRY_PERIOD_MS, the error display stays until its first sample
+ */
+void bl_sensor_task(void) {
+	if (sensor_lost) {
+		if (!recover_sensor()) {
+			return;
+		}
+		sensor_lost = false;
 	}
 
-	if (detected_event == EVENT_NONE) {
-		if (stateOnReleaseB == HMI_SHORT_EVENT) {
-			detected_event = EVENT_BUTTON_B_SHORT;
-		} else if (currentStateB == HMI_NO_EVENT) {
-			detected_event = EVENT_NONE;
+	if (BL_STATUS_OK != bl_process_sensor_data(sensor_hi2c)) {
+		sensor_lost = true;
+		measurement_started = false;
+		start_retry = false;
+		if (config.currentMainState != MAIN_STATE_ERROR_DISPLAY) {
+			resume_state = config.currentMainState;
+			config.currentMainState = MAIN_STATE_ERROR_DISPLAY;
+			scheduler_post_event(BL_EVENT_DISPLAY);
 		}
 	}
 
-	return detected_event;
+	update_sensor_period();
+}
+
+/*
+ * erases the next flash log sector ahead of time while the display is off.
+ * the erase stalls the core for 1-2 s, the flash log erases it itself if the display never goes off
+ */
+void bl_flash_task(void) {
+	if (!display_on) {
+		flash_log_prepare();
+	}
+}
+
+/*
+ * posts sensor event when a background transfer finishes, called from interrupt
+ */
+static void sensor_result_ready(void) {
+	scheduler_post_event(BL_EVENT_SENSOR);
+}
+
+/*
+ * posts frame event when the text layer needs a new frame, called from SysTick
+ */
+static void frame_redraw_ready(void) {
+	scheduler_post_event(BL_EVENT_FRAME);
+}
+
+/*
+ * registers sensor, button, display, frame and flash tasks in the scheduler.
+ * flash is added last, it runs after every other ready task
+ */
+bl_status_t bl_start_tasks(I2C_HandleTypeDef *hi2c) {
+	static const scheduler_task_config_t task_configs[] = {
+			{
+					.name = "buttons",
+					.run = bl_button_task,
+					.period_ms = BUTTON_TASK_PERIOD_MS,
+					.deadline_ms = BUTTON_TASK_DEADLINE_MS,
+					.event_mask = SCHEDULER_EVENT_BIT(BL_EVENT_BUTTON),
+			},
+			{
+					.name = "sensor",
+					.run = bl_sensor_task,
+					.period_ms = SENSOR_TASK_PERIOD_MS,
+					.deadline_ms = SENSOR_TASK_DEADLINE_MS,
+					.event_mask = SCHEDULER_EVENT_BIT(BL_EVENT_SENSOR),
+			},
+			{
+					.name = "display",
+					.run = bl_display_task,
+					.period_ms = DISPLAY_TASK_PERIOD_MS,
+					.deadline_ms = DISPLAY_TASK_DEADLINE_MS,
+					.event_mask = SCHEDULER_EVENT_BIT(BL_EVENT_DISPLAY),
+			},
+			{
+					.name = "frame",
+					.run = char_gen_text_render,
+					.deadline_ms = FRAME_TASK_DEADLINE_MS,
+					.event_mask = SCHEDULER_EVENT_BIT(BL_EVENT_FRAME),
+			},
+			{
+					.name = "flash",
+					.run = bl_flash_task,
+					.period_ms = FLASH_TASK_PERIOD_MS,
+			},
+	};
+
+	assert(hi2c != NULL);
+	sensor_hi2c = hi2c;
+	last_activity_ms = HAL_GetTick();
+	if (SAMPLE_RATE_STATUS_OK != sample_rate_init(&sample_rate, &SAMPLE_RATE_CONFIG, HAL_GetTick())) {
+		return BL_STATUS_RUN_FAILED;
+	}
+	aht20_api.set_result_callback(sensor_result_ready);
+	char_gen_text_set_redraw_callback(frame_redraw_ready);
+
+	for (uint8_t i = 0; i < sizeof(task_configs) / sizeof(task_configs[0]); ++i) {
+		uint8_t task_id = 0;
+		if (SCHEDULER_STATUS_OK != scheduler_add_task(&task_configs[i], &task_id)) {
+			return BL_STATUS_RUN_FAILED;
+		}
+		if (task_configs[i].run == bl_sensor_task) {
+			sensor_task_id = task_id;
+		}
+	}
+
+	return BL_STATUS_OK;
+}
+
+/*
+ * allows Stop mode while the display is off, buttons are idle, the sensor bus is idle and telemetry is sent
+ */
+bool bl_can_stop(void) {
+	return !display_on && !button_is_sampling() && sensor_hi2c != NULL && sensor_hi2c->State == HAL_I2C_STATE_READY
+			&& !telemetry_is_busy();
+}
+
+/*
+ * copies display update counters
+ */
+void bl_get_display_stats(bl_display_stats_t *stats) {
+	assert(stats != NULL);
+
+	*stats = display_stats;
+}
+
+/*
+ * writes sampling interval, effective sample rate and bus time saved
+ */
+void bl_get_sample_rate_stats(sample_rate_stats_t *stats) {
+	assert(stats != NULL);
+
+	sample_rate_get_stats(&sample_rate, HAL_GetTick(), stats);
+}
+
+/*
+ * sends every sample over the telemetry port: sensor frame, filtered values and state flags.
+ * a full transmit buffer drops the frame, the host sees a gap in the sequence
+ */
+static void send_telemetry(uint32_t time_ms, bool logged) {
+	telemetry_sample_t sample = {
+			.time_ms = time_ms,
+			.temperature_centi = (int16_t)sensor_data.temperature_c_centi,
+			.humidity_centi = (int16_t)sensor_data.humidity_centi,
+	};
+
+	memcpy(sample.raw, sensor_data.measured_data, TELEMETRY_RAW_FRAME_SIZE);
+	if (logged) {
+		sample.flags |= TELEMETRY_FLAG_LOGGED;
+	}
+	if (sensor_filter.config.mode != SENSOR_FILTER_NONE) {
+		sample.flags |= TELEMETRY_FLAG_FILTERED;
+	}
+	if (sample_rate.interval_ms <= SAMPLE_RATE_CONFIG.min_interval_ms) {
+		sample.flags |= TELEMETRY_FLAG_MIN_INTERVAL;
+	}
+	if (display_on) {
+		sample.flags |= TELEMETRY_FLAG_DISPLAY_ON;
+	}
+
+	telemetry_send_sample(&sample);
+}
+
+/*
+ * takes the next button gesture and maps it to an event.
+ * gesture_start is set to the time the gesture started
+ */
+static SystemEvent detect_events(uint32_t *gesture_start) {
+	HMI_Gesture_Event_t gesture;
+
+	while (button_hmi_api.get_gesture(&gesture)) {
+		*gesture_start = gesture.press_time;
+
+		if (gesture.gpio_pins == (BUTTON_S1_Pin | BUTTON_S2_Pin)) {
+			return EVENT_BUTTONS_AB_CHORD;
+		}
+
+		switch (gesture.type) {
+		case HMI_SHORT_EVENT:
+			return (gesture.gpio_pins == BUTTON_S1_Pin) ? EVENT_BUTTON_A_SHORT : EVENT_BUTTON_B_SHORT;
+		case HMI_DOUBLE_EVENT:
+			if (gesture.gpio_pins == BUTTON_S2_Pin) {
+				return EVENT_BUTTON_B_DOUBLE;
+			}
+			break;
+		case HMI_LONG_EVENT:
+			return (gesture.gpio_pins == BUTTON_S1_Pin) ? EVENT_BUTTON_A_LONG : EVENT_BUTTON_B_LONG;
+		case HMI_REPEAT_EVENT:
+			/* only brightness repeats while held */
+			if (gesture.gpio_pins == BUTTON_S1_Pin) {
+				return EVENT_BUTTON_A_LONG;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	return EVENT_NONE;
 }
 
 void HAL_GPIO_EXTI_Callback(uint16_t gpio_pin) {
+	PROFILER_BEGIN(start_cycles);
+
 	button_hmi_api.device_interrupt_handle(gpio_pin);
+	button_activity = true;
+	scheduler_post_event(BL_EVENT_BUTTON);
+
+	PROFILER_END(PROFILER_GPIO_EXTI_CALLBACK, start_cycles);
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
+	if (htim == sampling_htim) {
+		button_sample();
+	}
 }
@@ -18,9 +18,10 @@
  */
 
 #include "button_hmi_api.h"
+#include "hmi_gestures.h"
 
 /**
- * @brief Initializes button and adds it to linked list
+ * @brief Initializes button and registers it for the EXTI line of its pin
  *
  * @param[out] button button to be initialized
  *
@@ -37,7 +38,6 @@ static void b_hmi_init(void *button_ptr, GPIO_TypeDef* gpio_port, uint16_t gpio_
  *
  * @return Interaction status change
  * @retval HMI_SHORT_EVENT On transition from deactivated state to activated state
- * @retval HMI_LONG_EVENT On transition from activated state to long activation state
  * @retval HMI_NO_EVENT On transition to deactivated state
  */
 static HMI_Interact_Status_t b_hmi_check_button_status_change(void *button_ptr);
@@ -58,7 +58,8 @@ hmi_device_handler_t button_hmi_api = {
 		.init = b_hmi_init,
 		.check_device_status_change = b_hmi_check_button_status_change,
 		.check_device_current_status= b_hmi_check_button_current_state,
-		.device_interrupt_handle = read_button
+		.device_interrupt_handle = read_button,
+		.get_gesture = hmi_gestures_get_event
 };
 
 /**
@@ -69,12 +70,11 @@ hmi_device_handler_t button_hmi_api = {
  * @return converted HMI_Interact_Status_t
  * @retval HMI_NO_EVENT Variable button_status is equal BUTTON_RELEASED
  * @retval HMI_SHORT_EVENT Variable button_status is equal BUTTON_SHORT_PRESS
- * @retval HMI_LONG_EVENT Variable button_status is equal BUTTON_LONG_PRESS
  */
 static HMI_Interact_Status_t convert_to_hmi_status(Button_State button_status);
 
 /**
- * @brief Initializes button and adds it to linked list
+ * @brief Initializes button and registers it for the EXTI line of its pin
  *
  * @param[out] button button to be initialized
  *
@@ -94,7 +94,6 @@ static void b_hmi_init(void *button_ptr, GPIO_TypeDef* gpio_port, uint16_t gpio_
  *
  * @return Interaction status change
  * @retval HMI_SHORT_EVENT On transition from deactivated state to activated state
- * @retval HMI_LONG_EVENT On transition from activated state to long activation state
  * @retval HMI_NO_EVENT When state doesn't change and on transition to deactivated state
  */
 static HMI_Interact_Status_t b_hmi_check_button_status_change(void *button_ptr)
@@ -127,7 +126,15 @@ static HMI_Interact_Status_t b_hmi_check_button_status_change(void *button_ptr)
  */
 static HMI_Interact_Status_t b_hmi_check_button_current_state(void *button_ptr) {
 	volatile Button *button = (volatile Button*) button_ptr;
-	return convert_to_hmi_status(button->button_state);
+	HMI_Interact_Status_t result = convert_to_hmi_status(button->button_state);
+
+	// still held for the long press time
+	if(result == HMI_SHORT_EVENT && button->debounced_state == BUTTON_SHORT_PRESS
+			&& HAL_GetTick() - button->press_time >= HMI_GESTURE_LONG_MS) {
+		result = HMI_LONG_EVENT;
+	}
+
+	return result;
 }
 
 /**
@@ -138,7 +145,6 @@ static HMI_Interact_Status_t b_hmi_check_button_current_state(void *button_ptr)
  * @return converted HMI_Interact_Status_t
  * @retval HMI_NO_EVENT Variable button_status is equal BUTTON_RELEASED
  * @retval HMI_SHORT_EVENT Variable button_status is equal BUTTON_SHORT_PRESS
- * @retval HMI_LONG_EVENT Variable button_status is equal BUTTON_LONG_PRESS
  */
 static HMI_Interact_Status_t convert_to_hmi_status(Button_State button_status) {
 	HMI_Interact_Status_t result = HMI_NO_EVENT;
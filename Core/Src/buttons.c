@@ -18,42 +18,179 @@
  */
 
 #include "buttons.h"
-#include <stdbool.h>
+#include <stddef.h>
 
-/// Time needed to debounce in milliseconds
-static const uint8_t DEBOUNCE_TIME_MS = 20;
-/// Time needed to make long press
+/// Number of EXTI lines, one per pin number
+#define BUTTON_EXTI_LINES 16
+/// Number of GPIO ports buttons can be connected to
+#define BUTTON_MAX_PORTS 4
 
-// entry to button linked list
-static volatile Button *button_list_entry;
+// @brief Buttons of one port debounced together
+typedef struct {
+	GPIO_TypeDef *port; /// GPIO port
+	uint16_t mask; /// Pins with a button
+	uint16_t state; /// Debounced state, bit set when pressed
+	uint16_t count0; /// Vertical counter low bits
+	uint16_t count1; /// Vertical counter high bits
+} Button_Port;
+
+// buttons indexed by EXTI line, NULL for lines without a button
+static volatile Button *exti_buttons[BUTTON_EXTI_LINES];
+
+// ports with buttons
+static Button_Port ports[BUTTON_MAX_PORTS];
+static uint8_t port_count = 0;
+
+// EXTI lines of all buttons
+static uint16_t exti_mask = 0;
+
+// sampling timer and its state
+static TIM_HandleTypeDef *sampling_htim = NULL;
+static volatile bool sampling = false;
+
+// clean events, written by the sampler and read by the application
+static struct {
+	Button_Event events[BUTTON_EVENT_QUEUE_SIZE];
+	volatile uint8_t head;
+	volatile uint8_t tail;
+	uint32_t dropped;
+} event_queue = {0};
+
+// called after each sample, keeps sampling running while it returns true
+static bool (*sample_callback)(uint32_t now) = NULL;
+
+// interrupts from pins without a registered button
+static volatile uint32_t unknown_pin_count = 0;
 
 /**
- * @brief checks if there is a button connected to a gpio_pin
+ * @brief finds the button connected to a gpio_pin
  *
- * @param gpio_pin GPIO pin that caused interrupt
+ * @param gpio_pin GPIO pin that caused interrupt, exactly one bit set
  *
- * @return Button pointer which points to a button which caused interrupt
+ * @return Button pointer which points to a button which caused interrupt, NULL for unknown pin
  */
 static volatile Button* check_interrupt_pin(uint16_t gpio_pin);
 
 /**
- * @brief Checks button and returns detected button state
+ * @brief disables button EXTI lines and starts the sampling timer
+ */
+static void start_sampling(void);
+
+/**
+ * @brief stops the sampling timer and enables button EXTI lines, restarts if a button is already pressed
+ */
+static void stop_sampling(void);
+
+/**
+ * @brief updates the button and queues the event for a debounced state change
+ *
+ * @param line EXTI line of the changed pin
+ *
+ * @param pressed new debounced state
+ *
+ * @param now HAL tick
+ */
+static void report_change(uint8_t line, bool pressed, uint32_t now);
+
+/**
+ * @brief reads pressed pins of a port, buttons are active low
+ *
+ * @param port port to read
+ *
+ * @return bit set for each pressed pin
+ */
+static inline uint16_t read_pressed(const Button_Port *port) {
+	return (uint16_t)(~port->port->IDR & port->mask);
+}
+
+/**
+ * @brief Initializes button and registers it for the EXTI line of its pin and for sampling
+ *
+ * @param[out] button button to be initialized
+ *
+ * @param[in] gpio_port GPIO port button connected to
+ *
+ * @param gpio_pin GPIO pin button connected to
+ */
+void button_init(volatile Button *button, GPIO_TypeDef* gpio_port, uint16_t gpio_pin)
+{
+	bool pressed = HAL_GPIO_ReadPin(gpio_port, gpio_pin) == GPIO_PIN_RESET;
+
+	button->button_state = BUTTON_RELEASED;
+	button->debounced_state = pressed ? BUTTON_SHORT_PRESS : BUTTON_RELEASED;
+	button->press_count = 0;
+	button->seen_press_count = 0;
+	button->press_time = 0;
+	button->release_time = 0;
+
+	// initialize buttons GPIO
+	button->gpio.port = gpio_port;
+	button->gpio.pin = gpio_pin;
+
+	// pin number is the EXTI line, a pin mask with several bits can't be dispatched
+	if(gpio_pin == 0 || (gpio_pin & (gpio_pin - 1)) != 0) {
+		return;
+	}
+
+	// find or add the port group, the pin starts debounced at its current level
+	Button_Port *port = NULL;
+	for(uint8_t i = 0; i < port_count; ++i) {
+		if(ports[i].port == gpio_port) {
+			port = &ports[i];
+			break;
+		}
+	}
+	if(port == NULL) {
+		if(port_count == BUTTON_MAX_PORTS) {
+			return;
+		}
+		port = &ports[port_count++];
+		port->port = gpio_port;
+	}
+
+	port->mask |= gpio_pin;
+	if(pressed) {
+		port->state |= gpio_pin;
+	} else {
+		port->state &= (uint16_t)~gpio_pin;
+	}
+
+	exti_buttons[POSITION_VAL(gpio_pin)] = button;
+	exti_mask |= gpio_pin;
+}
+
+/**
+ * @brief Sets timer driving button_sample every BUTTON_SAMPLE_PERIOD_MS
+ *
+ * @param[in] htim sampling timer, its period elapsed callback must call button_sample
+ */
+void button_sampling_init(TIM_HandleTypeDef *htim) {
+	sampling_htim = htim;
+}
+
+/**
+ * @brief Sets function called from sampling interrupt after each sample, it consumes queued events
+ *
+ * @param callback function to call with the HAL tick, NULL to disable
+ */
+void button_set_sample_callback(bool (*callback)(uint32_t now)) {
+	sample_callback = callback;
+}
+
+/**
+ * @brief Checks button and returns debounced button state
  *
  * @param[in]button is a button to check
  *
  * @return detected button state
  */
 Button_State check_button_state(volatile Button *button) {
-	Button_State checked_button_state;
+	Button_State checked_button_state = button->debounced_state;
 
-	// Current state needs to be checked
-	// Because interrupt on rising edge sometimes don't work properly
-	GPIO_PinState  current_button_pin_state =  HAL_GPIO_ReadPin(button->gpio.port, button->gpio.pin);
-
-	// Check if button released
-	if(button->last_gpio_state == GPIO_PIN_SET || current_button_pin_state == GPIO_PIN_SET) {
-		checked_button_state = BUTTON_RELEASED;
-	} else {
+	// a press which was already released before this check is still reported once
+	uint8_t press_count = button->press_count;
+	if(press_count != button->seen_press_count) {
+		button->seen_press_count = press_count;
 		checked_button_state = BUTTON_SHORT_PRESS;
 	}
 
@@ -63,89 +200,184 @@ Button_State check_button_state(volatile Button *button) {
 }
 
 /**
- * @brief detect button GPIO state change using debouncing and save time when button pressed
+ * @brief Starts sampling on the first edge of an idle button, called from EXTI interrupt
  *
  * @param gpio_pin is a pin that caused interrupt
  */
 void read_button(uint16_t gpio_pin) {
-	// Determine which button was pressed
-	volatile Button* button = check_interrupt_pin(gpio_pin);
-	// Check if pressed button was found
-	if(button != NULL) {
-		uint32_t current_time = HAL_GetTick();
-		// Debounce
-		if(current_time - button->press_time >= DEBOUNCE_TIME_MS && current_time - button->release_time >= DEBOUNCE_TIME_MS) {
-			// Save button GPIO state
-			button->last_gpio_state = HAL_GPIO_ReadPin(button->gpio.port, button->gpio.pin);
-			// If button pressed save button_press_time
-			if(button->last_gpio_state == GPIO_PIN_RESET) {
-				button->press_time = current_time;
-			} else {
-				button->release_time = current_time;
-			}
+	// Unknown pin, nothing to sample
+	if(check_interrupt_pin(gpio_pin) == NULL) {
+		unknown_pin_count++;
+		return;
+	}
+
+	start_sampling();
+}
+
+/**
+ * @brief Samples all button pins and debounces them, called from sampling timer interrupt
+ */
+void button_sample(void) {
+	uint32_t now = HAL_GetTick();
+	bool active = false;
+
+	for(uint8_t i = 0; i < port_count; ++i) {
+		Button_Port *port = &ports[i];
+
+		// counters of pins matching the debounced state are cleared,
+		// the others count up and the state toggles when they wrap
+		uint16_t delta = read_pressed(port) ^ port->state;
+		port->count1 = (port->count1 ^ port->count0) & delta;
+		port->count0 = (uint16_t)~port->count0 & delta;
+		uint16_t toggle = delta & (uint16_t)~(port->count0 | port->count1);
+		port->state ^= toggle;
+
+		while(toggle != 0) {
+			uint8_t line = (uint8_t)POSITION_VAL(toggle);
+			report_change(line, (port->state & (1U << line)) != 0, now);
+			toggle &= (uint16_t)(toggle - 1);
 		}
+
+		active = active || port->state != 0 || port->count0 != 0 || port->count1 != 0;
+	}
+
+	if(sample_callback != NULL && sample_callback(now)) {
+		active = true;
+	}
+
+	if(!active) {
+		stop_sampling();
 	}
 }
 
 /**
- * @brief Initializes button and adds it to linked list
- *
- * @param[out] button button to be initialized
+ * @brief Takes the oldest clean button event from the queue
  *
- * @param[in] gpio_pin GPIO pin that caused interrupt
+ * @param[out] event taken event
  *
- * @param gpio_pin GPIO pin button connected to
+ * @return false if the queue is empty
  */
-void button_init(volatile Button *button, GPIO_TypeDef* gpio_port, uint16_t gpio_pin)
-{
-	static volatile Button *next_button = NULL;
+bool button_get_event(Button_Event *event) {
+	uint8_t tail = event_queue.tail;
 
-	button->button_state = (HAL_GPIO_ReadPin(gpio_port, gpio_pin) == GPIO_PIN_RESET) ? BUTTON_RELEASED : BUTTON_SHORT_PRESS;
-	button->last_gpio_state = HAL_GPIO_ReadPin(gpio_port, gpio_pin);
-	button->press_time = 0;
-	button->release_time = 0;
+	if(tail == event_queue.head) {
+		return false;
+	}
 
-	// initialize buttons GPIO
-	button->gpio.port = gpio_port;
-	button->gpio.pin = gpio_pin;
+	*event = event_queue.events[tail];
+	event_queue.tail = (uint8_t)((tail + 1) % BUTTON_EVENT_QUEUE_SIZE);
 
-	// assign next button
-	button->next_button = next_button;
+	return true;
+}
+
+/**
+ * @brief Checks whether button sampling is running
+ *
+ * @return true while a button is pressed or bouncing
+ */
+bool button_is_sampling(void) {
+	return sampling;
+}
 
-	// set next button pointer to a current button
-	next_button = button;
+/**
+ * @brief Returns number of events lost because the queue was full
+ *
+ * @return dropped event count
+ */
+uint32_t button_get_dropped_events(void) {
+	return event_queue.dropped;
+}
 
-	/*
-	 * button_list_entry variable is static global in buttons.c file
-	 * used to save the start of linked button list
-	 */
-	button_list_entry = button;
+/**
+ * @brief Returns number of interrupts from pins without a registered button
+ *
+ * @return unknown pin interrupt count
+ */
+uint32_t button_get_unknown_pin_count(void) {
+	return unknown_pin_count;
 }
 
 /**
- * @brief checks if there is a button connected to a gpio_pin
+ * @brief finds the button connected to a gpio_pin
  *
- * @param gpio_pin GPIO pin that caused interrupt
+ * @param gpio_pin GPIO pin that caused interrupt, exactly one bit set
  *
- * @return Button pointer which points to a button which caused interrupt
+ * @return Button pointer which points to a button which caused interrupt, NULL for unknown pin
  */
-volatile Button* check_interrupt_pin(uint16_t gpio_pin) {
-	/*
-	 * button_list_entry variable is static global in buttons.c file
-	 * used to save the start of linked button list
-	 */
-	volatile Button *button_to_return = button_list_entry;
+static volatile Button* check_interrupt_pin(uint16_t gpio_pin) {
+	if(gpio_pin == 0 || (gpio_pin & (gpio_pin - 1)) != 0) {
+		return NULL;
+	}
 
-	while(button_to_return->next_button != NULL) {
-		if(button_to_return->gpio.pin != gpio_pin) {
-			button_to_return = button_to_return->next_button;
-		}
-		else {
-			break;
-		}
+	return exti_buttons[POSITION_VAL(gpio_pin)];
+}
+
+/**
+ * @brief disables button EXTI lines and starts the sampling timer
+ */
+static void start_sampling(void) {
+	EXTI->IMR &= ~(uint32_t)exti_mask;
+
+	if(sampling || sampling_htim == NULL) {
+		return;
 	}
 
+	sampling = true;
+	__HAL_TIM_SET_COUNTER(sampling_htim, 0);
+	HAL_TIM_Base_Start_IT(sampling_htim);
+}
 
-	return button_to_return;
+/**
+ * @brief stops the sampling timer and enables button EXTI lines, restarts if a button is already pressed
+ */
+static void stop_sampling(void) {
+	HAL_TIM_Base_Stop_IT(sampling_htim);
+	sampling = false;
+
+	EXTI->PR = exti_mask;
+	EXTI->IMR |= exti_mask;
+
+	// an edge between the last sample and enabling the lines would be lost
+	for(uint8_t i = 0; i < port_count; ++i) {
+		if(read_pressed(&ports[i]) != 0) {
+			start_sampling();
+			return;
+		}
+	}
 }
 
+/**
+ * @brief updates the button and queues the event for a debounced state change
+ *
+ * @param line EXTI line of the changed pin
+ *
+ * @param pressed new debounced state
+ *
+ * @param now HAL tick
+ */
+static void report_change(uint8_t line, bool pressed, uint32_t now) {
+	volatile Button *button = exti_buttons[line];
+
+	if(pressed) {
+		button->debounced_state = BUTTON_SHORT_PRESS;
+		button->press_time = now;
+		button->press_count++;
+	} else {
+		button->debounced_state = BUTTON_RELEASED;
+		button->release_time = now;
+	}
+
+	uint8_t head = event_queue.head;
+	uint8_t next = (uint8_t)((head + 1) % BUTTON_EVENT_QUEUE_SIZE);
+	if(next == event_queue.tail) {
+		event_queue.dropped++;
+		return;
+	}
+
+	event_queue.events[head] = (Button_Event) {
+		.line = line,
+		.type = pressed ? BUTTON_EVENT_PRESS : BUTTON_EVENT_RELEASE,
+		.time = now,
+	};
+	event_queue.head = next;
+}
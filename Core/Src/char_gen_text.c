@@ -0,0 +1,322 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file char_gen_text.c
+ * @brief Implements the text layer for the 7-segment character generator.
+ *
+ * Text is encoded into segment codes once on submission and handed to the tick through a pair of
+ * buffers. The tick owns the displayed buffer and the scroll state and only flags a redraw, the
+ * frame is built by char_gen_text_render() in task context by sliding a window over the encoded
+ * glyphs.
+ */
+
+/**
+ * @addtogroup Character_Generator_Text
+ * @{
+ */
+
+#include <assert.h>
+#include <stddef.h>
+#include "char_gen_text.h"
+#include "character_generator.h"
+
+/**
+ * @brief Number of digits on the display.
+ */
+static const uint8_t DISPLAY_DIGITS = 4;
+
+/**
+ * @brief Blank digits inserted between the end and the start of scrolling text.
+ */
+static const uint8_t SCROLL_GAP = 2;
+
+/**
+ * @brief Decimal point bit of a segment code (active-low, set = off).
+ */
+static const uint8_t DP_SEGMENT = 0x80;
+
+/**
+ * @struct char_gen_text_buffer_t
+ * @brief Pre-encoded text with its brightness.
+ */
+typedef struct
+{
+    uint8_t codes[CHAR_GEN_TEXT_MAX_GLYPHS];	/**< Active-low segment codes, decimal points folded in. */
+    uint8_t length;								/**< Number of valid codes. */
+    driver_7_seg_brightness_t brightness[4];	/**< Brightness level per digit. */
+} char_gen_text_buffer_t;
+
+/**
+ * @brief Text buffers: one displayed by the tick, the other filled by char_gen_text_show().
+ */
+static char_gen_text_buffer_t buffers[2];
+
+/**
+ * @brief Index of the buffer owned by the tick.
+ */
+static volatile uint8_t displayed_buffer = 0;
+
+/**
+ * @brief Set when the other buffer holds newly submitted text.
+ */
+static volatile uint8_t text_pending = 0;
+
+/**
+ * @brief Milliseconds per scroll step, 0 disables scrolling.
+ */
+static volatile uint16_t scroll_period_ms = CHAR_GEN_TEXT_DEFAULT_SCROLL_MS;
+
+/**
+ * @brief Scroll state owned by the tick: window start and time since last step.
+ */
+static uint8_t scroll_offset = 0;
+static uint16_t scroll_elapsed_ms = 0;
+
+/**
+ * @brief Set when the displayed text has never been sent to the driver.
+ */
+static uint8_t text_shown = 0;
+
+/**
+ * @brief Set by the tick when the window changed and a frame must be rendered.
+ */
+static volatile uint8_t redraw_pending = 0;
+
+/**
+ * @brief Called from the tick when a redraw is flagged, NULL if not set.
+ */
+static volatile char_gen_text_redraw_callback_t redraw_callback = NULL;
+
+/**
+ * @brief Encodes text into the given buffer, folding decimal points into the previous glyph.
+ */
+static void encode_text(char_gen_text_buffer_t *const buffer, const char *text)
+{
+    uint8_t length = 0;
+
+    for (; *text != '\0' && length < CHAR_GEN_TEXT_MAX_GLYPHS; ++text)
+    {
+        if (*text == '.' && length > 0 && (buffer->codes[length - 1] & DP_SEGMENT))
+        {
+            buffer->codes[length - 1] &= (uint8_t)~DP_SEGMENT;
+            continue;
+        }
+
+        buffer->codes[length++] = char_gen_glyph(*text);
+    }
+
+    buffer->length = length;
+}
+
+/**
+ * @brief Withdraws a pending submission and returns the buffer free for writing.
+ *
+ * The pending flag is cleared first, so the tick never adopts a buffer being written. The barrier
+ * keeps the compiler from moving the buffer writes above the clear.
+ */
+static char_gen_text_buffer_t *claim_buffer(void)
+{
+    text_pending = 0;
+    __COMPILER_BARRIER();
+
+    return &buffers[displayed_buffer ^ 1];
+}
+
+/**
+ * @brief Stores brightness into the written buffer and hands it to the tick.
+ *
+ * The barrier makes every buffer write land before the pending flag is seen by the tick.
+ */
+static void publish_buffer(char_gen_text_buffer_t *const buffer, const driver_7_seg_brightness_t *const brightness)
+{
+    for (uint8_t i = 0; i < DISPLAY_DIGITS; ++i)
+    {
+        buffer->brightness[i] = brightness[i];
+    }
+
+    __COMPILER_BARRIER();
+    text_pending = 1;
+}
+
+/**
+ * @brief Sends the window of the given buffer starting at offset to the driver.
+ */
+static void send_window(const char_gen_text_buffer_t *const buffer, const uint8_t offset)
+{
+    uint16_t out_data[4];
+    uint8_t cycle = (uint8_t)(buffer->length + SCROLL_GAP);
+
+    for (uint8_t i = 0; i < DISPLAY_DIGITS; ++i)
+    {
+        uint8_t position = i;
+        uint8_t code = char_gen_glyph(' ');
+
+        if (buffer->length > DISPLAY_DIGITS)
+        {
+            position = (uint8_t)((offset + i) % cycle);
+        }
+
+        if (position < buffer->length)
+        {
+            code = buffer->codes[position];
+        }
+
+        out_data[i] = (uint16_t)(code << 8) | (1 << i);
+    }
+
+    char_gen_send_frame(out_data, buffer->brightness);
+}
+
+char_generator_status_t char_gen_text_show(const char *const text, const driver_7_seg_brightness_t *const brightness)
+{
+    if (text == NULL || brightness == NULL)
+    {
+        return CHAR_GEN_STATUS_INVALID_PARAMETERS;
+    }
+
+    char_gen_text_buffer_t *const buffer = claim_buffer();
+
+    encode_text(buffer, text);
+    publish_buffer(buffer, brightness);
+
+    return CHAR_GEN_STATUS_OK;
+}
+
+char_generator_status_t char_gen_text_show_codes(const uint8_t *const codes, const uint8_t length,
+                                                 const driver_7_seg_brightness_t *const brightness)
+{
+    if (codes == NULL || brightness == NULL || length > CHAR_GEN_TEXT_MAX_GLYPHS)
+    {
+        return CHAR_GEN_STATUS_INVALID_PARAMETERS;
+    }
+
+    char_gen_text_buffer_t *const buffer = claim_buffer();
+
+    for (uint8_t i = 0; i < length; ++i)
+    {
+        buffer->codes[i] = codes[i];
+    }
+    buffer->length = length;
+    publish_buffer(buffer, brightness);
+
+    return CHAR_GEN_STATUS_OK;
+}
+
+void char_gen_text_set_scroll_period(const uint16_t period_ms)
+{
+    scroll_period_ms = period_ms;
+}
+
+void char_gen_text_set_redraw_callback(const char_gen_text_redraw_callback_t callback)
+{
+    redraw_callback = callback;
+}
+
+void char_gen_text_tick(void)
+{
+    uint8_t redraw = 0;
+
+    if (text_pending)
+    {
+        uint8_t previous_length = buffers[displayed_buffer].length;
+
+        displayed_buffer ^= 1;
+        text_pending = 0;
+
+        if (buffers[displayed_buffer].length != previous_length || !text_shown)
+        {
+            scroll_offset = 0;
+            scroll_elapsed_ms = 0;
+        }
+        text_shown = 1;
+        redraw = 1;
+    }
+
+    const char_gen_text_buffer_t *const buffer = &buffers[displayed_buffer];
+
+    if (text_shown && buffer->length > DISPLAY_DIGITS && scroll_period_ms != 0)
+    {
+        if (++scroll_elapsed_ms >= scroll_period_ms)
+        {
+            scroll_elapsed_ms = 0;
+            scroll_offset = (uint8_t)((scroll_offset + 1) % (buffer->length + SCROLL_GAP));
+            redraw = 1;
+        }
+    }
+
+    if (redraw)
+    {
+        redraw_pending = 1;
+
+        char_gen_text_redraw_callback_t callback = redraw_callback;
+        if (callback != NULL)
+        {
+            callback();
+        }
+    }
+}
+
+void char_gen_text_render(void)
+{
+    /* take a consistent buffer and offset, the tick may move them while the frame is built */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint8_t pending = redraw_pending;
+    uint8_t index = displayed_buffer;
+    uint8_t offset = scroll_offset;
+    redraw_pending = 0;
+
+    __set_PRIMASK(primask);
+
+    if (pending)
+    {
+        send_window(&buffers[index], offset);
+    }
+}
+
+uint32_t char_gen_text_get_idle_ms(void)
+{
+    if (text_pending)
+    {
+        return 1;
+    }
+
+    if (!text_shown || buffers[displayed_buffer].length <= DISPLAY_DIGITS || scroll_period_ms == 0)
+    {
+        return UINT32_MAX;
+    }
+
+    if (scroll_elapsed_ms >= scroll_period_ms)
+    {
+        return 1;
+    }
+
+    return (uint32_t)(scroll_period_ms - scroll_elapsed_ms);
+}
+
+void char_gen_text_skip_ms(const uint32_t elapsed_ms)
+{
+    uint32_t elapsed = scroll_elapsed_ms + elapsed_ms;
+
+    scroll_elapsed_ms = (elapsed < scroll_period_ms) ? (uint16_t)elapsed : (uint16_t)(scroll_period_ms - 1U);
+}
+
+/** @} */ // end of Character_Generator_Text
@@ -22,8 +22,8 @@
  * @brief Implements character generation and transmission logic for 7-segment displays.
  *
  * This module provides functions to initialize and control a 7-segment display by converting ASCII characters
- * to segment patterns and transmitting them via an SPI interface. It uses a lookup table to map supported
- * characters to their 7-segment encodings and handles period (dot) control for each digit.
+ * to segment patterns and transmitting them via an SPI interface. It uses a compile-time table indexed by
+ * character to map characters to their 7-segment encodings and handles period (dot) control for each digit.
  */
 
 /**
@@ -32,7 +32,6 @@
  */
 
 #include <assert.h>
-#include <stddef.h>
 #include "driver_7_seg.h"
 #include "character_generator.h"
 
@@ -44,12 +43,7 @@
 static const uint8_t DIGIT_NUM = 4;
 
 /**
- * @enum chars
- * @brief Defines 7-segment display encodings for supported characters.
- *
- * Each enum value represents an 8-bit pattern for a character on a 7-segment display:
- * - Bit 7: Decimal point (0 = on, 1 = off).
- * - Bits 6-0: Segments G, F, E, D, C, B, A (0 = on, 1 = off).
+ * @brief 7-segment bit masks used in glyph descriptions (1 = segment on).
  *
  * Segment layout:
  * @verbatim
@@ -64,68 +58,97 @@ static const uint8_t DIGIT_NUM = 4;
  *     --- D ---
  * @endverbatim
  *
- * @note Uses `uint8_t` as the underlying type (GNU99 or later) to ensure 1-byte size.
+ * The display is active-low, glyphs are inverted on lookup.
  */
-typedef enum : uint8_t	/* despite of the fact that it shows syntax error it's legal in GNU99 and later standards */
-{
-    INVALID_CHAR = 0xFF, 	/**< 		  Invalid character. All segments off (11111111). */
-    ZERO    	 = 0xC0, 	/**< '0': 	  Segments A, B, C, D, E, F on (11000000). */
-    ONE     	 = 0xF9, 	/**< '1': 	  Segments B, C on (11111001). */
-    TWO     	 = 0xA4, 	/**< '2': 	  Segments A, B, D, E, G on (10100100). */
-    THREE   	 = 0xB0,	/**< '3': 	  Segments A, B, C, D, G on (10110000). */
-    FOUR    	 = 0x99, 	/**< '4': 	  Segments B, C, F, G on (10011001). */
-    FIVE    	 = 0x92, 	/**< '5': 	  Segments A, C, D, F, G on (10010010). */
-    SIX     	 = 0x82, 	/**< '6': 	  Segments A, C, D, E, F, G on (10000010). */
-    SEVEN   	 = 0xF8, 	/**< '7': 	  Segments A, B, C on (11111000). */
-    EIGHT   	 = 0x80, 	/**< '8': 	  All segments on (10000000). */
-    NINE    	 = 0x90, 	/**< '9': 	  Segments A, B, C, D, F, G on (10010000). */
-	H_CHAR		 = 0x89, 	/** 10001001 */
-	F_CHAR		 = 0x8E,	/** 10001110 */
-	C_CHAR		 = 0xC6,	/** 11000110 */
-    DASH    	 = 0xBF, 	/**< '-': 	  Segment G on (10111111). */
-} chars;
-
-/**
- * @struct char_mapping_t
- * @brief Maps an ASCII character to its 7-segment display code.
- *
- * Defines a packed structure to associate an ASCII character with its corresponding 7-segment code.
- *
- * @note Size: 2 bytes (1 byte for `ch`, 1 byte for `code` due to `__attribute__((packed))`).
- */
-typedef struct
-{
-    char ch; 	/**< ASCII character to display (e.g., '0', 'A', 't'). */
-    chars code;	/**< Corresponding 7-segment code from the chars enum. */
-} char_mapping_t;
+#define SEG_A	0x01
+#define SEG_B	0x02
+#define SEG_C	0x04
+#define SEG_D	0x08
+#define SEG_E	0x10
+#define SEG_F	0x20
+#define SEG_G	0x40
+#define SEG_DP	0x80
+
+/**
+ * @brief Glyph description: ASCII character and the segments forming it.
+ *
+ * Single source for the lookup table. Letters without a usable 7-segment form
+ * (K, M, V, W, X) are left out and render blank, as do all unlisted characters.
+ */
+#define CHAR_GEN_GLYPHS(X) \
+	X(' ', 0) \
+	X('-', SEG_G) \
+	X('_', SEG_D) \
+	X('=', SEG_D | SEG_G) \
+	X('.', SEG_DP) \
+	X('0', SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F) \
+	X('1', SEG_B | SEG_C) \
+	X('2', SEG_A | SEG_B | SEG_D | SEG_E | SEG_G) \
+	X('3', SEG_A | SEG_B | SEG_C | SEG_D | SEG_G) \
+	X('4', SEG_B | SEG_C | SEG_F | SEG_G) \
+	X('5', SEG_A | SEG_C | SEG_D | SEG_F | SEG_G) \
+	X('6', SEG_A | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G) \
+	X('7', SEG_A | SEG_B | SEG_C) \
+	X('8', SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G) \
+	X('9', SEG_A | SEG_B | SEG_C | SEG_D | SEG_F | SEG_G) \
+	X('A', SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G) \
+	X('a', SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G) \
+	X('B', SEG_C | SEG_D | SEG_E | SEG_F | SEG_G) \
+	X('b', SEG_C | SEG_D | SEG_E | SEG_F | SEG_G) \
+	X('C', SEG_A | SEG_D | SEG_E | SEG_F) \
+	X('c', SEG_A | SEG_D | SEG_E | SEG_F) \
+	X('D', SEG_B | SEG_C | SEG_D | SEG_E | SEG_G) \
+	X('d', SEG_B | SEG_C | SEG_D | SEG_E | SEG_G) \
+	X('E', SEG_A | SEG_D | SEG_E | SEG_F | SEG_G) \
+	X('e', SEG_A | SEG_D | SEG_E | SEG_F | SEG_G) \
+	X('F', SEG_A | SEG_E | SEG_F | SEG_G) \
+	X('f', SEG_A | SEG_E | SEG_F | SEG_G) \
+	X('G', SEG_A | SEG_C | SEG_D | SEG_E | SEG_F) \
+	X('g', SEG_A | SEG_C | SEG_D | SEG_E | SEG_F) \
+	X('H', SEG_B | SEG_C | SEG_E | SEG_F | SEG_G) \
+	X('h', SEG_B | SEG_C | SEG_E | SEG_F | SEG_G) \
+	X('I', SEG_E | SEG_F) \
+	X('i', SEG_C) \
+	X('J', SEG_B | SEG_C | SEG_D | SEG_E) \
+	X('j', SEG_B | SEG_C | SEG_D | SEG_E) \
+	X('L', SEG_D | SEG_E | SEG_F) \
+	X('l', SEG_D | SEG_E | SEG_F) \
+	X('N', SEG_C | SEG_E | SEG_G) \
+	X('n', SEG_C | SEG_E | SEG_G) \
+	X('O', SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F) \
+	X('o', SEG_C | SEG_D | SEG_E | SEG_G) \
+	X('P', SEG_A | SEG_B | SEG_E | SEG_F | SEG_G) \
+	X('p', SEG_A | SEG_B | SEG_E | SEG_F | SEG_G) \
+	X('Q', SEG_A | SEG_B | SEG_C | SEG_F | SEG_G) \
+	X('q', SEG_A | SEG_B | SEG_C | SEG_F | SEG_G) \
+	X('R', SEG_E | SEG_G) \
+	X('r', SEG_E | SEG_G) \
+	X('S', SEG_A | SEG_C | SEG_D | SEG_F | SEG_G) \
+	X('s', SEG_A | SEG_C | SEG_D | SEG_F | SEG_G) \
+	X('T', SEG_D | SEG_E | SEG_F | SEG_G) \
+	X('t', SEG_D | SEG_E | SEG_F | SEG_G) \
+	X('U', SEG_B | SEG_C | SEG_D | SEG_E | SEG_F) \
+	X('u', SEG_C | SEG_D | SEG_E) \
+	X('Y', SEG_B | SEG_C | SEG_D | SEG_F | SEG_G) \
+	X('y', SEG_B | SEG_C | SEG_D | SEG_F | SEG_G) \
+	X('Z', SEG_A | SEG_B | SEG_D | SEG_E | SEG_G) \
+	X('z', SEG_A | SEG_B | SEG_D | SEG_E | SEG_G)
+
+/**
+ * @brief Expands one glyph description into a designated table initializer.
+ */
+#define CHAR_GEN_GLYPH_ENTRY(ch, segments) [(uint8_t)(ch)] = (segments),
 
 /**
- * @brief Lookup table for ASCII characters and their 7-segment encodings.
+ * @brief Lookup table indexed directly by character, built at compile time.
  *
- * Maps supported ASCII characters to their 7-segment display codes.
- * Supported characters: '0'-'9', 'A', 'a', 'T', 't', 'P', 'p', '-'.
+ * Holds active-high segment masks, characters without a glyph are 0 (blank).
  *
- * @note Size: 34 bytes (17 entries × 2 bytes per entry).
+ * @note Size: 256 bytes.
  */
-static const char_mapping_t char_mappings[] =
+static const uint8_t glyph_table[256] =
 {
-    {'0', ZERO},
-    {'1', ONE},
-    {'2', TWO},
-    {'3', THREE},
-    {'4', FOUR},
-    {'5', FIVE},
-    {'6', SIX},
-    {'7', SEVEN},
-    {'8', EIGHT},
-    {'9', NINE},
-	{'H', H_CHAR},
-	{'h', H_CHAR},
-	{'F', F_CHAR},
-	{'f', F_CHAR},
-	{'C', C_CHAR},
-	{'c', C_CHAR},
-    {'-', DASH},
+	CHAR_GEN_GLYPHS(CHAR_GEN_GLYPH_ENTRY)
 };
 
 /**
@@ -137,8 +160,25 @@ const char_gen_api_t api_char_gen =
 {
     .init = char_gen_init,			/**< Pointer to initialization function. */
     .transmit = char_gen_transmit,	/**< Pointer to transmission function. */
+    .encode = char_gen_encode,		/**< Pointer to string encoding function. */
+    .get_stats = char_gen_get_stats,	/**< Pointer to frame counters function. */
 };
 
+/**
+ * @brief Last frame passed to the driver, used to suppress identical frames.
+ */
+static struct
+{
+    uint16_t data[4];						/**< Driver words of the last frame. */
+    driver_7_seg_brightness_t brightness[4];	/**< Brightness levels of the last frame. */
+    uint8_t valid;							/**< Set once a frame was sent successfully. */
+} last_frame;
+
+/**
+ * @brief Frame counters.
+ */
+static char_gen_stats_t frame_stats;
+
 /**
  * @brief Initializes the character generator module.
  *
@@ -184,7 +224,7 @@ char_generator_status_t char_gen_init(SPI_HandleTypeDef *const hspi, TIM_HandleT
  *         - CHAR_GEN_STATUS_INVALID_PARAMETERS: `config` is NULL or contains invalid characters.
  *         - CHAR_GEN_STATUS_NOT_TRANSMITTED: Driver failed to send data.
  * @pre char_gen_init must be called successfully prior to transmission.
- * @note Supported characters: '0'-'9', 'A', 'a', 'T', 't', 'P', 'p', '-'.
+ * @note Characters without a 7-segment glyph are displayed blank.
  * @note The `config->digits` array must contain exactly 4 elements.
  * @note The `config->periods` array must contain valid `period_status` values (PERIOD_ON or PERIOD_OFF).
  * @see char_gen_init
@@ -194,34 +234,136 @@ char_generator_status_t char_gen_transmit(const char_gen_data_t *const config)
     assert(config != NULL);
 
     uint16_t out_data[DIGIT_NUM];
+    uint8_t period_mask = 0;
 
     for (uint8_t i = 0; i < DIGIT_NUM; ++i)
     {
-        chars code = INVALID_CHAR;
-        for (size_t j = 0; j < (sizeof(char_mappings) / sizeof(char_mappings[0])); ++j)
-        {
-            if (char_mappings[j].ch == config->digits[i])
-            {
-                code = char_mappings[j].code;
-                break;
-            }
-        }
-
-        uint8_t segment_data = (uint8_t)code;
         if (config->periods[i] == PERIOD_ON)
         {
-            segment_data &= ~(1 << 7);
+            period_mask |= (uint8_t)(1 << i);
         }
+    }
+
+    char_gen_encode(config->digits, period_mask, out_data, DIGIT_NUM);
+
+    return char_gen_send_frame(out_data, config->brightness);
+}
 
-        out_data[i] = (uint16_t)(segment_data << 8) | (1 << i);
+/**
+ * @brief Sends a 4-digit frame of driver words to the display unless it equals the last one sent.
+ *
+ * An identical frame costs only the comparison and is counted as suppressed.
+ *
+ * @param[in] data Array of 4 driver words.
+ * @param[in] brightness Array of 4 brightness levels.
+ * @return char_generator_status_t Status of transmission:
+ *         - CHAR_GEN_STATUS_OK: Frame sent or suppressed as unchanged.
+ *         - CHAR_GEN_STATUS_NOT_TRANSMITTED: Driver failed to send data.
+ * @note Must be called from a single context, the same one for all frames.
+ */
+char_generator_status_t char_gen_send_frame(const uint16_t *const data, const driver_7_seg_brightness_t *const brightness)
+{
+    assert(data != NULL);
+    assert(brightness != NULL);
+
+    uint8_t changed = !last_frame.valid;
+
+    for (uint8_t i = 0; i < DIGIT_NUM && !changed; ++i)
+    {
+        changed = (data[i] != last_frame.data[i]) || (brightness[i] != last_frame.brightness[i]);
     }
 
-    if (api_7_seg.send_buffer(out_data, config->brightness, DIGIT_NUM) != DRIVER_7_SEG_STATUS_OK)
+    if (!changed)
     {
+        frame_stats.suppressed++;
+        return CHAR_GEN_STATUS_OK;
+    }
+
+    if (api_7_seg.send_buffer(data, brightness, DIGIT_NUM) != DRIVER_7_SEG_STATUS_OK)
+    {
+        last_frame.valid = 0;
         return CHAR_GEN_STATUS_NOT_TRANSMITTED;
     }
 
+    for (uint8_t i = 0; i < DIGIT_NUM; ++i)
+    {
+        last_frame.data[i] = data[i];
+        last_frame.brightness[i] = brightness[i];
+    }
+    last_frame.valid = 1;
+    frame_stats.submitted++;
+
+    return CHAR_GEN_STATUS_OK;
+}
+
+/**
+ * @brief Copies counters of submitted and suppressed frames.
+ *
+ * @param[out] stats Pointer to the structure receiving the counters.
+ */
+void char_gen_get_stats(char_gen_stats_t *const stats)
+{
+    assert(stats != NULL);
+
+    *stats = frame_stats;
+}
+
+/**
+ * @brief Encodes a string and period mask into 16-bit driver words in one pass.
+ *
+ * Each output word holds the active-low segment data (including decimal point) in the upper 8 bits
+ * and the digit select bit in the lower 8 bits. Characters without a glyph are blank, positions
+ * past the end of the string are blank as well.
+ *
+ * @param[in] text Null-terminated string, characters beyond @p count are ignored.
+ * @param[in] period_mask Bit i set turns on the decimal point of digit i.
+ * @param[out] out Array of at least @p count driver words.
+ * @param[in] count Number of digits to encode (at most 8).
+ * @return char_generator_status_t Status of encoding:
+ *         - CHAR_GEN_STATUS_OK: Encoding successful.
+ *         - CHAR_GEN_STATUS_INVALID_PARAMETERS: @p count exceeds 8 digit select bits.
+ */
+char_generator_status_t char_gen_encode(const char *const text, const uint8_t period_mask,
+                                        uint16_t *const out, const uint8_t count)
+{
+    assert(text != NULL);
+    assert(out != NULL);
+
+    if (count > 8)
+    {
+        return CHAR_GEN_STATUS_INVALID_PARAMETERS;
+    }
+
+    const char *ch = text;
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        uint8_t code = char_gen_glyph(' ');
+        if (*ch != '\0')
+        {
+            code = char_gen_glyph(*ch++);
+        }
+
+        if (period_mask & (1 << i))
+        {
+            code &= (uint8_t)~SEG_DP;
+        }
+
+        out[i] = (uint16_t)(code << 8) | (1 << i);
+    }
+
     return CHAR_GEN_STATUS_OK;
 }
 
+/**
+ * @brief Returns the 7-segment code of a single character.
+ *
+ * @param[in] ch Character to encode.
+ * @return uint8_t Active-low segment code (bit 7 is the decimal point), 0xFF for characters without a glyph.
+ */
+uint8_t char_gen_glyph(const char ch)
+{
+    return (uint8_t)~glyph_table[(uint8_t)ch];
+}
+
 /** @} */ // end of Character_Generator
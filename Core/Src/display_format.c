@@ -0,0 +1,166 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "display_format.h"
+#include "character_generator.h"
+#include <assert.h>
+#include <stddef.h>
+
+/*
+ * decimal point bit of a segment code, active-low
+ */
+static const uint8_t DP_BIT = 0x80;
+
+/*
+ * limits of values fitting the 3 digits after the unit glyph, in tenths and units
+ */
+static const int32_t TENTHS_MIN = -99;
+static const int32_t TENTHS_MAX = 999;
+static const int32_t UNITS_MIN = -99;
+static const int32_t UNITS_MAX = 999;
+
+/*
+ * divides rounding half away from zero
+ */
+static int32_t divide_rounded(int32_t value, int32_t divisor);
+
+/*
+ * returns segment code of a decimal digit
+ */
+static uint8_t digit_code(uint32_t digit);
+
+/*
+ * writes unit glyph followed by two characters of the saturation text
+ */
+static display_format_status_t write_saturated(char unit, char first, char second, display_format_status_t status,
+											   uint8_t codes[DISPLAY_FORMAT_DIGITS]);
+
+/*
+ * writes unit glyph followed by value in hundredths into 4 segment codes
+ */
+display_format_status_t display_format_value(int32_t value_centi, char unit, const display_format_range_t *range,
+											 uint8_t codes[DISPLAY_FORMAT_DIGITS]) {
+	assert(range != NULL);
+	assert(codes != NULL);
+
+	int32_t tenths = divide_rounded(value_centi, 10);
+	int32_t units = divide_rounded(value_centi, 100);
+
+	if (value_centi > range->max_centi || units > UNITS_MAX) {
+		return write_saturated(unit, 'H', 'i', DISPLAY_FORMAT_STATUS_HIGH, codes);
+	}
+
+	if (value_centi < range->min_centi || units < UNITS_MIN) {
+		return write_saturated(unit, 'L', 'o', DISPLAY_FORMAT_STATUS_LOW, codes);
+	}
+
+	codes[0] = char_gen_glyph(unit);
+
+	if (tenths >= TENTHS_MIN && tenths <= TENTHS_MAX) {
+		/* one decimal: [sign or tens][units with dp][tenths] */
+		uint32_t magnitude = (uint32_t)(tenths < 0 ? -tenths : tenths);
+
+		if (tenths < 0) {
+			codes[1] = char_gen_glyph('-');
+		} else if (magnitude >= 100) {
+			codes[1] = digit_code(magnitude / 100);
+		} else {
+			codes[1] = char_gen_glyph(' ');
+		}
+		codes[2] = digit_code((magnitude / 10) % 10) & (uint8_t)~DP_BIT;
+		codes[3] = digit_code(magnitude % 10);
+	} else {
+		/* integer: [sign or hundreds][tens][units] */
+		uint32_t magnitude = (uint32_t)(units < 0 ? -units : units);
+
+		codes[1] = (units < 0) ? char_gen_glyph('-') : digit_code(magnitude / 100);
+		codes[2] = digit_code((magnitude / 10) % 10);
+		codes[3] = digit_code(magnitude % 10);
+	}
+
+	return DISPLAY_FORMAT_STATUS_OK;
+}
+
+/*
+ * returns value in hundredths reduced to what the display can distinguish
+ */
+int32_t display_format_quantize(int32_t value_centi, const display_format_range_t *range) {
+	assert(range != NULL);
+
+	int32_t units = divide_rounded(value_centi, 100);
+
+	if (value_centi > range->max_centi || units > UNITS_MAX) {
+		return INT32_MAX;
+	}
+
+	if (value_centi < range->min_centi || units < UNITS_MIN) {
+		return INT32_MIN;
+	}
+
+	int32_t tenths = divide_rounded(value_centi, 10);
+
+	if (tenths >= TENTHS_MIN && tenths <= TENTHS_MAX) {
+		return tenths;
+	}
+
+	/* integer display: whole units on the tenths scale, outside of the tenths shown with one decimal */
+	return units * 10;
+}
+
+/*
+ * writes "----" into 4 segment codes
+ */
+void display_format_dashes(uint8_t codes[DISPLAY_FORMAT_DIGITS]) {
+	assert(codes != NULL);
+
+	for (uint8_t i = 0; i < DISPLAY_FORMAT_DIGITS; ++i) {
+		codes[i] = char_gen_glyph('-');
+	}
+}
+
+/*
+ * divides rounding half away from zero
+ */
+static int32_t divide_rounded(int32_t value, int32_t divisor) {
+	if (value < 0) {
+		return -((-value + divisor / 2) / divisor);
+	}
+
+	return (value + divisor / 2) / divisor;
+}
+
+/*
+ * returns segment code of a decimal digit
+ */
+static uint8_t digit_code(uint32_t digit) {
+	return char_gen_glyph((char)('0' + digit));
+}
+
+/*
+ * writes unit glyph followed by two characters of the saturation text
+ */
+static display_format_status_t write_saturated(char unit, char first, char second, display_format_status_t status,
+											   uint8_t codes[DISPLAY_FORMAT_DIGITS]) {
+	codes[0] = char_gen_glyph(unit);
+	codes[1] = char_gen_glyph(' ');
+	codes[2] = char_gen_glyph(first);
+	codes[3] = char_gen_glyph(second);
+
+	return status;
+}
@@ -1,7 +1,7 @@
 /*
  * digital_thermomether
  * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
- * Copyright (C) 2025 Anatoliy Lizanets
+ * Copyright (C) 2025 Andrew Kushyk
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU Affero General Public License as published
@@ -18,6 +18,7 @@
  */
 
 #include "driver_7_seg.h"
+#include "profiler.h"
 
 /*
   Driver configuration structure
@@ -29,47 +30,58 @@ typedef struct
 	uint16_t CS_GPIO_Pin;
 	SPI_HandleTypeDef *hspi;
 	TIM_HandleTypeDef *htim;
+	DMA_HandleTypeDef *hdma;
 	driver_7_seg_status_t initialized;
 } driver_7_seg_config_t;
 
 /*
-  Constant defining the number of segments
+  Constants defining the number of segments and the frame layout.
+  A frame holds SCANS_PER_FRAME scans of all segments, a segment with duty d
+  is lit in d of them (binary-coded modulation, 1/256 duty resolution).
  */
 typedef enum
 {
 	NUMBER_OF_SEGMENTS = 4,
+	SCANS_PER_FRAME    = 256,
+	FRAME_WORDS        = NUMBER_OF_SEGMENTS * SCANS_PER_FRAME,
+	NUMBER_OF_FRAMES   = 4,
+	FRAME_INDEX_MASK   = 0x03,
+	FRAME_FRESH        = 0x80,
 } driver_7_seg_constant_t;
 
 /*
-  Structure holding segment data and brightness control (skip buffer) for all segments.
+  Word shifted out while a segment is dark, no digit selected
  */
-typedef struct
-{
-    uint16_t data      [NUMBER_OF_SEGMENTS];
-    uint8_t  skip_buff [NUMBER_OF_SEGMENTS];
-} driver_7_seg_segment_buffer_t;
+static const uint16_t BLANK_WORD = 0x0000;
 
 /*
-  Structure holding double buffers and skip counters for the 7-segment display driver.
+  Master brightness used until driver_7_seg_set_brightness is called
  */
-typedef struct
-{
-	driver_7_seg_segment_buffer_t buf0;
-	driver_7_seg_segment_buffer_t buf1;
-    uint8_t skip_counter [NUMBER_OF_SEGMENTS];
-} driver_7_seg_display_buffers_t;
+static const uint8_t DEFAULT_BRIGHTNESS = 255;
 
 /*
-  State machine states for data transfer.
+  Gamma 2.2 correction: perceived brightness 0-255 to duty in scans per frame.
+  Non-zero levels get at least one scan so the dimmest level stays visible.
  */
-typedef enum
+static const uint8_t GAMMA_TABLE[256] =
 {
-	STATE_PREPARE,
-	STATE_START_SENDING,
-	STATE_WAIT_SPI,
-	STATE_POST,
-	STATE_WAIT
-} driver_7_seg_transfer_state_t;
+		  0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+		  1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+		  3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+		  6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+		 12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+		 20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+		 30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+		 42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+		 56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+		 73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+		 91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+		113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+		137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+		163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+		192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+		223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
 
 /*
  API instance linking public functions to driver interface.
@@ -78,53 +90,139 @@ typedef enum
 const driver_7_seg_api_t api_7_seg =
 {
 		.init          = driver_7_seg_init,
-		.send_buffer   = driver_7_seg_send_buffer
+		.send_buffer   = driver_7_seg_send_buffer,
+		.set_brightness = driver_7_seg_set_brightness,
+		.suspend       = driver_7_seg_suspend,
+		.resume        = driver_7_seg_resume
 };
 
 /*
   Global driver configuration instance
  */
 static driver_7_seg_config_t config  = {0};
+
 /*
-  Structure of sending buffers
+  Frame buffers streamed to SPI1->DR by DMA on every timer update.
+  Ownership of the frames moves between the writer and the DMA callback:
+  one back frame filled by driver_7_seg_send_buffer, one frame in the shared
+  slot and two frames held by the callback (displayed and spare, the spare
+  one being queued in the idle DMA memory register after a swap).
  */
-static driver_7_seg_display_buffers_t buffers = {0};
+static uint16_t frames[NUMBER_OF_FRAMES][FRAME_WORDS] = {0};
 
 /*     State variables:
-       Flag set by SPI complete callback
-       Flag indicating new buffer available
-       Indicates currently active buffer
+       Shared slot: index of the latest complete frame, FRAME_FRESH set until it is taken
+       Frame owned by the writer
+       Frames owned by the DMA callback and the one loaded into the idle memory register
 */
-static volatile uint8_t spi_tranfer_complete = 0;
-static volatile uint8_t new_buffer_ready     = 0;
-static uint8_t      current_active_buf_index = 0;
+static volatile uint8_t shared_slot          = 2;
+static uint8_t back_frame                    = 3;
+static uint8_t displayed_frame               = 0;
+static uint8_t spare_frame                   = 1;
+static uint8_t queued_frame                  = 0;
+
+/*
+  Flag indicating the refresh is stopped by driver_7_seg_suspend
+ */
+static uint8_t suspended                     = 0;
+
+/*
+  Number of DMA errors, the refresh is restarted after each
+ */
+static volatile uint32_t dma_errors          = 0;
+
+/*     Writer state used to rebuild the frame on brightness change:
+       Master brightness
+       Last data and per-segment levels sent
+*/
+static uint8_t master_brightness             = DEFAULT_BRIGHTNESS;
+static uint16_t last_data[NUMBER_OF_SEGMENTS]                    = {0};
+static driver_7_seg_brightness_t last_level[NUMBER_OF_SEGMENTS] = {0};
+
+/*
+ Builds the back frame from last data and publishes it.
+ */
+static void publish_frame( void );
+
+/*
+ Atomically exchanges the shared slot, returns previous slot value.
+ */
+static uint8_t exchange_shared_slot( const uint8_t value );
+
+/*
+ Builds frame for given data and brightness levels.
+ */
+static void build_frame( uint16_t *const frame, const uint16_t *const data, const driver_7_seg_brightness_t *const brightness_level );
+
+/*
+ Reverses bit order of a scan index.
+ */
+static uint8_t reverse_scan( uint8_t scan );
+
+/*
+ DMA memory buffer complete callback, called once per displayed frame.
+ */
+static void frame_complete_callback( DMA_HandleTypeDef *hdma );
+
+/*
+ DMA error callback.
+ */
+static void frame_error_callback( DMA_HandleTypeDef *hdma );
+
+/*
+ Streams the displayed frame again and starts the latch timer.
+ */
+static driver_7_seg_status_t start_refresh( void );
 
 
 /*
  Initializes the 7-segment display driver.
+ htim update event must have a DMA request linked to hdma[TIM_DMA_ID_UPDATE],
+ the latch pin GPIOx/GPIO_Pin must be driven by htim channel 2 complementary output.
  */
 driver_7_seg_status_t driver_7_seg_init( SPI_HandleTypeDef *const hspi, TIM_HandleTypeDef *const htim,
 										 GPIO_TypeDef *const GPIOx, const uint16_t GPIO_Pin )
 {
 
-	if ( hspi == NULL || htim == NULL || GPIOx == NULL )
+	if ( hspi == NULL || htim == NULL || GPIOx == NULL || htim->hdma[TIM_DMA_ID_UPDATE] == NULL )
 	{
 		return DRIVER_7_SEG_STATUS_NOT_INITIALIZED;
 	}
 
-	HAL_GPIO_WritePin( config.CS_GPIO_Port, config.CS_GPIO_Pin, GPIO_PIN_SET );
-
 	config.CS_GPIO_Port = GPIOx;
 	config.CS_GPIO_Pin  = GPIO_Pin;
 	config.hspi         = hspi;
 	config.htim         = htim;
+	config.hdma         = htim->hdma[TIM_DMA_ID_UPDATE];
+
+	for ( uint8_t frame = 0; frame < NUMBER_OF_FRAMES; frame++ )
+	{
+		for ( uint16_t i = 0; i < FRAME_WORDS; i++ )
+		{
+			frames[frame][i] = BLANK_WORD;
+		}
+	}
+	displayed_frame = 0;
+	spare_frame     = 1;
+	queued_frame    = 0;
+	shared_slot     = 2;
+	back_frame      = 3;
 
-	for ( uint8_t i = 0; i < NUMBER_OF_SEGMENTS; i++ )
+	config.hdma->XferCpltCallback   = frame_complete_callback;
+	config.hdma->XferM1CpltCallback = frame_complete_callback;
+	config.hdma->XferErrorCallback  = frame_error_callback;
+
+	__HAL_SPI_ENABLE( config.hspi );
+
+	if ( HAL_OK != HAL_DMAEx_MultiBufferStart_IT( config.hdma, (uint32_t)frames[0], (uint32_t)&config.hspi->Instance->DR,
+												  (uint32_t)frames[0], FRAME_WORDS ) )
 	{
-		buffers.buf0.skip_buff[i] = NOT_USED;
+		return DRIVER_7_SEG_STATUS_NOT_INITIALIZED;
 	}
 
-	if ( HAL_OK != HAL_TIM_Base_Start_IT(config.htim) )
+	__HAL_TIM_ENABLE_DMA( config.htim, TIM_DMA_UPDATE );
+
+	if ( HAL_OK != HAL_TIMEx_PWMN_Start( config.htim, TIM_CHANNEL_2 ) )
 	{
 		return DRIVER_7_SEG_STATUS_NOT_INITIALIZED;
 	}
@@ -149,115 +247,276 @@ driver_7_seg_status_t driver_7_seg_send_buffer ( const uint16_t *const data, con
 		return DRIVER_7_SEG_STATUS_INVALID_PARAMETERS;
 	}
 
-	while ( new_buffer_ready != 0 ) {}
+	for ( uint8_t segment = 0; segment < NUMBER_OF_SEGMENTS; segment++ )
+	{
+		last_data[segment]  = data[segment];
+		last_level[segment] = brightness_level[segment];
+	}
 
-	if (current_active_buf_index == 0)
+	publish_frame();
+
+	return DRIVER_7_SEG_STATUS_OK;
+}
+
+/*
+ Sets master brightness on the gamma-corrected 0-255 scale and redraws
+ the last buffer with it. Must be called from the same context as
+ driver_7_seg_send_buffer.
+ */
+driver_7_seg_status_t driver_7_seg_set_brightness( const uint8_t level )
+{
+	if ( DRIVER_7_SEG_STATUS_OK != config.initialized )
 	{
-		for ( uint8_t i = 0; i < NUMBER_OF_SEGMENTS; i++)
-		{
-			buffers.buf1.data[i]      = data[i];
-			buffers.buf1.skip_buff[i] = (uint8_t)brightness_level[i];
-		}
+		return DRIVER_7_SEG_STATUS_NOT_INITIALIZED;
 	}
-	else
+
+	master_brightness = level;
+
+	publish_frame();
+
+	return DRIVER_7_SEG_STATUS_OK;
+}
+
+/*
+ Stops the refresh and blanks the display, so the MCU can enter Stop mode.
+ A blank word is shifted out and latched by forcing an edge on the latch output.
+ Frames sent while suspended are shown after driver_7_seg_resume.
+ */
+driver_7_seg_status_t driver_7_seg_suspend( void )
+{
+	if ( DRIVER_7_SEG_STATUS_OK != config.initialized )
 	{
-		for( uint8_t i = 0; i < NUMBER_OF_SEGMENTS; i++)
-		{
-			buffers.buf0.data[i]      = data[i];
-			buffers.buf0.skip_buff[i] = (uint8_t)brightness_level[i];
-		}
+		return DRIVER_7_SEG_STATUS_NOT_INITIALIZED;
+	}
+
+	if ( suspended != 0 )
+	{
+		return DRIVER_7_SEG_STATUS_OK;
+	}
+
+	__HAL_TIM_DISABLE_DMA( config.htim, TIM_DMA_UPDATE );
+	if ( HAL_OK != HAL_DMA_Abort( config.hdma ) )
+	{
+		return DRIVER_7_SEG_STATUS_SEND_ERROR;
+	}
+	config.htim->Instance->CR1 &= ~TIM_CR1_CEN;
+
+	while ( __HAL_SPI_GET_FLAG( config.hspi, SPI_FLAG_BSY ) ) {}
+	config.hspi->Instance->DR = BLANK_WORD;
+	while ( !__HAL_SPI_GET_FLAG( config.hspi, SPI_FLAG_TXE ) ) {}
+	while ( __HAL_SPI_GET_FLAG( config.hspi, SPI_FLAG_BSY ) ) {}
+
+	/* CH2N is the inverted OC2REF, forcing OC2REF active then inactive gives the rising latch edge */
+	MODIFY_REG( config.htim->Instance->CCMR1, TIM_CCMR1_OC2M, TIM_OCMODE_FORCED_ACTIVE << 8 );
+	MODIFY_REG( config.htim->Instance->CCMR1, TIM_CCMR1_OC2M, TIM_OCMODE_FORCED_INACTIVE << 8 );
+
+	suspended = 1;
+
+	return DRIVER_7_SEG_STATUS_OK;
+}
 
+/*
+ Restarts the refresh stopped by driver_7_seg_suspend.
+ The displayed frame is streamed again, a frame published meanwhile follows on the next frame boundary.
+ */
+driver_7_seg_status_t driver_7_seg_resume( void )
+{
+	if ( DRIVER_7_SEG_STATUS_OK != config.initialized )
+	{
+		return DRIVER_7_SEG_STATUS_NOT_INITIALIZED;
 	}
 
-	new_buffer_ready = 1;
+	if ( suspended == 0 )
+	{
+		return DRIVER_7_SEG_STATUS_OK;
+	}
+
+	if ( DRIVER_7_SEG_STATUS_OK != start_refresh() )
+	{
+		return DRIVER_7_SEG_STATUS_SEND_ERROR;
+	}
+
+	suspended = 0;
 
 	return DRIVER_7_SEG_STATUS_OK;
 }
 
 /*
- Periodic timer callback for driving the display
- Timer Frequency [Hz] = Timer_Clock / ((Prescaler + 1) * (AutoReload + 1)) =
- Timer_Clock = 84 Mhz;
- Prescaler = 150;
- AutoReload = 1;
- Timer Period ≈ 3.595 microseconds
+ Returns number of DMA errors since init.
+ */
+uint32_t driver_7_seg_get_dma_errors( void )
+{
+	return dma_errors;
+}
+
+/*
+ Builds the back frame from last data and publishes it.
+ */
+static void publish_frame( void )
+{
+	build_frame( frames[back_frame], last_data, last_level );
+
+	/* publish the complete frame, take back whichever frame was in the slot */
+	back_frame = exchange_shared_slot( back_frame | FRAME_FRESH ) & FRAME_INDEX_MASK;
+
+	/* frame complete interrupt is only needed while a swap is in flight.
+	   while it is off the complete flag is still set on every frame, such a flag is no frame
+	   boundary of the swap and is cleared first, otherwise its callback runs mid-frame and a
+	   boundary passing meanwhile takes the queued frame for the displayed one */
+	if ( !__HAL_DMA_GET_IT_SOURCE( config.hdma, DMA_IT_TC ) )
+	{
+		__HAL_DMA_CLEAR_FLAG( config.hdma, __HAL_DMA_GET_TC_FLAG_INDEX( config.hdma ) );
+	}
+	__HAL_DMA_ENABLE_IT( config.hdma, DMA_IT_TC );
+}
+
+/*
+ Builds frame for given data and brightness levels.
+ Segment level scaled by master brightness is converted to duty d through
+ the gamma table, the segment is lit in scans whose bit-reversed index is
+ below d. Bit reversal spreads lit scans evenly over the frame, so every
+ bit of d contributes evenly spaced scans (binary-coded modulation).
+ */
+static void build_frame( uint16_t *const frame, const uint16_t *const data, const driver_7_seg_brightness_t *const brightness_level )
+{
+	uint8_t duty[NUMBER_OF_SEGMENTS];
+
+	for ( uint8_t segment = 0; segment < NUMBER_OF_SEGMENTS; segment++ )
+	{
+		uint16_t level = (uint16_t)( ( (uint16_t)brightness_level[segment] * master_brightness + 127 ) / 255 );
+
+		duty[segment] = GAMMA_TABLE[level];
+	}
+
+	for ( uint16_t scan = 0; scan < SCANS_PER_FRAME; scan++ )
+	{
+		uint8_t position = reverse_scan( (uint8_t)scan );
+
+		for ( uint8_t segment = 0; segment < NUMBER_OF_SEGMENTS; segment++ )
+		{
+			frame[scan * NUMBER_OF_SEGMENTS + segment] = ( position < duty[segment] ) ? data[segment] : BLANK_WORD;
+		}
+	}
+}
+
+/*
+ Reverses bit order of a scan index.
  */
-void HAL_TIM_PeriodElapsedCallback( TIM_HandleTypeDef *htim )
+static uint8_t reverse_scan( uint8_t scan )
 {
-	if ( htim->Instance == TIM6 )
+	scan = (uint8_t)( ( scan & 0xF0 ) >> 4 | ( scan & 0x0F ) << 4 );
+	scan = (uint8_t)( ( scan & 0xCC ) >> 2 | ( scan & 0x33 ) << 2 );
+	scan = (uint8_t)( ( scan & 0xAA ) >> 1 | ( scan & 0x55 ) << 1 );
+
+	return scan;
+}
+
+/*
+ DMA memory buffer complete callback, called once per displayed frame.
+ The frame queued on the previous call is displayed now and the register
+ just released by DMA is idle for a whole frame. If the writer published a
+ frame it is taken from the shared slot and queued, otherwise the displayed
+ frame is repeated. Frames held here are never handed to the writer.
+ */
+static void frame_complete_callback( DMA_HandleTypeDef *hdma )
+{
+	PROFILER_BEGIN(start_cycles);
+
+	volatile uint32_t *idle_address = ( hdma->Instance->CR & DMA_SxCR_CT ) ? &hdma->Instance->M0AR : &hdma->Instance->M1AR;
+
+	if ( queued_frame != displayed_frame )
 	{
-		static driver_7_seg_transfer_state_t state = STATE_PREPARE;
+		spare_frame     = displayed_frame;
+		displayed_frame = queued_frame;
+	}
 
-		switch (state)
+	if ( shared_slot & FRAME_FRESH )
+	{
+		spare_frame = exchange_shared_slot( spare_frame ) & FRAME_INDEX_MASK;
+		queued_frame = spare_frame;
+	}
+	else
+	{
+		queued_frame = displayed_frame;
+	}
+
+	*idle_address = (uint32_t)frames[queued_frame];
+
+	/* nothing in flight: stop interrupting every frame until the writer publishes again.
+	   check the slot after disabling, a frame published in between enables it back */
+	if ( queued_frame == displayed_frame )
+	{
+		__HAL_DMA_DISABLE_IT( hdma, DMA_IT_TC );
+		if ( shared_slot & FRAME_FRESH )
 		{
-		case STATE_PREPARE:
-			if (new_buffer_ready == 1)
-			{
-				current_active_buf_index ^= 1;
-				new_buffer_ready = 0;
-			}
-			static uint16_t *data_buf = NULL;
-			static uint8_t  *skip_buf  = NULL;
-
-			data_buf = (current_active_buf_index == 0) ? buffers.buf0.data      : buffers.buf1.data;
-			skip_buf = (current_active_buf_index == 0) ? buffers.buf0.skip_buff : buffers.buf1.skip_buff;
-
-			static uint8_t current_segment_index = 0;
-
-			HAL_GPIO_WritePin(config.CS_GPIO_Port, config.CS_GPIO_Pin, GPIO_PIN_RESET);
-			state = STATE_START_SENDING;
-			break;
-
-		case STATE_START_SENDING:
-			spi_tranfer_complete = 0;
-
-			if ( skip_buf[current_segment_index] != NOT_USED && buffers.skip_counter[current_segment_index] >= skip_buf[current_segment_index])
-			{
-				HAL_SPI_Transmit_IT(config.hspi, (uint8_t*)&data_buf[current_segment_index], 1);
-
-				buffers.skip_counter[current_segment_index] = 0;
-			}
-			else
-			{
-				static const uint16_t void_data = 0;
-
-				HAL_SPI_Transmit_IT(config.hspi, (uint8_t*)&void_data, 1);
-
-				buffers.skip_counter[current_segment_index]++;
-			}
-			state = STATE_WAIT_SPI;
-			break;
-
-		case STATE_WAIT_SPI:
-			if (spi_tranfer_complete != 0)
-			{
-				state = STATE_POST;
-
-			}
-			break;
-
-		case STATE_POST:
-			HAL_GPIO_WritePin(config.CS_GPIO_Port, config.CS_GPIO_Pin, GPIO_PIN_SET);
-			state = STATE_WAIT;
-			break;
-
-		case STATE_WAIT:
-			current_segment_index = ( current_segment_index + 1 ) % NUMBER_OF_SEGMENTS;
-			state = STATE_PREPARE;
-			break;
+			__HAL_DMA_ENABLE_IT( hdma, DMA_IT_TC );
 		}
+	}
+
+	PROFILER_END(PROFILER_DISPLAY_FRAME_CALLBACK, start_cycles);
+}
 
+/*
+ Atomically exchanges the shared slot, returns previous slot value.
+ Exclusive access is lost on exception entry, so the writer retries when
+ preempted by the DMA callback.
+ */
+static uint8_t exchange_shared_slot( const uint8_t value )
+{
+	uint8_t previous;
+
+	do
+	{
+		previous = __LDREXB( &shared_slot );
 	}
+	while ( __STREXB( value, &shared_slot ) != 0 );
+
+	return previous;
 }
 
 /*
- SPI transmission complete callback.
+ DMA error callback.
+ A transfer error stops the stream, the refresh is restarted from the displayed frame.
+ FIFO and direct mode errors leave the stream running, they are only counted.
+ If the restart fails the refresh stays stopped as if suspended, driver_7_seg_resume retries.
  */
+static void frame_error_callback( DMA_HandleTypeDef *hdma )
+{
+	(void)hdma;
+
+	dma_errors++;
+
+	if ( config.hdma->State != HAL_DMA_STATE_READY || suspended != 0 )
+	{
+		return;
+	}
 
-void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+	__HAL_TIM_DISABLE_DMA( config.htim, TIM_DMA_UPDATE );
+	config.htim->Instance->CR1 &= ~TIM_CR1_CEN;
+
+	if ( DRIVER_7_SEG_STATUS_OK != start_refresh() )
+	{
+		suspended = 1;
+	}
+}
+
+/*
+ Streams the displayed frame again and starts the latch timer.
+ A frame published meanwhile follows on the next frame boundary.
+ */
+static driver_7_seg_status_t start_refresh( void )
 {
-	if (hspi == config.hspi)
+	queued_frame = displayed_frame;
+	if ( HAL_OK != HAL_DMAEx_MultiBufferStart_IT( config.hdma, (uint32_t)frames[displayed_frame], (uint32_t)&config.hspi->Instance->DR,
+												  (uint32_t)frames[displayed_frame], FRAME_WORDS ) )
 	{
-		spi_tranfer_complete = 1;
+		return DRIVER_7_SEG_STATUS_SEND_ERROR;
 	}
+
+	MODIFY_REG( config.htim->Instance->CCMR1, TIM_CCMR1_OC2M, TIM_OCMODE_PWM1 << 8 );
+	__HAL_TIM_SET_COUNTER( config.htim, 0 );
+	__HAL_TIM_ENABLE_DMA( config.htim, TIM_DMA_UPDATE );
+	config.htim->Instance->CR1 |= TIM_CR1_CEN;
+
+	return DRIVER_7_SEG_STATUS_OK;
 }
@@ -0,0 +1,616 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "flash_log.h"
+#include "main.h"
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * log sectors, placed by the linker script at _slog
+ */
+#define LOG_SECTOR_COUNT 3
+#define LOG_SECTOR_SIZE (128 * 1024)
+#define PAGES_PER_SECTOR (LOG_SECTOR_SIZE / FLASH_LOG_PAGE_SIZE)
+#define PAGE_WORDS (FLASH_LOG_PAGE_SIZE / 4)
+
+/*
+ * page layout: header word, sample_codec stream, padding, CRC of everything before it.
+ * every page starts a new stream, so a page decodes without the ones before it.
+ * the header word is programmed first, a page with any data programmed is never free again
+ */
+#define PAGE_HEADER_WORD 0
+#define PAGE_SAMPLES_OFFSET 4
+#define PAGE_CRC_WORD (PAGE_WORDS - 1)
+#define PAGE_STREAM_SIZE (PAGE_CRC_WORD * 4 - PAGE_SAMPLES_OFFSET)
+
+/*
+ * sector header in the first page: magic, sequence, erase count, CRC of the three
+ */
+#define SECTOR_MAGIC_WORD 0
+#define SECTOR_SEQUENCE_WORD 1
+#define SECTOR_ERASE_COUNT_WORD 2
+#define SECTOR_CRC_WORD 3
+#define SECTOR_HEADER_WORDS 4
+
+static const uint32_t SECTOR_MAGIC = 0x474F4C46;
+static const uint32_t PAGE_MARKER = 0xA5000000;
+static const uint32_t PAGE_MARKER_MASK = 0xFF000000;
+static const uint32_t ERASED_WORD = 0xFFFFFFFF;
+static const uint32_t FIRST_PAGE = 1;
+
+/*
+ * the next sector is erased by flash_log_prepare when the active one has this many free pages left
+ */
+static const uint16_t PREPARE_PAGES = 64;
+
+/*
+ * wait after a failed erase before the next attempt, doubled on every failure
+ */
+static const uint32_t ERASE_BACKOFF_MIN_MS = 10000;
+static const uint32_t ERASE_BACKOFF_MAX_MS = 3600000;
+
+/*
+ * unit of stored time
+ */
+static const uint32_t TIME_UNIT_MS = 1000;
+
+/*
+ * sample count is kept in 8 bits of the page header, constant readings could fit more
+ */
+static const uint8_t MAX_PAGE_SAMPLES = UINT8_MAX;
+
+/*
+ * flash sectors of the log area
+ */
+static const uint32_t LOG_SECTORS[LOG_SECTOR_COUNT] = {FLASH_SECTOR_5, FLASH_SECTOR_6, FLASH_SECTOR_7};
+
+/*
+ * log area start, defined by the linker script
+ */
+extern uint32_t _slog[];
+
+/*
+ * sector headers read at mount
+ */
+static struct {
+	bool valid;
+	uint32_t sequence;
+	uint32_t erase_count;
+} sectors[LOG_SECTOR_COUNT];
+
+/*
+ * active sector and its first free page
+ */
+static bool mounted = false;
+static uint8_t active_sector = 0;
+static uint16_t write_page = 0;
+
+/*
+ * the sector after the active one is erased and only waits for its header
+ */
+static bool next_prepared = false;
+
+/*
+ * erase back-off, no erase is started before erase_retry_tick while erase_backoff_ms isn't 0
+ */
+static uint32_t erase_backoff_ms = 0;
+static uint32_t erase_retry_tick = 0;
+
+/*
+ * page collected in RAM, number of samples in it and the encoder writing them
+ */
+static uint32_t page_buffer[PAGE_WORDS];
+static uint8_t buffered = 0;
+static sample_codec_encoder_t encoder;
+
+/*
+ * log statistics
+ */
+static flash_log_stats_t stats = {0};
+
+/*
+ * returns address of a page
+ */
+static inline const uint32_t *page_address(uint8_t sector, uint16_t page) {
+	return _slog + (sector * LOG_SECTOR_SIZE + page * FLASH_LOG_PAGE_SIZE) / sizeof(uint32_t);
+}
+
+/*
+ * computes CRC-32 (IEEE 802.3) of data
+ */
+static uint32_t crc32(const void *data, uint32_t length);
+
+/*
+ * finds the first free page of a sector with a binary search, pages are programmed in order
+ */
+static uint16_t find_free_page(uint8_t sector);
+
+/*
+ * checks page marker and CRC
+ */
+static bool page_valid(const uint32_t *page);
+
+/*
+ * finds the boot number of the newest valid page, scanning back from the free page
+ */
+static bool find_last_boot(uint16_t *boot);
+
+/*
+ * checks that every word of a sector is erased
+ */
+static bool sector_blank(uint8_t sector);
+
+/*
+ * erases a sector unless a previous erase failed less than the back-off time ago
+ */
+static flash_log_status_t erase_sector(uint8_t sector);
+
+/*
+ * writes header of an erased sector with the given sequence and its erase count
+ */
+static flash_log_status_t write_sector_header(uint8_t sector, uint32_t sequence);
+
+/*
+ * erases a sector and writes its header with the given sequence, erase count is carried over
+ */
+static flash_log_status_t format_sector(uint8_t sector, uint32_t sequence);
+
+/*
+ * programs the RAM page to the free page, continues in the next sector when the active one is full
+ */
+static flash_log_status_t program_page(void);
+
+/*
+ * clears the RAM page
+ */
+static void clear_page_buffer(void);
+
+/*
+ * finds the active sector and the first free page, formats an empty log
+ */
+flash_log_status_t flash_log_mount(void) {
+	uint32_t start_cycles = DWT->CYCCNT;
+	bool any_valid = false;
+
+	for (uint8_t i = 0; i < LOG_SECTOR_COUNT; ++i) {
+		const uint32_t *header = page_address(i, 0);
+
+		sectors[i].valid = header[SECTOR_MAGIC_WORD] == SECTOR_MAGIC
+				&& header[SECTOR_CRC_WORD] == crc32(header, SECTOR_CRC_WORD * sizeof(uint32_t));
+		sectors[i].sequence = header[SECTOR_SEQUENCE_WORD];
+		sectors[i].erase_count = sectors[i].valid ? header[SECTOR_ERASE_COUNT_WORD] : 0;
+
+		if (sectors[i].valid && (!any_valid || (int32_t)(sectors[i].sequence - sectors[active_sector].sequence) > 0)) {
+			active_sector = i;
+			any_valid = true;
+		}
+	}
+
+	if (!any_valid) {
+		active_sector = 0;
+		if (FLASH_LOG_STATUS_OK != format_sector(0, 1)) {
+			return FLASH_LOG_STATUS_FLASH_ERROR;
+		}
+	}
+
+	write_page = find_free_page(active_sector);
+
+	uint16_t last_boot = 0;
+	stats.boot = find_last_boot(&last_boot) ? (uint16_t)(last_boot + 1) : 0;
+
+	for (uint8_t i = 0; i < LOG_SECTOR_COUNT; ++i) {
+		if (sectors[i].valid && sectors[i].erase_count > stats.max_erase_count) {
+			stats.max_erase_count = sectors[i].erase_count;
+		}
+	}
+
+	clear_page_buffer();
+	mounted = true;
+	stats.mount_cycles = DWT->CYCCNT - start_cycles;
+
+	return FLASH_LOG_STATUS_OK;
+}
+
+/*
+ * adds sample to the RAM page, programs the page when full
+ */
+flash_log_status_t flash_log_append(uint32_t raw_humidity, uint32_t raw_temperature, uint32_t time_ms) {
+	if (!mounted) {
+		return FLASH_LOG_STATUS_NOT_MOUNTED;
+	}
+
+	/* a full page left by a failed program is retried first, the count must not wrap */
+	if (buffered == MAX_PAGE_SAMPLES) {
+		flash_log_status_t status = program_page();
+		if (status != FLASH_LOG_STATUS_OK) {
+			return status;
+		}
+	}
+
+	uint32_t time_s = time_ms / TIME_UNIT_MS;
+	uint32_t start_cycles = DWT->CYCCNT;
+	bool encoded = sample_codec_encode(&encoder, raw_humidity, raw_temperature, time_s);
+
+	stats.last_encode_cycles = DWT->CYCCNT - start_cycles;
+
+	if (!encoded) {
+		flash_log_status_t status = program_page();
+		if (status != FLASH_LOG_STATUS_OK) {
+			return status;
+		}
+		/* an empty page always has room for a sample */
+		sample_codec_encode(&encoder, raw_humidity, raw_temperature, time_s);
+	}
+
+	stats.samples_written++;
+
+	if (++buffered == MAX_PAGE_SAMPLES) {
+		return program_page();
+	}
+
+	return FLASH_LOG_STATUS_OK;
+}
+
+/*
+ * programs the RAM page even if not full
+ */
+flash_log_status_t flash_log_flush(void) {
+	if (!mounted) {
+		return FLASH_LOG_STATUS_NOT_MOUNTED;
+	}
+
+	if (buffered == 0) {
+		return FLASH_LOG_STATUS_OK;
+	}
+
+	return program_page();
+}
+
+/*
+ * erases the next sector ahead of time when the active one is nearly full.
+ * a sector already blank, e.g. erased before a reset, isn't erased again
+ */
+flash_log_status_t flash_log_prepare(void) {
+	if (!mounted) {
+		return FLASH_LOG_STATUS_NOT_MOUNTED;
+	}
+
+	if (next_prepared || PAGES_PER_SECTOR - write_page > PREPARE_PAGES) {
+		return FLASH_LOG_STATUS_OK;
+	}
+
+	uint8_t next_sector = (uint8_t)((active_sector + 1) % LOG_SECTOR_COUNT);
+	if (!sector_blank(next_sector) && FLASH_LOG_STATUS_OK != erase_sector(next_sector)) {
+		return FLASH_LOG_STATUS_FLASH_ERROR;
+	}
+
+	next_prepared = true;
+
+	return FLASH_LOG_STATUS_OK;
+}
+
+/*
+ * starts walking the log from the oldest sample
+ */
+void flash_log_iterator_init(flash_log_iterator_t *iterator) {
+	assert(iterator != NULL);
+
+	*iterator = (flash_log_iterator_t) {
+		.step = 0,
+		.page = FIRST_PAGE,
+		.slot = 0,
+	};
+}
+
+/*
+ * reads the next sample, returns false at the end of the log.
+ * sectors are walked from the one after the active sector, which holds the oldest samples
+ */
+bool flash_log_next(flash_log_iterator_t *iterator, flash_log_sample_t *sample) {
+	assert(iterator != NULL);
+	assert(sample != NULL);
+
+	if (!mounted) {
+		return false;
+	}
+
+	while (iterator->step < LOG_SECTOR_COUNT) {
+		uint8_t sector = (uint8_t)((active_sector + 1 + iterator->step) % LOG_SECTOR_COUNT);
+		uint16_t end_page = (sector == active_sector) ? write_page : PAGES_PER_SECTOR;
+		const uint32_t *page = page_address(sector, iterator->page);
+
+		if (!sectors[sector].valid || iterator->page >= end_page || page[PAGE_HEADER_WORD] == ERASED_WORD) {
+			iterator->step++;
+			iterator->page = FIRST_PAGE;
+			iterator->slot = 0;
+			continue;
+		}
+
+		uint8_t count = (uint8_t)(page[PAGE_HEADER_WORD] >> 16);
+		if ((iterator->slot == 0 && !page_valid(page)) || iterator->slot >= count) {
+			iterator->page++;
+			iterator->slot = 0;
+			continue;
+		}
+
+		if (iterator->slot == 0) {
+			sample_codec_decoder_init(&iterator->decoder, (const uint8_t *)page + PAGE_SAMPLES_OFFSET, PAGE_STREAM_SIZE);
+		}
+
+		uint32_t time_s = 0;
+		if (!sample_codec_decode(&iterator->decoder, &sample->raw_humidity, &sample->raw_temperature, &time_s)) {
+			iterator->page++;
+			iterator->slot = 0;
+			continue;
+		}
+		sample->boot = (uint16_t)page[PAGE_HEADER_WORD];
+		sample->time_ms = time_s * TIME_UNIT_MS;
+
+		iterator->slot++;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * copies log statistics
+ */
+void flash_log_get_stats(flash_log_stats_t *log_stats) {
+	assert(log_stats != NULL);
+
+	*log_stats = stats;
+}
+
+/*
+ * computes CRC-32 (IEEE 802.3) of data, four bits at a time
+ */
+static uint32_t crc32(const void *data, uint32_t length) {
+	static const uint32_t TABLE[16] = {
+			0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+			0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+	};
+	const uint8_t *bytes = data;
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (uint32_t i = 0; i < length; ++i) {
+		crc ^= bytes[i];
+		crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+		crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+	}
+
+	return ~crc;
+}
+
+/*
+ * finds the first free page of a sector with a binary search, pages are programmed in order
+ */
+static uint16_t find_free_page(uint8_t sector) {
+	uint16_t low = FIRST_PAGE;
+	uint16_t high = PAGES_PER_SECTOR;
+
+	while (low < high) {
+		uint16_t middle = (uint16_t)((low + high) / 2);
+		if (page_address(sector, middle)[PAGE_HEADER_WORD] == ERASED_WORD) {
+			high = middle;
+		} else {
+			low = (uint16_t)(middle + 1);
+		}
+	}
+
+	return low;
+}
+
+/*
+ * checks page marker and CRC
+ */
+static bool page_valid(const uint32_t *page) {
+	return (page[PAGE_HEADER_WORD] & PAGE_MARKER_MASK) == PAGE_MARKER
+			&& page[PAGE_CRC_WORD] == crc32(page, PAGE_CRC_WORD * sizeof(uint32_t));
+}
+
+/*
+ * finds the boot number of the newest valid page, scanning back from the free page.
+ * the sector before the active one is checked too, the active one may have no pages yet
+ */
+static bool find_last_boot(uint16_t *boot) {
+	uint8_t sector = active_sector;
+	uint16_t page = write_page;
+
+	for (uint8_t checked = 0; checked < 2; ++checked) {
+		while (page > FIRST_PAGE) {
+			const uint32_t *data = page_address(sector, --page);
+			if (page_valid(data)) {
+				*boot = (uint16_t)data[PAGE_HEADER_WORD];
+				return true;
+			}
+		}
+
+		sector = (uint8_t)((sector + LOG_SECTOR_COUNT - 1) % LOG_SECTOR_COUNT);
+		if (!sectors[sector].valid) {
+			break;
+		}
+		page = find_free_page(sector);
+	}
+
+	return false;
+}
+
+/*
+ * checks that every word of a sector is erased, stops at the first programmed word
+ */
+static bool sector_blank(uint8_t sector) {
+	const uint32_t *words = page_address(sector, 0);
+
+	for (uint32_t i = 0; i < LOG_SECTOR_SIZE / sizeof(uint32_t); ++i) {
+		if (words[i] != ERASED_WORD) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * erases a sector unless a previous erase failed less than the back-off time ago.
+ * the sector's samples are dropped from the log before the erase starts, its erase count is kept in RAM
+ * until the header is written. a failed erase doubles the back-off up to ERASE_BACKOFF_MAX_MS
+ */
+static flash_log_status_t erase_sector(uint8_t sector) {
+	if (erase_backoff_ms != 0 && (int32_t)(HAL_GetTick() - erase_retry_tick) < 0) {
+		return FLASH_LOG_STATUS_FLASH_ERROR;
+	}
+
+	uint32_t start_cycles = DWT->CYCCNT;
+	FLASH_EraseInitTypeDef erase = {
+			.TypeErase = FLASH_TYPEERASE_SECTORS,
+			.Sector = LOG_SECTORS[sector],
+			.NbSectors = 1,
+			.VoltageRange = FLASH_VOLTAGE_RANGE_3,
+	};
+	uint32_t sector_error = 0;
+
+	sectors[sector].valid = false;
+
+	HAL_FLASH_Unlock();
+	HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &sector_error);
+	HAL_FLASH_Lock();
+
+	stats.last_erase_cycles = DWT->CYCCNT - start_cycles;
+	stats.erases++;
+
+	if (status != HAL_OK) {
+		stats.erase_failures++;
+		erase_backoff_ms = (erase_backoff_ms == 0) ? ERASE_BACKOFF_MIN_MS : erase_backoff_ms * 2U;
+		if (erase_backoff_ms > ERASE_BACKOFF_MAX_MS) {
+			erase_backoff_ms = ERASE_BACKOFF_MAX_MS;
+		}
+		erase_retry_tick = HAL_GetTick() + erase_backoff_ms;
+		return FLASH_LOG_STATUS_FLASH_ERROR;
+	}
+
+	erase_backoff_ms = 0;
+	sectors[sector].erase_count++;
+	if (sectors[sector].erase_count > stats.max_erase_count) {
+		stats.max_erase_count = sectors[sector].erase_count;
+	}
+
+	return FLASH_LOG_STATUS_OK;
+}
+
+/*
+ * writes header of an erased sector with the given sequence and its erase count.
+ * a sector found blank after a reset has lost its count and is counted as erased once
+ */
+static flash_log_status_t write_sector_header(uint8_t sector, uint32_t sequence) {
+	uint32_t erase_count = (sectors[sector].erase_count != 0) ? sectors[sector].erase_count : 1;
+	uint32_t header[SECTOR_HEADER_WORDS] = {SECTOR_MAGIC, sequence, erase_count, 0};
+	HAL_StatusTypeDef status = HAL_OK;
+
+	header[SECTOR_CRC_WORD] = crc32(header, SECTOR_CRC_WORD * sizeof(uint32_t));
+
+	HAL_FLASH_Unlock();
+	for (uint8_t i = 0; i < SECTOR_HEADER_WORDS && status == HAL_OK; ++i) {
+		status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, (uint32_t)page_address(sector, 0) + i * sizeof(uint32_t), header[i]);
+	}
+	HAL_FLASH_Lock();
+
+	if (status != HAL_OK) {
+		return FLASH_LOG_STATUS_FLASH_ERROR;
+	}
+
+	sectors[sector].valid = true;
+	sectors[sector].sequence = sequence;
+	sectors[sector].erase_count = erase_count;
+
+	return FLASH_LOG_STATUS_OK;
+}
+
+/*
+ * erases a sector and writes its header with the given sequence, erase count is carried over
+ */
+static flash_log_status_t format_sector(uint8_t sector, uint32_t sequence) {
+	if (FLASH_LOG_STATUS_OK != erase_sector(sector)) {
+		return FLASH_LOG_STATUS_FLASH_ERROR;
+	}
+
+	return write_sector_header(sector, sequence);
+}
+
+/*
+ * programs the RAM page to the free page, continues in the next sector when the active one is full.
+ * sectors are used round-robin, every sector is erased equally often.
+ * the next sector is normally erased by flash_log_prepare, it is only erased here if that never ran.
+ * the header word goes first and the CRC last, power loss in between leaves a page with a bad CRC
+ */
+static flash_log_status_t program_page(void) {
+	if (write_page >= PAGES_PER_SECTOR) {
+		uint8_t next_sector = (uint8_t)((active_sector + 1) % LOG_SECTOR_COUNT);
+		if (!next_prepared && FLASH_LOG_STATUS_OK != erase_sector(next_sector)) {
+			return FLASH_LOG_STATUS_FLASH_ERROR;
+		}
+		next_prepared = false;
+		if (FLASH_LOG_STATUS_OK != write_sector_header(next_sector, sectors[active_sector].sequence + 1)) {
+			return FLASH_LOG_STATUS_FLASH_ERROR;
+		}
+		active_sector = next_sector;
+		write_page = FIRST_PAGE;
+	}
+
+	uint32_t start_cycles = DWT->CYCCNT;
+	uint32_t address = (uint32_t)page_address(active_sector, write_page);
+	HAL_StatusTypeDef status = HAL_OK;
+
+	sample_codec_finish(&encoder);
+	page_buffer[PAGE_HEADER_WORD] = PAGE_MARKER | ((uint32_t)buffered << 16) | stats.boot;
+	page_buffer[PAGE_CRC_WORD] = crc32(page_buffer, PAGE_CRC_WORD * sizeof(uint32_t));
+
+	HAL_FLASH_Unlock();
+	for (uint8_t i = 0; i < PAGE_WORDS && status == HAL_OK; ++i) {
+		if (page_buffer[i] != ERASED_WORD) {
+			status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + i * sizeof(uint32_t), page_buffer[i]);
+		}
+	}
+	HAL_FLASH_Lock();
+
+	/* a page is used once anything was programmed, also after an error */
+	write_page++;
+	clear_page_buffer();
+
+	stats.last_program_cycles = DWT->CYCCNT - start_cycles;
+
+	if (status != HAL_OK) {
+		return FLASH_LOG_STATUS_FLASH_ERROR;
+	}
+
+	stats.pages_written++;
+
+	return FLASH_LOG_STATUS_OK;
+}
+
+/*
+ * clears the RAM page and starts a new stream in it, unused bytes stay erased
+ */
+static void clear_page_buffer(void) {
+	memset(page_buffer, 0xFF, sizeof(page_buffer));
+	buffered = 0;
+	sample_codec_encoder_init(&encoder, (uint8_t *)page_buffer + PAGE_SAMPLES_OFFSET, PAGE_STREAM_SIZE);
+}
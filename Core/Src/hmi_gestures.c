@@ -0,0 +1,339 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk, Eldar Vanin
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hmi_gestures.h"
+#include "buttons.h"
+#include <stddef.h>
+
+/// Number of EXTI lines, one per pin number
+#define GESTURE_LINES 16
+
+// @brief Recognition state of one button
+typedef enum {
+	GESTURE_IDLE = 0, /// Released, nothing pending
+	GESTURE_PRESSED, /// Pressed, not yet long
+	GESTURE_HELD, /// Long press reported, repeating
+	GESTURE_WAIT_SECOND, /// Released once, waiting for a second press
+	GESTURE_PRESSED_SECOND, /// Pressed the second time, a long hold turns it into a long press
+	GESTURE_CHORD, /// Part of a reported chord, waiting for release
+} Gesture_State;
+
+// @brief Recognition data of one button
+typedef struct {
+	Gesture_State state; /// Recognition state
+	uint32_t press_time; /// Time the gesture started
+	uint32_t deadline; /// Time of the next timeout: long press, repeat or double click window
+	uint16_t repeat_count; /// Repeats reported during the current hold
+} Gesture_Line;
+
+// recognition data indexed by EXTI line
+static Gesture_Line lines[GESTURE_LINES];
+
+// engine configuration
+static HMI_Gesture_Config_t config = {0};
+
+// recognized gestures, written by the sampling interrupt and read by the application
+static struct {
+	HMI_Gesture_Event_t events[HMI_GESTURE_QUEUE_SIZE];
+	volatile uint8_t head;
+	volatile uint8_t tail;
+	uint32_t dropped;
+} gesture_queue = {0};
+
+// called after new gestures were queued
+static void (*gesture_callback)(void) = NULL;
+
+/**
+ * @brief runs recognition for new button events and timeouts, called from button sampling interrupt
+ *
+ * @param now HAL tick
+ *
+ * @return true while a gesture is pending and sampling must continue
+ */
+static bool process(uint32_t now);
+
+/**
+ * @brief updates recognition on a debounced press
+ *
+ * @param line EXTI line of the button
+ *
+ * @param time time of the press
+ */
+static void on_press(uint8_t line, uint32_t time);
+
+/**
+ * @brief updates recognition on a debounced release
+ *
+ * @param line EXTI line of the button
+ *
+ * @param time time of the release
+ */
+static void on_release(uint8_t line, uint32_t time);
+
+/**
+ * @brief reports gestures whose timeout passed
+ *
+ * @param line EXTI line of the button
+ *
+ * @param now HAL tick
+ */
+static void on_tick(uint8_t line, uint32_t now);
+
+/**
+ * @brief queues a gesture
+ *
+ * @param type gesture type
+ *
+ * @param gpio_pins pins making the gesture
+ *
+ * @param line_data recognition data of the first button, gives start time and repeat count
+ *
+ * @param time time the gesture was recognized
+ */
+static void push_gesture(HMI_Interact_Status_t type, uint16_t gpio_pins, const Gesture_Line *line_data, uint32_t time);
+
+/**
+ * @brief checks whether deadline passed, safe across tick overflow
+ */
+static inline bool deadline_passed(uint32_t now, uint32_t deadline) {
+	return (int32_t)(now - deadline) >= 0;
+}
+
+/**
+ * @brief Starts recognizing gestures from debounced button events
+ *
+ * @param[in] gesture_config engine configuration
+ */
+void hmi_gestures_init(const HMI_Gesture_Config_t *gesture_config) {
+	config = *gesture_config;
+	button_set_sample_callback(process);
+}
+
+/**
+ * @brief Sets function called from interrupt after new gestures were queued
+ *
+ * @param callback function to call, NULL to disable
+ */
+void hmi_gestures_set_callback(void (*callback)(void)) {
+	gesture_callback = callback;
+}
+
+/**
+ * @brief Takes the oldest recognized gesture
+ *
+ * @param[out] event taken gesture
+ *
+ * @return false if no gesture is queued
+ */
+bool hmi_gestures_get_event(HMI_Gesture_Event_t *event) {
+	uint8_t tail = gesture_queue.tail;
+
+	if(tail == gesture_queue.head) {
+		return false;
+	}
+
+	*event = gesture_queue.events[tail];
+	gesture_queue.tail = (uint8_t)((tail + 1) % HMI_GESTURE_QUEUE_SIZE);
+
+	return true;
+}
+
+/**
+ * @brief Returns number of gestures lost because the queue was full
+ *
+ * @return dropped gesture count
+ */
+uint32_t hmi_gestures_get_dropped_events(void) {
+	return gesture_queue.dropped;
+}
+
+/**
+ * @brief runs recognition for new button events and timeouts, called from button sampling interrupt
+ *
+ * @param now HAL tick
+ *
+ * @return true while a gesture is pending and sampling must continue
+ */
+static bool process(uint32_t now) {
+	uint8_t head = gesture_queue.head;
+	Button_Event event;
+	bool pending = false;
+
+	while(button_get_event(&event)) {
+		if(event.type == BUTTON_EVENT_PRESS) {
+			on_press(event.line, event.time);
+		} else {
+			on_release(event.line, event.time);
+		}
+	}
+
+	for(uint8_t line = 0; line < GESTURE_LINES; ++line) {
+		if(lines[line].state != GESTURE_IDLE) {
+			on_tick(line, now);
+			pending = pending || lines[line].state != GESTURE_IDLE;
+		}
+	}
+
+	if(gesture_queue.head != head && gesture_callback != NULL) {
+		gesture_callback();
+	}
+
+	return pending;
+}
+
+/**
+ * @brief updates recognition on a debounced press
+ *
+ * @param line EXTI line of the button
+ *
+ * @param time time of the press
+ */
+static void on_press(uint8_t line, uint32_t time) {
+	Gesture_Line *data = &lines[line];
+
+	// another button pressed shortly before and not yet recognized makes a chord with this one
+	for(uint8_t other = 0; other < GESTURE_LINES; ++other) {
+		Gesture_Line *other_data = &lines[other];
+		if(other != line && other_data->state == GESTURE_PRESSED && time - other_data->press_time <= HMI_GESTURE_CHORD_MS) {
+			other_data->state = GESTURE_CHORD;
+			data->state = GESTURE_CHORD;
+			push_gesture(HMI_CHORD_EVENT, (uint16_t)((1U << other) | (1U << line)), other_data, time);
+			return;
+		}
+	}
+
+	// press_time stays at the first click until the second press is known to be short
+	if(data->state == GESTURE_WAIT_SECOND) {
+		data->state = GESTURE_PRESSED_SECOND;
+		data->deadline = time + HMI_GESTURE_LONG_MS;
+		return;
+	}
+
+	data->state = GESTURE_PRESSED;
+	data->press_time = time;
+	data->deadline = time + HMI_GESTURE_LONG_MS;
+	data->repeat_count = 0;
+}
+
+/**
+ * @brief updates recognition on a debounced release
+ *
+ * @param line EXTI line of the button
+ *
+ * @param time time of the release
+ */
+static void on_release(uint8_t line, uint32_t time) {
+	Gesture_Line *data = &lines[line];
+	uint16_t gpio_pin = (uint16_t)(1U << line);
+
+	switch(data->state) {
+		case GESTURE_PRESSED:
+			if(config.double_click_pins & gpio_pin) {
+				data->state = GESTURE_WAIT_SECOND;
+				data->deadline = time + HMI_GESTURE_DOUBLE_MS;
+				return;
+			}
+			push_gesture(HMI_SHORT_EVENT, gpio_pin, data, time);
+			break;
+		case GESTURE_PRESSED_SECOND:
+			push_gesture(HMI_DOUBLE_EVENT, gpio_pin, data, time);
+			break;
+		case GESTURE_HELD:
+		case GESTURE_CHORD:
+		case GESTURE_WAIT_SECOND:
+		case GESTURE_IDLE:
+			break;
+	}
+
+	data->state = GESTURE_IDLE;
+}
+
+/**
+ * @brief reports gestures whose timeout passed
+ *
+ * @param line EXTI line of the button
+ *
+ * @param now HAL tick
+ */
+static void on_tick(uint8_t line, uint32_t now) {
+	Gesture_Line *data = &lines[line];
+	uint16_t gpio_pin = (uint16_t)(1U << line);
+
+	if(!deadline_passed(now, data->deadline)) {
+		return;
+	}
+
+	switch(data->state) {
+		case GESTURE_PRESSED:
+			data->state = GESTURE_HELD;
+			data->deadline = now + HMI_GESTURE_REPEAT_DELAY_MS;
+			push_gesture(HMI_LONG_EVENT, gpio_pin, data, now);
+			break;
+		case GESTURE_HELD:
+			data->repeat_count++;
+			data->deadline += HMI_GESTURE_REPEAT_PERIOD_MS;
+			push_gesture(HMI_REPEAT_EVENT, gpio_pin, data, now);
+			break;
+		case GESTURE_WAIT_SECOND:
+			data->state = GESTURE_IDLE;
+			push_gesture(HMI_SHORT_EVENT, gpio_pin, data, now);
+			break;
+		case GESTURE_PRESSED_SECOND:
+			// held too long for a double click: the first click was short, this press is long
+			push_gesture(HMI_SHORT_EVENT, gpio_pin, data, now);
+			data->press_time = data->deadline - HMI_GESTURE_LONG_MS;
+			data->state = GESTURE_HELD;
+			data->deadline = now + HMI_GESTURE_REPEAT_DELAY_MS;
+			push_gesture(HMI_LONG_EVENT, gpio_pin, data, now);
+			break;
+		case GESTURE_CHORD:
+		case GESTURE_IDLE:
+			break;
+	}
+}
+
+/**
+ * @brief queues a gesture
+ *
+ * @param type gesture type
+ *
+ * @param gpio_pins pins making the gesture
+ *
+ * @param line_data recognition data of the first button, gives start time and repeat count
+ *
+ * @param time time the gesture was recognized
+ */
+static void push_gesture(HMI_Interact_Status_t type, uint16_t gpio_pins, const Gesture_Line *line_data, uint32_t time) {
+	uint8_t head = gesture_queue.head;
+	uint8_t next = (uint8_t)((head + 1) % HMI_GESTURE_QUEUE_SIZE);
+
+	if(next == gesture_queue.tail) {
+		gesture_queue.dropped++;
+		return;
+	}
+
+	gesture_queue.events[head] = (HMI_Gesture_Event_t) {
+		.type = type,
+		.gpio_pins = gpio_pins,
+		.repeat_count = line_data->repeat_count,
+		.press_time = line_data->press_time,
+		.time = time,
+	};
+	gesture_queue.head = next;
+}
@@ -0,0 +1,409 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "power.h"
+#include "scheduler.h"
+#include "main.h"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * RTC prescalers: ck_apre = LSI / 4, ck_spre = ck_apre / 8000, 1 Hz for 32 kHz LSI.
+ * the sub-second counter is the time reference during Stop mode
+ */
+static const uint32_t RTC_PREDIV_A = 3;
+static const uint32_t RTC_PREDIV_S = 7999;
+
+/*
+ * wakeup timer runs from RTCCLK / 16
+ */
+static const uint32_t WAKEUP_CLOCK_DIVIDER = 16;
+
+/*
+ * time used to measure LSI against the system clock
+ */
+static const uint32_t LSI_CALIBRATION_MS = 100;
+static const uint32_t LSI_STARTUP_TIMEOUT_MS = 10;
+
+/*
+ * idle time limits: shorter idle just waits for the next tick,
+ * Stop mode is not worth its clock restart below STOP_MIN_MS
+ */
+static const uint32_t SLEEP_MIN_MS = 2;
+static const uint32_t STOP_MIN_MS = 10;
+static const uint32_t STOP_MAX_MS = 30000;
+
+/*
+ * SysTick reload shorter than this is not programmed, the tick is taken as passed
+ */
+static const uint32_t SYSTICK_MIN_RELOAD = 64;
+
+/*
+ * RTC write protection keys
+ */
+static const uint32_t RTC_KEY_1 = 0xCA;
+static const uint32_t RTC_KEY_2 = 0x53;
+static const uint32_t RTC_KEY_LOCK = 0xFF;
+
+/*
+ * EXTI line of the RTC wakeup event
+ */
+static const uint32_t RTC_WAKEUP_EXTI_LINE = EXTI_IMR_MR22;
+
+/*
+ * configuration, measured sub-second counter rate and statistics
+ */
+static power_config_t config = {0};
+static uint32_t rtc_ticks_per_s = 0;
+static uint32_t start_tick = 0;
+static uint64_t sleep_cycles = 0;
+static uint32_t stop_ms = 0;
+static uint32_t sleeps = 0;
+static uint32_t stops = 0;
+static uint32_t suppressed_ticks = 0;
+
+/*
+ * part of a millisecond measured in Stop mode and not yet added to the tick, in 1/rtc_ticks_per_s ms
+ */
+static uint32_t stop_remainder = 0;
+
+/*
+ * returns RTC time within the hour in sub-second counter ticks
+ */
+static uint32_t rtc_now_ticks(void);
+
+/*
+ * sleeps with SysTick stretched over sleep_ms, returns suppressed ticks
+ */
+static uint32_t sleep_tickless(uint32_t sleep_ms);
+
+/*
+ * enters Stop mode for up to sleep_ms, returns milliseconds spent
+ */
+static uint32_t enter_stop(uint32_t sleep_ms);
+
+/*
+ * adds suppressed ticks to HAL tick and tick client
+ */
+static void compensate_ticks(uint32_t elapsed_ms);
+
+/*
+ * starts LSI and the RTC used as Stop mode wakeup and time reference,
+ * measures LSI frequency against the system clock
+ */
+power_status_t power_init(const power_config_t *power_config) {
+	if (power_config == NULL || power_config->restore_clock == NULL) {
+		return POWER_STATUS_INVALID_PARAMETERS;
+	}
+
+	config = *power_config;
+
+	__HAL_RCC_PWR_CLK_ENABLE();
+	HAL_PWR_EnableBkUpAccess();
+
+	__HAL_RCC_LSI_ENABLE();
+	uint32_t start = HAL_GetTick();
+	while ((RCC->CSR & RCC_CSR_LSIRDY) == 0) {
+		if (HAL_GetTick() - start > LSI_STARTUP_TIMEOUT_MS) {
+			return POWER_STATUS_NO_LSI;
+		}
+	}
+
+	if ((RCC->BDCR & RCC_BDCR_RTCSEL) != RCC_RTCCLKSOURCE_LSI) {
+		__HAL_RCC_BACKUPRESET_FORCE();
+		__HAL_RCC_BACKUPRESET_RELEASE();
+	}
+	__HAL_RCC_RTC_CONFIG(RCC_RTCCLKSOURCE_LSI);
+	__HAL_RCC_RTC_ENABLE();
+
+	RTC->WPR = RTC_KEY_1;
+	RTC->WPR = RTC_KEY_2;
+
+	RTC->ISR |= RTC_ISR_INIT;
+	while ((RTC->ISR & RTC_ISR_INITF) == 0) {
+	}
+	RTC->PRER = RTC_PREDIV_S;
+	RTC->PRER = (RTC_PREDIV_A << RTC_PRER_PREDIV_A_Pos) | RTC_PREDIV_S;
+	RTC->TR = 0;
+	RTC->CR |= RTC_CR_BYPSHAD;
+	RTC->ISR &= ~RTC_ISR_INIT;
+
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE | RTC_CR_WUCKSEL);
+
+	RTC->WPR = RTC_KEY_LOCK;
+
+	EXTI->IMR |= RTC_WAKEUP_EXTI_LINE;
+	EXTI->RTSR |= RTC_WAKEUP_EXTI_LINE;
+	HAL_NVIC_SetPriority(RTC_WKUP_IRQn, 3, 0);
+	HAL_NVIC_EnableIRQ(RTC_WKUP_IRQn);
+
+	/* LSI is only accurate to tens of percent, measure it against the system clock.
+	   the window starts on a tick edge, otherwise it is up to a tick short */
+	start = HAL_GetTick();
+	while (HAL_GetTick() == start) {
+	}
+	uint32_t first = rtc_now_ticks();
+	start = HAL_GetTick();
+	while (HAL_GetTick() - start < LSI_CALIBRATION_MS) {
+	}
+	uint32_t ticks = rtc_now_ticks() - first;
+	rtc_ticks_per_s = ticks * 1000 / LSI_CALIBRATION_MS;
+
+	start_tick = HAL_GetTick();
+
+	return POWER_STATUS_OK;
+}
+
+/*
+ * scheduler idle hook, called with interrupts masked
+ */
+void power_idle(void) {
+	uint32_t idle_ms = scheduler_get_idle_ms();
+
+	if (config.tick_client_idle_ms != NULL) {
+		uint32_t client_ms = config.tick_client_idle_ms();
+		if (client_ms < idle_ms) {
+			idle_ms = client_ms;
+		}
+	}
+
+	if (idle_ms >= STOP_MIN_MS && rtc_ticks_per_s != 0 && config.can_stop != NULL && config.can_stop()) {
+		uint32_t elapsed_ms = enter_stop(idle_ms);
+		stop_ms += elapsed_ms;
+		stops++;
+		compensate_ticks(elapsed_ms);
+		return;
+	}
+
+	if (idle_ms >= SLEEP_MIN_MS) {
+		compensate_ticks(sleep_tickless(idle_ms));
+		return;
+	}
+
+	uint32_t before = SysTick->VAL;
+	__DSB();
+	__WFI();
+	uint32_t after = SysTick->VAL;
+	uint32_t reload = SysTick->LOAD + 1;
+
+	sleep_cycles += (before >= after) ? (before - after) : (before + reload - after);
+	sleeps++;
+}
+
+/*
+ * RTC wakeup interrupt handler, clears wakeup flags
+ */
+void power_rtc_wakeup_irq(void) {
+	RTC->ISR = (~(RTC_ISR_WUTF | RTC_ISR_INIT) & 0x0000FFFFU) | (RTC->ISR & RTC_ISR_INIT);
+	EXTI->PR = RTC_WAKEUP_EXTI_LINE;
+}
+
+/*
+ * copies time spent in each mode
+ */
+void power_get_stats(power_stats_t *stats) {
+	assert(stats != NULL);
+
+	uint32_t cycles_per_ms = SystemCoreClock / 1000;
+	uint32_t uptime_ms = HAL_GetTick() - start_tick;
+
+	stats->sleep_ms = (uint32_t)(sleep_cycles / cycles_per_ms);
+	stats->stop_ms = stop_ms;
+	stats->active_ms = (uptime_ms > stats->sleep_ms + stop_ms) ? uptime_ms - stats->sleep_ms - stop_ms : 0;
+	stats->sleeps = sleeps;
+	stats->stops = stops;
+	stats->suppressed_ticks = suppressed_ticks;
+}
+
+/*
+ * prints time spent in each mode and active share of each scheduler task with printf
+ */
+void power_dump(void) {
+	power_stats_t stats;
+	power_get_stats(&stats);
+
+	uint32_t uptime_ms = stats.active_ms + stats.sleep_ms + stats.stop_ms;
+	uint32_t active_permille = (uptime_ms != 0) ? (uint32_t)((uint64_t)stats.active_ms * 1000 / uptime_ms) : 0;
+
+	printf("active %lu ms, sleep %lu ms (%lu), stop %lu ms (%lu), duty %lu.%lu%%, suppressed ticks %lu\r\n",
+			(unsigned long)stats.active_ms, (unsigned long)stats.sleep_ms, (unsigned long)stats.sleeps,
+			(unsigned long)stats.stop_ms, (unsigned long)stats.stops,
+			(unsigned long)(active_permille / 10), (unsigned long)(active_permille % 10),
+			(unsigned long)stats.suppressed_ticks);
+
+	/* share of uptime each task kept the CPU active */
+	uint64_t uptime_cycles = (uint64_t)uptime_ms * (SystemCoreClock / 1000);
+	scheduler_task_stats_t task_stats;
+
+	for (uint8_t id = 0; uptime_cycles != 0 && SCHEDULER_STATUS_OK == scheduler_get_stats(id, &task_stats); ++id) {
+		uint32_t task_permille = (uint32_t)(task_stats.total_cycles * 1000 / uptime_cycles);
+		printf("task %u active %lu.%lu%%\r\n", id, (unsigned long)(task_permille / 10), (unsigned long)(task_permille % 10));
+	}
+}
+
+/*
+ * returns RTC time within the hour in sub-second counter ticks.
+ * shadow registers are bypassed, sub-seconds are read until stable around the time read
+ */
+static uint32_t rtc_now_ticks(void) {
+	uint32_t ssr;
+	uint32_t tr;
+
+	do {
+		ssr = RTC->SSR;
+		tr = RTC->TR;
+	} while (ssr != RTC->SSR);
+
+	uint32_t minutes = ((tr & RTC_TR_MNT) >> RTC_TR_MNT_Pos) * 10 + ((tr & RTC_TR_MNU) >> RTC_TR_MNU_Pos);
+	uint32_t seconds = ((tr & RTC_TR_ST) >> RTC_TR_ST_Pos) * 10 + ((tr & RTC_TR_SU) >> RTC_TR_SU_Pos);
+
+	return (minutes * 60 + seconds) * (RTC_PREDIV_S + 1) + (RTC_PREDIV_S - ssr);
+}
+
+/*
+ * sleeps with SysTick stretched over sleep_ms, returns suppressed ticks.
+ * the first tick boundary is kept where it was, later ones are merged into one long reload.
+ * on an earlier wakeup the passed boundaries are counted and SysTick is realigned to the next one
+ */
+static uint32_t sleep_tickless(uint32_t sleep_ms) {
+	uint32_t cycles_per_ms = SystemCoreClock / 1000;
+	uint32_t max_ms = (SysTick_LOAD_RELOAD_Msk + 1) / cycles_per_ms;
+	uint32_t skipped = 0;
+
+	if (sleep_ms > max_ms) {
+		sleep_ms = max_ms;
+	}
+
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+	uint32_t to_boundary = SysTick->VAL;
+	if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) || to_boundary < SYSTICK_MIN_RELOAD) {
+		/* tick is due anyway, let it run */
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+		return 0;
+	}
+
+	uint32_t reload = to_boundary + (sleep_ms - 1) * cycles_per_ms;
+	SysTick->LOAD = reload - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	SysTick->LOAD = cycles_per_ms - 1;
+
+	__DSB();
+	__WFI();
+
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+	if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+		/* woken by the stretched tick, its handler counts the last millisecond */
+		skipped = sleep_ms - 1;
+		sleep_cycles += reload;
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	} else {
+		uint32_t elapsed = reload - 1 - SysTick->VAL;
+		uint32_t next = to_boundary - elapsed;
+
+		if (elapsed >= to_boundary) {
+			skipped = 1 + (elapsed - to_boundary) / cycles_per_ms;
+			next = cycles_per_ms - (elapsed - to_boundary) % cycles_per_ms;
+		}
+		if (next < SYSTICK_MIN_RELOAD) {
+			skipped++;
+			next += cycles_per_ms;
+		}
+
+		/* the counter takes LOAD when it is enabled, so the normal reload goes back after that */
+		SysTick->LOAD = next - 1;
+		SysTick->VAL = 0;
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+		SysTick->LOAD = cycles_per_ms - 1;
+		sleep_cycles += elapsed;
+	}
+
+	sleeps++;
+
+	return skipped;
+}
+
+/*
+ * enters Stop mode for up to sleep_ms, returns milliseconds spent.
+ * wakes on the RTC wakeup timer or any EXTI line, e.g. a button
+ */
+static uint32_t enter_stop(uint32_t sleep_ms) {
+	if (sleep_ms > STOP_MAX_MS) {
+		sleep_ms = STOP_MAX_MS;
+	}
+
+	uint32_t wakeup_ticks = (uint32_t)((uint64_t)sleep_ms * rtc_ticks_per_s * (RTC_PREDIV_A + 1) / WAKEUP_CLOCK_DIVIDER / 1000);
+	if (wakeup_ticks == 0) {
+		wakeup_ticks = 1;
+	}
+	if (wakeup_ticks > RTC_WUTR_WUT) {
+		wakeup_ticks = RTC_WUTR_WUT;
+	}
+
+	RTC->WPR = RTC_KEY_1;
+	RTC->WPR = RTC_KEY_2;
+	RTC->CR &= ~RTC_CR_WUTE;
+	while ((RTC->ISR & RTC_ISR_WUTWF) == 0) {
+	}
+	RTC->WUTR = wakeup_ticks - 1;
+	RTC->ISR = (~(RTC_ISR_WUTF | RTC_ISR_INIT) & 0x0000FFFFU) | (RTC->ISR & RTC_ISR_INIT);
+	RTC->CR |= RTC_CR_WUTIE | RTC_CR_WUTE;
+	RTC->WPR = RTC_KEY_LOCK;
+	EXTI->PR = RTC_WAKEUP_EXTI_LINE;
+
+	uint32_t before = rtc_now_ticks();
+
+	HAL_SuspendTick();
+	HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+	config.restore_clock();
+	HAL_ResumeTick();
+
+	uint32_t hour_ticks = 3600 * (RTC_PREDIV_S + 1);
+	uint32_t elapsed_ticks = (rtc_now_ticks() + hour_ticks - before) % hour_ticks;
+
+	RTC->WPR = RTC_KEY_1;
+	RTC->WPR = RTC_KEY_2;
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	RTC->WPR = RTC_KEY_LOCK;
+
+	/* the fraction of a millisecond is carried over, dropping it would lose half a tick per Stop */
+	uint64_t elapsed = (uint64_t)elapsed_ticks * 1000 + stop_remainder;
+	stop_remainder = (uint32_t)(elapsed % rtc_ticks_per_s);
+
+	return (uint32_t)(elapsed / rtc_ticks_per_s);
+}
+
+/*
+ * adds suppressed ticks to HAL tick and tick client
+ */
+static void compensate_ticks(uint32_t elapsed_ms) {
+	if (elapsed_ms == 0) {
+		return;
+	}
+
+	uwTick += elapsed_ms;
+	suppressed_ticks += elapsed_ms;
+
+	if (config.tick_client_skip_ms != NULL) {
+		config.tick_client_skip_ms(elapsed_ms);
+	}
+}
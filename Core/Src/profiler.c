@@ -0,0 +1,149 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "profiler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * names used by profiler_dump
+ */
+static const char *const PROFILER_NAMES[PROFILER_ID_COUNT] = {
+		[PROFILER_TIM6_IRQ] = "TIM6 IRQ",
+		[PROFILER_SPI1_IRQ] = "SPI1 IRQ",
+		[PROFILER_EXTI1_IRQ] = "EXTI1 IRQ",
+		[PROFILER_EXTI4_IRQ] = "EXTI4 IRQ",
+		[PROFILER_I2C1_EV_IRQ] = "I2C1 EV IRQ",
+		[PROFILER_I2C1_ER_IRQ] = "I2C1 ER IRQ",
+		[PROFILER_DMA1_STREAM0_IRQ] = "DMA1 S0 IRQ",
+		[PROFILER_DMA1_STREAM6_IRQ] = "DMA1 S6 IRQ",
+		[PROFILER_DMA1_STREAM7_IRQ] = "DMA1 S7 IRQ",
+		[PROFILER_DMA2_STREAM1_IRQ] = "DMA2 S1 IRQ",
+		[PROFILER_DISPLAY_FRAME_CALLBACK] = "Frame cb",
+		[PROFILER_GPIO_EXTI_CALLBACK] = "GPIO EXTI cb",
+};
+
+/*
+ * struct for holding raw measurments of one function
+ */
+typedef struct {
+	uint32_t count;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+} profiler_entry_t;
+
+/*
+ * measurments of all functions
+ */
+static volatile profiler_entry_t entries[PROFILER_ID_COUNT];
+
+/*
+ * tick of the last reset, used for cpu load
+ */
+static uint32_t reset_tick = 0;
+
+/*
+ * enables DWT cycle counter and clears statistics
+ */
+void profiler_init(void) {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	profiler_reset();
+}
+
+/*
+ * clears statistics
+ */
+void profiler_reset(void) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	for (uint8_t i = 0; i < PROFILER_ID_COUNT; ++i) {
+		entries[i].count = 0;
+		entries[i].min_cycles = UINT32_MAX;
+		entries[i].max_cycles = 0;
+		entries[i].total_cycles = 0;
+	}
+	reset_tick = HAL_GetTick();
+
+	__set_PRIMASK(primask);
+}
+
+/*
+ * adds one measurment of given function.
+ * called from interrupts, an interrupt of higher priority can only add its own id
+ */
+void profiler_record(profiler_id_t id, uint32_t cycles) {
+	assert(id < PROFILER_ID_COUNT);
+
+	volatile profiler_entry_t *entry = &entries[id];
+
+	entry->count++;
+	entry->total_cycles += cycles;
+	if (cycles < entry->min_cycles) {
+		entry->min_cycles = cycles;
+	}
+	if (cycles > entry->max_cycles) {
+		entry->max_cycles = cycles;
+	}
+}
+
+/*
+ * copies statistics of given function
+ */
+void profiler_get_stats(profiler_id_t id, profiler_stats_t *stats) {
+	assert(id < PROFILER_ID_COUNT);
+	assert(stats != NULL);
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	stats->count = entries[id].count;
+	stats->min_cycles = (stats->count != 0) ? entries[id].min_cycles : 0;
+	stats->max_cycles = entries[id].max_cycles;
+	stats->total_cycles = entries[id].total_cycles;
+	uint32_t elapsed_ms = HAL_GetTick() - reset_tick;
+
+	__set_PRIMASK(primask);
+
+	stats->avg_cycles = (stats->count != 0) ? (uint32_t)(stats->total_cycles / stats->count) : 0;
+
+	uint64_t elapsed_cycles = (uint64_t)elapsed_ms * (SystemCoreClock / 1000U);
+	stats->load_permille = (elapsed_cycles != 0) ? (uint32_t)((stats->total_cycles * 1000U) / elapsed_cycles) : 0;
+}
+
+/*
+ * prints statistics of all functions with printf
+ */
+void profiler_dump(void) {
+	profiler_stats_t stats;
+
+	printf("%-14s %10s %8s %8s %8s %6s\r\n", "name", "count", "min", "avg", "max", "load");
+	for (uint8_t i = 0; i < PROFILER_ID_COUNT; ++i) {
+		profiler_get_stats((profiler_id_t)i, &stats);
+		printf("%-14s %10lu %8lu %8lu %8lu %3lu.%lu%%\r\n", PROFILER_NAMES[i],
+			   (unsigned long)stats.count, (unsigned long)stats.min_cycles, (unsigned long)stats.avg_cycles,
+			   (unsigned long)stats.max_cycles, (unsigned long)(stats.load_permille / 10U),
+			   (unsigned long)(stats.load_permille % 10U));
+	}
+}
@@ -0,0 +1,354 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sample_codec.h"
+#include <assert.h>
+#include <stddef.h>
+
+/*
+ * channel indexes
+ */
+#define CHANNEL_HUMIDITY 0
+#define CHANNEL_TEMPERATURE 1
+#define CHANNEL_TIME 2
+
+/*
+ * raw bits of each channel, used for the first sample and escaped residuals.
+ * a zigzag residual of a 20 bit delta needs 21 bits
+ */
+static const uint8_t RAW_BITS[SAMPLE_CODEC_CHANNELS] = {20, 20, 32};
+static const uint8_t ESCAPED_BITS[SAMPLE_CODEC_CHANNELS] = {21, 21, 32};
+
+/*
+ * mask of a 20 bit raw value
+ */
+static const uint32_t RAW_MASK = 0xFFFFF;
+
+/*
+ * Rice quotient written as ESCAPE_QUOTIENT ones is followed by the residual in full
+ */
+static const uint8_t ESCAPE_QUOTIENT = 16;
+
+/*
+ * largest Rice parameter and fraction bits of the running mean
+ */
+static const uint8_t MAX_RICE_BITS = 20;
+static const uint8_t MEAN_FRACTION_BITS = 4;
+
+/*
+ * maps signed residual to unsigned, small magnitudes to small values
+ */
+static inline uint32_t zigzag_encode(int32_t value) {
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t zigzag_decode(uint32_t value) {
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/*
+ * Rice parameter for a channel: floor(log2(mean residual))
+ */
+static inline uint8_t rice_bits(uint32_t mean) {
+	uint32_t residual_mean = mean >> MEAN_FRACTION_BITS;
+	uint8_t bits = (residual_mean == 0) ? 0 : (uint8_t)(31 - __builtin_clz(residual_mean));
+
+	return (bits > MAX_RICE_BITS) ? MAX_RICE_BITS : bits;
+}
+
+/*
+ * moves running mean towards the residual by 1/16
+ */
+static inline void update_mean(uint32_t *mean, uint32_t residual) {
+	if (residual > (UINT32_MAX >> MEAN_FRACTION_BITS)) {
+		residual = UINT32_MAX >> MEAN_FRACTION_BITS;
+	}
+	*mean = *mean - (*mean >> MEAN_FRACTION_BITS) + residual;
+}
+
+/*
+ * writes up to 24 bits
+ */
+static void put_bits(sample_codec_encoder_t *encoder, uint32_t value, uint8_t count);
+
+/*
+ * reads up to 24 bits, returns false at the end of the stream
+ */
+static bool get_bits(sample_codec_decoder_t *decoder, uint8_t count, uint32_t *value);
+
+/*
+ * writes up to 32 bits
+ */
+static void put_wide(sample_codec_encoder_t *encoder, uint32_t value, uint8_t count);
+
+/*
+ * reads up to 32 bits
+ */
+static bool get_wide(sample_codec_decoder_t *decoder, uint8_t count, uint32_t *value);
+
+/*
+ * writes a residual with the channel's adaptive Rice code
+ */
+static void put_residual(sample_codec_encoder_t *encoder, uint8_t channel, uint32_t residual);
+
+/*
+ * reads a residual with the channel's adaptive Rice code
+ */
+static bool get_residual(sample_codec_decoder_t *decoder, uint8_t channel, uint32_t *residual);
+
+/*
+ * starts a stream in data, capacity in bytes
+ */
+void sample_codec_encoder_init(sample_codec_encoder_t *encoder, uint8_t *data, uint32_t capacity) {
+	assert(encoder != NULL);
+	assert(data != NULL);
+
+	*encoder = (sample_codec_encoder_t) {
+		.data = data,
+		.capacity = capacity,
+	};
+}
+
+/*
+ * encodes one sample: 20 bit raw values and time in seconds
+ */
+bool sample_codec_encode(sample_codec_encoder_t *encoder, uint32_t raw_humidity, uint32_t raw_temperature, uint32_t time_s) {
+	assert(encoder != NULL);
+
+	sample_codec_state_t *state = &encoder->state;
+	uint32_t values[SAMPLE_CODEC_CHANNELS] = {raw_humidity & RAW_MASK, raw_temperature & RAW_MASK, time_s};
+
+	if (encoder->position + (encoder->bit_count + SAMPLE_CODEC_MAX_SAMPLE_BITS + 7) / 8 > encoder->capacity) {
+		return false;
+	}
+
+	if (!state->started) {
+		for (uint8_t channel = 0; channel < SAMPLE_CODEC_CHANNELS; ++channel) {
+			put_wide(encoder, values[channel], RAW_BITS[channel]);
+			state->previous[channel] = values[channel];
+		}
+		state->previous_step = 0;
+		state->started = true;
+		return true;
+	}
+
+	uint32_t step = time_s - state->previous[CHANNEL_TIME];
+
+	put_residual(encoder, CHANNEL_HUMIDITY, zigzag_encode((int32_t)(values[CHANNEL_HUMIDITY] - state->previous[CHANNEL_HUMIDITY])));
+	put_residual(encoder, CHANNEL_TEMPERATURE, zigzag_encode((int32_t)(values[CHANNEL_TEMPERATURE] - state->previous[CHANNEL_TEMPERATURE])));
+	put_residual(encoder, CHANNEL_TIME, zigzag_encode((int32_t)(step - state->previous_step)));
+
+	for (uint8_t channel = 0; channel < SAMPLE_CODEC_CHANNELS; ++channel) {
+		state->previous[channel] = values[channel];
+	}
+	state->previous_step = step;
+
+	return true;
+}
+
+/*
+ * writes the last partial byte, returns stream length in bytes
+ */
+uint32_t sample_codec_finish(sample_codec_encoder_t *encoder) {
+	assert(encoder != NULL);
+
+	if (encoder->bit_count > 0) {
+		encoder->data[encoder->position++] = (uint8_t)encoder->bits;
+		encoder->bits = 0;
+		encoder->bit_count = 0;
+	}
+
+	return encoder->position;
+}
+
+/*
+ * starts reading a stream of length bytes
+ */
+void sample_codec_decoder_init(sample_codec_decoder_t *decoder, const uint8_t *data, uint32_t length) {
+	assert(decoder != NULL);
+	assert(data != NULL);
+
+	*decoder = (sample_codec_decoder_t) {
+		.data = data,
+		.length = length,
+	};
+}
+
+/*
+ * decodes the next sample, returns false when the stream ends
+ */
+bool sample_codec_decode(sample_codec_decoder_t *decoder, uint32_t *raw_humidity, uint32_t *raw_temperature, uint32_t *time_s) {
+	assert(decoder != NULL);
+
+	sample_codec_state_t *state = &decoder->state;
+	uint32_t values[SAMPLE_CODEC_CHANNELS] = {0};
+
+	if (!state->started) {
+		for (uint8_t channel = 0; channel < SAMPLE_CODEC_CHANNELS; ++channel) {
+			if (!get_wide(decoder, RAW_BITS[channel], &values[channel])) {
+				return false;
+			}
+		}
+		state->previous_step = 0;
+		state->started = true;
+	} else {
+		uint32_t residuals[SAMPLE_CODEC_CHANNELS] = {0};
+
+		for (uint8_t channel = 0; channel < SAMPLE_CODEC_CHANNELS; ++channel) {
+			if (!get_residual(decoder, channel, &residuals[channel])) {
+				return false;
+			}
+		}
+
+		values[CHANNEL_HUMIDITY] = (state->previous[CHANNEL_HUMIDITY] + (uint32_t)zigzag_decode(residuals[CHANNEL_HUMIDITY])) & RAW_MASK;
+		values[CHANNEL_TEMPERATURE] = (state->previous[CHANNEL_TEMPERATURE] + (uint32_t)zigzag_decode(residuals[CHANNEL_TEMPERATURE])) & RAW_MASK;
+		state->previous_step += (uint32_t)zigzag_decode(residuals[CHANNEL_TIME]);
+		values[CHANNEL_TIME] = state->previous[CHANNEL_TIME] + state->previous_step;
+	}
+
+	for (uint8_t channel = 0; channel < SAMPLE_CODEC_CHANNELS; ++channel) {
+		state->previous[channel] = values[channel];
+	}
+
+	*raw_humidity = values[CHANNEL_HUMIDITY];
+	*raw_temperature = values[CHANNEL_TEMPERATURE];
+	*time_s = values[CHANNEL_TIME];
+
+	return true;
+}
+
+/*
+ * writes up to 24 bits
+ */
+static void put_bits(sample_codec_encoder_t *encoder, uint32_t value, uint8_t count) {
+	encoder->bits |= (value & ((1U << count) - 1)) << encoder->bit_count;
+	encoder->bit_count = (uint8_t)(encoder->bit_count + count);
+
+	while (encoder->bit_count >= 8) {
+		encoder->data[encoder->position++] = (uint8_t)encoder->bits;
+		encoder->bits >>= 8;
+		encoder->bit_count = (uint8_t)(encoder->bit_count - 8);
+	}
+}
+
+/*
+ * reads up to 24 bits, returns false at the end of the stream
+ */
+static bool get_bits(sample_codec_decoder_t *decoder, uint8_t count, uint32_t *value) {
+	while (decoder->bit_count < count) {
+		if (decoder->position >= decoder->length) {
+			return false;
+		}
+		decoder->bits |= (uint32_t)decoder->data[decoder->position++] << decoder->bit_count;
+		decoder->bit_count = (uint8_t)(decoder->bit_count + 8);
+	}
+
+	*value = decoder->bits & ((1U << count) - 1);
+	decoder->bits >>= count;
+	decoder->bit_count = (uint8_t)(decoder->bit_count - count);
+
+	return true;
+}
+
+/*
+ * writes up to 32 bits
+ */
+static void put_wide(sample_codec_encoder_t *encoder, uint32_t value, uint8_t count) {
+	if (count > 16) {
+		put_bits(encoder, value, 16);
+		put_bits(encoder, value >> 16, (uint8_t)(count - 16));
+	} else {
+		put_bits(encoder, value, count);
+	}
+}
+
+/*
+ * reads up to 32 bits
+ */
+static bool get_wide(sample_codec_decoder_t *decoder, uint8_t count, uint32_t *value) {
+	uint32_t low = 0;
+	uint32_t high = 0;
+
+	if (count > 16) {
+		if (!get_bits(decoder, 16, &low) || !get_bits(decoder, (uint8_t)(count - 16), &high)) {
+			return false;
+		}
+		*value = low | (high << 16);
+		return true;
+	}
+
+	return get_bits(decoder, count, value);
+}
+
+/*
+ * writes a residual with the channel's adaptive Rice code:
+ * quotient in unary as ones closed by a zero, then the low bits.
+ * a quotient of ESCAPE_QUOTIENT or more is written as ESCAPE_QUOTIENT ones and the residual in full
+ */
+static void put_residual(sample_codec_encoder_t *encoder, uint8_t channel, uint32_t residual) {
+	uint32_t *mean = &encoder->state.mean[channel];
+	uint8_t bits = rice_bits(*mean);
+	uint32_t quotient = residual >> bits;
+
+	if (quotient >= ESCAPE_QUOTIENT) {
+		put_bits(encoder, (1U << ESCAPE_QUOTIENT) - 1, ESCAPE_QUOTIENT);
+		put_wide(encoder, residual, ESCAPED_BITS[channel]);
+	} else {
+		put_bits(encoder, (1U << quotient) - 1, (uint8_t)(quotient + 1));
+		put_bits(encoder, residual, bits);
+	}
+
+	update_mean(mean, residual);
+}
+
+/*
+ * reads a residual with the channel's adaptive Rice code
+ */
+static bool get_residual(sample_codec_decoder_t *decoder, uint8_t channel, uint32_t *residual) {
+	uint32_t *mean = &decoder->state.mean[channel];
+	uint8_t bits = rice_bits(*mean);
+	uint32_t quotient = 0;
+	uint32_t bit = 1;
+
+	while (quotient < ESCAPE_QUOTIENT) {
+		if (!get_bits(decoder, 1, &bit)) {
+			return false;
+		}
+		if (bit == 0) {
+			break;
+		}
+		quotient++;
+	}
+
+	if (quotient == ESCAPE_QUOTIENT) {
+		if (!get_wide(decoder, ESCAPED_BITS[channel], residual)) {
+			return false;
+		}
+	} else {
+		uint32_t low = 0;
+		if (!get_bits(decoder, bits, &low)) {
+			return false;
+		}
+		*residual = (quotient << bits) | low;
+	}
+
+	update_mean(mean, *residual);
+
+	return true;
+}
@@ -0,0 +1,148 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sample_rate.h"
+#include <assert.h>
+#include <stddef.h>
+
+/*
+ * milliseconds per minute and per hour, slopes are per minute and rates per hour
+ */
+static const uint32_t MS_PER_MINUTE = 60000;
+static const uint64_t MS_PER_HOUR = 3600000;
+
+/*
+ * checks whether a change exceeds its noise band and slope threshold
+ */
+static bool is_fast_change(int32_t value, int32_t reference, uint32_t elapsed_ms, uint32_t noise_centi, uint32_t slope_centi);
+
+/*
+ * checks configuration and starts at the fastest interval
+ */
+sample_rate_status_t sample_rate_init(sample_rate_t *rate, const sample_rate_config_t *config, uint32_t now) {
+	assert(rate != NULL);
+	assert(config != NULL);
+
+	if (config->min_interval_ms == 0 || config->min_interval_ms > config->max_interval_ms || config->stable_samples == 0) {
+		return SAMPLE_RATE_STATUS_INVALID_PARAMETERS;
+	}
+
+	rate->config = *config;
+	rate->interval_ms = config->min_interval_ms;
+	rate->stable_count = 0;
+	rate->has_reference = false;
+	rate->start_time = now;
+	rate->samples = 0;
+
+	return SAMPLE_RATE_STATUS_OK;
+}
+
+/*
+ * changes the slowest interval, the current interval is clamped to it
+ */
+sample_rate_status_t sample_rate_set_max_interval(sample_rate_t *rate, uint32_t max_interval_ms) {
+	assert(rate != NULL);
+
+	if (max_interval_ms < rate->config.min_interval_ms) {
+		return SAMPLE_RATE_STATUS_INVALID_PARAMETERS;
+	}
+
+	rate->config.max_interval_ms = max_interval_ms;
+	if (rate->interval_ms > max_interval_ms) {
+		rate->interval_ms = max_interval_ms;
+	}
+
+	return SAMPLE_RATE_STATUS_OK;
+}
+
+/*
+ * adds a measurement and returns the interval until the next one.
+ * a fast change drops to the fastest interval, stable windows double it up to the slowest
+ */
+uint32_t sample_rate_update(sample_rate_t *rate, int32_t temperature_centi, int32_t humidity_centi, uint32_t now) {
+	assert(rate != NULL);
+
+	rate->samples++;
+
+	if (!rate->has_reference) {
+		rate->reference_temperature_centi = temperature_centi;
+		rate->reference_humidity_centi = humidity_centi;
+		rate->reference_time = now;
+		rate->has_reference = true;
+		return rate->interval_ms;
+	}
+
+	uint32_t elapsed_ms = now - rate->reference_time;
+	bool fast = is_fast_change(temperature_centi, rate->reference_temperature_centi, elapsed_ms,
+							   rate->config.temperature_noise_centi, rate->config.temperature_slope_centi)
+			|| is_fast_change(humidity_centi, rate->reference_humidity_centi, elapsed_ms,
+							  rate->config.humidity_noise_centi, rate->config.humidity_slope_centi);
+
+	if (fast) {
+		rate->interval_ms = rate->config.min_interval_ms;
+		rate->stable_count = 0;
+	} else if (++rate->stable_count >= rate->config.stable_samples) {
+		rate->interval_ms = (rate->interval_ms > rate->config.max_interval_ms / 2) ? rate->config.max_interval_ms : rate->interval_ms * 2;
+		rate->stable_count = 0;
+	} else {
+		return rate->interval_ms;
+	}
+
+	/* new window starts at this sample */
+	rate->reference_temperature_centi = temperature_centi;
+	rate->reference_humidity_centi = humidity_centi;
+	rate->reference_time = now;
+
+	return rate->interval_ms;
+}
+
+/*
+ * writes current interval, effective rate and bus time saved
+ */
+void sample_rate_get_stats(const sample_rate_t *rate, uint32_t now, sample_rate_stats_t *stats) {
+	assert(rate != NULL);
+	assert(stats != NULL);
+
+	uint32_t elapsed_ms = now - rate->start_time;
+	uint32_t baseline_samples = (rate->config.baseline_interval_ms != 0) ? elapsed_ms / rate->config.baseline_interval_ms : 0;
+
+	stats->interval_ms = rate->interval_ms;
+	stats->samples = rate->samples;
+	stats->samples_per_hour = (elapsed_ms != 0) ? (uint32_t)(rate->samples * MS_PER_HOUR / elapsed_ms) : 0;
+	stats->bus_saved_ms = (baseline_samples > rate->samples)
+			? (uint32_t)((uint64_t)(baseline_samples - rate->samples) * rate->config.bus_us_per_sample / 1000)
+			: 0;
+}
+
+/*
+ * checks whether a change exceeds its noise band and slope threshold
+ */
+static bool is_fast_change(int32_t value, int32_t reference, uint32_t elapsed_ms, uint32_t noise_centi, uint32_t slope_centi) {
+	uint32_t change = (uint32_t)((value > reference) ? value - reference : reference - value);
+
+	if (change <= noise_centi) {
+		return false;
+	}
+
+	if (elapsed_ms == 0) {
+		return true;
+	}
+
+	return (uint64_t)change * MS_PER_MINUTE / elapsed_ms > slope_centi;
+}
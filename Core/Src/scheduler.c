@@ -0,0 +1,351 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "scheduler.h"
+#include "main.h"
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * struct for holding task configuration and run state
+ */
+typedef struct {
+	scheduler_task_config_t config;
+	uint32_t next_release;
+	uint32_t release_tick;
+	uint8_t event_ready;
+	scheduler_task_stats_t stats;
+} scheduler_task_t;
+
+/*
+ * queue of posted events, filled by interrupts and emptied by the scheduler
+ */
+typedef struct {
+	uint8_t events[SCHEDULER_EVENT_QUEUE_SIZE];
+	uint8_t head;
+	uint8_t tail;
+	uint32_t dropped;
+} scheduler_event_queue_t;
+
+/*
+ * registered tasks
+ */
+static scheduler_task_t tasks[SCHEDULER_MAX_TASKS];
+static uint8_t task_count = 0;
+
+/*
+ * posted events
+ */
+static volatile scheduler_event_queue_t event_queue = {0};
+
+/*
+ * function called when nothing is ready
+ */
+static scheduler_idle_fn_t idle_hook = NULL;
+
+/*
+ * waits for interrupt, default idle hook
+ */
+static void wait_for_interrupt(void);
+
+/*
+ * takes events from the queue and marks subscribed tasks ready
+ */
+static void dispatch_events(uint32_t now);
+
+/*
+ * runs task and updates its statistics
+ */
+static void run_task(scheduler_task_t *task, uint32_t release_tick);
+
+/*
+ * moves the periodic release of a task past now
+ */
+static void advance_release(scheduler_task_t *task, uint32_t now);
+
+/*
+ * clears tasks, events and statistics, enables the cycle counter
+ */
+void scheduler_init(void) {
+	memset(tasks, 0, sizeof(tasks));
+	task_count = 0;
+	event_queue.head = 0;
+	event_queue.tail = 0;
+	event_queue.dropped = 0;
+	idle_hook = wait_for_interrupt;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/*
+ * adds task, tasks added first run first when ready at the same time
+ */
+scheduler_status_t scheduler_add_task(const scheduler_task_config_t *config, uint8_t *task_id) {
+	if (config == NULL || config->run == NULL || (config->period_ms == 0 && config->event_mask == 0)) {
+		return SCHEDULER_STATUS_INVALID_PARAMETERS;
+	}
+
+	if (task_count >= SCHEDULER_MAX_TASKS) {
+		return SCHEDULER_STATUS_FULL;
+	}
+
+	scheduler_task_t *task = &tasks[task_count];
+	task->config = *config;
+	task->next_release = HAL_GetTick();
+	task->event_ready = 0;
+
+	if (task_id != NULL) {
+		*task_id = task_count;
+	}
+	task_count++;
+
+	return SCHEDULER_STATUS_OK;
+}
+
+/*
+ * changes period of a task, next release is one new period from now
+ */
+scheduler_status_t scheduler_set_period(uint8_t task_id, uint32_t period_ms) {
+	if (task_id >= task_count || (period_ms == 0 && tasks[task_id].config.event_mask == 0)) {
+		return SCHEDULER_STATUS_INVALID_PARAMETERS;
+	}
+
+	tasks[task_id].config.period_ms = period_ms;
+	tasks[task_id].next_release = HAL_GetTick() + period_ms;
+
+	return SCHEDULER_STATUS_OK;
+}
+
+/*
+ * queues event for subscribed tasks. safe to call from interrupts
+ */
+scheduler_status_t scheduler_post_event(uint8_t event) {
+	if (event >= 32) {
+		return SCHEDULER_STATUS_INVALID_PARAMETERS;
+	}
+
+	scheduler_status_t status = SCHEDULER_STATUS_OK;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint8_t next_head = (uint8_t)((event_queue.head + 1) % SCHEDULER_EVENT_QUEUE_SIZE);
+	if (next_head == event_queue.tail) {
+		event_queue.dropped++;
+		status = SCHEDULER_STATUS_FULL;
+	} else {
+		event_queue.events[event_queue.head] = event;
+		event_queue.head = next_head;
+	}
+
+	__set_PRIMASK(primask);
+
+	return status;
+}
+
+/*
+ * sets function called when nothing is ready, NULL restores default __WFI
+ */
+void scheduler_set_idle_hook(scheduler_idle_fn_t hook) {
+	idle_hook = (hook != NULL) ? hook : wait_for_interrupt;
+}
+
+/*
+ * dispatches queued events and runs every ready task once.
+ * calls idle hook if nothing was ready
+ */
+void scheduler_run_once(void) {
+	uint32_t now = HAL_GetTick();
+	uint8_t ran = 0;
+
+	dispatch_events(now);
+
+	for (uint8_t i = 0; i < task_count; ++i) {
+		scheduler_task_t *task = &tasks[i];
+
+		uint8_t due = task->config.period_ms != 0 && (int32_t)(now - task->next_release) >= 0;
+
+		if (task->event_ready) {
+			task->event_ready = 0;
+			/* the event run serves a period that is due as well */
+			if (due) {
+				advance_release(task, now);
+			}
+			run_task(task, task->release_tick);
+			ran = 1;
+		} else if (due) {
+			uint32_t release = task->next_release;
+
+			advance_release(task, now);
+			run_task(task, release);
+			ran = 1;
+		}
+	}
+
+	if (ran) {
+		return;
+	}
+
+	__disable_irq();
+	if (event_queue.head == event_queue.tail) {
+		idle_hook();
+	}
+	__enable_irq();
+}
+
+/*
+ * returns milliseconds until the next periodic release, 0 if a task or event is ready
+ */
+uint32_t scheduler_get_idle_ms(void) {
+	if (event_queue.head != event_queue.tail) {
+		return 0;
+	}
+
+	uint32_t now = HAL_GetTick();
+	uint32_t idle_ms = UINT32_MAX;
+
+	for (uint8_t i = 0; i < task_count; ++i) {
+		if (tasks[i].event_ready) {
+			return 0;
+		}
+
+		if (tasks[i].config.period_ms != 0) {
+			int32_t remaining = (int32_t)(tasks[i].next_release - now);
+
+			if (remaining <= 0) {
+				return 0;
+			}
+			if ((uint32_t)remaining < idle_ms) {
+				idle_ms = (uint32_t)remaining;
+			}
+		}
+	}
+
+	return idle_ms;
+}
+
+/*
+ * runs the scheduler forever
+ */
+void scheduler_run(void) {
+	while (1) {
+		scheduler_run_once();
+	}
+}
+
+/*
+ * copies statistics of a task
+ */
+scheduler_status_t scheduler_get_stats(uint8_t task_id, scheduler_task_stats_t *stats) {
+	if (task_id >= task_count || stats == NULL) {
+		return SCHEDULER_STATUS_INVALID_PARAMETERS;
+	}
+
+	*stats = tasks[task_id].stats;
+
+	return SCHEDULER_STATUS_OK;
+}
+
+/*
+ * returns number of events lost because the queue was full
+ */
+uint32_t scheduler_get_dropped_events(void) {
+	return event_queue.dropped;
+}
+
+/*
+ * prints statistics of all tasks with printf
+ */
+void scheduler_dump(void) {
+	printf("%-10s %8s %8s %8s %6s %6s\r\n", "task", "runs", "avg", "max", "miss", "lat");
+
+	for (uint8_t i = 0; i < task_count; ++i) {
+		const scheduler_task_stats_t *stats = &tasks[i].stats;
+		uint32_t avg = (stats->runs != 0) ? (uint32_t)(stats->total_cycles / stats->runs) : 0;
+
+		printf("%-10s %8lu %8lu %8lu %6lu %6lu\r\n", tasks[i].config.name,
+				(unsigned long)stats->runs, (unsigned long)avg, (unsigned long)stats->max_cycles,
+				(unsigned long)stats->deadline_misses, (unsigned long)stats->max_latency_ms);
+	}
+
+	printf("dropped events %lu\r\n", (unsigned long)event_queue.dropped);
+}
+
+/*
+ * waits for interrupt, default idle hook
+ */
+static void wait_for_interrupt(void) {
+	__WFI();
+}
+
+/*
+ * takes events from the queue and marks subscribed tasks ready
+ */
+static void dispatch_events(uint32_t now) {
+	while (event_queue.tail != event_queue.head) {
+		uint32_t event_bit = SCHEDULER_EVENT_BIT(event_queue.events[event_queue.tail]);
+		event_queue.tail = (uint8_t)((event_queue.tail + 1) % SCHEDULER_EVENT_QUEUE_SIZE);
+
+		for (uint8_t i = 0; i < task_count; ++i) {
+			if ((tasks[i].config.event_mask & event_bit) && !tasks[i].event_ready) {
+				tasks[i].event_ready = 1;
+				tasks[i].release_tick = now;
+			}
+		}
+	}
+}
+
+/*
+ * runs task and updates its statistics
+ */
+static void run_task(scheduler_task_t *task, uint32_t release_tick) {
+	uint32_t start_cycles = DWT->CYCCNT;
+
+	task->config.run();
+
+	uint32_t cycles = DWT->CYCCNT - start_cycles;
+	uint32_t latency_ms = HAL_GetTick() - release_tick;
+	scheduler_task_stats_t *stats = &task->stats;
+
+	stats->runs++;
+	stats->last_cycles = cycles;
+	stats->total_cycles += cycles;
+	if (cycles > stats->max_cycles) {
+		stats->max_cycles = cycles;
+	}
+	if (latency_ms > stats->max_latency_ms) {
+		stats->max_latency_ms = latency_ms;
+	}
+	if (task->config.deadline_ms != 0 && latency_ms > task->config.deadline_ms) {
+		stats->deadline_misses++;
+	}
+}
+
+/*
+ * moves the periodic release of a task past now
+ */
+static void advance_release(scheduler_task_t *task, uint32_t now) {
+	task->next_release += task->config.period_ms;
+	if ((int32_t)(now - task->next_release) >= 0) {
+		/* fell behind by more than a period, skip the missed releases */
+		task->next_release = now + task->config.period_ms;
+	}
+}
@@ -0,0 +1,209 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sensor_filter.h"
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * fraction bits of the ema state and alpha
+ */
+static const uint8_t EMA_FRACTION_BITS = 8;
+
+/*
+ * checks window and alpha of a configuration
+ */
+static sensor_filter_status_t check_config(const sensor_filter_config_t *config);
+
+/*
+ * moves the newest count samples of the channel history to the start of the ring
+ */
+static void keep_newest(const sensor_filter_t *filter, sensor_filter_channel_t *channel, uint8_t count);
+
+/*
+ * adds sample to the channel history and returns filtered value
+ */
+static uint32_t filter_channel(sensor_filter_t *filter, sensor_filter_channel_t *channel, uint32_t sample);
+
+/*
+ * returns median of the samples kept in the channel history
+ */
+static uint32_t median(const sensor_filter_t *filter, const sensor_filter_channel_t *channel);
+
+/*
+ * checks configuration and clears filter history
+ */
+sensor_filter_status_t sensor_filter_init(sensor_filter_t *filter, const sensor_filter_config_t *config) {
+	assert(filter != NULL);
+	assert(config != NULL);
+
+	if (SENSOR_FILTER_STATUS_OK != check_config(config)) {
+		return SENSOR_FILTER_STATUS_INVALID_PARAMETERS;
+	}
+
+	filter->config = *config;
+	sensor_filter_reset(filter);
+
+	return SENSOR_FILTER_STATUS_OK;
+}
+
+/*
+ * changes configuration keeping the history.
+ * the newest samples that fit the new window stay, the ema state is kept
+ */
+sensor_filter_status_t sensor_filter_set_config(sensor_filter_t *filter, const sensor_filter_config_t *config) {
+	assert(filter != NULL);
+	assert(config != NULL);
+
+	if (SENSOR_FILTER_STATUS_OK != check_config(config)) {
+		return SENSOR_FILTER_STATUS_INVALID_PARAMETERS;
+	}
+
+	uint8_t count = (filter->count < config->window) ? filter->count : config->window;
+
+	keep_newest(filter, &filter->humidity, count);
+	keep_newest(filter, &filter->temperature, count);
+
+	filter->config = *config;
+	filter->count = count;
+	filter->head = (uint8_t)(count % config->window);
+
+	return SENSOR_FILTER_STATUS_OK;
+}
+
+/*
+ * clears filter history, next sample starts the filter again
+ */
+void sensor_filter_reset(sensor_filter_t *filter) {
+	assert(filter != NULL);
+
+	memset(&filter->humidity, 0, sizeof(filter->humidity));
+	memset(&filter->temperature, 0, sizeof(filter->temperature));
+	filter->head = 0;
+	filter->count = 0;
+}
+
+/*
+ * adds raw sample to the filter and writes filtered raw values
+ */
+void sensor_filter_push(sensor_filter_t *filter, uint32_t raw_humidity, uint32_t raw_temperature,
+						uint32_t *filtered_humidity, uint32_t *filtered_temperature) {
+	assert(filter != NULL);
+	assert(filtered_humidity != NULL);
+	assert(filtered_temperature != NULL);
+
+	if (filter->count < filter->config.window) {
+		filter->count++;
+	}
+
+	*filtered_humidity = filter_channel(filter, &filter->humidity, raw_humidity);
+	*filtered_temperature = filter_channel(filter, &filter->temperature, raw_temperature);
+
+	filter->head = (uint8_t)((filter->head + 1) % filter->config.window);
+}
+
+/*
+ * checks window and alpha of a configuration
+ */
+static sensor_filter_status_t check_config(const sensor_filter_config_t *config) {
+	if (config->window == 0 || config->window > SENSOR_FILTER_MAX_SAMPLES) {
+		return SENSOR_FILTER_STATUS_INVALID_PARAMETERS;
+	}
+
+	if (config->mode == SENSOR_FILTER_EMA && (config->ema_alpha == 0 || config->ema_alpha > (1U << EMA_FRACTION_BITS))) {
+		return SENSOR_FILTER_STATUS_INVALID_PARAMETERS;
+	}
+
+	return SENSOR_FILTER_STATUS_OK;
+}
+
+/*
+ * moves the newest count samples of the channel history to the start of the ring, oldest first.
+ * unused slots are cleared, filter_channel subtracts them from the sum when they are first written
+ */
+static void keep_newest(const sensor_filter_t *filter, sensor_filter_channel_t *channel, uint8_t count) {
+	uint32_t kept[SENSOR_FILTER_MAX_SAMPLES];
+	uint8_t window = filter->config.window;
+
+	channel->sum = 0;
+	for (uint8_t i = 0; i < count; ++i) {
+		kept[i] = channel->samples[(filter->head + window - count + i) % window];
+		channel->sum += kept[i];
+	}
+
+	memset(channel->samples, 0, sizeof(channel->samples));
+	memcpy(channel->samples, kept, count * sizeof(kept[0]));
+}
+
+/*
+ * adds sample to the channel history and returns filtered value.
+ * the sample replaced in the ring buffer is removed from the running sum,
+ * so moving average costs the same for any window
+ */
+static uint32_t filter_channel(sensor_filter_t *filter, sensor_filter_channel_t *channel, uint32_t sample) {
+	/* count was already increased, a slot is reused once the window is full */
+	channel->sum -= channel->samples[filter->head];
+	channel->samples[filter->head] = sample;
+	channel->sum += sample;
+
+	switch (filter->config.mode) {
+	case SENSOR_FILTER_MOVING_AVERAGE:
+		return (channel->sum + filter->count / 2U) / filter->count;
+	case SENSOR_FILTER_MEDIAN:
+		return median(filter, channel);
+	case SENSOR_FILTER_EMA:
+		if (filter->count == 1) {
+			channel->ema = sample << EMA_FRACTION_BITS;
+		} else {
+			int64_t error = (int64_t)(sample << EMA_FRACTION_BITS) - (int64_t)channel->ema;
+			channel->ema = (uint32_t)((int64_t)channel->ema + ((error * filter->config.ema_alpha) >> EMA_FRACTION_BITS));
+		}
+		return (channel->ema + (1U << (EMA_FRACTION_BITS - 1))) >> EMA_FRACTION_BITS;
+	case SENSOR_FILTER_NONE:
+	default:
+		return sample;
+	}
+}
+
+/*
+ * returns median of the samples kept in the channel history.
+ * insertion sort on a copy, window is at most SENSOR_FILTER_MAX_SAMPLES
+ */
+static uint32_t median(const sensor_filter_t *filter, const sensor_filter_channel_t *channel) {
+	uint32_t sorted[SENSOR_FILTER_MAX_SAMPLES];
+	uint8_t count = filter->count;
+
+	for (uint8_t i = 0; i < count; ++i) {
+		uint32_t value = channel->samples[i];
+		uint8_t j = i;
+
+		while (j > 0 && sorted[j - 1] > value) {
+			sorted[j] = sorted[j - 1];
+			--j;
+		}
+		sorted[j] = value;
+	}
+
+	if (count % 2U) {
+		return sorted[count / 2U];
+	}
+
+	return (sorted[count / 2U - 1U] + sorted[count / 2U] + 1U) / 2U;
+}
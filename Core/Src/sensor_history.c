@@ -0,0 +1,286 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sensor_history.h"
+#include <assert.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * bytes of one packed sample: 20 bit humidity followed by 20 bit temperature, as in the sensor frame
+ */
+#define PACKED_SAMPLE_SIZE 5
+
+/*
+ * number of summary blocks
+ */
+#define BLOCK_COUNT (SENSOR_HISTORY_CAPACITY / SENSOR_HISTORY_BLOCK_SIZE)
+
+static_assert(SENSOR_HISTORY_CAPACITY % SENSOR_HISTORY_BLOCK_SIZE == 0, "capacity must be a multiple of the block size");
+
+/*
+ * time delta unit and largest stored delta
+ */
+static const uint32_t DELTA_UNIT_MS = 1000;
+static const uint32_t MAX_DELTA = 255;
+
+/*
+ * mask of a 20 bit raw value
+ */
+static const uint32_t RAW_MASK = 0xFFFFF;
+
+/*
+ * struct for holding statistics of one block and its start time
+ */
+typedef struct {
+	uint32_t start_time_ms;
+	uint32_t min_humidity;
+	uint32_t max_humidity;
+	uint32_t sum_humidity;
+	uint32_t min_temperature;
+	uint32_t max_temperature;
+	uint32_t sum_temperature;
+} block_summary_t;
+
+/*
+ * packed samples, time deltas to the previous sample in seconds and block summaries.
+ * the first sample of a block has delta 0, its time is the block start time
+ */
+static uint8_t packed[SENSOR_HISTORY_CAPACITY * PACKED_SAMPLE_SIZE];
+static uint8_t deltas[SENSOR_HISTORY_CAPACITY];
+static block_summary_t blocks[BLOCK_COUNT];
+
+/*
+ * physical index of the oldest sample, number of samples and stored time of the newest sample.
+ * deltas are taken from the stored time, rounding errors don't add up within a block
+ */
+static uint32_t tail = 0;
+static uint32_t count = 0;
+static uint32_t last_time_ms = 0;
+
+/*
+ * reads packed raw values at physical index
+ */
+static void unpack(uint32_t position, uint32_t *raw_humidity, uint32_t *raw_temperature);
+
+/*
+ * adds statistics of samples at physical positions [position, position + length) to summary, scanning them.
+ * the samples must not cross a block boundary
+ */
+static void scan(uint32_t position, uint32_t length, sensor_history_summary_t *summary, uint64_t *sum_humidity, uint64_t *sum_temperature);
+
+/*
+ * removes all samples
+ */
+void sensor_history_reset(void) {
+	tail = 0;
+	count = 0;
+}
+
+/*
+ * adds sample, drops the oldest block when full. constant time
+ */
+void sensor_history_append(uint32_t raw_humidity, uint32_t raw_temperature, uint32_t time_ms) {
+	uint32_t position = (tail + count) % SENSOR_HISTORY_CAPACITY;
+	block_summary_t *block = &blocks[position / SENSOR_HISTORY_BLOCK_SIZE];
+
+	raw_humidity &= RAW_MASK;
+	raw_temperature &= RAW_MASK;
+
+	/* a full history drops the block about to be reused */
+	if (count == SENSOR_HISTORY_CAPACITY) {
+		tail = (tail + SENSOR_HISTORY_BLOCK_SIZE) % SENSOR_HISTORY_CAPACITY;
+		count -= SENSOR_HISTORY_BLOCK_SIZE;
+	}
+
+	if (position % SENSOR_HISTORY_BLOCK_SIZE == 0) {
+		*block = (block_summary_t) {
+			.start_time_ms = time_ms,
+			.min_humidity = raw_humidity,
+			.max_humidity = raw_humidity,
+			.min_temperature = raw_temperature,
+			.max_temperature = raw_temperature,
+		};
+		deltas[position] = 0;
+	} else {
+		uint32_t delta = (time_ms - last_time_ms + DELTA_UNIT_MS / 2) / DELTA_UNIT_MS;
+		if (delta > MAX_DELTA) {
+			delta = MAX_DELTA;
+		}
+		deltas[position] = (uint8_t)delta;
+		time_ms = last_time_ms + delta * DELTA_UNIT_MS;
+
+		if (raw_humidity < block->min_humidity) {
+			block->min_humidity = raw_humidity;
+		}
+		if (raw_humidity > block->max_humidity) {
+			block->max_humidity = raw_humidity;
+		}
+		if (raw_temperature < block->min_temperature) {
+			block->min_temperature = raw_temperature;
+		}
+		if (raw_temperature > block->max_temperature) {
+			block->max_temperature = raw_temperature;
+		}
+	}
+	block->sum_humidity += raw_humidity;
+	block->sum_temperature += raw_temperature;
+
+	uint8_t *bytes = &packed[position * PACKED_SAMPLE_SIZE];
+	bytes[0] = (uint8_t)(raw_humidity >> 12);
+	bytes[1] = (uint8_t)(raw_humidity >> 4);
+	bytes[2] = (uint8_t)((raw_humidity << 4) | (raw_temperature >> 16));
+	bytes[3] = (uint8_t)(raw_temperature >> 8);
+	bytes[4] = (uint8_t)raw_temperature;
+
+	last_time_ms = time_ms;
+	count++;
+}
+
+/*
+ * returns number of samples kept
+ */
+uint32_t sensor_history_count(void) {
+	return count;
+}
+
+/*
+ * reads sample by index, 0 is the oldest.
+ * time is rebuilt from the block start time and the deltas before the sample in its block,
+ * at most SENSOR_HISTORY_BLOCK_SIZE - 1 of them. a 16 bit offset per sample would make this
+ * constant time for 8 KB more, one byte per sample keeps the history at 48 KB
+ */
+sensor_history_status_t sensor_history_get(uint32_t index, sensor_history_sample_t *sample) {
+	assert(sample != NULL);
+
+	if (index >= count) {
+		return SENSOR_HISTORY_STATUS_INVALID_PARAMETERS;
+	}
+
+	uint32_t position = (tail + index) % SENSOR_HISTORY_CAPACITY;
+	uint32_t block_start = position - position % SENSOR_HISTORY_BLOCK_SIZE;
+	uint32_t time_ms = blocks[block_start / SENSOR_HISTORY_BLOCK_SIZE].start_time_ms;
+
+	for (uint32_t i = block_start + 1; i <= position; ++i) {
+		time_ms += deltas[i] * DELTA_UNIT_MS;
+	}
+
+	unpack(position, &sample->raw_humidity, &sample->raw_temperature);
+	sample->time_ms = time_ms;
+
+	return SENSOR_HISTORY_STATUS_OK;
+}
+
+/*
+ * computes min, max and mean of count samples starting at index first
+ */
+sensor_history_status_t sensor_history_query(uint32_t first, uint32_t length, sensor_history_summary_t *summary) {
+	assert(summary != NULL);
+
+	if (length == 0 || first >= count || length > count - first) {
+		return SENSOR_HISTORY_STATUS_INVALID_PARAMETERS;
+	}
+
+	uint64_t sum_humidity = 0;
+	uint64_t sum_temperature = 0;
+
+	*summary = (sensor_history_summary_t) {
+		.min_humidity = RAW_MASK,
+		.min_temperature = RAW_MASK,
+	};
+
+	while (length > 0) {
+		uint32_t position = (tail + first) % SENSOR_HISTORY_CAPACITY;
+		uint32_t offset = position % SENSOR_HISTORY_BLOCK_SIZE;
+		uint32_t in_block = SENSOR_HISTORY_BLOCK_SIZE - offset;
+		uint32_t block_length = (length < in_block) ? length : in_block;
+
+		/* a window covering a whole block is answered by its summary. the block of the newest
+		   sample is partial until full, its summary only covers what was appended */
+		if (offset == 0 && block_length == SENSOR_HISTORY_BLOCK_SIZE) {
+			const block_summary_t *block = &blocks[position / SENSOR_HISTORY_BLOCK_SIZE];
+
+			if (block->min_humidity < summary->min_humidity) {
+				summary->min_humidity = block->min_humidity;
+			}
+			if (block->max_humidity > summary->max_humidity) {
+				summary->max_humidity = block->max_humidity;
+			}
+			if (block->min_temperature < summary->min_temperature) {
+				summary->min_temperature = block->min_temperature;
+			}
+			if (block->max_temperature > summary->max_temperature) {
+				summary->max_temperature = block->max_temperature;
+			}
+			sum_humidity += block->sum_humidity;
+			sum_temperature += block->sum_temperature;
+			summary->count += SENSOR_HISTORY_BLOCK_SIZE;
+		} else {
+			scan(position, block_length, summary, &sum_humidity, &sum_temperature);
+		}
+
+		first += block_length;
+		length -= block_length;
+	}
+
+	summary->mean_humidity = (uint32_t)(sum_humidity / summary->count);
+	summary->mean_temperature = (uint32_t)(sum_temperature / summary->count);
+
+	return SENSOR_HISTORY_STATUS_OK;
+}
+
+/*
+ * reads packed raw values at physical index
+ */
+static void unpack(uint32_t position, uint32_t *raw_humidity, uint32_t *raw_temperature) {
+	const uint8_t *bytes = &packed[position * PACKED_SAMPLE_SIZE];
+
+	*raw_humidity = ((uint32_t)bytes[0] << 12) | ((uint32_t)bytes[1] << 4) | (bytes[2] >> 4);
+	*raw_temperature = ((uint32_t)(bytes[2] & 0x0F) << 16) | ((uint32_t)bytes[3] << 8) | bytes[4];
+}
+
+/*
+ * adds statistics of samples at physical positions [position, position + length) to summary, scanning them.
+ * the samples must not cross a block boundary
+ */
+static void scan(uint32_t position, uint32_t length, sensor_history_summary_t *summary, uint64_t *sum_humidity, uint64_t *sum_temperature) {
+	for (uint32_t i = position; i < position + length; ++i) {
+		uint32_t raw_humidity = 0;
+		uint32_t raw_temperature = 0;
+
+		unpack(i, &raw_humidity, &raw_temperature);
+
+		if (raw_humidity < summary->min_humidity) {
+			summary->min_humidity = raw_humidity;
+		}
+		if (raw_humidity > summary->max_humidity) {
+			summary->max_humidity = raw_humidity;
+		}
+		if (raw_temperature < summary->min_temperature) {
+			summary->min_temperature = raw_temperature;
+		}
+		if (raw_temperature > summary->max_temperature) {
+			summary->max_temperature = raw_temperature;
+		}
+		*sum_humidity += raw_humidity;
+		*sum_temperature += raw_temperature;
+	}
+
+	summary->count += length;
+}
@@ -0,0 +1,175 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "telemetry_frame.h"
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * computes CRC-16/CCITT-FALSE of data
+ */
+static uint16_t crc16(const uint8_t *data, uint16_t length);
+
+/*
+ * writes little endian values
+ */
+static inline uint8_t *put_u16(uint8_t *out, uint16_t value) {
+	out[0] = (uint8_t)value;
+	out[1] = (uint8_t)(value >> 8);
+	return out + 2;
+}
+
+static inline uint8_t *put_u32(uint8_t *out, uint32_t value) {
+	out = put_u16(out, (uint16_t)value);
+	return put_u16(out, (uint16_t)(value >> 16));
+}
+
+/*
+ * reads little endian values
+ */
+static inline uint16_t get_u16(const uint8_t *in) {
+	return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static inline uint32_t get_u32(const uint8_t *in) {
+	return get_u16(in) | ((uint32_t)get_u16(in + 2) << 16);
+}
+
+/*
+ * writes COBS encoded frame with CRC and zero delimiter to out.
+ * COBS replaces every zero with the distance to the next one, so zero only marks frame ends
+ * and a receiver resynchronizes at the next delimiter after a lost byte
+ */
+uint16_t telemetry_frame_encode(const telemetry_sample_t *sample, uint8_t *out, uint16_t capacity) {
+	assert(sample != NULL);
+	assert(out != NULL);
+
+	if (capacity < TELEMETRY_FRAME_MAX_SIZE) {
+		return 0;
+	}
+
+	uint8_t payload[TELEMETRY_FRAME_PAYLOAD_SIZE];
+	uint8_t *position = payload;
+
+	*position++ = TELEMETRY_FRAME_SAMPLE;
+	position = put_u16(position, sample->sequence);
+	position = put_u32(position, sample->time_ms);
+	memcpy(position, sample->raw, TELEMETRY_RAW_FRAME_SIZE);
+	position += TELEMETRY_RAW_FRAME_SIZE;
+	position = put_u16(position, (uint16_t)sample->temperature_centi);
+	position = put_u16(position, (uint16_t)sample->humidity_centi);
+	*position++ = sample->flags;
+	put_u16(position, crc16(payload, (uint16_t)(position - payload)));
+
+	uint16_t code_index = 0;
+	uint16_t length = 1;
+	uint8_t code = 1;
+
+	for (uint16_t i = 0; i < TELEMETRY_FRAME_PAYLOAD_SIZE; ++i) {
+		if (payload[i] != 0) {
+			out[length++] = payload[i];
+			code++;
+		}
+		if (payload[i] == 0 || code == 0xFF) {
+			out[code_index] = code;
+			code_index = length++;
+			code = 1;
+		}
+	}
+	out[code_index] = code;
+	out[length++] = 0;
+
+	return length;
+}
+
+/*
+ * decodes one frame received between zero delimiters
+ */
+telemetry_frame_status_t telemetry_frame_decode(const uint8_t *frame, uint16_t length, telemetry_sample_t *sample) {
+	assert(frame != NULL);
+	assert(sample != NULL);
+
+	uint8_t payload[TELEMETRY_FRAME_PAYLOAD_SIZE];
+	uint16_t decoded = 0;
+	uint16_t i = 0;
+
+	while (i < length) {
+		uint8_t code = frame[i++];
+		if (code == 0 || i + code - 1 > length) {
+			return TELEMETRY_FRAME_STATUS_BAD_FRAMING;
+		}
+		for (uint8_t j = 1; j < code; ++j) {
+			if (frame[i] == 0 || decoded == TELEMETRY_FRAME_PAYLOAD_SIZE) {
+				return TELEMETRY_FRAME_STATUS_BAD_FRAMING;
+			}
+			payload[decoded++] = frame[i++];
+		}
+		if (code != 0xFF && i < length) {
+			if (decoded == TELEMETRY_FRAME_PAYLOAD_SIZE) {
+				return TELEMETRY_FRAME_STATUS_BAD_FRAMING;
+			}
+			payload[decoded++] = 0;
+		}
+	}
+
+	if (decoded != TELEMETRY_FRAME_PAYLOAD_SIZE) {
+		return TELEMETRY_FRAME_STATUS_BAD_FRAMING;
+	}
+
+	if (crc16(payload, TELEMETRY_FRAME_PAYLOAD_SIZE - 2) != get_u16(payload + TELEMETRY_FRAME_PAYLOAD_SIZE - 2)) {
+		return TELEMETRY_FRAME_STATUS_BAD_CRC;
+	}
+
+	if (payload[0] != TELEMETRY_FRAME_SAMPLE) {
+		return TELEMETRY_FRAME_STATUS_BAD_TYPE;
+	}
+
+	const uint8_t *position = payload + 1;
+
+	sample->sequence = get_u16(position);
+	position += 2;
+	sample->time_ms = get_u32(position);
+	position += 4;
+	memcpy(sample->raw, position, TELEMETRY_RAW_FRAME_SIZE);
+	position += TELEMETRY_RAW_FRAME_SIZE;
+	sample->temperature_centi = (int16_t)get_u16(position);
+	position += 2;
+	sample->humidity_centi = (int16_t)get_u16(position);
+	position += 2;
+	sample->flags = *position;
+
+	return TELEMETRY_FRAME_STATUS_OK;
+}
+
+/*
+ * computes CRC-16/CCITT-FALSE of data, bit by bit, frames are short
+ */
+static uint16_t crc16(const uint8_t *data, uint16_t length) {
+	uint16_t crc = 0xFFFF;
+
+	for (uint16_t i = 0; i < length; ++i) {
+		crc ^= (uint16_t)(data[i] << 8);
+		for (uint8_t bit = 0; bit < 8; ++bit) {
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+
+	return crc;
+}
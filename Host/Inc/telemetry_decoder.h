@@ -0,0 +1,89 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "telemetry_frame.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * enum for status returns
+ */
+typedef enum {
+	TELEMETRY_DECODER_STATUS_OK = 1,
+	TELEMETRY_DECODER_STATUS_INVALID_PARAMETERS,
+	TELEMETRY_DECODER_STATUS_PORT_ERROR,
+} telemetry_decoder_status_t;
+
+/*
+ * function called for every good sample frame
+ */
+typedef void (*telemetry_decoder_fn_t)(const telemetry_sample_t *sample, void *context);
+
+/*
+ * struct for holding receive counters.
+ * lost frames are sequence gaps: frames dropped by the device or damaged on the line
+ */
+typedef struct {
+	uint32_t bytes;
+	uint32_t frames;
+	uint32_t bad_framing;
+	uint32_t bad_crc;
+	uint32_t bad_type;
+	uint32_t oversized;
+	uint32_t lost_frames;
+} telemetry_decoder_stats_t;
+
+/*
+ * struct for holding decoder state: the frame collected since the last delimiter
+ * and the sequence number expected next
+ */
+typedef struct {
+	uint8_t frame[TELEMETRY_FRAME_MAX_SIZE];
+	uint16_t length;
+	bool oversized;
+	bool synchronized;
+	bool has_sequence;
+	uint16_t next_sequence;
+	telemetry_decoder_fn_t on_sample;
+	void *context;
+	telemetry_decoder_stats_t stats;
+} telemetry_decoder_t;
+
+/*
+ * starts decoding a stream, on_sample is called for every good frame.
+ * bytes before the first delimiter belong to a frame started before the stream was opened and are dropped
+ */
+telemetry_decoder_status_t telemetry_decoder_init(telemetry_decoder_t *decoder, telemetry_decoder_fn_t on_sample, void *context);
+
+/*
+ * feeds received bytes in any chunks, returns number of good frames among them
+ */
+uint32_t telemetry_decoder_feed(telemetry_decoder_t *decoder, const uint8_t *data, size_t length);
+
+/*
+ * copies receive counters
+ */
+void telemetry_decoder_get_stats(const telemetry_decoder_t *decoder, telemetry_decoder_stats_t *stats);
+
+/*
+ * opens a serial port or a pseudo-terminal raw, 8N1 at baud_rate, reads don't block.
+ * returns the file descriptor in fd
+ */
+telemetry_decoder_status_t telemetry_decoder_open_port(const char *path, uint32_t baud_rate, int *fd);
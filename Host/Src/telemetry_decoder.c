@@ -0,0 +1,188 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "telemetry_decoder.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+/*
+ * termios speeds of the supported rates
+ */
+static const struct {
+	uint32_t baud_rate;
+	speed_t speed;
+} SPEEDS[] = {
+	{9600, B9600},
+	{19200, B19200},
+	{38400, B38400},
+	{57600, B57600},
+	{115200, B115200},
+	{230400, B230400},
+	{460800, B460800},
+	{921600, B921600},
+};
+
+/*
+ * decodes the collected frame and checks its sequence number
+ */
+static void end_frame(telemetry_decoder_t *decoder);
+
+/*
+ * starts decoding a stream
+ */
+telemetry_decoder_status_t telemetry_decoder_init(telemetry_decoder_t *decoder, telemetry_decoder_fn_t on_sample, void *context) {
+	if (decoder == NULL || on_sample == NULL) {
+		return TELEMETRY_DECODER_STATUS_INVALID_PARAMETERS;
+	}
+
+	*decoder = (telemetry_decoder_t) {
+		.on_sample = on_sample,
+		.context = context,
+	};
+
+	return TELEMETRY_DECODER_STATUS_OK;
+}
+
+/*
+ * feeds received bytes, frames end at zero delimiters
+ */
+uint32_t telemetry_decoder_feed(telemetry_decoder_t *decoder, const uint8_t *data, size_t length) {
+	assert(decoder != NULL);
+	assert(data != NULL || length == 0);
+
+	uint32_t frames = decoder->stats.frames;
+
+	for (size_t i = 0; i < length; ++i) {
+		decoder->stats.bytes++;
+
+		if (data[i] == 0) {
+			end_frame(decoder);
+		} else if (decoder->length < sizeof(decoder->frame)) {
+			decoder->frame[decoder->length++] = data[i];
+		} else {
+			/* no delimiter where a frame must have ended, drop everything up to the next one */
+			decoder->oversized = true;
+		}
+	}
+
+	return decoder->stats.frames - frames;
+}
+
+/*
+ * copies receive counters
+ */
+void telemetry_decoder_get_stats(const telemetry_decoder_t *decoder, telemetry_decoder_stats_t *stats) {
+	assert(decoder != NULL);
+	assert(stats != NULL);
+
+	*stats = decoder->stats;
+}
+
+/*
+ * opens a serial port or a pseudo-terminal raw, 8N1 at baud_rate, reads don't block
+ */
+telemetry_decoder_status_t telemetry_decoder_open_port(const char *path, uint32_t baud_rate, int *fd) {
+	if (path == NULL || fd == NULL) {
+		return TELEMETRY_DECODER_STATUS_INVALID_PARAMETERS;
+	}
+
+	speed_t speed = B0;
+	for (size_t i = 0; i < sizeof(SPEEDS) / sizeof(SPEEDS[0]); ++i) {
+		if (SPEEDS[i].baud_rate == baud_rate) {
+			speed = SPEEDS[i].speed;
+		}
+	}
+	if (speed == B0) {
+		return TELEMETRY_DECODER_STATUS_INVALID_PARAMETERS;
+	}
+
+	int port = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (port < 0) {
+		return TELEMETRY_DECODER_STATUS_PORT_ERROR;
+	}
+
+	struct termios settings;
+	if (tcgetattr(port, &settings) != 0) {
+		close(port);
+		return TELEMETRY_DECODER_STATUS_PORT_ERROR;
+	}
+
+	cfmakeraw(&settings);
+	settings.c_cflag |= CLOCAL | CREAD;
+	settings.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+	cfsetispeed(&settings, speed);
+	cfsetospeed(&settings, speed);
+
+	if (tcsetattr(port, TCSANOW, &settings) != 0) {
+		close(port);
+		return TELEMETRY_DECODER_STATUS_PORT_ERROR;
+	}
+
+	*fd = port;
+
+	return TELEMETRY_DECODER_STATUS_OK;
+}
+
+/*
+ * decodes the collected frame and checks its sequence number.
+ * an empty frame is a delimiter following another one and isn't counted
+ */
+static void end_frame(telemetry_decoder_t *decoder) {
+	bool synchronized = decoder->synchronized;
+	bool oversized = decoder->oversized;
+	uint16_t length = decoder->length;
+
+	decoder->synchronized = true;
+	decoder->oversized = false;
+	decoder->length = 0;
+
+	if (!synchronized || length == 0) {
+		return;
+	}
+
+	if (oversized) {
+		decoder->stats.oversized++;
+		return;
+	}
+
+	telemetry_sample_t sample;
+	switch (telemetry_frame_decode(decoder->frame, length, &sample)) {
+	case TELEMETRY_FRAME_STATUS_OK:
+		break;
+	case TELEMETRY_FRAME_STATUS_BAD_CRC:
+		decoder->stats.bad_crc++;
+		return;
+	case TELEMETRY_FRAME_STATUS_BAD_TYPE:
+		decoder->stats.bad_type++;
+		return;
+	default:
+		decoder->stats.bad_framing++;
+		return;
+	}
+
+	if (decoder->has_sequence) {
+		decoder->stats.lost_frames += (uint16_t)(sample.sequence - decoder->next_sequence);
+	}
+	decoder->has_sequence = true;
+	decoder->next_sequence = (uint16_t)(sample.sequence + 1);
+	decoder->stats.frames++;
+
+	decoder->on_sample(&sample, decoder->context);
+}
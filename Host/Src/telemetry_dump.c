@@ -0,0 +1,78 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * prints telemetry samples received on a serial port as CSV, counters go to stderr at the end.
+ * usage: telemetry_dump <port> [baud rate], the device sends at 921600, or at 115200
+ * when its clock can't reach that rate
+ */
+
+#include "telemetry_decoder.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const uint32_t DEFAULT_BAUD_RATE = 921600;
+
+/*
+ * prints one sample
+ */
+static void print_sample(const telemetry_sample_t *sample, void *context) {
+	(void)context;
+
+	printf("%u,%lu,%.2f,%.2f,0x%02X\n", sample->sequence, (unsigned long)sample->time_ms,
+			sample->temperature_centi / 100.0, sample->humidity_centi / 100.0, sample->flags);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "usage: %s <port> [baud rate]\n", argv[0]);
+		return 2;
+	}
+
+	uint32_t baud_rate = (argc == 3) ? (uint32_t)strtoul(argv[2], NULL, 10) : DEFAULT_BAUD_RATE;
+	int fd = -1;
+	if (TELEMETRY_DECODER_STATUS_OK != telemetry_decoder_open_port(argv[1], baud_rate, &fd)) {
+		fprintf(stderr, "can't open %s at %lu baud\n", argv[1], (unsigned long)baud_rate);
+		return 1;
+	}
+
+	telemetry_decoder_t decoder;
+	telemetry_decoder_init(&decoder, print_sample, NULL);
+	printf("sequence,time_ms,temperature_c,humidity_percent,flags\n");
+
+	uint8_t data[4096];
+	struct pollfd input = {.fd = fd, .events = POLLIN};
+	while (poll(&input, 1, -1) > 0 && !(input.revents & (POLLERR | POLLHUP))) {
+		ssize_t length = read(fd, data, sizeof(data));
+		if (length > 0) {
+			telemetry_decoder_feed(&decoder, data, (size_t)length);
+			fflush(stdout);
+		}
+	}
+
+	telemetry_decoder_stats_t stats;
+	telemetry_decoder_get_stats(&decoder, &stats);
+	fprintf(stderr, "%lu bytes, %lu frames, %lu lost, %lu bad crc, %lu bad framing, %lu oversized\n",
+			(unsigned long)stats.bytes, (unsigned long)stats.frames, (unsigned long)stats.lost_frames,
+			(unsigned long)stats.bad_crc, (unsigned long)stats.bad_framing, (unsigned long)stats.oversized);
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * host simulation of the STM32F446 board: the firmware and the HAL run unchanged
+ * against simulated peripherals, a virtual AHT20 on I2C1 and the multi-function
+ * shield (74HC595 chain behind SPI1, buttons, LED). register accesses trap into
+ * the peripheral models, simulated time advances with every access and intrinsic
+ * and jumps ahead while the core sleeps
+ */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * simulated time unit, 1/336 MHz, an exact multiple of every bus clock used
+ */
+#define SIM_CLOCK_HZ 336000000ULL
+#define SIM_UNITS_PER_US (SIM_CLOCK_HZ / 1000000ULL)
+#define SIM_UNITS_PER_MS (SIM_CLOCK_HZ / 1000ULL)
+
+/*
+ * state of the firmware context
+ */
+typedef enum {
+	SIM_STATE_IDLE = 1,
+	SIM_STATE_RUNNING,
+	SIM_STATE_RETURNED,
+} sim_state_t;
+
+/*
+ * buttons of the shield and of the nucleo board, active low
+ */
+typedef enum {
+	SIM_BUTTON_A = 0,
+	SIM_BUTTON_B,
+	SIM_BUTTON_USER,
+	SIM_BUTTON_COUNT,
+} sim_button_t;
+
+/*
+ * time spent by the core in each power mode, in simulated time units
+ */
+typedef struct {
+	uint64_t run;
+	uint64_t sleep;
+	uint64_t stop;
+	uint32_t stop_entries;
+	uint32_t sleep_entries;
+} sim_power_stats_t;
+
+/*
+ * virtual AHT20: environment and fault injection knobs, read at every transaction
+ */
+typedef struct {
+	int32_t temperature_centi;
+	int32_t humidity_centi;
+	uint32_t conversion_ms;
+	bool absent;            /* address is not acknowledged */
+	bool stuck_busy;        /* conversions never finish */
+	bool calibrated;        /* calibration bit after power up */
+	uint32_t bad_crc_frames;   /* next frames read with a wrong checksum */
+	uint32_t hold_sda_clocks;  /* sda held low until this many scl pulses, 0 releases */
+} sim_aht20_t;
+
+/*
+ * counters of the virtual AHT20
+ */
+typedef struct {
+	uint32_t power_cycles;
+	uint32_t measurements;
+	uint32_t frames_read;
+	uint32_t soft_resets;
+	uint32_t nacks;
+	uint32_t bus_time_us;
+} sim_aht20_stats_t;
+
+/*
+ * what the display showed during the last complete refresh window:
+ * active-low segment codes (same encoding as char_gen_glyph, 0xFF blank)
+ * and the on time of each segment in 1/65536 of the window
+ */
+typedef struct {
+	uint8_t code[4];
+	uint16_t duty[4][8];
+	bool refreshing;
+} sim_display_t;
+
+/*
+ * counters of the flash memory model
+ */
+typedef struct {
+	uint32_t sector_erases;
+	uint32_t words_programmed;
+	uint32_t program_errors;
+	uint64_t stall_units;
+} sim_flash_stats_t;
+
+/*
+ * maps the simulated memory, installs the traps and resets every peripheral;
+ * called once per process before anything touches a register
+ */
+void sim_init(void);
+
+/*
+ * prepares entry to run on the firmware stack, it starts at the first sim_run_* call.
+ * the stack lives in the low 4 GB, so buffers on it can be handed to the DMA
+ */
+void sim_start(void (*entry)(void));
+
+/*
+ * boots the firmware: reset handler work (SystemInit) followed by main
+ */
+void sim_boot(void);
+
+/*
+ * runs the firmware for the given simulated time; without a started context the
+ * peripherals alone advance, interrupts run on the caller's stack
+ */
+sim_state_t sim_run_ms(uint32_t ms);
+sim_state_t sim_run_us(uint32_t us);
+
+/*
+ * runs until condition returns true or timeout_ms elapses, checking every millisecond
+ */
+bool sim_run_until(bool (*condition)(void), uint32_t timeout_ms);
+
+/*
+ * return value of main once the state is SIM_STATE_RETURNED
+ */
+int sim_exit_code(void);
+
+/*
+ * simulated time since sim_init
+ */
+uint64_t sim_time(void);
+uint32_t sim_time_ms(void);
+
+/*
+ * host cpu time charged to the firmware: every nanosecond spent in firmware code
+ * between two simulated points costs cycles_per_ns core cycles, 0 (default) keeps
+ * the run deterministic and only charges the fixed cost of register accesses
+ */
+void sim_set_cpu_scale(double cycles_per_ns);
+
+void sim_power_get_stats(sim_power_stats_t *stats);
+
+sim_aht20_t *sim_aht20(void);
+void sim_aht20_get_stats(sim_aht20_stats_t *stats);
+
+void sim_button_set(sim_button_t button, bool pressed);
+
+/*
+ * level driven on an output pin, port is 'A'..'H'
+ */
+bool sim_gpio_output(char port, uint8_t pin);
+
+void sim_display_read(sim_display_t *display);
+
+/*
+ * words seen by the 74HC595 chain: one shifted in by SPI1, the content of the
+ * shift register moved to the outputs by the latch edge
+ */
+typedef enum {
+	SIM_DISPLAY_SHIFTED = 1,
+	SIM_DISPLAY_LATCHED,
+} sim_display_event_t;
+
+/*
+ * sink receiving every shifted and latched word, NULL removes it
+ */
+void sim_display_set_sink(void (*sink)(sim_display_event_t event, uint16_t word, uint64_t time, void *context), void *context);
+
+/*
+ * bytes sent by USART2 since the last call, with the time the stop bit of the
+ * last one ended
+ */
+size_t sim_uart_read(uint8_t *data, size_t size, uint64_t *last_time);
+
+/*
+ * sink receiving each byte as its stop bit ends, replaces the internal buffer
+ */
+void sim_uart_set_sink(void (*sink)(uint8_t byte, uint64_t time, void *context), void *context);
+
+/*
+ * direct view of the flash memory array at a bus address, for seeding images
+ * and inspecting what the firmware wrote
+ */
+uint8_t *sim_flash_at(uint32_t address);
+void sim_flash_get_stats(sim_flash_stats_t *stats);
+
+/*
+ * LSI frequency, the RTC and the wakeup timer run from it
+ */
+void sim_set_lsi_hz(uint32_t hz);
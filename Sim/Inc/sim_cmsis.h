@@ -0,0 +1,116 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * compiler and core intrinsics for the host build, replacing cmsis_gcc.h.
+ * the intrinsics that change the core state (interrupt mask, sleep, barriers,
+ * exclusive access) are calls into the simulated core, so every one of them is
+ * a point where simulated time advances and pending interrupts are taken
+ */
+
+#pragma once
+#include <stdint.h>
+
+#define __CMSIS_GCC_H
+
+#ifndef __has_builtin
+#define __has_builtin(x) (0)
+#endif
+
+#define __ASM __asm
+#define __INLINE inline
+#define __STATIC_INLINE static inline
+#define __STATIC_FORCEINLINE __attribute__((always_inline)) static inline
+#define __NO_RETURN __attribute__((__noreturn__))
+#define __USED __attribute__((used))
+#define __WEAK __attribute__((weak))
+#define __PACKED __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x) __attribute__((aligned(x)))
+#define __RESTRICT __restrict
+#define __COMPILER_BARRIER() __ASM volatile("" ::: "memory")
+
+#define __UNALIGNED_UINT16_READ(addr) (*(const uint16_t *)(const void *)(addr))
+#define __UNALIGNED_UINT16_WRITE(addr, val) ((void)(*(uint16_t *)(void *)(addr) = (val)))
+#define __UNALIGNED_UINT32_READ(addr) (*(const uint32_t *)(const void *)(addr))
+#define __UNALIGNED_UINT32_WRITE(addr, val) ((void)(*(uint32_t *)(void *)(addr) = (val)))
+
+/*
+ * simulated core, implemented in Sim/Src/sim_core.c
+ */
+void sim_core_barrier(void);
+void sim_core_wfi(void);
+void sim_core_wfe(void);
+void sim_core_sev(void);
+void sim_core_set_primask(uint32_t primask);
+uint32_t sim_core_get_primask(void);
+uint8_t sim_core_ldrexb(volatile uint8_t *address);
+uint32_t sim_core_strexb(uint8_t value, volatile uint8_t *address);
+void sim_core_clrex(void);
+
+#define __NOP() sim_core_barrier()
+#define __DSB() sim_core_barrier()
+#define __ISB() sim_core_barrier()
+#define __DMB() sim_core_barrier()
+#define __WFI() sim_core_wfi()
+#define __WFE() sim_core_wfe()
+#define __SEV() sim_core_sev()
+#define __BKPT(value) __builtin_trap()
+#define __CLREX() sim_core_clrex()
+#define __LDREXB(address) sim_core_ldrexb(address)
+#define __STREXB(value, address) sim_core_strexb((value), (address))
+
+__STATIC_FORCEINLINE void __enable_irq(void) {
+	sim_core_set_primask(0);
+}
+
+__STATIC_FORCEINLINE void __disable_irq(void) {
+	sim_core_set_primask(1);
+}
+
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void) {
+	return sim_core_get_primask();
+}
+
+__STATIC_FORCEINLINE void __set_PRIMASK(uint32_t priMask) {
+	sim_core_set_primask(priMask & 1U);
+}
+
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value) {
+	return __builtin_bswap32(value);
+}
+
+__STATIC_FORCEINLINE uint32_t __REV16(uint32_t value) {
+	return ((value & 0xFF00FF00U) >> 8) | ((value & 0x00FF00FFU) << 8);
+}
+
+/*
+ * one instruction on the core, swapped in a few steps so the host time charged with sim_set_cpu_scale stays close
+ */
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value) {
+	value = ((value >> 1) & 0x55555555U) | ((value & 0x55555555U) << 1);
+	value = ((value >> 2) & 0x33333333U) | ((value & 0x33333333U) << 2);
+	value = ((value >> 4) & 0x0F0F0F0FU) | ((value & 0x0F0F0F0FU) << 4);
+	return __builtin_bswap32(value);
+}
+
+__STATIC_FORCEINLINE uint8_t __CLZ(uint32_t value) {
+	return value == 0 ? 32U : (uint8_t)__builtin_clz(value);
+}
@@ -0,0 +1,218 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * interface between the simulated core and the peripheral models
+ */
+
+#pragma once
+#include "sim.h"
+#include <stm32f4xx.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * backing memory of a register named by its peripheral struct, e.g.
+ * SIM_REG(RCC_TypeDef, RCC_BASE, CR)
+ */
+#define SIM_REG(type, base, field) (*sim_reg((uint32_t)(base) + (uint32_t)offsetof(type, field)))
+#define SIM_OFFSET(type, field) ((uint32_t)offsetof(type, field))
+
+/*
+ * register block of a peripheral. the CPU sees the registers through trapped
+ * pages; a model keeps its plain registers in the backing memory (sim_reg) and
+ * only hooks the ones with side effects:
+ * read    - before the CPU or the DMA reads offset, stores the current value
+ * read_done - after the read, for clear-on-read sequences
+ * write   - after a write to offset, old is the value before it
+ */
+typedef struct {
+	const char *name;
+	uint32_t base;
+	uint32_t size;
+	void (*reset)(void);
+	void (*read)(uint32_t offset);
+	void (*read_done)(uint32_t offset);
+	void (*write)(uint32_t offset, uint32_t old);
+} sim_periph_t;
+
+void sim_periph_add(const sim_periph_t *periph);
+
+/*
+ * backing memory of a register, accessed by the models without trapping
+ */
+volatile uint32_t *sim_reg(uint32_t address);
+
+/*
+ * bus accesses of the DMA, running the same hooks as the CPU
+ */
+uint32_t sim_bus_read(uint32_t address, uint8_t size);
+void sim_bus_write(uint32_t address, uint32_t value, uint8_t size);
+
+/*
+ * timed event owned by a model
+ */
+typedef struct sim_event {
+	uint64_t when;
+	void (*fire)(struct sim_event *event);
+	bool armed;
+	bool registered;
+} sim_event_t;
+
+extern uint64_t sim_now;
+
+void sim_event_at(sim_event_t *event, uint64_t when);
+void sim_event_cancel(sim_event_t *event);
+
+/*
+ * clock tree as seen by the models, 0 while the domain is stopped
+ */
+typedef struct {
+	uint32_t sysclk;
+	uint32_t hclk;
+	uint32_t pclk1;
+	uint32_t pclk2;
+	uint32_t tim1;
+	uint32_t tim2;
+	uint32_t lsi;
+	bool stopped;
+} sim_clocks_t;
+
+extern sim_clocks_t sim_clk;
+
+/*
+ * clock change listener: sync brings the model up to sim_now with the old clocks,
+ * resched recomputes its events with the new ones
+ */
+typedef struct {
+	void (*sync)(void);
+	void (*resched)(void);
+} sim_clock_listener_t;
+
+void sim_clock_listen(const sim_clock_listener_t *listener);
+void sim_clocks_set(const sim_clocks_t *clocks);
+
+/*
+ * conversions between simulated time and cycles of a clock
+ */
+uint64_t sim_cycles(uint64_t units, uint32_t hz);
+uint64_t sim_span(uint64_t cycles, uint32_t hz);
+
+/*
+ * stalls the core (flash operation): time advances, interrupts wait
+ */
+void sim_stall(uint64_t units);
+
+/*
+ * interrupt mask of the core and the cost of exception entry and return
+ */
+bool sim_core_masked(void);
+void sim_core_charge(uint32_t cycles);
+
+/*
+ * core cycles executed since sim_init, the DWT cycle counter follows it
+ */
+uint64_t sim_core_cycles(void);
+
+/*
+ * interrupt lines, exception numbers are irqn + 16
+ */
+void sim_irq_level(int irqn, bool level);
+void sim_irq_pulse(int irqn);
+bool sim_nvic_wake_pending(void);
+void sim_nvic_deliver(void);
+bool sim_nvic_in_handler(void);
+void sim_systick_pend(void);
+
+/*
+ * one DMA transfer requested by a peripheral on dma (1 or 2), stream and channel,
+ * false when the stream is not enabled for that channel
+ */
+bool sim_dma_transfer(uint8_t dma, uint8_t stream, uint8_t channel);
+
+/*
+ * remaining items of a stream, for peripherals acting on the last transfer
+ */
+uint16_t sim_dma_remaining(uint8_t dma, uint8_t stream);
+
+/*
+ * peripheral side of a DMA request line, kicked when a stream is enabled
+ */
+void sim_dma_set_requester(uint8_t dma, uint8_t stream, uint8_t channel, void (*kick)(void));
+
+/*
+ * GPIO levels seen by the models
+ */
+bool sim_gpio_pin_level(uint8_t port, uint8_t pin);
+bool sim_gpio_pin_is_output(uint8_t port, uint8_t pin);
+void sim_gpio_set_input(uint8_t port, uint8_t pin, bool level);
+void sim_gpio_on_output(void (*listener)(uint8_t port, uint16_t old_odr, uint16_t new_odr));
+
+/*
+ * EXTI line driven by a peripheral (RTC wakeup)
+ */
+void sim_exti_line(uint8_t line, bool level);
+
+/*
+ * shield and sensor hooks
+ */
+void sim_display_shift(uint16_t word);
+void sim_display_latch(void);
+void sim_display_set_refresh(bool refreshing);
+bool sim_aht20_holds_sda(void);
+void sim_uart_emit(uint8_t byte);
+
+/*
+ * I2C slave side used by the I2C1 model
+ */
+bool sim_i2c_address(uint8_t address_byte);
+bool sim_i2c_write(uint8_t data);
+uint8_t sim_i2c_read(void);
+void sim_i2c_stop(void);
+
+/*
+ * core power mode changes, driven by WFI
+ */
+void sim_rcc_enter_stop(void);
+void sim_rcc_exit_stop(void);
+bool sim_pwr_stop_selected(void);
+
+/*
+ * flash programming: bits only go from 1 to 0 and only with PG set, the core
+ * stalls for the word programming time
+ */
+void sim_flash_program(uint32_t address, uint64_t old, uint64_t *value);
+
+/*
+ * registration of every model, called by sim_init
+ */
+void sim_scs_register(void);
+void sim_rcc_register(void);
+void sim_gpio_register(void);
+void sim_tim_register(void);
+void sim_dma_register(void);
+void sim_spi_register(void);
+void sim_i2c_register(void);
+void sim_usart_register(void);
+void sim_rtc_register(void);
+void sim_aht20_register(void);
+void sim_display_register(void);
+
+void sim_fatal(const char *format, ...) __attribute__((noreturn, format(printf, 1, 2)));
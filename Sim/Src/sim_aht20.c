@@ -0,0 +1,235 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * virtual AHT20 at address 0x38, powered from PC7 (low is on). commands follow
+ * the datasheet: 0xBA soft reset, 0xAC 0x33 0x00 measurement, 0xBE 0x08 0x00
+ * calibration; every read returns the status byte, five data bytes and the
+ * crc8. unknown bytes are acknowledged and ignored
+ */
+
+#include "sim_internal.h"
+#include <string.h>
+
+#define ADDRESS 0x38U
+#define POWER_UP_MS 20U
+#define SOFT_RESET_MS 20U
+#define DEFAULT_CONVERSION_MS 80U
+#define FRAME_SIZE 7U
+#define STATUS_BUSY (1U << 7)
+#define STATUS_CALIBRATED (1U << 3)
+#define RAW_FULL_SCALE (1UL << 20)
+
+static sim_aht20_t knobs = {
+	.temperature_centi = 2150,
+	.humidity_centi = 4500,
+	.conversion_ms = DEFAULT_CONVERSION_MS,
+	.calibrated = true,
+};
+
+static sim_aht20_stats_t stats;
+
+static struct {
+	bool powered;
+	bool calibrated;
+	bool reading;
+	bool selected;
+	uint64_t ready_at;
+	uint64_t conversion_end;
+	uint64_t selected_at;
+	uint8_t command[3];
+	uint8_t command_length;
+	uint8_t frame[FRAME_SIZE];
+	uint8_t read_index;
+	uint32_t raw_humidity;
+	uint32_t raw_temperature;
+} sensor;
+
+sim_aht20_t *sim_aht20(void) {
+	return &knobs;
+}
+
+void sim_aht20_get_stats(sim_aht20_stats_t *out) {
+	*out = stats;
+}
+
+static uint8_t crc8(const uint8_t *data, size_t size) {
+	uint8_t crc = 0xFF;
+
+	for (size_t i = 0; i < size; i++) {
+		crc ^= data[i];
+		for (uint8_t bit = 0; bit < 8; bit++) {
+			crc = (uint8_t)((crc & 0x80U) ? ((uint32_t)crc << 1) ^ 0x31U : (uint32_t)crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint32_t to_raw(int64_t numerator, int64_t denominator) {
+	int64_t raw = numerator * (int64_t)RAW_FULL_SCALE / denominator;
+
+	if (raw < 0) {
+		return 0;
+	}
+	return raw >= (int64_t)RAW_FULL_SCALE ? (uint32_t)(RAW_FULL_SCALE - 1U) : (uint32_t)raw;
+}
+
+static bool busy(void) {
+	return knobs.stuck_busy || sim_now < sensor.conversion_end;
+}
+
+static void power(bool on) {
+	if (on == sensor.powered) {
+		return;
+	}
+	sensor.powered = on;
+	sensor.selected = false;
+	sensor.conversion_end = 0;
+	sensor.raw_humidity = 0;
+	sensor.raw_temperature = 0;
+	sensor.calibrated = knobs.calibrated;
+	knobs.hold_sda_clocks = 0;
+	if (on) {
+		stats.power_cycles++;
+		sensor.ready_at = sim_now + POWER_UP_MS * SIM_UNITS_PER_MS;
+	}
+}
+
+static void run_command(void) {
+	switch (sensor.command[0]) {
+	case 0xBA:
+		stats.soft_resets++;
+		sensor.conversion_end = 0;
+		sensor.ready_at = sim_now + SOFT_RESET_MS * SIM_UNITS_PER_MS;
+		sensor.command_length = 0;
+		break;
+	case 0xAC:
+		if (sensor.command_length == 3 && sensor.command[1] == 0x33 && sensor.command[2] == 0x00) {
+			uint32_t conversion_ms = knobs.conversion_ms != 0 ? knobs.conversion_ms : DEFAULT_CONVERSION_MS;
+			stats.measurements++;
+			sensor.raw_humidity = to_raw(knobs.humidity_centi, 10000);
+			sensor.raw_temperature = to_raw((int64_t)knobs.temperature_centi + 5000, 20000);
+			sensor.conversion_end = sim_now + conversion_ms * SIM_UNITS_PER_MS;
+		}
+		break;
+	case 0xBE:
+		if (sensor.command_length == 3 && sensor.command[1] == 0x08 && sensor.command[2] == 0x00) {
+			sensor.calibrated = true;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * status and data as they are when the read starts
+ */
+static void build_frame(void) {
+	uint8_t *frame = sensor.frame;
+
+	frame[0] = (uint8_t)((busy() ? STATUS_BUSY : 0U) | (sensor.calibrated ? STATUS_CALIBRATED : 0U));
+	frame[1] = (uint8_t)(sensor.raw_humidity >> 12);
+	frame[2] = (uint8_t)(sensor.raw_humidity >> 4);
+	frame[3] = (uint8_t)(((sensor.raw_humidity & 0x0FU) << 4) | (sensor.raw_temperature >> 16));
+	frame[4] = (uint8_t)(sensor.raw_temperature >> 8);
+	frame[5] = (uint8_t)sensor.raw_temperature;
+	frame[6] = crc8(frame, 6);
+	if (!(frame[0] & STATUS_BUSY) && knobs.bad_crc_frames != 0) {
+		knobs.bad_crc_frames--;
+		frame[6] ^= 0xA5U;
+	}
+}
+
+bool sim_i2c_address(uint8_t address_byte) {
+	if ((address_byte >> 1) != ADDRESS) {
+		return false;
+	}
+	if (!sensor.powered || knobs.absent || sim_now < sensor.ready_at || knobs.hold_sda_clocks != 0) {
+		stats.nacks++;
+		return false;
+	}
+	sensor.selected = true;
+	sensor.selected_at = sim_now;
+	sensor.reading = (address_byte & 1U) != 0;
+	sensor.command_length = 0;
+	sensor.read_index = 0;
+	if (sensor.reading) {
+		build_frame();
+	}
+	return true;
+}
+
+bool sim_i2c_write(uint8_t data) {
+	if (!sensor.selected || sensor.reading) {
+		return false;
+	}
+	if (sensor.command_length < sizeof(sensor.command)) {
+		sensor.command[sensor.command_length++] = data;
+		run_command();
+	}
+	return true;
+}
+
+uint8_t sim_i2c_read(void) {
+	if (!sensor.selected || !sensor.reading) {
+		return 0xFF;
+	}
+	if (sensor.read_index >= FRAME_SIZE) {
+		return 0xFF;
+	}
+	if (sensor.read_index == FRAME_SIZE - 1U) {
+		stats.frames_read++;
+	}
+	return sensor.frame[sensor.read_index++];
+}
+
+void sim_i2c_stop(void) {
+	if (sensor.selected) {
+		stats.bus_time_us += (uint32_t)((sim_now - sensor.selected_at) / SIM_UNITS_PER_US);
+	}
+	sensor.selected = false;
+}
+
+bool sim_aht20_holds_sda(void) {
+	return sensor.powered && knobs.hold_sda_clocks != 0;
+}
+
+/*
+ * PC7 powers the sensor, PB6 driven as a GPIO clocks out a held SDA
+ */
+static void on_output(uint8_t port, uint16_t old_odr, uint16_t new_odr) {
+	uint16_t rising = (uint16_t)(~old_odr & new_odr);
+
+	if (port == 2 && ((old_odr ^ new_odr) & (1U << 7))) {
+		power(!(new_odr & (1U << 7)));
+	}
+	if (port == 1 && (rising & (1U << 6)) && sim_gpio_pin_is_output(1, 6) && knobs.hold_sda_clocks != 0) {
+		knobs.hold_sda_clocks--;
+	}
+}
+
+void sim_aht20_register(void) {
+	memset(&sensor, 0, sizeof(sensor));
+	memset(&stats, 0, sizeof(stats));
+	sim_gpio_on_output(on_output);
+	power(true);
+	stats.power_cycles = 0;
+	sensor.ready_at = 0;
+}
@@ -0,0 +1,880 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * simulated core: memory map, register traps, time, events, power modes and
+ * the firmware context.
+ *
+ * peripheral, bit-band and core registers live in pages with no access rights;
+ * an access faults, the handler brings time up to date, lets the model store
+ * the register value, opens the page and single-steps the instruction, the trap
+ * after it closes the page again and runs the side effects of the trap.
+ * the same memory is mapped a second time with full access for the models.
+ * flash is readable and faults only on writes, which program it.
+ * interrupts are taken at these points by calling the handler, nested on the
+ * interrupted code's stack like on the core
+ */
+
+#define _GNU_SOURCE
+#include "sim_internal.h"
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+/*
+ * cost in core cycles of a register access, of an intrinsic and of HAL_GetTick
+ */
+#define ACCESS_CYCLES 8
+#define INTRINSIC_CYCLES 2
+#define GET_TICK_CYCLES 8
+
+/*
+ * HAL_GetTick calls returning the same value, with no register written in between,
+ * before time jumps to the next event
+ */
+#define GET_TICK_SPIN_LIMIT 16
+
+/*
+ * granularity of the peripheral lookup and of host pages
+ */
+#define BLOCK_SHIFT 10
+#define PAGE_SIZE_HOST 4096UL
+
+/*
+ * x86 trap flag and the write bit of the page fault error code
+ */
+#define EFLAGS_TF 0x100
+#define FAULT_WRITE 0x2
+
+/*
+ * seconds without a simulated point before the firmware is declared stuck
+ */
+#define WATCHDOG_SECONDS 10
+
+#define MAX_EVENTS 64
+#define MAX_LISTENERS 16
+#define FIRMWARE_STACK_SIZE (1024 * 1024)
+
+typedef enum {
+	REGION_FLASH = 1,
+	REGION_PERIPH,
+	REGION_BITBAND,
+	REGION_CORE,
+} region_kind_t;
+
+typedef struct {
+	region_kind_t kind;
+	uintptr_t base;
+	size_t size;
+	int prot;
+	uint8_t *alias;
+	const sim_periph_t **blocks;
+} region_t;
+
+static const sim_periph_t *periph_blocks[(512 * 1024) >> BLOCK_SHIFT];
+static const sim_periph_t *core_blocks[(1024 * 1024) >> BLOCK_SHIFT];
+
+static region_t regions[] = {
+	{ REGION_FLASH, 0x08000000UL, 512 * 1024, PROT_READ, NULL, NULL },
+	{ REGION_PERIPH, 0x40000000UL, 512 * 1024, PROT_NONE, NULL, periph_blocks },
+	{ REGION_BITBAND, 0x42000000UL, 32 * 1024 * 1024, PROT_NONE, NULL, NULL },
+	{ REGION_CORE, 0xE0000000UL, 1024 * 1024, PROT_NONE, NULL, core_blocks },
+};
+
+#define REGION_COUNT (sizeof(regions) / sizeof(regions[0]))
+
+/*
+ * access being single-stepped
+ */
+static struct {
+	bool active;
+	region_t *region;
+	uintptr_t address;
+	bool write;
+	uint32_t old;
+	uint64_t old_flash;
+} trap;
+
+uint64_t sim_now = 0;
+sim_clocks_t sim_clk = {0};
+
+static sim_event_t *events[MAX_EVENTS];
+static uint8_t event_count = 0;
+
+static const sim_clock_listener_t *listeners[MAX_LISTENERS];
+static uint8_t listener_count = 0;
+
+/*
+ * core state: interrupt mask, exclusive monitor, event register, power mode
+ */
+static uint32_t primask = 0;
+static volatile uint8_t *exclusive = NULL;
+static bool event_register = false;
+static bool stalled = false;
+
+typedef enum {
+	MODE_RUN = 1,
+	MODE_SLEEP,
+	MODE_STOP,
+} power_mode_t;
+
+static power_mode_t mode = MODE_RUN;
+static sim_power_stats_t power_stats = {0};
+static uint64_t core_cycles = 0;
+static unsigned __int128 core_cycles_rest = 0;
+
+/*
+ * firmware context
+ */
+static ucontext_t host_context;
+static ucontext_t firmware_context;
+static uint8_t firmware_stack[FIRMWARE_STACK_SIZE] __attribute__((aligned(64)));
+static void (*firmware_entry)(void) = NULL;
+static sim_state_t firmware_state = SIM_STATE_IDLE;
+static bool firmware_started = false;
+static bool in_firmware = false;
+static uint64_t stop_time = 0;
+static int exit_code = 0;
+
+/*
+ * HAL_GetTick spin detection
+ */
+extern volatile uint32_t uwTick;
+static uint32_t last_tick = 0;
+static uint32_t same_tick_count = 0;
+
+/*
+ * host cpu time charging and the watchdog
+ */
+static double cpu_scale = 0;
+static uint64_t cpu_mark_ns = 0;
+static volatile uint64_t point_count = 0;
+static uint64_t watchdog_points = 0;
+static uint32_t watchdog_strikes = 0;
+
+static bool initialized = false;
+
+void sim_fatal(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "sim: %.6f s: ", (double)sim_now / SIM_CLOCK_HZ);
+	vfprintf(stderr, format, args);
+	fputc('\n', stderr);
+	va_end(args);
+	abort();
+}
+
+static region_t *find_region(uintptr_t address) {
+	for (size_t i = 0; i < REGION_COUNT; i++) {
+		if (address >= regions[i].base && address - regions[i].base < regions[i].size) {
+			return &regions[i];
+		}
+	}
+	return NULL;
+}
+
+static const sim_periph_t *find_periph(region_t *region, uintptr_t address) {
+	if (region->blocks == NULL) {
+		return NULL;
+	}
+	return region->blocks[(address - region->base) >> BLOCK_SHIFT];
+}
+
+void sim_periph_add(const sim_periph_t *periph) {
+	region_t *region = find_region(periph->base);
+	if (region == NULL || region->blocks == NULL) {
+		sim_fatal("%s outside the register regions", periph->name);
+	}
+	for (uint32_t offset = 0; offset < periph->size; offset += 1U << BLOCK_SHIFT) {
+		region->blocks[(periph->base + offset - region->base) >> BLOCK_SHIFT] = periph;
+	}
+}
+
+volatile uint32_t *sim_reg(uint32_t address) {
+	region_t *region = find_region(address);
+	if (region == NULL) {
+		sim_fatal("no backing memory at 0x%08X", address);
+	}
+	return (volatile uint32_t *)(region->alias + ((address & ~3U) - region->base));
+}
+
+/*
+ * time and events
+ */
+
+uint64_t sim_cycles(uint64_t units, uint32_t hz) {
+	return (uint64_t)(((unsigned __int128)units * hz) / SIM_CLOCK_HZ);
+}
+
+uint64_t sim_span(uint64_t cycles, uint32_t hz) {
+	if (hz == 0) {
+		return UINT64_MAX / 4;
+	}
+	return (uint64_t)(((unsigned __int128)cycles * SIM_CLOCK_HZ + hz - 1) / hz);
+}
+
+void sim_event_at(sim_event_t *event, uint64_t when) {
+	if (!event->registered) {
+		if (event_count == MAX_EVENTS) {
+			sim_fatal("too many events");
+		}
+		events[event_count++] = event;
+		event->registered = true;
+	}
+	event->when = when < sim_now ? sim_now : when;
+	event->armed = true;
+}
+
+void sim_event_cancel(sim_event_t *event) {
+	event->armed = false;
+}
+
+static sim_event_t *next_event(void) {
+	sim_event_t *next = NULL;
+	for (uint8_t i = 0; i < event_count; i++) {
+		if (events[i]->armed && (next == NULL || events[i]->when < next->when)) {
+			next = events[i];
+		}
+	}
+	return next;
+}
+
+/*
+ * charges the time up to when to the current power mode
+ */
+static void account(uint64_t when) {
+	uint64_t elapsed = when - sim_now;
+
+	switch (mode) {
+	case MODE_RUN:
+		power_stats.run += elapsed;
+		core_cycles_rest += (unsigned __int128)elapsed * sim_clk.hclk;
+		core_cycles += (uint64_t)(core_cycles_rest / SIM_CLOCK_HZ);
+		core_cycles_rest %= SIM_CLOCK_HZ;
+		break;
+	case MODE_SLEEP:
+		power_stats.sleep += elapsed;
+		break;
+	case MODE_STOP:
+		power_stats.stop += elapsed;
+		break;
+	}
+	sim_now = when;
+}
+
+/*
+ * fires the events due up to target in time order
+ */
+static void advance_to(uint64_t target) {
+	for (;;) {
+		sim_event_t *next = next_event();
+		if (next == NULL || next->when > target) {
+			break;
+		}
+		account(next->when);
+		next->armed = false;
+		next->fire(next);
+	}
+	if (target > sim_now) {
+		account(target);
+	}
+}
+
+uint64_t sim_core_cycles(void) {
+	return core_cycles;
+}
+
+void sim_clock_listen(const sim_clock_listener_t *listener) {
+	if (listener_count == MAX_LISTENERS) {
+		sim_fatal("too many clock listeners");
+	}
+	listeners[listener_count++] = listener;
+}
+
+void sim_clocks_set(const sim_clocks_t *clocks) {
+	for (uint8_t i = 0; i < listener_count; i++) {
+		listeners[i]->sync();
+	}
+	sim_clk = *clocks;
+	for (uint8_t i = 0; i < listener_count; i++) {
+		listeners[i]->resched();
+	}
+}
+
+void sim_stall(uint64_t units) {
+	bool was_stalled = stalled;
+	stalled = true;
+	advance_to(sim_now + units);
+	stalled = was_stalled;
+}
+
+/*
+ * firmware context switches
+ */
+
+static bool can_yield(void) {
+	return in_firmware && !stalled && !sim_nvic_in_handler();
+}
+
+static void yield_if_due(void) {
+	if (can_yield() && sim_now >= stop_time) {
+		in_firmware = false;
+		swapcontext(&firmware_context, &host_context);
+		in_firmware = true;
+	}
+}
+
+static uint64_t host_cpu_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/*
+ * a point where the firmware meets the simulation: time advances by the cost of
+ * the operation (and by the host time spent since the last point when scaling),
+ * due events fire and pending interrupts are taken
+ */
+static void sim_point(uint32_t cycles) {
+	point_count++;
+	if (cpu_scale > 0 && in_firmware) {
+		uint64_t now_ns = host_cpu_ns();
+		cycles += (uint32_t)((double)(now_ns - cpu_mark_ns) * cpu_scale);
+	}
+	if (mode == MODE_RUN && sim_clk.hclk != 0) {
+		advance_to(sim_now + sim_span(cycles, sim_clk.hclk));
+	}
+	if (!stalled) {
+		sim_nvic_deliver();
+	}
+	yield_if_due();
+	if (cpu_scale > 0) {
+		cpu_mark_ns = host_cpu_ns();
+	}
+}
+
+/*
+ * jumps to the next event while the firmware waits on the tick in a loop
+ */
+static void skip_to_next_event(void) {
+	sim_event_t *next = next_event();
+	if (next == NULL) {
+		return;
+	}
+	uint64_t target = next->when;
+	if (in_firmware && target > stop_time && stop_time > sim_now) {
+		target = stop_time;
+	}
+	advance_to(target);
+}
+
+uint32_t HAL_GetTick(void) {
+	/* a test reading the tick doesn't move simulated time */
+	if (!in_firmware) {
+		return uwTick;
+	}
+	sim_point(GET_TICK_CYCLES);
+
+	uint32_t tick = uwTick;
+	if (tick == last_tick) {
+		if (++same_tick_count >= GET_TICK_SPIN_LIMIT) {
+			same_tick_count = 0;
+			skip_to_next_event();
+		}
+	} else {
+		last_tick = tick;
+		same_tick_count = 0;
+	}
+	return tick;
+}
+
+/*
+ * intrinsics
+ */
+
+void sim_core_barrier(void) {
+	sim_point(INTRINSIC_CYCLES);
+}
+
+void sim_core_set_primask(uint32_t value) {
+	primask = value;
+	sim_point(INTRINSIC_CYCLES);
+}
+
+uint32_t sim_core_get_primask(void) {
+	return primask;
+}
+
+bool sim_core_masked(void) {
+	return primask != 0;
+}
+
+void sim_core_charge(uint32_t cycles) {
+	if (mode == MODE_RUN && sim_clk.hclk != 0) {
+		advance_to(sim_now + sim_span(cycles, sim_clk.hclk));
+	}
+}
+
+uint8_t sim_core_ldrexb(volatile uint8_t *address) {
+	sim_point(INTRINSIC_CYCLES);
+	exclusive = address;
+	return *address;
+}
+
+uint32_t sim_core_strexb(uint8_t value, volatile uint8_t *address) {
+	sim_point(INTRINSIC_CYCLES);
+	if (exclusive != address) {
+		return 1;
+	}
+	*address = value;
+	exclusive = NULL;
+	return 0;
+}
+
+void sim_core_clrex(void) {
+	exclusive = NULL;
+}
+
+void sim_core_sev(void) {
+	event_register = true;
+	sim_point(INTRINSIC_CYCLES);
+}
+
+/*
+ * sleeps until an interrupt is pending that would preempt with the mask clear;
+ * with SLEEPDEEP and the regulator selection of PWR the core enters Stop, the
+ * high speed clocks stop and the system clock falls back to HSI on wakeup
+ */
+void sim_core_wfi(void) {
+	sim_point(INTRINSIC_CYCLES);
+	if (sim_nvic_wake_pending()) {
+		return;
+	}
+
+	bool deep = (*sim_reg(0xE000ED10UL) & (1U << 2)) != 0;
+	if (deep && sim_pwr_stop_selected()) {
+		mode = MODE_STOP;
+		power_stats.stop_entries++;
+		sim_rcc_enter_stop();
+	} else {
+		mode = MODE_SLEEP;
+		power_stats.sleep_entries++;
+	}
+
+	while (!sim_nvic_wake_pending()) {
+		sim_event_t *next = next_event();
+		bool limited = in_firmware && !sim_nvic_in_handler();
+		if (next == NULL && !limited) {
+			sim_fatal("WFI with no wakeup source");
+		}
+		uint64_t target = next != NULL ? next->when : stop_time;
+		if (limited && target > stop_time && stop_time > sim_now) {
+			target = stop_time;
+		}
+		advance_to(target);
+		yield_if_due();
+	}
+
+	if (mode == MODE_STOP) {
+		sim_rcc_exit_stop();
+	}
+	mode = MODE_RUN;
+	sim_point(INTRINSIC_CYCLES);
+}
+
+void sim_core_wfe(void) {
+	if (event_register) {
+		event_register = false;
+		sim_point(INTRINSIC_CYCLES);
+		return;
+	}
+	sim_core_wfi();
+	event_register = false;
+}
+
+/*
+ * register traps
+ */
+
+static void crash(int signal_number) {
+	signal(signal_number, SIG_DFL);
+}
+
+static void on_segv(int signal_number, siginfo_t *info, void *context) {
+	ucontext_t *uc = context;
+	uintptr_t address = (uintptr_t)info->si_addr;
+	region_t *region = find_region(address);
+	bool is_write = (uc->uc_mcontext.gregs[REG_ERR] & FAULT_WRITE) != 0;
+
+	if (region == NULL || trap.active || (region->kind == REGION_FLASH && !is_write)) {
+		static const char message[] = "sim: memory fault outside the simulated registers\n";
+		(void)!write(STDERR_FILENO, message, sizeof(message) - 1);
+		crash(signal_number);
+		return;
+	}
+
+	sim_point(ACCESS_CYCLES);
+	if (is_write) {
+		/* a loop waiting on the tick only reads, e.g. back to back flash programs aren't one */
+		same_tick_count = 0;
+	}
+
+	uintptr_t word = address & ~(uintptr_t)3;
+	if (region->kind == REGION_FLASH) {
+		memcpy(&trap.old_flash, region->alias + ((address & ~(uintptr_t)7) - region->base), sizeof(trap.old_flash));
+	} else if (region->kind == REGION_BITBAND) {
+		uint32_t offset = (uint32_t)(word - region->base);
+		uint32_t target = 0x40000000UL + ((offset >> 5) & ~3U);
+		uint32_t bit = (offset >> 2) & 31U;
+		region_t *target_region = find_region(target);
+		const sim_periph_t *periph = target_region != NULL ? find_periph(target_region, target) : NULL;
+		if (periph != NULL && periph->read != NULL) {
+			periph->read(target - periph->base);
+		}
+		*(volatile uint32_t *)(region->alias + (word - region->base)) = (*sim_reg(target) >> bit) & 1U;
+	} else {
+		const sim_periph_t *periph = find_periph(region, word);
+		if (periph != NULL && periph->read != NULL) {
+			periph->read((uint32_t)(word - periph->base));
+		}
+	}
+
+	trap.active = true;
+	trap.region = region;
+	trap.address = address;
+	trap.write = is_write;
+	trap.old = *(volatile uint32_t *)(region->alias + (word - region->base));
+
+	mprotect((void *)(address & ~(PAGE_SIZE_HOST - 1)), PAGE_SIZE_HOST, PROT_READ | PROT_WRITE);
+	uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+}
+
+static void finish_flash(region_t *region) {
+	uint8_t *cell = region->alias + ((trap.address & ~(uintptr_t)7) - region->base);
+	uint64_t written;
+	memcpy(&written, cell, sizeof(written));
+	sim_flash_program((uint32_t)(trap.address & ~(uintptr_t)7), trap.old_flash, &written);
+	memcpy(cell, &written, sizeof(written));
+}
+
+static void finish_bitband(region_t *region) {
+	uintptr_t word = trap.address & ~(uintptr_t)3;
+	uint32_t offset = (uint32_t)(word - region->base);
+	uint32_t target = 0x40000000UL + ((offset >> 5) & ~3U);
+	uint32_t bit = (offset >> 2) & 31U;
+	region_t *target_region = find_region(target);
+	const sim_periph_t *periph = target_region != NULL ? find_periph(target_region, target) : NULL;
+
+	if (trap.write) {
+		uint32_t value = *(volatile uint32_t *)(region->alias + (word - region->base)) & 1U;
+		volatile uint32_t *reg = sim_reg(target);
+		uint32_t old = *reg;
+		*reg = (old & ~(1U << bit)) | (value << bit);
+		if (periph != NULL && periph->write != NULL) {
+			periph->write(target - periph->base, old);
+		}
+	} else if (periph != NULL && periph->read_done != NULL) {
+		periph->read_done(target - periph->base);
+	}
+}
+
+static void on_trap(int signal_number, siginfo_t *info, void *context) {
+	ucontext_t *uc = context;
+	(void)info;
+
+	if (!trap.active) {
+		crash(signal_number);
+		raise(signal_number);
+		return;
+	}
+
+	uc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+	region_t *region = trap.region;
+	mprotect((void *)(trap.address & ~(PAGE_SIZE_HOST - 1)), PAGE_SIZE_HOST, region->prot);
+	trap.active = false;
+
+	if (region->kind == REGION_FLASH) {
+		finish_flash(region);
+	} else if (region->kind == REGION_BITBAND) {
+		finish_bitband(region);
+	} else {
+		uintptr_t word = trap.address & ~(uintptr_t)3;
+		const sim_periph_t *periph = find_periph(region, word);
+		if (periph != NULL) {
+			if (trap.write && periph->write != NULL) {
+				periph->write((uint32_t)(word - periph->base), trap.old);
+			} else if (!trap.write && periph->read_done != NULL) {
+				periph->read_done((uint32_t)(word - periph->base));
+			}
+		}
+	}
+
+	if (!stalled) {
+		sim_nvic_deliver();
+	}
+}
+
+/*
+ * bus accesses of the DMA
+ */
+
+uint32_t sim_bus_read(uint32_t address, uint8_t size) {
+	region_t *region = find_region(address);
+	if (region == NULL) {
+		return 0;
+	}
+	uint32_t word = address & ~3U;
+	const sim_periph_t *periph = find_periph(region, word);
+	if (periph != NULL && periph->read != NULL) {
+		periph->read(word - periph->base);
+	}
+	uint32_t value = *(volatile uint32_t *)(region->alias + (word - region->base)) >> ((address & 3U) * 8U);
+	if (periph != NULL && periph->read_done != NULL) {
+		periph->read_done(word - periph->base);
+	}
+	return size >= 4 ? value : value & ((1U << (size * 8U)) - 1U);
+}
+
+void sim_bus_write(uint32_t address, uint32_t value, uint8_t size) {
+	region_t *region = find_region(address);
+	if (region == NULL) {
+		return;
+	}
+	uint32_t word = address & ~3U;
+	const sim_periph_t *periph = find_periph(region, word);
+	volatile uint32_t *reg = (volatile uint32_t *)(region->alias + (word - region->base));
+	uint32_t old = *reg;
+	uint32_t shift = (address & 3U) * 8U;
+	uint32_t mask = size >= 4 ? 0xFFFFFFFFU : ((1U << (size * 8U)) - 1U) << shift;
+
+	*reg = (old & ~mask) | ((value << shift) & mask);
+	if (periph != NULL && periph->write != NULL) {
+		periph->write(word - periph->base, old);
+	}
+}
+
+/*
+ * watchdog: a firmware spinning without touching a register never comes back
+ */
+static void on_alarm(int signal_number) {
+	(void)signal_number;
+	if (!in_firmware || point_count != watchdog_points) {
+		watchdog_points = point_count;
+		watchdog_strikes = 0;
+		return;
+	}
+	if (++watchdog_strikes >= WATCHDOG_SECONDS) {
+		static const char message[] = "sim: firmware spins without touching the hardware (Error_Handler?)\n";
+		(void)!write(STDERR_FILENO, message, sizeof(message) - 1);
+		abort();
+	}
+}
+
+static void map_regions(void) {
+	size_t total = 0;
+	for (size_t i = 0; i < REGION_COUNT; i++) {
+		total += regions[i].size;
+	}
+
+	int fd = memfd_create("sim-registers", 0);
+	if (fd < 0 || ftruncate(fd, (off_t)total) != 0) {
+		sim_fatal("cannot create the register memory");
+	}
+
+	off_t offset = 0;
+	for (size_t i = 0; i < REGION_COUNT; i++) {
+		region_t *region = &regions[i];
+		void *cpu = mmap((void *)region->base, region->size, region->prot, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, offset);
+		void *alias = mmap(NULL, region->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+		if (cpu != (void *)region->base || alias == MAP_FAILED) {
+			sim_fatal("cannot map 0x%08lX, is the host build linked with -no-pie?", (unsigned long)region->base);
+		}
+		region->alias = alias;
+		offset += (off_t)region->size;
+	}
+	close(fd);
+
+	memset(regions[0].alias, 0xFF, regions[0].size);
+}
+
+static void install_handlers(void) {
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_flags = SA_SIGINFO | SA_NODEFER;
+	sigemptyset(&action.sa_mask);
+
+	action.sa_sigaction = on_segv;
+	sigaction(SIGSEGV, &action, NULL);
+	action.sa_sigaction = on_trap;
+	sigaction(SIGTRAP, &action, NULL);
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = on_alarm;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGALRM, &action, NULL);
+
+	struct itimerval interval = {{1, 0}, {1, 0}};
+	setitimer(ITIMER_REAL, &interval, NULL);
+}
+
+void sim_init(void) {
+	if (initialized) {
+		return;
+	}
+	initialized = true;
+
+	map_regions();
+
+	sim_clocks_t clocks = {
+		.sysclk = 16000000U, .hclk = 16000000U, .pclk1 = 16000000U, .pclk2 = 16000000U,
+		.tim1 = 16000000U, .tim2 = 16000000U, .lsi = 0U, .stopped = false,
+	};
+	sim_clk = clocks;
+
+	sim_scs_register();
+	sim_rcc_register();
+	sim_gpio_register();
+	sim_tim_register();
+	sim_dma_register();
+	sim_spi_register();
+	sim_i2c_register();
+	sim_usart_register();
+	sim_rtc_register();
+	sim_aht20_register();
+	sim_display_register();
+
+	for (size_t i = 0; i < REGION_COUNT; i++) {
+		if (regions[i].blocks == NULL) {
+			continue;
+		}
+		size_t count = regions[i].size >> BLOCK_SHIFT;
+		for (size_t b = 0; b < count; b++) {
+			const sim_periph_t *periph = regions[i].blocks[b];
+			if (periph != NULL && periph->reset != NULL && (b == 0 || regions[i].blocks[b - 1] != periph)) {
+				periph->reset();
+			}
+		}
+	}
+
+	install_handlers();
+}
+
+/*
+ * firmware context
+ */
+
+static void firmware_trampoline(void) {
+	firmware_entry();
+	firmware_state = SIM_STATE_RETURNED;
+	in_firmware = false;
+}
+
+void sim_start(void (*entry)(void)) {
+	sim_init();
+	firmware_entry = entry;
+	getcontext(&firmware_context);
+	firmware_context.uc_stack.ss_sp = firmware_stack;
+	firmware_context.uc_stack.ss_size = sizeof(firmware_stack);
+	firmware_context.uc_link = &host_context;
+	makecontext(&firmware_context, firmware_trampoline, 0);
+	firmware_started = true;
+	firmware_state = SIM_STATE_RUNNING;
+}
+
+extern void SystemInit(void);
+extern int firmware_main(void);
+
+static void boot_entry(void) {
+	SystemInit();
+	exit_code = firmware_main();
+}
+
+void sim_boot(void) {
+	sim_start(boot_entry);
+}
+
+int sim_exit_code(void) {
+	return exit_code;
+}
+
+/*
+ * without a firmware context only the peripherals and interrupts run
+ */
+static void run_peripherals(uint64_t target) {
+	while (sim_now < target) {
+		sim_event_t *next = next_event();
+		uint64_t step = next != NULL && next->when < target ? next->when : target;
+		advance_to(step);
+		sim_nvic_deliver();
+	}
+}
+
+sim_state_t sim_run_us(uint32_t us) {
+	sim_init();
+	stop_time = sim_now + (uint64_t)us * SIM_UNITS_PER_US;
+
+	if (firmware_started && firmware_state == SIM_STATE_RUNNING) {
+		in_firmware = true;
+		cpu_mark_ns = host_cpu_ns();
+		swapcontext(&host_context, &firmware_context);
+		in_firmware = false;
+	}
+	if (sim_now < stop_time) {
+		run_peripherals(stop_time);
+	}
+	return firmware_started ? firmware_state : SIM_STATE_IDLE;
+}
+
+sim_state_t sim_run_ms(uint32_t ms) {
+	return sim_run_us(ms * 1000U);
+}
+
+bool sim_run_until(bool (*condition)(void), uint32_t timeout_ms) {
+	for (uint32_t ms = 0; ms < timeout_ms; ms++) {
+		if (condition()) {
+			return true;
+		}
+		sim_run_ms(1);
+	}
+	return condition();
+}
+
+uint64_t sim_time(void) {
+	return sim_now;
+}
+
+uint32_t sim_time_ms(void) {
+	return (uint32_t)(sim_now / SIM_UNITS_PER_MS);
+}
+
+void sim_set_cpu_scale(double cycles_per_ns) {
+	cpu_scale = cycles_per_ns;
+}
+
+void sim_power_get_stats(sim_power_stats_t *stats) {
+	*stats = power_stats;
+}
@@ -0,0 +1,142 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * multi-function shield display: two 74HC595 behind SPI1, the high byte drives
+ * the active-low segments and bit i of the low byte selects digit i. the latched
+ * word is integrated over time, so the reported duty is what the eye would see
+ * over a window of several refresh frames
+ */
+
+#include "sim_internal.h"
+#include <string.h>
+
+#define DIGITS 4U
+#define SEGMENTS 8U
+#define WINDOW_UNITS (4096ULL * SIM_UNITS_PER_US)
+
+static uint16_t shift_register = 0;
+static uint16_t latched = 0;
+static uint64_t latched_at = 0;
+static bool refreshing = false;
+static void (*sink)(sim_display_event_t event, uint16_t word, uint64_t time, void *context) = NULL;
+static void *sink_context = NULL;
+
+/*
+ * on time of each segment in the open window and in the last complete one
+ */
+static uint64_t current[DIGITS][SEGMENTS];
+static uint64_t complete[DIGITS][SEGMENTS];
+static uint64_t window_start = 0;
+
+static void credit(uint16_t word, uint64_t units) {
+	uint8_t lit = (uint8_t)~(word >> 8);
+
+	if (lit == 0) {
+		return;
+	}
+	for (uint8_t digit = 0; digit < DIGITS; digit++) {
+		if (!(word & (1U << digit))) {
+			continue;
+		}
+		for (uint8_t segment = 0; segment < SEGMENTS; segment++) {
+			if (lit & (1U << segment)) {
+				current[digit][segment] += units;
+			}
+		}
+	}
+}
+
+/*
+ * integrates the latched word up to now, closing the windows passed meanwhile
+ */
+static void integrate(void) {
+	uint64_t from = latched_at;
+
+	while (sim_now >= window_start + WINDOW_UNITS) {
+		uint64_t end = window_start + WINDOW_UNITS;
+		if (from < end) {
+			credit(latched, end - from);
+			from = end;
+		}
+		memcpy(complete, current, sizeof(complete));
+		memset(current, 0, sizeof(current));
+		window_start = end;
+		if (sim_now - window_start >= WINDOW_UNITS) {
+			/* nothing changed for a whole window, skip the idle ones */
+			credit(latched, WINDOW_UNITS);
+			memcpy(complete, current, sizeof(complete));
+			memset(current, 0, sizeof(current));
+			window_start += ((sim_now - window_start) / WINDOW_UNITS) * WINDOW_UNITS;
+			from = window_start;
+		}
+	}
+	credit(latched, sim_now - from);
+	latched_at = sim_now;
+}
+
+void sim_display_shift(uint16_t word) {
+	shift_register = word;
+	if (sink != NULL) {
+		sink(SIM_DISPLAY_SHIFTED, word, sim_now, sink_context);
+	}
+}
+
+void sim_display_latch(void) {
+	integrate();
+	latched = shift_register;
+	if (sink != NULL) {
+		sink(SIM_DISPLAY_LATCHED, latched, sim_now, sink_context);
+	}
+}
+
+void sim_display_set_sink(void (*new_sink)(sim_display_event_t event, uint16_t word, uint64_t time, void *context), void *context) {
+	sink = new_sink;
+	sink_context = context;
+}
+
+void sim_display_set_refresh(bool on) {
+	refreshing = on;
+}
+
+void sim_display_read(sim_display_t *display) {
+	integrate();
+	for (uint8_t digit = 0; digit < DIGITS; digit++) {
+		uint8_t code = 0xFF;
+		for (uint8_t segment = 0; segment < SEGMENTS; segment++) {
+			uint64_t duty = (complete[digit][segment] << 16) / WINDOW_UNITS;
+			display->duty[digit][segment] = (uint16_t)(duty > 0xFFFFU ? 0xFFFFU : duty);
+			if (duty != 0) {
+				code &= (uint8_t)~(1U << segment);
+			}
+		}
+		display->code[digit] = code;
+	}
+	display->refreshing = refreshing;
+}
+
+void sim_display_register(void) {
+	shift_register = 0;
+	latched = 0;
+	latched_at = 0;
+	window_start = 0;
+	refreshing = false;
+	memset(current, 0, sizeof(current));
+	memset(complete, 0, sizeof(complete));
+}
@@ -0,0 +1,270 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * DMA1 and DMA2. a peripheral request moves one item of the stream selected for
+ * its channel: the memory side is a host pointer, the peripheral side goes
+ * through the register hooks. flags and interrupts follow NDTR as on the chip,
+ * circular and double buffer streams reload at the end of each block
+ */
+
+#include "sim_internal.h"
+#include <string.h>
+
+#define STREAM_COUNT 8U
+
+/*
+ * bit offsets of the stream flags in LISR/HISR and their positions within a stream
+ */
+static const uint8_t FLAG_SHIFT[4] = { 0, 6, 16, 22 };
+#define FLAG_FE (1U << 0)
+#define FLAG_DME (1U << 2)
+#define FLAG_TE (1U << 3)
+#define FLAG_HT (1U << 4)
+#define FLAG_TC (1U << 5)
+
+typedef struct {
+	uint16_t total;
+	uint16_t done;
+	/* requesters by channel, several peripherals share a stream */
+	void (*kick[8])(void);
+} sim_stream_t;
+
+typedef struct {
+	uint32_t base;
+	sim_stream_t streams[STREAM_COUNT];
+	IRQn_Type irqn[STREAM_COUNT];
+} sim_dma_t;
+
+static sim_dma_t controllers[2] = {
+	{
+		.base = DMA1_BASE,
+		.irqn = { DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn,
+				DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn },
+	},
+	{
+		.base = DMA2_BASE,
+		.irqn = { DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn,
+				DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn },
+	},
+};
+
+static uint32_t stream_base(const sim_dma_t *dma, uint8_t stream) {
+	return dma->base + 0x10U + 0x18U * stream;
+}
+
+#define STREAM_R(dma, stream, field) SIM_REG(DMA_Stream_TypeDef, stream_base(dma, stream), field)
+
+static volatile uint32_t *flag_register(const sim_dma_t *dma, uint8_t stream) {
+	return stream < 4 ? sim_reg(dma->base + SIM_OFFSET(DMA_TypeDef, LISR)) : sim_reg(dma->base + SIM_OFFSET(DMA_TypeDef, HISR));
+}
+
+static uint32_t stream_flags(const sim_dma_t *dma, uint8_t stream) {
+	return (*flag_register(dma, stream) >> FLAG_SHIFT[stream % 4]) & 0x3FU;
+}
+
+static void update_irq(sim_dma_t *dma, uint8_t stream) {
+	uint32_t flags = stream_flags(dma, stream);
+	uint32_t cr = STREAM_R(dma, stream, CR);
+	uint32_t enabled = 0;
+
+	if (cr & DMA_SxCR_TCIE) {
+		enabled |= FLAG_TC;
+	}
+	if (cr & DMA_SxCR_HTIE) {
+		enabled |= FLAG_HT;
+	}
+	if (cr & DMA_SxCR_TEIE) {
+		enabled |= FLAG_TE;
+	}
+	if (cr & DMA_SxCR_DMEIE) {
+		enabled |= FLAG_DME;
+	}
+	if (STREAM_R(dma, stream, FCR) & DMA_SxFCR_FEIE) {
+		enabled |= FLAG_FE;
+	}
+	sim_irq_level(dma->irqn[stream], (flags & enabled) != 0);
+}
+
+static void set_flags(sim_dma_t *dma, uint8_t stream, uint32_t flags) {
+	*flag_register(dma, stream) |= flags << FLAG_SHIFT[stream % 4];
+	update_irq(dma, stream);
+}
+
+static uint8_t item_size(uint32_t cr, uint32_t mask, uint32_t position) {
+	return (uint8_t)(1U << ((cr & mask) >> position));
+}
+
+bool sim_dma_transfer(uint8_t dma_number, uint8_t stream, uint8_t channel) {
+	sim_dma_t *dma = &controllers[dma_number - 1];
+	sim_stream_t *state = &dma->streams[stream];
+	uint32_t cr = STREAM_R(dma, stream, CR);
+
+	if (!(cr & DMA_SxCR_EN) || ((cr & DMA_SxCR_CHSEL) >> DMA_SxCR_CHSEL_Pos) != channel || STREAM_R(dma, stream, NDTR) == 0) {
+		return false;
+	}
+
+	uint8_t psize = item_size(cr, DMA_SxCR_PSIZE, DMA_SxCR_PSIZE_Pos);
+	uint8_t msize = item_size(cr, DMA_SxCR_MSIZE, DMA_SxCR_MSIZE_Pos);
+	uint32_t peripheral = STREAM_R(dma, stream, PAR) + ((cr & DMA_SxCR_PINC) ? (uint32_t)state->done * psize : 0U);
+	uint32_t memory = ((cr & DMA_SxCR_CT) ? STREAM_R(dma, stream, M1AR) : STREAM_R(dma, stream, M0AR))
+			+ ((cr & DMA_SxCR_MINC) ? (uint32_t)state->done * msize : 0U);
+	uint32_t value = 0;
+
+	if ((cr & DMA_SxCR_DIR) == DMA_SxCR_DIR_0) {
+		memcpy(&value, (const void *)(uintptr_t)memory, msize);
+		sim_bus_write(peripheral, value, psize);
+	} else {
+		value = sim_bus_read(peripheral, psize);
+		memcpy((void *)(uintptr_t)memory, &value, msize);
+	}
+
+	/* the peripheral access may have disabled the stream */
+	if (!(STREAM_R(dma, stream, CR) & DMA_SxCR_EN)) {
+		return true;
+	}
+
+	state->done++;
+	uint32_t remaining = STREAM_R(dma, stream, NDTR) - 1U;
+	STREAM_R(dma, stream, NDTR) = remaining;
+	uint32_t flags = 0;
+	if (state->done == state->total / 2U) {
+		flags |= FLAG_HT;
+	}
+	if (remaining == 0) {
+		flags |= FLAG_TC;
+		if (cr & (DMA_SxCR_CIRC | DMA_SxCR_DBM)) {
+			STREAM_R(dma, stream, NDTR) = state->total;
+			state->done = 0;
+			if (cr & DMA_SxCR_DBM) {
+				STREAM_R(dma, stream, CR) ^= DMA_SxCR_CT;
+			}
+		} else {
+			STREAM_R(dma, stream, CR) &= ~DMA_SxCR_EN;
+		}
+	}
+	if (flags != 0) {
+		set_flags(dma, stream, flags);
+	}
+	return true;
+}
+
+uint16_t sim_dma_remaining(uint8_t dma_number, uint8_t stream) {
+	sim_dma_t *dma = &controllers[dma_number - 1];
+	if (!(STREAM_R(dma, stream, CR) & DMA_SxCR_EN)) {
+		return 0;
+	}
+	return (uint16_t)STREAM_R(dma, stream, NDTR);
+}
+
+void sim_dma_set_requester(uint8_t dma_number, uint8_t stream, uint8_t channel, void (*kick)(void)) {
+	sim_stream_t *state = &controllers[dma_number - 1].streams[stream];
+	state->kick[channel] = kick;
+}
+
+/*
+ * register hooks
+ */
+
+static void stream_write(sim_dma_t *dma, uint8_t stream, uint32_t offset, uint32_t old) {
+	sim_stream_t *state = &dma->streams[stream];
+	volatile uint32_t *reg = sim_reg(stream_base(dma, stream) + offset);
+
+	if (offset == SIM_OFFSET(DMA_Stream_TypeDef, CR)) {
+		uint32_t value = *reg;
+		if ((old & DMA_SxCR_EN) && (value & DMA_SxCR_EN)) {
+			/* only the interrupt enables change on an enabled stream, CT is then a status bit of the double buffer */
+			uint32_t writable = DMA_SxCR_TCIE | DMA_SxCR_HTIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE;
+			*reg = (old & ~writable) | (value & writable);
+		} else if (!(old & DMA_SxCR_EN) && (value & DMA_SxCR_EN)) {
+			state->total = (uint16_t)STREAM_R(dma, stream, NDTR);
+			state->done = 0;
+		} else if ((old & DMA_SxCR_EN) && !(value & DMA_SxCR_EN) && STREAM_R(dma, stream, NDTR) != 0) {
+			set_flags(dma, stream, FLAG_TC);
+		}
+		update_irq(dma, stream);
+		uint8_t channel = (uint8_t)((value & DMA_SxCR_CHSEL) >> DMA_SxCR_CHSEL_Pos);
+		if (!(old & DMA_SxCR_EN) && (value & DMA_SxCR_EN) && state->kick[channel] != NULL) {
+			state->kick[channel]();
+		}
+	} else if (offset == SIM_OFFSET(DMA_Stream_TypeDef, NDTR)) {
+		if (STREAM_R(dma, stream, CR) & DMA_SxCR_EN) {
+			*reg = old;
+		} else {
+			*reg &= 0xFFFFU;
+		}
+	} else if (offset == SIM_OFFSET(DMA_Stream_TypeDef, FCR)) {
+		update_irq(dma, stream);
+	}
+}
+
+static void dma_write(sim_dma_t *dma, uint32_t offset, uint32_t old) {
+	if (offset == SIM_OFFSET(DMA_TypeDef, LIFCR) || offset == SIM_OFFSET(DMA_TypeDef, HIFCR)) {
+		volatile uint32_t *clear = sim_reg(dma->base + offset);
+		volatile uint32_t *flags = sim_reg(dma->base + offset - SIM_OFFSET(DMA_TypeDef, LIFCR));
+		uint8_t first = offset == SIM_OFFSET(DMA_TypeDef, LIFCR) ? 0 : 4;
+
+		*flags &= ~*clear;
+		*clear = 0;
+		for (uint8_t stream = first; stream < first + 4U; stream++) {
+			update_irq(dma, stream);
+		}
+	} else if (offset == SIM_OFFSET(DMA_TypeDef, LISR) || offset == SIM_OFFSET(DMA_TypeDef, HISR)) {
+		*sim_reg(dma->base + offset) = old;
+	} else if (offset >= 0x10U && offset < 0x10U + 0x18U * STREAM_COUNT) {
+		uint8_t stream = (uint8_t)((offset - 0x10U) / 0x18U);
+		stream_write(dma, stream, (offset - 0x10U) % 0x18U, old);
+	}
+}
+
+static void dma1_write(uint32_t offset, uint32_t old) {
+	dma_write(&controllers[0], offset, old);
+}
+
+static void dma2_write(uint32_t offset, uint32_t old) {
+	dma_write(&controllers[1], offset, old);
+}
+
+static void dma_reset(void) {
+	for (size_t i = 0; i < 2; i++) {
+		for (uint8_t stream = 0; stream < STREAM_COUNT; stream++) {
+			STREAM_R(&controllers[i], stream, FCR) = DMA_SxFCR_FS_2 | DMA_SxFCR_FTH_0;
+		}
+	}
+}
+
+static const sim_periph_t dma1_periph = {
+	.name = "DMA1",
+	.base = DMA1_BASE,
+	.size = 0x400,
+	.reset = dma_reset,
+	.write = dma1_write,
+};
+
+static const sim_periph_t dma2_periph = {
+	.name = "DMA2",
+	.base = DMA2_BASE,
+	.size = 0x400,
+	.write = dma2_write,
+};
+
+void sim_dma_register(void) {
+	sim_periph_add(&dma1_periph);
+	sim_periph_add(&dma2_periph);
+}
@@ -0,0 +1,294 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * GPIO ports, SYSCFG external interrupt routing and the EXTI controller.
+ * a pin reads what drives its wire: the port itself in output mode, otherwise an
+ * external driver (buttons, the sensor holding SDA) or the pull-up of the board
+ * or of the port. EXTI sees the edges of these levels, in Stop mode as well
+ */
+
+#include "sim_internal.h"
+
+#define PORT_COUNT 8
+#define PORT_STRIDE (GPIOB_BASE - GPIOA_BASE)
+#define EXTI_LINES 23
+#define MAX_OUTPUT_LISTENERS 4
+
+#define GPIO_R(port, field) SIM_REG(GPIO_TypeDef, GPIOA_BASE + (port) * PORT_STRIDE, field)
+#define EXTI_R(field) SIM_REG(EXTI_TypeDef, EXTI_BASE, field)
+#define SYSCFG_R(field) SIM_REG(SYSCFG_TypeDef, SYSCFG_BASE, field)
+
+enum {
+	PIN_MODE_INPUT = 0,
+	PIN_MODE_OUTPUT = 1,
+	PIN_MODE_ALTERNATE = 2,
+	PIN_MODE_ANALOG = 3,
+};
+
+/*
+ * pins pulled up on the boards: shield buttons, user button, I2C lines
+ */
+static const uint16_t BOARD_PULLUPS[PORT_COUNT] = {
+	[0] = (1U << 1) | (1U << 4),
+	[1] = (1U << 6) | (1U << 7),
+	[2] = (1U << 13),
+};
+
+static const struct {
+	uint8_t port;
+	uint8_t pin;
+} BUTTON_PINS[SIM_BUTTON_COUNT] = {
+	[SIM_BUTTON_A] = { 0, 1 },
+	[SIM_BUTTON_B] = { 0, 4 },
+	[SIM_BUTTON_USER] = { 2, 13 },
+};
+
+static uint16_t pulled_low[PORT_COUNT];
+static uint16_t levels[PORT_COUNT];
+static uint32_t exti_pending = 0;
+static uint32_t exti_inputs = 0;
+
+static void (*output_listeners[MAX_OUTPUT_LISTENERS])(uint8_t port, uint16_t old_odr, uint16_t new_odr);
+static uint8_t output_listener_count = 0;
+
+static uint8_t pin_mode(uint8_t port, uint8_t pin) {
+	return (uint8_t)((GPIO_R(port, MODER) >> (pin * 2U)) & 3U);
+}
+
+static bool wire_level(uint8_t port, uint8_t pin) {
+	if (pulled_low[port] & (1U << pin)) {
+		return false;
+	}
+	if (port == 1 && pin == 7 && sim_aht20_holds_sda()) {
+		return false;
+	}
+	if (BOARD_PULLUPS[port] & (1U << pin)) {
+		return true;
+	}
+	return ((GPIO_R(port, PUPDR) >> (pin * 2U)) & 3U) == 1U;
+}
+
+bool sim_gpio_pin_level(uint8_t port, uint8_t pin) {
+	bool wire = wire_level(port, pin);
+
+	switch (pin_mode(port, pin)) {
+	case PIN_MODE_OUTPUT: {
+		bool out = (GPIO_R(port, ODR) >> pin) & 1U;
+		bool open_drain = (GPIO_R(port, OTYPER) >> pin) & 1U;
+		return open_drain ? out && wire : out;
+	}
+	case PIN_MODE_ANALOG:
+		return false;
+	default:
+		return wire;
+	}
+}
+
+bool sim_gpio_pin_is_output(uint8_t port, uint8_t pin) {
+	return pin_mode(port, pin) == PIN_MODE_OUTPUT;
+}
+
+/*
+ * EXTI
+ */
+
+static void exti_update_irqs(void) {
+	uint32_t active = exti_pending & EXTI_R(IMR);
+
+	sim_irq_level(EXTI0_IRQn, active & (1U << 0));
+	sim_irq_level(EXTI1_IRQn, active & (1U << 1));
+	sim_irq_level(EXTI2_IRQn, active & (1U << 2));
+	sim_irq_level(EXTI3_IRQn, active & (1U << 3));
+	sim_irq_level(EXTI4_IRQn, active & (1U << 4));
+	sim_irq_level(EXTI9_5_IRQn, active & 0x000003E0U);
+	sim_irq_level(EXTI15_10_IRQn, active & 0x0000FC00U);
+	sim_irq_level(PVD_IRQn, active & (1U << 16));
+	sim_irq_level(RTC_Alarm_IRQn, active & (1U << 17));
+	sim_irq_level(TAMP_STAMP_IRQn, active & (1U << 21));
+	sim_irq_level(RTC_WKUP_IRQn, active & (1U << 22));
+}
+
+static void exti_edge(uint8_t line, bool rising) {
+	uint32_t mask = 1U << line;
+	if ((rising && (EXTI_R(RTSR) & mask)) || (!rising && (EXTI_R(FTSR) & mask))) {
+		exti_pending |= mask;
+		exti_update_irqs();
+	}
+}
+
+void sim_exti_line(uint8_t line, bool level) {
+	uint32_t mask = 1U << line;
+	bool old = (exti_inputs & mask) != 0;
+	if (level) {
+		exti_inputs |= mask;
+	} else {
+		exti_inputs &= ~mask;
+	}
+	if (old != level) {
+		exti_edge(line, level);
+	}
+}
+
+/*
+ * recomputes the pin levels of a port and passes the edges to EXTI
+ */
+static void refresh(uint8_t port) {
+	uint16_t now = 0;
+	for (uint8_t pin = 0; pin < 16; pin++) {
+		if (sim_gpio_pin_level(port, pin)) {
+			now |= (uint16_t)(1U << pin);
+		}
+	}
+
+	uint16_t changed = now ^ levels[port];
+	levels[port] = now;
+	for (uint8_t pin = 0; pin < 16; pin++) {
+		if (!(changed & (1U << pin))) {
+			continue;
+		}
+		uint32_t source = (SYSCFG_R(EXTICR[pin / 4U]) >> ((pin % 4U) * 4U)) & 0xFU;
+		if (source == port) {
+			exti_edge(pin, (now >> pin) & 1U);
+		}
+	}
+}
+
+void sim_gpio_set_input(uint8_t port, uint8_t pin, bool level) {
+	if (level) {
+		pulled_low[port] &= (uint16_t)~(1U << pin);
+	} else {
+		pulled_low[port] |= (uint16_t)(1U << pin);
+	}
+	refresh(port);
+}
+
+void sim_button_set(sim_button_t button, bool pressed) {
+	sim_init();
+	sim_gpio_set_input(BUTTON_PINS[button].port, BUTTON_PINS[button].pin, !pressed);
+}
+
+bool sim_gpio_output(char port, uint8_t pin) {
+	sim_init();
+	return (GPIO_R((uint8_t)(port - 'A'), ODR) >> pin) & 1U;
+}
+
+void sim_gpio_on_output(void (*listener)(uint8_t port, uint16_t old_odr, uint16_t new_odr)) {
+	output_listeners[output_listener_count++] = listener;
+}
+
+/*
+ * register hooks
+ */
+
+static void gpio_reset(void) {
+	for (uint8_t port = 0; port < PORT_COUNT; port++) {
+		levels[port] = 0;
+	}
+	GPIO_R(0, MODER) = 0xA8000000U;
+	GPIO_R(0, PUPDR) = 0x64000000U;
+	GPIO_R(0, OSPEEDR) = 0x0C000000U;
+	GPIO_R(1, MODER) = 0x00000280U;
+	GPIO_R(1, PUPDR) = 0x00000100U;
+	GPIO_R(1, OSPEEDR) = 0x000000C0U;
+	for (uint8_t port = 0; port < PORT_COUNT; port++) {
+		for (uint8_t pin = 0; pin < 16; pin++) {
+			if (sim_gpio_pin_level(port, pin)) {
+				levels[port] |= (uint16_t)(1U << pin);
+			}
+		}
+	}
+}
+
+static void gpio_read(uint32_t offset) {
+	uint8_t port = (uint8_t)(offset / PORT_STRIDE);
+	uint32_t reg = offset % PORT_STRIDE;
+
+	if (reg == SIM_OFFSET(GPIO_TypeDef, IDR)) {
+		refresh(port);
+		GPIO_R(port, IDR) = levels[port];
+	} else if (reg == SIM_OFFSET(GPIO_TypeDef, BSRR)) {
+		GPIO_R(port, BSRR) = 0;
+	}
+}
+
+static void gpio_write(uint32_t offset, uint32_t old) {
+	uint8_t port = (uint8_t)(offset / PORT_STRIDE);
+	uint32_t reg = offset % PORT_STRIDE;
+	uint16_t old_odr = (uint16_t)GPIO_R(port, ODR);
+
+	if (reg == SIM_OFFSET(GPIO_TypeDef, BSRR)) {
+		uint32_t value = GPIO_R(port, BSRR);
+		GPIO_R(port, ODR) = ((old_odr & ~(value >> 16)) | value) & 0xFFFFU;
+		GPIO_R(port, BSRR) = 0;
+	} else if (reg == SIM_OFFSET(GPIO_TypeDef, IDR)) {
+		GPIO_R(port, IDR) = old;
+	} else if (reg == SIM_OFFSET(GPIO_TypeDef, ODR)) {
+		old_odr = (uint16_t)old;
+		GPIO_R(port, ODR) &= 0xFFFFU;
+	}
+
+	uint16_t new_odr = (uint16_t)GPIO_R(port, ODR);
+	if (new_odr != old_odr) {
+		for (uint8_t i = 0; i < output_listener_count; i++) {
+			output_listeners[i](port, old_odr, new_odr);
+		}
+	}
+	refresh(port);
+}
+
+static void exti_read(uint32_t offset) {
+	if (offset == SIM_OFFSET(EXTI_TypeDef, PR)) {
+		EXTI_R(PR) = exti_pending;
+	}
+}
+
+static void exti_write(uint32_t offset, uint32_t old) {
+	(void)old;
+	if (offset == SIM_OFFSET(EXTI_TypeDef, PR)) {
+		exti_pending &= ~EXTI_R(PR);
+		EXTI_R(PR) = exti_pending;
+	} else if (offset == SIM_OFFSET(EXTI_TypeDef, SWIER)) {
+		exti_pending |= EXTI_R(SWIER) & EXTI_R(IMR);
+		EXTI_R(SWIER) = 0;
+	}
+	exti_update_irqs();
+}
+
+static const sim_periph_t gpio_periph = {
+	.name = "GPIO",
+	.base = GPIOA_BASE,
+	.size = PORT_COUNT * PORT_STRIDE,
+	.reset = gpio_reset,
+	.read = gpio_read,
+	.write = gpio_write,
+};
+
+static const sim_periph_t exti_periph = {
+	.name = "EXTI",
+	.base = EXTI_BASE,
+	.size = 0x400,
+	.read = exti_read,
+	.write = exti_write,
+};
+
+void sim_gpio_register(void) {
+	sim_periph_add(&gpio_periph);
+	sim_periph_add(&exti_periph);
+}
@@ -0,0 +1,429 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * I2C1 in master mode, timed byte by byte from the clock control register.
+ * the flag sequences follow the reference manual closely enough for the HAL
+ * blocking, interrupt and DMA transfers: ADDR clears with a read of SR1 then
+ * SR2, a received byte waiting behind a full DR sets BTF and stretches the
+ * clock, STOP takes effect after the byte in flight. the slave side is the
+ * virtual AHT20
+ */
+
+#include "sim_internal.h"
+
+#define I2C_R(field) SIM_REG(I2C_TypeDef, I2C1_BASE, field)
+
+#define SR1_ERRORS (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_AF | I2C_SR1_OVR | I2C_SR1_PECERR | I2C_SR1_TIMEOUT | I2C_SR1_SMBALERT)
+#define SR1_EVENTS (I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_BTF | I2C_SR1_ADD10 | I2C_SR1_STOPF)
+
+/*
+ * what the running timer completes
+ */
+typedef enum {
+	PHASE_IDLE = 1,
+	PHASE_START,
+	PHASE_ADDRESS,
+	PHASE_TRANSMIT,
+	PHASE_RECEIVE,
+} i2c_phase_t;
+
+static struct {
+	i2c_phase_t phase;
+	bool master;
+	bool transmitter;
+	bool addressed;       /* slave acknowledged, sim_i2c_stop is due */
+	bool data_phase;      /* ADDR cleared, bytes move */
+	bool addr_sr1_read;   /* first half of the ADDR clear sequence */
+	bool stop_pending;
+	bool start_pending;
+	bool receiving;       /* last byte acknowledged, the next one follows */
+	bool shift_full;      /* received byte waiting for DR */
+	bool next_ack;        /* acknowledge latched for the next byte with POS */
+	uint8_t shift;
+	sim_event_t timer;
+	sim_event_t dma_request;
+} i2c;
+
+static uint64_t bit_units(void) {
+	uint32_t ccr = I2C_R(CCR);
+	uint64_t clocks = ccr & I2C_CCR_CCR;
+
+	if (clocks == 0) {
+		clocks = 1;
+	}
+	if (ccr & I2C_CCR_FS) {
+		clocks *= (ccr & I2C_CCR_DUTY) ? 25U : 3U;
+	} else {
+		clocks *= 2U;
+	}
+	return sim_span(clocks, sim_clk.pclk1);
+}
+
+static void update_irq(void) {
+	uint32_t sr1 = I2C_R(SR1);
+	uint32_t cr2 = I2C_R(CR2);
+	bool event = (sr1 & SR1_EVENTS) || ((cr2 & I2C_CR2_ITBUFEN) && (sr1 & (I2C_SR1_TXE | I2C_SR1_RXNE)));
+
+	sim_irq_level(I2C1_EV_IRQn, (cr2 & I2C_CR2_ITEVTEN) && event);
+	sim_irq_level(I2C1_ER_IRQn, (cr2 & I2C_CR2_ITERREN) && (sr1 & SR1_ERRORS));
+}
+
+static void set_sr1(uint32_t set, uint32_t clear) {
+	I2C_R(SR1) = (I2C_R(SR1) & ~clear) | set;
+	update_irq();
+	if ((set & (I2C_SR1_TXE | I2C_SR1_RXNE)) && (I2C_R(CR2) & I2C_CR2_DMAEN)) {
+		sim_event_at(&i2c.dma_request, sim_now);
+	}
+}
+
+static void run_timer(i2c_phase_t phase, uint64_t units) {
+	i2c.phase = phase;
+	sim_event_at(&i2c.timer, sim_now + units);
+}
+
+static void release_bus(void) {
+	if (i2c.addressed) {
+		sim_i2c_stop();
+	}
+	sim_event_cancel(&i2c.timer);
+	i2c.phase = PHASE_IDLE;
+	i2c.master = false;
+	i2c.transmitter = false;
+	i2c.addressed = false;
+	i2c.data_phase = false;
+	i2c.receiving = false;
+	i2c.shift_full = false;
+	i2c.stop_pending = false;
+	i2c.addr_sr1_read = false;
+}
+
+static void generate_stop(void) {
+	/* a byte received behind a full DR stays in the shift register for the next DR read */
+	bool shift_full = i2c.shift_full;
+
+	release_bus();
+	i2c.shift_full = shift_full;
+	I2C_R(CR1) &= ~I2C_CR1_STOP;
+	set_sr1(0, I2C_SR1_TXE | I2C_SR1_BTF | I2C_SR1_SB | I2C_SR1_ADDR);
+}
+
+static void request_start(void) {
+	i2c.start_pending = false;
+	run_timer(PHASE_START, bit_units() / 2U);
+}
+
+/*
+ * the byte in flight has finished: a pending STOP or repeated START goes out now
+ */
+static bool conditions_after_byte(void) {
+	if (i2c.stop_pending) {
+		generate_stop();
+		if (i2c.start_pending) {
+			request_start();
+		}
+		return true;
+	}
+	if (i2c.start_pending) {
+		i2c.data_phase = false;
+		request_start();
+		return true;
+	}
+	return false;
+}
+
+static void transmit_next(void) {
+	i2c.shift = (uint8_t)I2C_R(DR);
+	set_sr1(I2C_SR1_TXE, I2C_SR1_BTF);
+	run_timer(PHASE_TRANSMIT, 9U * bit_units());
+}
+
+static void receive_next(void) {
+	run_timer(PHASE_RECEIVE, 9U * bit_units());
+}
+
+static void start_done(void) {
+	if (sim_aht20_holds_sda()) {
+		/* bus busy, the start condition waits for it */
+		run_timer(PHASE_START, bit_units());
+		return;
+	}
+	if (i2c.addressed) {
+		sim_i2c_stop();
+		i2c.addressed = false;
+	}
+	i2c.phase = PHASE_IDLE;
+	i2c.master = true;
+	i2c.data_phase = false;
+	i2c.receiving = false;
+	i2c.shift_full = false;
+	I2C_R(CR1) &= ~I2C_CR1_START;
+	set_sr1(I2C_SR1_SB, I2C_SR1_TXE | I2C_SR1_BTF | I2C_SR1_RXNE);
+}
+
+static void address_done(void) {
+	i2c.phase = PHASE_IDLE;
+	if (!sim_i2c_address(i2c.shift)) {
+		set_sr1(I2C_SR1_AF, 0);
+		conditions_after_byte();
+		return;
+	}
+	i2c.addressed = true;
+	i2c.transmitter = (i2c.shift & 1U) == 0;
+	i2c.next_ack = (I2C_R(CR1) & I2C_CR1_ACK) != 0;
+	set_sr1(I2C_SR1_ADDR, 0);
+}
+
+static void transmit_done(void) {
+	i2c.phase = PHASE_IDLE;
+	if (!sim_i2c_write(i2c.shift)) {
+		set_sr1(I2C_SR1_AF, 0);
+		conditions_after_byte();
+		return;
+	}
+	if (conditions_after_byte()) {
+		return;
+	}
+	if (!(I2C_R(SR1) & I2C_SR1_TXE)) {
+		transmit_next();
+	} else {
+		set_sr1(I2C_SR1_BTF, 0);
+	}
+}
+
+static bool last_dma_item(void) {
+	if ((I2C_R(CR2) & (I2C_CR2_DMAEN | I2C_CR2_LAST)) != (I2C_CR2_DMAEN | I2C_CR2_LAST)) {
+		return false;
+	}
+	return sim_dma_remaining(1, 0) == 1 || sim_dma_remaining(1, 5) == 1;
+}
+
+static void receive_done(void) {
+	uint32_t cr1 = I2C_R(CR1);
+	uint8_t data = sim_i2c_read();
+	bool ack = (cr1 & I2C_CR1_POS) ? i2c.next_ack : (cr1 & I2C_CR1_ACK) != 0;
+
+	i2c.phase = PHASE_IDLE;
+	if (last_dma_item()) {
+		ack = false;
+	}
+	i2c.next_ack = (cr1 & I2C_CR1_ACK) != 0;
+	i2c.receiving = ack;
+
+	if (!(I2C_R(SR1) & I2C_SR1_RXNE)) {
+		I2C_R(DR) = data;
+		set_sr1(I2C_SR1_RXNE, 0);
+		if (!conditions_after_byte() && ack) {
+			receive_next();
+		}
+	} else {
+		i2c.shift = data;
+		i2c.shift_full = true;
+		set_sr1(I2C_SR1_BTF, 0);
+		conditions_after_byte();
+	}
+}
+
+static void timer_fire(sim_event_t *event) {
+	(void)event;
+
+	switch (i2c.phase) {
+	case PHASE_START:
+		start_done();
+		break;
+	case PHASE_ADDRESS:
+		address_done();
+		break;
+	case PHASE_TRANSMIT:
+		transmit_done();
+		break;
+	case PHASE_RECEIVE:
+		receive_done();
+		break;
+	default:
+		break;
+	}
+}
+
+static void dma_request_fire(sim_event_t *event) {
+	(void)event;
+	uint32_t sr1 = I2C_R(SR1);
+
+	if (!(I2C_R(CR2) & I2C_CR2_DMAEN) || !i2c.data_phase) {
+		return;
+	}
+	if (i2c.transmitter && (sr1 & I2C_SR1_TXE)) {
+		if (!sim_dma_transfer(1, 6, 1)) {
+			sim_dma_transfer(1, 7, 1);
+		}
+	} else if (!i2c.transmitter && (sr1 & I2C_SR1_RXNE)) {
+		if (!sim_dma_transfer(1, 0, 1)) {
+			sim_dma_transfer(1, 5, 1);
+		}
+	}
+}
+
+static void dma_kick(void) {
+	sim_event_at(&i2c.dma_request, sim_now);
+}
+
+/*
+ * ADDR cleared: the transmitter asks for its first byte, the receiver starts clocking
+ */
+static void enter_data_phase(void) {
+	i2c.addr_sr1_read = false;
+	i2c.data_phase = true;
+	set_sr1(0, I2C_SR1_ADDR);
+	if (i2c.transmitter) {
+		set_sr1(I2C_SR1_TXE, 0);
+	} else if (!i2c.stop_pending) {
+		i2c.receiving = true;
+		receive_next();
+	}
+}
+
+static void reset_state(void) {
+	release_bus();
+	i2c.start_pending = false;
+	I2C_R(SR1) = 0;
+	I2C_R(SR2) = 0;
+	update_irq();
+}
+
+/*
+ * register hooks
+ */
+
+static void i2c_reset(void) {
+	i2c.timer.fire = timer_fire;
+	i2c.dma_request.fire = dma_request_fire;
+	i2c.phase = PHASE_IDLE;
+	sim_dma_set_requester(1, 0, 1, dma_kick);
+	sim_dma_set_requester(1, 5, 1, dma_kick);
+	sim_dma_set_requester(1, 6, 1, dma_kick);
+	sim_dma_set_requester(1, 7, 1, dma_kick);
+}
+
+static void i2c_read(uint32_t offset) {
+	if (offset == SIM_OFFSET(I2C_TypeDef, SR2)) {
+		uint32_t sr2 = 0;
+		if (i2c.master) {
+			sr2 |= I2C_SR2_MSL | I2C_SR2_BUSY;
+		}
+		if (i2c.transmitter && i2c.addressed) {
+			sr2 |= I2C_SR2_TRA;
+		}
+		if (sim_aht20_holds_sda() || i2c.phase == PHASE_START) {
+			sr2 |= I2C_SR2_BUSY;
+		}
+		I2C_R(SR2) = sr2;
+	}
+}
+
+static void i2c_read_done(uint32_t offset) {
+	if (offset == SIM_OFFSET(I2C_TypeDef, SR1)) {
+		i2c.addr_sr1_read = (I2C_R(SR1) & I2C_SR1_ADDR) != 0;
+	} else if (offset == SIM_OFFSET(I2C_TypeDef, SR2)) {
+		if (i2c.addr_sr1_read && (I2C_R(SR1) & I2C_SR1_ADDR)) {
+			enter_data_phase();
+		}
+	} else if (offset == SIM_OFFSET(I2C_TypeDef, DR)) {
+		if (!(I2C_R(SR1) & I2C_SR1_RXNE)) {
+			return;
+		}
+		if (!i2c.shift_full) {
+			set_sr1(0, I2C_SR1_RXNE);
+			return;
+		}
+		I2C_R(DR) = i2c.shift;
+		i2c.shift_full = false;
+		set_sr1(I2C_SR1_RXNE, I2C_SR1_BTF);
+		if (i2c.receiving && i2c.master && !i2c.stop_pending && !i2c.start_pending) {
+			receive_next();
+		}
+	}
+}
+
+static void i2c_write(uint32_t offset, uint32_t old) {
+	uint32_t value = *sim_reg(I2C1_BASE + offset);
+
+	if (offset == SIM_OFFSET(I2C_TypeDef, CR1)) {
+		if (((old & I2C_CR1_PE) && !(value & I2C_CR1_PE)) || (value & I2C_CR1_SWRST)) {
+			reset_state();
+			I2C_R(CR1) = value & ~(I2C_CR1_START | I2C_CR1_STOP);
+			return;
+		}
+		if (!(value & I2C_CR1_PE)) {
+			return;
+		}
+		if ((value & I2C_CR1_STOP) && !(old & I2C_CR1_STOP)) {
+			if (i2c.master && i2c.phase != PHASE_IDLE && i2c.phase != PHASE_START) {
+				i2c.stop_pending = true;
+			} else if (i2c.master) {
+				generate_stop();
+			} else {
+				I2C_R(CR1) &= ~I2C_CR1_STOP;
+			}
+		}
+		if ((value & I2C_CR1_START) && !(old & I2C_CR1_START)) {
+			if (i2c.phase == PHASE_IDLE && !i2c.stop_pending) {
+				request_start();
+			} else if (i2c.phase != PHASE_START) {
+				i2c.start_pending = true;
+			}
+		}
+	} else if (offset == SIM_OFFSET(I2C_TypeDef, CR2)) {
+		update_irq();
+		if ((value & I2C_CR2_DMAEN) && !(old & I2C_CR2_DMAEN)) {
+			sim_event_at(&i2c.dma_request, sim_now);
+		}
+	} else if (offset == SIM_OFFSET(I2C_TypeDef, SR1)) {
+		I2C_R(SR1) = (old & ~SR1_ERRORS) | (old & value & SR1_ERRORS);
+		update_irq();
+	} else if (offset == SIM_OFFSET(I2C_TypeDef, SR2)) {
+		I2C_R(SR2) = old;
+	} else if (offset == SIM_OFFSET(I2C_TypeDef, DR)) {
+		uint32_t sr1 = I2C_R(SR1);
+		if (sr1 & I2C_SR1_SB) {
+			i2c.shift = (uint8_t)value;
+			set_sr1(0, I2C_SR1_SB);
+			run_timer(PHASE_ADDRESS, 9U * bit_units());
+		} else if (i2c.master && i2c.transmitter && i2c.data_phase) {
+			if (i2c.phase == PHASE_IDLE && !(sr1 & I2C_SR1_AF)) {
+				transmit_next();
+			} else {
+				set_sr1(0, I2C_SR1_TXE);
+			}
+		}
+	}
+}
+
+static const sim_periph_t i2c1_periph = {
+	.name = "I2C1",
+	.base = I2C1_BASE,
+	.size = 0x400,
+	.reset = i2c_reset,
+	.read = i2c_read,
+	.read_done = i2c_read_done,
+	.write = i2c_write,
+};
+
+void sim_i2c_register(void) {
+	sim_periph_add(&i2c1_periph);
+}
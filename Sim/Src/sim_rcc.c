@@ -0,0 +1,354 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * reset and clock control, power control and the flash interface with its
+ * memory array. oscillators and the PLL lock at once, the system clock switch
+ * follows SW, Stop mode stops every high speed clock and leaves HSI selected
+ */
+
+#include "sim_internal.h"
+#include <string.h>
+
+#define HSI_HZ 16000000U
+#define HSE_HZ 8000000U
+
+#define RCC_R(field) SIM_REG(RCC_TypeDef, RCC_BASE, field)
+#define PWR_R(field) SIM_REG(PWR_TypeDef, PWR_BASE, field)
+#define FLASH_R(field) SIM_REG(FLASH_TypeDef, FLASH_R_BASE, field)
+
+#define FLASH_KEY_1 0x45670123U
+#define FLASH_KEY_2 0xCDEF89ABU
+#define FLASH_SR_ERRORS (FLASH_SR_SOP | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR | FLASH_SR_RDERR)
+
+/*
+ * word programming time and sector erase times by size and parallelism (x8..x64), in us
+ */
+#define PROGRAM_TIME_US 16U
+
+static const uint32_t ERASE_TIME_US[3][4] = {
+	{ 400000U, 300000U, 250000U, 200000U },
+	{ 1100000U, 700000U, 500000U, 400000U },
+	{ 2000000U, 1300000U, 1000000U, 800000U },
+};
+
+static uint32_t lsi_hz = 32000U;
+static uint8_t key_stage = 0;
+static sim_flash_stats_t flash_stats = {0};
+
+void sim_rtc_backup_reset(void);
+
+/*
+ * clock tree from the RCC registers
+ */
+static void update_clocks(void) {
+	static const uint16_t AHB_DIVIDERS[8] = { 2, 4, 8, 16, 64, 128, 256, 512 };
+	uint32_t cfgr = RCC_R(CFGR);
+	uint32_t pllcfgr = RCC_R(PLLCFGR);
+	uint32_t pll_in = (pllcfgr & RCC_PLLCFGR_PLLSRC) ? HSE_HZ : HSI_HZ;
+	uint32_t pllm = pllcfgr & RCC_PLLCFGR_PLLM;
+	uint32_t plln = (pllcfgr & RCC_PLLCFGR_PLLN) >> RCC_PLLCFGR_PLLN_Pos;
+	uint32_t pllp = (((pllcfgr & RCC_PLLCFGR_PLLP) >> RCC_PLLCFGR_PLLP_Pos) + 1U) * 2U;
+	uint32_t pllr = (pllcfgr & RCC_PLLCFGR_PLLR) >> RCC_PLLCFGR_PLLR_Pos;
+	uint64_t vco = pllm != 0 ? (uint64_t)pll_in / pllm * plln : 0;
+	sim_clocks_t clocks = sim_clk;
+
+	switch ((cfgr & RCC_CFGR_SWS) >> RCC_CFGR_SWS_Pos) {
+	case 0:
+		clocks.sysclk = HSI_HZ;
+		break;
+	case 1:
+		clocks.sysclk = HSE_HZ;
+		break;
+	case 2:
+		clocks.sysclk = (uint32_t)(vco / pllp);
+		break;
+	default:
+		clocks.sysclk = pllr != 0 ? (uint32_t)(vco / pllr) : 0;
+		break;
+	}
+
+	uint32_t hpre = (cfgr & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos;
+	uint32_t ppre1 = (cfgr & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+	uint32_t ppre2 = (cfgr & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos;
+	uint32_t apb1 = (ppre1 & 4U) ? 2U << (ppre1 & 3U) : 1U;
+	uint32_t apb2 = (ppre2 & 4U) ? 2U << (ppre2 & 3U) : 1U;
+
+	clocks.hclk = (hpre & 8U) ? clocks.sysclk / AHB_DIVIDERS[hpre & 7U] : clocks.sysclk;
+	clocks.pclk1 = clocks.hclk / apb1;
+	clocks.pclk2 = clocks.hclk / apb2;
+	clocks.tim1 = apb1 == 1U ? clocks.pclk1 : clocks.pclk1 * 2U;
+	clocks.tim2 = apb2 == 1U ? clocks.pclk2 : clocks.pclk2 * 2U;
+	clocks.lsi = (RCC_R(CSR) & RCC_CSR_LSION) ? lsi_hz : 0U;
+	clocks.stopped = false;
+
+	if (memcmp(&clocks, &sim_clk, sizeof(clocks)) != 0) {
+		sim_clocks_set(&clocks);
+	}
+}
+
+static void rcc_reset(void) {
+	RCC_R(CR) = RCC_CR_HSION | RCC_CR_HSIRDY | (0x10U << RCC_CR_HSITRIM_Pos);
+	RCC_R(PLLCFGR) = 0x24003010U;
+	RCC_R(CSR) = RCC_CSR_PORRSTF | RCC_CSR_PINRSTF | RCC_CSR_BORRSTF;
+	RCC_R(AHB1ENR) = 0x00100000U;
+	RCC_R(PLLI2SCFGR) = 0x24003010U;
+	RCC_R(PLLSAICFGR) = 0x04003010U;
+}
+
+static void rcc_write(uint32_t offset, uint32_t old) {
+	volatile uint32_t *reg = sim_reg(RCC_BASE + offset);
+	uint32_t value = *reg;
+
+	if (offset == SIM_OFFSET(RCC_TypeDef, CR)) {
+		value &= ~(RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY | RCC_CR_PLLI2SRDY | RCC_CR_PLLSAIRDY);
+		value |= (value & RCC_CR_HSION) << 1;
+		value |= (value & RCC_CR_HSEON) << 1;
+		value |= (value & RCC_CR_PLLON) << 1;
+		value |= (value & RCC_CR_PLLI2SON) << 1;
+		value |= (value & RCC_CR_PLLSAION) << 1;
+		*reg = value;
+		update_clocks();
+	} else if (offset == SIM_OFFSET(RCC_TypeDef, CFGR)) {
+		uint32_t sw = value & RCC_CFGR_SW;
+		uint32_t cr = RCC_R(CR);
+		bool ready = (sw == 0 && (cr & RCC_CR_HSIRDY)) || (sw == 1 && (cr & RCC_CR_HSERDY)) || (sw >= 2 && (cr & RCC_CR_PLLRDY));
+		uint32_t sws = ready ? sw : (old & RCC_CFGR_SWS) >> RCC_CFGR_SWS_Pos;
+		*reg = (value & ~RCC_CFGR_SWS) | (sws << RCC_CFGR_SWS_Pos);
+		update_clocks();
+	} else if (offset == SIM_OFFSET(RCC_TypeDef, PLLCFGR)) {
+		update_clocks();
+	} else if (offset == SIM_OFFSET(RCC_TypeDef, BDCR)) {
+		if (value & RCC_BDCR_BDRST) {
+			*reg = RCC_BDCR_BDRST;
+			sim_rtc_backup_reset();
+		} else {
+			*reg = (value & ~RCC_BDCR_LSERDY) | ((value & RCC_BDCR_LSEON) << 1);
+		}
+	} else if (offset == SIM_OFFSET(RCC_TypeDef, CSR)) {
+		value = (value & ~RCC_CSR_LSIRDY) | ((value & RCC_CSR_LSION) << 1);
+		if (value & RCC_CSR_RMVF) {
+			value &= 0x00FFFFFFU;
+		}
+		*reg = value;
+		update_clocks();
+	}
+}
+
+void sim_rcc_enter_stop(void) {
+	sim_clocks_t clocks = sim_clk;
+	clocks.sysclk = clocks.hclk = clocks.pclk1 = clocks.pclk2 = clocks.tim1 = clocks.tim2 = 0;
+	clocks.stopped = true;
+	sim_clocks_set(&clocks);
+}
+
+void sim_rcc_exit_stop(void) {
+	RCC_R(CR) = (RCC_R(CR) & ~(RCC_CR_PLLON | RCC_CR_PLLRDY | RCC_CR_HSEON | RCC_CR_HSERDY | RCC_CR_PLLI2SON | RCC_CR_PLLI2SRDY | RCC_CR_PLLSAION | RCC_CR_PLLSAIRDY)) | RCC_CR_HSION | RCC_CR_HSIRDY;
+	RCC_R(CFGR) &= ~(RCC_CFGR_SW | RCC_CFGR_SWS);
+	update_clocks();
+}
+
+void sim_set_lsi_hz(uint32_t hz) {
+	lsi_hz = hz;
+	if (sim_clk.lsi != 0) {
+		update_clocks();
+	}
+}
+
+/*
+ * PWR
+ */
+
+static void pwr_reset(void) {
+	PWR_R(CR) = 0x0000C000U;
+	PWR_R(CSR) = PWR_CSR_VOSRDY;
+}
+
+static void pwr_write(uint32_t offset, uint32_t old) {
+	(void)old;
+	if (offset == SIM_OFFSET(PWR_TypeDef, CR)) {
+		uint32_t value = PWR_R(CR);
+		uint32_t csr = PWR_R(CSR) & ~(PWR_CSR_ODRDY | PWR_CSR_ODSWRDY);
+		if (value & PWR_CR_CWUF) {
+			csr &= ~PWR_CSR_WUF;
+		}
+		if (value & PWR_CR_CSBF) {
+			csr &= ~PWR_CSR_SBF;
+		}
+		if (value & PWR_CR_ODEN) {
+			csr |= PWR_CSR_ODRDY;
+		}
+		if (value & PWR_CR_ODSWEN) {
+			csr |= PWR_CSR_ODSWRDY;
+		}
+		PWR_R(CSR) = csr;
+		PWR_R(CR) = value & ~(PWR_CR_CWUF | PWR_CR_CSBF);
+	} else if (offset == SIM_OFFSET(PWR_TypeDef, CSR)) {
+		PWR_R(CSR) = (old & ~(PWR_CSR_EWUP1 | PWR_CSR_EWUP2 | PWR_CSR_BRE)) | (PWR_R(CSR) & (PWR_CSR_EWUP1 | PWR_CSR_EWUP2 | PWR_CSR_BRE));
+	}
+}
+
+bool sim_pwr_stop_selected(void) {
+	if (PWR_R(CR) & PWR_CR_PDDS) {
+		sim_fatal("Standby mode is not simulated");
+	}
+	return true;
+}
+
+/*
+ * flash interface
+ */
+
+static void flash_reset(void) {
+	FLASH_R(CR) = FLASH_CR_LOCK;
+	FLASH_R(OPTCR) = 0x0FFFAAEDU;
+}
+
+static bool flash_sector(uint32_t sector, uint32_t *start, uint32_t *size, uint8_t *size_class) {
+	if (sector < 4) {
+		*start = FLASH_BASE + sector * 0x4000U;
+		*size = 0x4000U;
+		*size_class = 0;
+	} else if (sector == 4) {
+		*start = FLASH_BASE + 0x10000U;
+		*size = 0x10000U;
+		*size_class = 1;
+	} else if (sector < 8) {
+		*start = FLASH_BASE + 0x20000U + (sector - 5U) * 0x20000U;
+		*size = 0x20000U;
+		*size_class = 2;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static void flash_erase(uint32_t cr) {
+	uint32_t sector = (cr & FLASH_CR_SNB) >> FLASH_CR_SNB_Pos;
+	uint32_t psize = (cr & FLASH_CR_PSIZE) >> FLASH_CR_PSIZE_Pos;
+	uint32_t start;
+	uint32_t size;
+	uint8_t size_class;
+
+	if (!flash_sector(sector, &start, &size, &size_class)) {
+		FLASH_R(SR) |= FLASH_SR_WRPERR;
+		return;
+	}
+
+	FLASH_R(SR) |= FLASH_SR_BSY;
+	uint64_t stall = (uint64_t)ERASE_TIME_US[size_class][psize] * SIM_UNITS_PER_US;
+	flash_stats.stall_units += stall;
+	sim_stall(stall);
+
+	memset((void *)sim_reg(start), 0xFF, size);
+	flash_stats.sector_erases++;
+	FLASH_R(SR) &= ~FLASH_SR_BSY;
+	if (cr & FLASH_CR_EOPIE) {
+		FLASH_R(SR) |= FLASH_SR_EOP;
+	}
+}
+
+static void flash_write(uint32_t offset, uint32_t old) {
+	volatile uint32_t *reg = sim_reg(FLASH_R_BASE + offset);
+	uint32_t value = *reg;
+
+	if (offset == SIM_OFFSET(FLASH_TypeDef, KEYR)) {
+		if (key_stage == 0 && value == FLASH_KEY_1) {
+			key_stage = 1;
+		} else if (key_stage == 1 && value == FLASH_KEY_2) {
+			FLASH_R(CR) &= ~FLASH_CR_LOCK;
+			key_stage = 0;
+		} else {
+			key_stage = 0;
+		}
+		*reg = 0;
+	} else if (offset == SIM_OFFSET(FLASH_TypeDef, CR)) {
+		if (old & FLASH_CR_LOCK) {
+			*reg = old;
+			return;
+		}
+		*reg = value & ~FLASH_CR_STRT;
+		if ((value & FLASH_CR_STRT) && (value & FLASH_CR_SER)) {
+			flash_erase(value);
+		} else if ((value & FLASH_CR_STRT) && (value & FLASH_CR_MER)) {
+			sim_fatal("mass erase would wipe the firmware");
+		}
+	} else if (offset == SIM_OFFSET(FLASH_TypeDef, SR)) {
+		*reg = (old & ~(value & (FLASH_SR_EOP | FLASH_SR_ERRORS)));
+	}
+}
+
+void sim_flash_program(uint32_t address, uint64_t old, uint64_t *value) {
+	uint32_t cr = FLASH_R(CR);
+	(void)address;
+
+	if ((cr & FLASH_CR_LOCK) || !(cr & FLASH_CR_PG)) {
+		FLASH_R(SR) |= (cr & FLASH_CR_LOCK) ? FLASH_SR_WRPERR : FLASH_SR_PGSERR;
+		flash_stats.program_errors++;
+		*value = old;
+		return;
+	}
+
+	*value &= old;
+	flash_stats.words_programmed++;
+	flash_stats.stall_units += (uint64_t)PROGRAM_TIME_US * SIM_UNITS_PER_US;
+	sim_stall((uint64_t)PROGRAM_TIME_US * SIM_UNITS_PER_US);
+	if (cr & FLASH_CR_EOPIE) {
+		FLASH_R(SR) |= FLASH_SR_EOP;
+	}
+}
+
+uint8_t *sim_flash_at(uint32_t address) {
+	sim_init();
+	return (uint8_t *)sim_reg(address & ~3U) + (address & 3U);
+}
+
+void sim_flash_get_stats(sim_flash_stats_t *stats) {
+	*stats = flash_stats;
+}
+
+static const sim_periph_t rcc_periph = {
+	.name = "RCC",
+	.base = RCC_BASE,
+	.size = 0x400,
+	.reset = rcc_reset,
+	.write = rcc_write,
+};
+
+static const sim_periph_t pwr_periph = {
+	.name = "PWR",
+	.base = PWR_BASE,
+	.size = 0x400,
+	.reset = pwr_reset,
+	.write = pwr_write,
+};
+
+static const sim_periph_t flash_periph = {
+	.name = "FLASH",
+	.base = FLASH_R_BASE,
+	.size = 0x400,
+	.reset = flash_reset,
+	.write = flash_write,
+};
+
+void sim_rcc_register(void) {
+	sim_periph_add(&rcc_periph);
+	sim_periph_add(&pwr_periph);
+	sim_periph_add(&flash_periph);
+}
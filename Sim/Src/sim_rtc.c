@@ -0,0 +1,278 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * RTC clocked from LSI: calendar time and sub-seconds computed from the cycles
+ * counted since initialization mode was left, and the periodic wakeup timer
+ * driving EXTI line 22. registers are write protected until the key sequence
+ */
+
+#include "sim_internal.h"
+
+#define RTC_R(field) SIM_REG(RTC_TypeDef, RTC_BASE, field)
+#define RCC_BDCR (*sim_reg(RCC_BASE + SIM_OFFSET(RCC_TypeDef, BDCR)))
+
+#define WAKEUP_EXTI_LINE 22U
+#define SECONDS_PER_DAY 86400U
+
+/*
+ * flags of ISR cleared by writing 0, writable without the keys
+ */
+#define ISR_FLAGS (RTC_ISR_WUTF | RTC_ISR_ALRAF | RTC_ISR_ALRBF | RTC_ISR_TSF | RTC_ISR_TSOVF | RTC_ISR_TAMP1F | RTC_ISR_TAMP2F)
+
+static struct {
+	uint8_t key_stage;
+	/* RTCCLK cycles counted up to anchor */
+	uint64_t cycles;
+	uint64_t anchor;
+	/* calendar: seconds at calendar_start, cycle count where it started */
+	uint32_t base_seconds;
+	uint64_t calendar_start;
+	bool counting;
+	/* wakeup timer: cycle count of the next WUTF */
+	uint64_t wakeup_at;
+	sim_event_t wakeup;
+} rtc;
+
+static uint32_t rtc_hz(void) {
+	uint32_t bdcr = RCC_BDCR;
+	if (!(bdcr & RCC_BDCR_RTCEN) || (bdcr & RCC_BDCR_RTCSEL) != RCC_BDCR_RTCSEL_1) {
+		return 0;
+	}
+	return sim_clk.lsi;
+}
+
+/*
+ * brings the cycle count up to now
+ */
+static void sync(void) {
+	uint32_t hz = rtc_hz();
+	if (hz == 0) {
+		rtc.anchor = sim_now;
+		return;
+	}
+	uint64_t elapsed = sim_cycles(sim_now - rtc.anchor, hz);
+	rtc.cycles += elapsed;
+	rtc.anchor += (uint64_t)(((unsigned __int128)elapsed * SIM_CLOCK_HZ) / hz);
+}
+
+static uint32_t prediv_a(void) {
+	return ((RTC_R(PRER) & RTC_PRER_PREDIV_A) >> RTC_PRER_PREDIV_A_Pos) + 1U;
+}
+
+static uint32_t prediv_s(void) {
+	return (RTC_R(PRER) & RTC_PRER_PREDIV_S) + 1U;
+}
+
+static uint32_t from_bcd(uint32_t value) {
+	return ((value >> 4) & 0x0FU) * 10U + (value & 0x0FU);
+}
+
+static uint32_t to_bcd(uint32_t value) {
+	return ((value / 10U) << 4) | (value % 10U);
+}
+
+static uint32_t decode_time(uint32_t tr) {
+	uint32_t hours = from_bcd((tr & (RTC_TR_HT | RTC_TR_HU)) >> RTC_TR_HU_Pos);
+	uint32_t minutes = from_bcd((tr & (RTC_TR_MNT | RTC_TR_MNU)) >> RTC_TR_MNU_Pos);
+	uint32_t seconds = from_bcd(tr & (RTC_TR_ST | RTC_TR_SU));
+	return (hours * 60U + minutes) * 60U + seconds;
+}
+
+static uint32_t encode_time(uint32_t seconds) {
+	seconds %= SECONDS_PER_DAY;
+	return (to_bcd(seconds / 3600U) << RTC_TR_HU_Pos) | (to_bcd(seconds / 60U % 60U) << RTC_TR_MNU_Pos) | to_bcd(seconds % 60U);
+}
+
+static void update_calendar(void) {
+	if (!rtc.counting) {
+		return;
+	}
+	uint64_t apre = (rtc.cycles - rtc.calendar_start) / prediv_a();
+	uint32_t per_second = prediv_s();
+
+	RTC_R(TR) = encode_time(rtc.base_seconds + (uint32_t)(apre / per_second));
+	RTC_R(SSR) = per_second - 1U - (uint32_t)(apre % per_second);
+}
+
+/*
+ * wakeup timer period in RTCCLK cycles
+ */
+static uint64_t wakeup_period(void) {
+	uint32_t select = RTC_R(CR) & RTC_CR_WUCKSEL;
+	uint64_t count = (uint64_t)(RTC_R(WUTR) & RTC_WUTR_WUT) + 1U;
+
+	if (select < 4U) {
+		return count * (16U >> select);
+	}
+	if (select >= 6U) {
+		count += 0x10000U;
+	}
+	return count * prediv_a() * prediv_s();
+}
+
+static void schedule_wakeup(void) {
+	uint32_t hz = rtc_hz();
+	if (!(RTC_R(CR) & RTC_CR_WUTE) || hz == 0) {
+		sim_event_cancel(&rtc.wakeup);
+		return;
+	}
+	uint64_t ahead = rtc.wakeup_at > rtc.cycles ? rtc.wakeup_at - rtc.cycles : 0;
+	sim_event_at(&rtc.wakeup, rtc.anchor + sim_span(ahead, hz));
+}
+
+static void wakeup_fire(sim_event_t *event) {
+	(void)event;
+	sync();
+	rtc.wakeup_at += wakeup_period();
+	RTC_R(ISR) |= RTC_ISR_WUTF;
+	sim_exti_line(WAKEUP_EXTI_LINE, true);
+	schedule_wakeup();
+}
+
+static bool unlocked(void) {
+	return rtc.key_stage == 2;
+}
+
+void sim_rtc_backup_reset(void) {
+	sim_event_cancel(&rtc.wakeup);
+	rtc.key_stage = 0;
+	rtc.cycles = 0;
+	rtc.anchor = sim_now;
+	rtc.base_seconds = 0;
+	rtc.calendar_start = 0;
+	rtc.counting = true;
+	rtc.wakeup_at = 0;
+	RTC_R(TR) = 0;
+	RTC_R(DR) = 0x00002101U;
+	RTC_R(CR) = 0;
+	RTC_R(ISR) = RTC_ISR_ALRAWF | RTC_ISR_ALRBWF | RTC_ISR_WUTWF;
+	RTC_R(PRER) = 0x007F00FFU;
+	RTC_R(WUTR) = 0x0000FFFFU;
+	RTC_R(SSR) = 0;
+	sim_exti_line(WAKEUP_EXTI_LINE, false);
+}
+
+/*
+ * register hooks
+ */
+
+static void rtc_reset(void) {
+	rtc.wakeup.fire = wakeup_fire;
+	sim_rtc_backup_reset();
+}
+
+static void rtc_read(uint32_t offset) {
+	if (offset == SIM_OFFSET(RTC_TypeDef, TR) || offset == SIM_OFFSET(RTC_TypeDef, SSR)) {
+		sync();
+		update_calendar();
+	} else if (offset == SIM_OFFSET(RTC_TypeDef, WPR)) {
+		RTC_R(WPR) = 0;
+	}
+}
+
+static void rtc_write(uint32_t offset, uint32_t old) {
+	volatile uint32_t *reg = sim_reg(RTC_BASE + offset);
+	uint32_t value = *reg;
+
+	sync();
+	if (offset == SIM_OFFSET(RTC_TypeDef, WPR)) {
+		uint8_t key = (uint8_t)value;
+		if (key == 0xCA) {
+			rtc.key_stage = 1;
+		} else if (key == 0x53 && rtc.key_stage == 1) {
+			rtc.key_stage = 2;
+		} else {
+			rtc.key_stage = 0;
+		}
+		*reg = 0;
+		return;
+	}
+	if (offset == SIM_OFFSET(RTC_TypeDef, ISR)) {
+		uint32_t isr = (old & ~ISR_FLAGS) | (old & value & ISR_FLAGS);
+		if (unlocked()) {
+			bool entering = (value & RTC_ISR_INIT) && !(old & RTC_ISR_INIT);
+			bool leaving = !(value & RTC_ISR_INIT) && (old & RTC_ISR_INIT);
+			if (entering) {
+				update_calendar();
+				rtc.counting = false;
+			} else if (leaving) {
+				rtc.base_seconds = decode_time(RTC_R(TR));
+				rtc.calendar_start = rtc.cycles;
+				rtc.counting = true;
+			}
+			isr = (isr & ~(RTC_ISR_INIT | RTC_ISR_INITF)) | ((value & RTC_ISR_INIT) ? RTC_ISR_INIT | RTC_ISR_INITF : 0U);
+		}
+		*reg = isr;
+		if (!(isr & RTC_ISR_WUTF)) {
+			sim_exti_line(WAKEUP_EXTI_LINE, false);
+		}
+		return;
+	}
+	if (!unlocked() && offset < SIM_OFFSET(RTC_TypeDef, BKP0R)) {
+		*reg = old;
+		return;
+	}
+	if (offset == SIM_OFFSET(RTC_TypeDef, CR)) {
+		if ((value ^ old) & RTC_CR_WUTE) {
+			if (value & RTC_CR_WUTE) {
+				RTC_R(ISR) &= ~RTC_ISR_WUTWF;
+				rtc.wakeup_at = rtc.cycles + wakeup_period();
+			} else {
+				RTC_R(ISR) |= RTC_ISR_WUTWF;
+			}
+		}
+		schedule_wakeup();
+	} else if (offset == SIM_OFFSET(RTC_TypeDef, TR) || offset == SIM_OFFSET(RTC_TypeDef, PRER)) {
+		if (!(RTC_R(ISR) & RTC_ISR_INITF)) {
+			*reg = old;
+		}
+	} else if (offset == SIM_OFFSET(RTC_TypeDef, WUTR)) {
+		if (!(RTC_R(ISR) & RTC_ISR_WUTWF)) {
+			*reg = old;
+		}
+	}
+}
+
+static void rtc_sync(void) {
+	sync();
+}
+
+static void rtc_resched(void) {
+	schedule_wakeup();
+}
+
+static const sim_clock_listener_t rtc_listener = {
+	.sync = rtc_sync,
+	.resched = rtc_resched,
+};
+
+static const sim_periph_t rtc_periph = {
+	.name = "RTC",
+	.base = RTC_BASE,
+	.size = 0x400,
+	.reset = rtc_reset,
+	.read = rtc_read,
+	.write = rtc_write,
+};
+
+void sim_rtc_register(void) {
+	sim_periph_add(&rtc_periph);
+	sim_clock_listen(&rtc_listener);
+}
@@ -0,0 +1,471 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * system control space of the Cortex-M4: NVIC, SCB, SysTick, DWT cycle counter
+ */
+
+#include "sim_internal.h"
+#include <stddef.h>
+
+#define DWT_BASE_ADDRESS 0xE0001000UL
+
+#define IRQ_COUNT 97
+#define EXCEPTION_COUNT (16 + IRQ_COUNT)
+#define SYSTICK_EXCEPTION 15
+#define PENDSV_EXCEPTION 14
+#define NO_EXCEPTION (-1)
+#define THREAD_PRIORITY 0x7FFFFFFF
+
+/*
+ * cycles of exception entry (stacking, vector fetch) and return
+ */
+#define ENTRY_CYCLES 12
+#define RETURN_CYCLES 10
+
+/*
+ * register offsets in the system control space
+ */
+#define SYST_CSR 0x010
+#define SYST_RVR 0x014
+#define SYST_CVR 0x018
+#define SYST_CALIB 0x01C
+#define NVIC_ISER 0x100
+#define NVIC_ICER 0x180
+#define NVIC_ISPR 0x200
+#define NVIC_ICPR 0x280
+#define NVIC_IABR 0x300
+#define NVIC_IPR 0x400
+#define SCB_CPUID 0xD00
+#define SCB_ICSR 0xD04
+#define SCB_AIRCR 0xD0C
+#define SCB_SHPR 0xD18
+#define DEMCR 0xDFC
+#define NVIC_STIR 0xF00
+
+#define SYST_CSR_ENABLE (1U << 0)
+#define SYST_CSR_TICKINT (1U << 1)
+#define SYST_CSR_CLKSOURCE (1U << 2)
+#define SYST_CSR_COUNTFLAG (1U << 16)
+
+#define ICSR_PENDSTCLR (1U << 25)
+#define ICSR_PENDSTSET (1U << 26)
+#define ICSR_PENDSVCLR (1U << 27)
+#define ICSR_PENDSVSET (1U << 28)
+#define ICSR_ISRPENDING (1U << 22)
+
+#define DEMCR_TRCENA (1U << 24)
+#define DWT_CTRL_CYCCNTENA (1U << 0)
+
+/*
+ * handlers by exception number, generated from the startup file vector table
+ */
+extern void (*const sim_vectors[EXCEPTION_COUNT])(void);
+
+static bool enabled[EXCEPTION_COUNT];
+static bool pending[EXCEPTION_COUNT];
+static bool active[EXCEPTION_COUNT];
+static bool level[EXCEPTION_COUNT];
+static int8_t active_stack[EXCEPTION_COUNT];
+static uint8_t depth = 0;
+static uint8_t prigroup = 0;
+
+/*
+ * SysTick: the counter reaches zero at zero_at while running, holds frozen otherwise
+ */
+static struct {
+	bool running;
+	uint64_t zero_at;
+	uint32_t frozen;
+	sim_event_t wrap;
+} systick;
+
+/*
+ * DWT cycle counter: value at anchor plus core cycles since then while counting
+ */
+static struct {
+	bool counting;
+	uint32_t base;
+	uint64_t anchor;
+} cyccnt;
+
+static volatile uint32_t *scs(uint32_t offset) {
+	return sim_reg(SCS_BASE + offset);
+}
+
+static uint8_t scs_byte(uint32_t offset) {
+	return ((volatile uint8_t *)scs(offset & ~3U))[offset & 3U];
+}
+
+static uint8_t priority_of(int exception) {
+	if (exception >= 16) {
+		return scs_byte(NVIC_IPR + (uint32_t)(exception - 16));
+	}
+	if (exception >= 4) {
+		return scs_byte(SCB_SHPR + (uint32_t)(exception - 4));
+	}
+	return 0;
+}
+
+static int group_of(int exception) {
+	return priority_of(exception) >> (prigroup + 1U);
+}
+
+static int execution_priority(bool masked) {
+	int priority = THREAD_PRIORITY;
+	for (uint8_t i = 0; i < depth; i++) {
+		int group = group_of(active_stack[i]);
+		if (group < priority) {
+			priority = group;
+		}
+	}
+	if (masked && priority > 0) {
+		priority = 0;
+	}
+	return priority;
+}
+
+/*
+ * highest priority pending exception: lowest priority value, then lowest number
+ */
+static int best_pending(void) {
+	int best = NO_EXCEPTION;
+	for (int exception = 2; exception < EXCEPTION_COUNT; exception++) {
+		if (!pending[exception] || (exception >= 16 && !enabled[exception])) {
+			continue;
+		}
+		if (best == NO_EXCEPTION || priority_of(exception) < priority_of(best)) {
+			best = exception;
+		}
+	}
+	return best;
+}
+
+static void take(int exception) {
+	void (*handler)(void) = sim_vectors[exception];
+	if (handler == NULL) {
+		sim_fatal("exception %d has no handler", exception);
+	}
+
+	pending[exception] = false;
+	active[exception] = true;
+	active_stack[depth++] = (int8_t)exception;
+	sim_core_clrex();
+	sim_core_charge(ENTRY_CYCLES);
+
+	handler();
+
+	sim_core_charge(RETURN_CYCLES);
+	depth--;
+	active[exception] = false;
+	if (level[exception]) {
+		pending[exception] = true;
+	}
+}
+
+void sim_nvic_deliver(void) {
+	for (;;) {
+		int exception = best_pending();
+		if (exception == NO_EXCEPTION || group_of(exception) >= execution_priority(sim_core_masked())) {
+			return;
+		}
+		take(exception);
+	}
+}
+
+bool sim_nvic_wake_pending(void) {
+	int exception = best_pending();
+	return exception != NO_EXCEPTION && group_of(exception) < execution_priority(false);
+}
+
+bool sim_nvic_in_handler(void) {
+	return depth > 0;
+}
+
+void sim_irq_level(int irqn, bool high) {
+	int exception = irqn + 16;
+	level[exception] = high;
+	if (high && !active[exception]) {
+		pending[exception] = true;
+	}
+}
+
+void sim_irq_pulse(int irqn) {
+	pending[irqn + 16] = true;
+}
+
+void sim_systick_pend(void) {
+	pending[SYSTICK_EXCEPTION] = true;
+}
+
+/*
+ * SysTick
+ */
+
+static uint32_t systick_hz(void) {
+	uint32_t csr = *scs(SYST_CSR);
+	return (csr & SYST_CSR_CLKSOURCE) ? sim_clk.hclk : sim_clk.hclk / 8U;
+}
+
+static uint32_t systick_reload(void) {
+	return *scs(SYST_RVR) & 0x00FFFFFFU;
+}
+
+static uint32_t systick_value(void) {
+	if (!systick.running) {
+		return systick.frozen;
+	}
+	/* the counter runs down from the value loaded at the last wrap, a new reload applies at the next one */
+	uint64_t left = sim_cycles(systick.zero_at - sim_now, systick_hz());
+	return left > 0x00FFFFFFU ? 0x00FFFFFFU : (uint32_t)left;
+}
+
+static void systick_arm(uint32_t value) {
+	uint32_t hz = systick_hz();
+	bool enabled_now = (*scs(SYST_CSR) & SYST_CSR_ENABLE) != 0;
+
+	systick.running = enabled_now && hz != 0;
+	if (!systick.running) {
+		systick.frozen = value;
+		sim_event_cancel(&systick.wrap);
+		return;
+	}
+	uint64_t cycles = value != 0 ? value : (uint64_t)systick_reload() + 1U;
+	if (value == 0 && systick_reload() == 0) {
+		systick.running = false;
+		systick.frozen = 0;
+		sim_event_cancel(&systick.wrap);
+		return;
+	}
+	systick.zero_at = sim_now + sim_span(cycles, hz);
+	sim_event_at(&systick.wrap, systick.zero_at);
+}
+
+static void systick_wrap(sim_event_t *event) {
+	(void)event;
+	*scs(SYST_CSR) |= SYST_CSR_COUNTFLAG;
+	if (*scs(SYST_CSR) & SYST_CSR_TICKINT) {
+		pending[SYSTICK_EXCEPTION] = true;
+	}
+	systick_arm(0);
+}
+
+static void systick_sync(void) {
+	systick.frozen = systick_value();
+}
+
+static void systick_resched(void) {
+	systick_arm(systick.frozen);
+}
+
+static const sim_clock_listener_t systick_listener = {
+	.sync = systick_sync,
+	.resched = systick_resched,
+};
+
+/*
+ * DWT cycle counter
+ */
+
+static uint32_t cyccnt_value(void) {
+	if (!cyccnt.counting) {
+		return cyccnt.base;
+	}
+	return cyccnt.base + (uint32_t)(sim_core_cycles() - cyccnt.anchor);
+}
+
+static void cyccnt_update(void) {
+	bool counting = (*scs(DEMCR) & DEMCR_TRCENA) && (*sim_reg(DWT_BASE_ADDRESS) & DWT_CTRL_CYCCNTENA);
+	cyccnt.base = cyccnt_value();
+	cyccnt.anchor = sim_core_cycles();
+	cyccnt.counting = counting;
+}
+
+/*
+ * register hooks
+ */
+
+static void scs_reset(void) {
+	*scs(SCB_CPUID) = 0x410FC241U;
+	*scs(SCB_AIRCR) = 0xFA050000U;
+	*scs(SYST_CALIB) = 0x40002903U;
+	systick.wrap.fire = systick_wrap;
+}
+
+static uint32_t bank_bits(const bool *bits, uint32_t bank) {
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < 32; i++) {
+		uint32_t irq = bank * 32U + i;
+		if (irq < IRQ_COUNT && bits[16 + irq]) {
+			value |= 1U << i;
+		}
+	}
+	return value;
+}
+
+static void scs_read(uint32_t offset) {
+	uint32_t bank = (offset & 0x7FU) >> 2;
+
+	if (offset == SYST_CVR) {
+		*scs(offset) = systick_value();
+	} else if (offset >= NVIC_ISER && offset < NVIC_ISPR) {
+		*scs(offset) = bank_bits(enabled, bank);
+	} else if (offset >= NVIC_ISPR && offset < NVIC_IABR) {
+		*scs(offset) = bank_bits(pending, bank);
+	} else if (offset >= NVIC_IABR && offset < NVIC_IABR + 0x20) {
+		*scs(offset) = bank_bits(active, bank);
+	} else if (offset == SCB_ICSR) {
+		int best = best_pending();
+		uint32_t value = depth > 0 ? (uint32_t)active_stack[depth - 1] : 0U;
+		if (best != NO_EXCEPTION) {
+			value |= (uint32_t)best << 12;
+		}
+		for (int irq = 16; irq < EXCEPTION_COUNT; irq++) {
+			if (pending[irq]) {
+				value |= ICSR_ISRPENDING;
+			}
+		}
+		if (pending[SYSTICK_EXCEPTION]) {
+			value |= ICSR_PENDSTSET;
+		}
+		if (pending[PENDSV_EXCEPTION]) {
+			value |= ICSR_PENDSVSET;
+		}
+		*scs(offset) = value;
+	} else if (offset == SCB_AIRCR) {
+		*scs(offset) = 0xFA050000U | ((uint32_t)prigroup << 8);
+	}
+}
+
+static void scs_read_done(uint32_t offset) {
+	if (offset == SYST_CSR) {
+		*scs(offset) &= ~SYST_CSR_COUNTFLAG;
+	}
+}
+
+static void set_bank(bool *bits, uint32_t bank, uint32_t value, bool set) {
+	for (uint32_t i = 0; i < 32; i++) {
+		uint32_t irq = bank * 32U + i;
+		if (irq < IRQ_COUNT && (value & (1U << i))) {
+			bits[16 + irq] = set;
+			if (!set && bits == pending && level[16 + irq] && !active[16 + irq]) {
+				pending[16 + irq] = true;
+			}
+		}
+	}
+}
+
+static void scs_write(uint32_t offset, uint32_t old) {
+	uint32_t value = *scs(offset);
+	uint32_t bank = (offset & 0x7FU) >> 2;
+
+	if (offset == SYST_CSR) {
+		uint32_t count = systick_value();
+		*scs(offset) = (value & ~SYST_CSR_COUNTFLAG) | (old & SYST_CSR_COUNTFLAG);
+		if ((value ^ old) & (SYST_CSR_ENABLE | SYST_CSR_CLKSOURCE)) {
+			systick_arm(count);
+		}
+	} else if (offset == SYST_CVR) {
+		*scs(SYST_CSR) &= ~SYST_CSR_COUNTFLAG;
+		systick_arm(0);
+		*scs(offset) = 0;
+	} else if (offset >= NVIC_ISER && offset < NVIC_ICER) {
+		set_bank(enabled, bank, value, true);
+	} else if (offset >= NVIC_ICER && offset < NVIC_ISPR) {
+		set_bank(enabled, bank, value, false);
+	} else if (offset >= NVIC_ISPR && offset < NVIC_ICPR) {
+		set_bank(pending, bank, value, true);
+	} else if (offset >= NVIC_ICPR && offset < NVIC_IABR) {
+		set_bank(pending, bank, value, false);
+	} else if (offset == SCB_ICSR) {
+		if (value & ICSR_PENDSTSET) {
+			pending[SYSTICK_EXCEPTION] = true;
+		}
+		if (value & ICSR_PENDSTCLR) {
+			pending[SYSTICK_EXCEPTION] = false;
+		}
+		if (value & ICSR_PENDSVSET) {
+			pending[PENDSV_EXCEPTION] = true;
+		}
+		if (value & ICSR_PENDSVCLR) {
+			pending[PENDSV_EXCEPTION] = false;
+		}
+	} else if (offset == SCB_AIRCR) {
+		if ((value >> 16) == 0x05FAU) {
+			prigroup = (uint8_t)((value >> 8) & 7U);
+			if (value & (1U << 2)) {
+				sim_fatal("system reset requested");
+			}
+		}
+		*scs(offset) = 0xFA050000U | ((uint32_t)prigroup << 8);
+	} else if (offset == SCB_CPUID) {
+		*scs(offset) = old;
+	} else if (offset == DEMCR) {
+		cyccnt_update();
+	} else if (offset == NVIC_STIR) {
+		if ((value & 0x1FFU) < IRQ_COUNT) {
+			pending[16 + (value & 0x1FFU)] = true;
+		}
+	}
+}
+
+static void dwt_reset(void) {
+	*sim_reg(DWT_BASE_ADDRESS) = 0x40000000U;
+}
+
+static void dwt_read(uint32_t offset) {
+	if (offset == 0x04) {
+		*sim_reg(DWT_BASE_ADDRESS + offset) = cyccnt_value();
+	}
+}
+
+static void dwt_write(uint32_t offset, uint32_t old) {
+	(void)old;
+	if (offset == 0x00) {
+		cyccnt_update();
+	} else if (offset == 0x04) {
+		cyccnt.base = *sim_reg(DWT_BASE_ADDRESS + offset);
+		cyccnt.anchor = sim_core_cycles();
+	}
+}
+
+static const sim_periph_t scs_periph = {
+	.name = "SCS",
+	.base = SCS_BASE,
+	.size = 0x1000,
+	.reset = scs_reset,
+	.read = scs_read,
+	.read_done = scs_read_done,
+	.write = scs_write,
+};
+
+static const sim_periph_t dwt_periph = {
+	.name = "DWT",
+	.base = DWT_BASE_ADDRESS,
+	.size = 0x1000,
+	.reset = dwt_reset,
+	.read = dwt_read,
+	.write = dwt_write,
+};
+
+void sim_scs_register(void) {
+	sim_periph_add(&scs_periph);
+	sim_periph_add(&dwt_periph);
+	sim_clock_listen(&systick_listener);
+}
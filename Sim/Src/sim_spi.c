@@ -0,0 +1,60 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SPI1, transmit only: the shift into the 74HC595 chain is instantaneous, so the
+ * transmit buffer is always empty and the bus never busy
+ */
+
+#include "sim_internal.h"
+
+#define SPI_R(field) SIM_REG(SPI_TypeDef, SPI1_BASE, field)
+
+static void spi_reset(void) {
+	SPI_R(SR) = SPI_SR_TXE;
+	SPI_R(I2SPR) = 0x0002U;
+}
+
+static void spi_write(uint32_t offset, uint32_t old) {
+	if (offset == SIM_OFFSET(SPI_TypeDef, DR)) {
+		uint32_t cr1 = SPI_R(CR1);
+		if (cr1 & SPI_CR1_SPE) {
+			uint16_t word = (uint16_t)SPI_R(DR);
+			if (cr1 & SPI_CR1_DFF) {
+				sim_display_shift(word);
+			} else {
+				sim_display_shift((uint16_t)((old << 8) | (word & 0xFFU)));
+			}
+		}
+	} else if (offset == SIM_OFFSET(SPI_TypeDef, SR)) {
+		SPI_R(SR) = SPI_SR_TXE;
+	}
+}
+
+static const sim_periph_t spi1_periph = {
+	.name = "SPI1",
+	.base = SPI1_BASE,
+	.size = 0x400,
+	.reset = spi_reset,
+	.write = spi_write,
+};
+
+void sim_spi_register(void) {
+	sim_periph_add(&spi1_periph);
+}
@@ -0,0 +1,281 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * TIM6 (sampling of the buttons) and TIM8 (refresh clock of the display).
+ * the counter is computed from the time its period started; each update event
+ * sets UIF, reloads the prescaler and auto-reload shadows and, on TIM8, requests
+ * the DMA transfer of the next display word and latches the shift registers
+ * with the rising edge of CH2N
+ */
+
+#include "sim_internal.h"
+
+typedef struct {
+	const char *name;
+	uint32_t base;
+	bool apb2;
+	IRQn_Type irqn;
+	void (*on_update)(void);
+	bool running;
+	uint64_t period_start;
+	uint32_t frozen;
+	uint32_t psc;
+	uint32_t arr;
+	sim_event_t update;
+} sim_timer_t;
+
+#define TIM_R(timer, field) SIM_REG(TIM_TypeDef, (timer)->base, field)
+
+/*
+ * output compare modes of OC2M
+ */
+#define OCM_FORCED_INACTIVE 4U
+#define OCM_FORCED_ACTIVE 5U
+#define OCM_PWM1 6U
+#define OCM_PWM2 7U
+
+static void tim8_update(void);
+
+static sim_timer_t timers[] = {
+	{ .name = "TIM6", .base = TIM6_BASE, .apb2 = false, .irqn = TIM6_DAC_IRQn },
+	{ .name = "TIM8", .base = TIM8_BASE, .apb2 = true, .irqn = TIM8_UP_TIM13_IRQn, .on_update = tim8_update },
+};
+
+#define TIMER_COUNT (sizeof(timers) / sizeof(timers[0]))
+
+static uint32_t timer_hz(const sim_timer_t *timer) {
+	return timer->apb2 ? sim_clk.tim2 : sim_clk.tim1;
+}
+
+static uint32_t counter(const sim_timer_t *timer) {
+	if (!timer->running) {
+		return timer->frozen;
+	}
+	uint64_t ticks = sim_cycles(sim_now - timer->period_start, timer_hz(timer)) / (timer->psc + 1U);
+	return ticks > timer->arr ? timer->arr : (uint32_t)ticks;
+}
+
+static void update_irq(sim_timer_t *timer) {
+	sim_irq_level(timer->irqn, (TIM_R(timer, SR) & TIM_SR_UIF) && (TIM_R(timer, DIER) & TIM_DIER_UIE));
+}
+
+/*
+ * starts counting from value, or freezes it when disabled or unclocked
+ */
+static void arm(sim_timer_t *timer, uint32_t value) {
+	uint32_t hz = timer_hz(timer);
+
+	timer->running = (TIM_R(timer, CR1) & TIM_CR1_CEN) && hz != 0;
+	if (!timer->running) {
+		timer->frozen = value;
+		sim_event_cancel(&timer->update);
+		return;
+	}
+	uint64_t prescaled = (uint64_t)timer->psc + 1U;
+	timer->period_start = sim_now - sim_span((uint64_t)value * prescaled, hz);
+	sim_event_at(&timer->update, timer->period_start + sim_span(((uint64_t)timer->arr + 1U) * prescaled, hz));
+}
+
+static void reload_shadows(sim_timer_t *timer) {
+	timer->psc = TIM_R(timer, PSC) & 0xFFFFU;
+	timer->arr = TIM_R(timer, ARR);
+}
+
+static void update_event(sim_timer_t *timer, bool set_flag) {
+	reload_shadows(timer);
+	if (set_flag) {
+		TIM_R(timer, SR) |= TIM_SR_UIF;
+		update_irq(timer);
+	}
+	if (timer->on_update != NULL) {
+		timer->on_update();
+	}
+}
+
+static void overflow(sim_event_t *event) {
+	sim_timer_t *timer = NULL;
+	for (size_t i = 0; i < TIMER_COUNT; i++) {
+		if (&timers[i].update == event) {
+			timer = &timers[i];
+		}
+	}
+	if (!(TIM_R(timer, CR1) & TIM_CR1_UDIS)) {
+		update_event(timer, true);
+	}
+	if (TIM_R(timer, CR1) & TIM_CR1_OPM) {
+		TIM_R(timer, CR1) &= ~TIM_CR1_CEN;
+	}
+	arm(timer, 0);
+}
+
+/*
+ * TIM8 channel 2: OC2REF of the output compare mode, CH2N is its complement and
+ * clocks the 74HC595 storage registers on its rising edge
+ */
+static bool oc2_reference(sim_timer_t *timer, uint32_t ccmr1) {
+	uint32_t mode = (ccmr1 & TIM_CCMR1_OC2M) >> TIM_CCMR1_OC2M_Pos;
+	bool below = counter(timer) < TIM_R(timer, CCR2);
+
+	switch (mode) {
+	case OCM_FORCED_INACTIVE:
+		return false;
+	case OCM_FORCED_ACTIVE:
+		return true;
+	case OCM_PWM1:
+		return below;
+	case OCM_PWM2:
+		return !below;
+	default:
+		return false;
+	}
+}
+
+static bool ch2n_enabled(sim_timer_t *timer) {
+	return (TIM_R(timer, BDTR) & TIM_BDTR_MOE) && (TIM_R(timer, CCER) & TIM_CCER_CC2NE);
+}
+
+static void tim8_update(void) {
+	sim_timer_t *timer = &timers[1];
+
+	if (TIM_R(timer, DIER) & TIM_DIER_UDE) {
+		sim_dma_transfer(2, 1, 7);
+	}
+	uint32_t mode = (TIM_R(timer, CCMR1) & TIM_CCMR1_OC2M) >> TIM_CCMR1_OC2M_Pos;
+	bool pwm = mode == OCM_PWM1 || mode == OCM_PWM2;
+	bool refreshing = pwm && timer->running && ch2n_enabled(timer) && TIM_R(timer, CCR2) <= timer->arr;
+	sim_display_set_refresh(refreshing);
+	if (refreshing) {
+		sim_display_latch();
+	}
+}
+
+/*
+ * register hooks
+ */
+
+static void tim_reset(void) {
+	for (size_t i = 0; i < TIMER_COUNT; i++) {
+		timers[i].update.fire = overflow;
+		TIM_R(&timers[i], ARR) = 0xFFFFU;
+		reload_shadows(&timers[i]);
+	}
+}
+
+static void tim_read(sim_timer_t *timer, uint32_t offset) {
+	if (offset == SIM_OFFSET(TIM_TypeDef, CNT)) {
+		TIM_R(timer, CNT) = counter(timer);
+	} else if (offset == SIM_OFFSET(TIM_TypeDef, EGR)) {
+		TIM_R(timer, EGR) = 0;
+	}
+}
+
+static void tim_write(sim_timer_t *timer, uint32_t offset, uint32_t old) {
+	uint32_t value = *sim_reg(timer->base + offset);
+	uint32_t count = counter(timer);
+
+	if (offset == SIM_OFFSET(TIM_TypeDef, CR1)) {
+		if ((value ^ old) & TIM_CR1_CEN) {
+			arm(timer, count);
+			if (timer == &timers[1] && !timer->running) {
+				sim_display_set_refresh(false);
+			}
+		}
+	} else if (offset == SIM_OFFSET(TIM_TypeDef, SR)) {
+		TIM_R(timer, SR) = old & value;
+		update_irq(timer);
+	} else if (offset == SIM_OFFSET(TIM_TypeDef, DIER)) {
+		update_irq(timer);
+	} else if (offset == SIM_OFFSET(TIM_TypeDef, EGR)) {
+		TIM_R(timer, EGR) = 0;
+		if (value & TIM_EGR_UG) {
+			update_event(timer, !(TIM_R(timer, CR1) & TIM_CR1_URS));
+			arm(timer, 0);
+		}
+	} else if (offset == SIM_OFFSET(TIM_TypeDef, CNT)) {
+		arm(timer, value & 0xFFFFU);
+	} else if (offset == SIM_OFFSET(TIM_TypeDef, ARR)) {
+		if (!(TIM_R(timer, CR1) & TIM_CR1_ARPE)) {
+			timer->arr = value;
+			arm(timer, count);
+		}
+	} else if (offset == SIM_OFFSET(TIM_TypeDef, CCMR1) && timer == &timers[1]) {
+		bool was = oc2_reference(timer, old);
+		bool now = oc2_reference(timer, value);
+		if (was && !now && ch2n_enabled(timer)) {
+			sim_display_latch();
+		}
+	}
+}
+
+static void tim6_read(uint32_t offset) {
+	tim_read(&timers[0], offset);
+}
+
+static void tim6_write(uint32_t offset, uint32_t old) {
+	tim_write(&timers[0], offset, old);
+}
+
+static void tim8_read(uint32_t offset) {
+	tim_read(&timers[1], offset);
+}
+
+static void tim8_write(uint32_t offset, uint32_t old) {
+	tim_write(&timers[1], offset, old);
+}
+
+static void tim_sync(void) {
+	for (size_t i = 0; i < TIMER_COUNT; i++) {
+		timers[i].frozen = counter(&timers[i]);
+	}
+}
+
+static void tim_resched(void) {
+	for (size_t i = 0; i < TIMER_COUNT; i++) {
+		arm(&timers[i], timers[i].frozen);
+	}
+}
+
+static const sim_clock_listener_t tim_listener = {
+	.sync = tim_sync,
+	.resched = tim_resched,
+};
+
+static const sim_periph_t tim6_periph = {
+	.name = "TIM6",
+	.base = TIM6_BASE,
+	.size = 0x400,
+	.reset = tim_reset,
+	.read = tim6_read,
+	.write = tim6_write,
+};
+
+static const sim_periph_t tim8_periph = {
+	.name = "TIM8",
+	.base = TIM8_BASE,
+	.size = 0x400,
+	.read = tim8_read,
+	.write = tim8_write,
+};
+
+void sim_tim_register(void) {
+	sim_periph_add(&tim6_periph);
+	sim_periph_add(&tim8_periph);
+	sim_clock_listen(&tim_listener);
+}
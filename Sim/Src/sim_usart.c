@@ -0,0 +1,186 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * USART2 transmitter: DR feeds a shift register emptied at the programmed baud
+ * rate, ten bit times per byte. each byte reaches the host when its stop bit ends
+ */
+
+#include "sim_internal.h"
+
+#define USART_R(field) SIM_REG(USART_TypeDef, USART2_BASE, field)
+
+#define BUFFER_SIZE 65536U
+
+static struct {
+	bool shifting;
+	uint8_t shift;
+	sim_event_t byte_end;
+	sim_event_t dma_request;
+	uint8_t buffer[BUFFER_SIZE];
+	size_t head;
+	size_t tail;
+	uint64_t last_time;
+	void (*sink)(uint8_t byte, uint64_t time, void *context);
+	void *sink_context;
+} usart;
+
+/*
+ * PCLK1 cycles per bit from BRR, the fraction has three bits with OVER8
+ */
+static uint64_t byte_units(void) {
+	uint32_t brr = USART_R(BRR) & 0xFFFFU;
+	uint32_t clocks = (USART_R(CR1) & USART_CR1_OVER8) ? (((brr >> 4) << 3) | (brr & 7U)) : brr;
+
+	if (clocks == 0) {
+		clocks = 16;
+	}
+	return sim_span(10ULL * clocks, sim_clk.pclk1);
+}
+
+static void update_irq(void) {
+	uint32_t sr = USART_R(SR);
+	uint32_t cr1 = USART_R(CR1);
+	bool level = ((cr1 & USART_CR1_TXEIE) && (sr & USART_SR_TXE)) || ((cr1 & USART_CR1_TCIE) && (sr & USART_SR_TC));
+
+	sim_irq_level(USART2_IRQn, level);
+}
+
+static void request_dma(void) {
+	if ((USART_R(CR3) & USART_CR3_DMAT) && (USART_R(SR) & USART_SR_TXE)) {
+		sim_event_at(&usart.dma_request, sim_now);
+	}
+}
+
+static void load_shift(void) {
+	usart.shift = (uint8_t)USART_R(DR);
+	usart.shifting = true;
+	USART_R(SR) = (USART_R(SR) | USART_SR_TXE) & ~USART_SR_TC;
+	sim_event_at(&usart.byte_end, sim_now + byte_units());
+	update_irq();
+	request_dma();
+}
+
+void sim_uart_emit(uint8_t byte) {
+	usart.last_time = sim_now;
+	if (usart.sink != NULL) {
+		usart.sink(byte, sim_now, usart.sink_context);
+		return;
+	}
+	size_t next = (usart.head + 1U) % BUFFER_SIZE;
+	if (next == usart.tail) {
+		usart.tail = (usart.tail + 1U) % BUFFER_SIZE;
+	}
+	usart.buffer[usart.head] = byte;
+	usart.head = next;
+}
+
+size_t sim_uart_read(uint8_t *data, size_t size, uint64_t *last_time) {
+	size_t count = 0;
+
+	while (count < size && usart.tail != usart.head) {
+		data[count++] = usart.buffer[usart.tail];
+		usart.tail = (usart.tail + 1U) % BUFFER_SIZE;
+	}
+	if (last_time != NULL) {
+		*last_time = usart.last_time;
+	}
+	return count;
+}
+
+void sim_uart_set_sink(void (*sink)(uint8_t byte, uint64_t time, void *context), void *context) {
+	usart.sink = sink;
+	usart.sink_context = context;
+}
+
+static void byte_end_fire(sim_event_t *event) {
+	(void)event;
+
+	usart.shifting = false;
+	sim_uart_emit(usart.shift);
+	if (!(USART_R(SR) & USART_SR_TXE)) {
+		load_shift();
+	} else {
+		USART_R(SR) |= USART_SR_TC;
+		update_irq();
+	}
+}
+
+static void dma_request_fire(sim_event_t *event) {
+	(void)event;
+	if ((USART_R(CR3) & USART_CR3_DMAT) && (USART_R(SR) & USART_SR_TXE)) {
+		sim_dma_transfer(1, 6, 4);
+	}
+}
+
+static void dma_kick(void) {
+	request_dma();
+}
+
+/*
+ * register hooks
+ */
+
+static void usart_reset(void) {
+	usart.byte_end.fire = byte_end_fire;
+	usart.dma_request.fire = dma_request_fire;
+	USART_R(SR) = USART_SR_TXE | USART_SR_TC;
+	sim_dma_set_requester(1, 6, 4, dma_kick);
+}
+
+static void usart_write(uint32_t offset, uint32_t old) {
+	uint32_t value = *sim_reg(USART2_BASE + offset);
+
+	if (offset == SIM_OFFSET(USART_TypeDef, DR)) {
+		if ((USART_R(CR1) & (USART_CR1_UE | USART_CR1_TE)) != (USART_CR1_UE | USART_CR1_TE)) {
+			return;
+		}
+		if (!usart.shifting) {
+			load_shift();
+		} else {
+			USART_R(SR) &= ~USART_SR_TXE;
+			update_irq();
+		}
+	} else if (offset == SIM_OFFSET(USART_TypeDef, SR)) {
+		uint32_t clearable = USART_SR_TC | USART_SR_RXNE | USART_SR_LBD | USART_SR_CTS;
+		USART_R(SR) = (old & ~clearable) | (old & value & clearable);
+		update_irq();
+	} else if (offset == SIM_OFFSET(USART_TypeDef, CR1)) {
+		if (!(value & USART_CR1_UE)) {
+			sim_event_cancel(&usart.byte_end);
+			usart.shifting = false;
+			USART_R(SR) = USART_SR_TXE | USART_SR_TC;
+		}
+		update_irq();
+	} else if (offset == SIM_OFFSET(USART_TypeDef, CR3)) {
+		request_dma();
+	}
+}
+
+static const sim_periph_t usart2_periph = {
+	.name = "USART2",
+	.base = USART2_BASE,
+	.size = 0x400,
+	.reset = usart_reset,
+	.write = usart_write,
+};
+
+void sim_usart_register(void) {
+	sim_periph_add(&usart2_periph);
+}
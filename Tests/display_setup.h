@@ -0,0 +1,144 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * display of the tests driving driver_7_seg directly: SPI1, TIM8 and DMA2
+ * Stream1 set up as main.c does, then the driver started on them. runs in the
+ * firmware context of sim_start
+ */
+
+#pragma once
+#include "sim.h"
+#include "main.h"
+#include "driver_7_seg.h"
+#include "check.h"
+#include <math.h>
+
+/*
+ * words of one frame: 256 scans of the 4 digits, one word per 1 us slot of TIM8
+ */
+#define DISPLAY_DIGITS 4U
+#define DISPLAY_SCANS 256U
+#define DISPLAY_FRAME_WORDS (DISPLAY_DIGITS * DISPLAY_SCANS)
+
+/*
+ * clock setup of main.c
+ */
+void SystemClock_Config(void);
+
+/*
+ * handles of main.c, the DMA2 Stream1 interrupt handler uses them
+ */
+extern SPI_HandleTypeDef hspi1;
+extern TIM_HandleTypeDef htim8;
+extern DMA_HandleTypeDef hdma_tim8_up;
+
+static inline void display_setup(void) {
+	TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+	TIM_MasterConfigTypeDef sMasterConfig = {0};
+	TIM_OC_InitTypeDef sConfigOC = {0};
+	TIM_BreakDeadTimeConfigTypeDef sBreakDeadTimeConfig = {0};
+
+	SystemInit();
+	HAL_Init();
+	SystemClock_Config();
+
+	/* MX_GPIO_Init and MX_DMA_Init */
+	__HAL_RCC_GPIOA_CLK_ENABLE();
+	__HAL_RCC_GPIOB_CLK_ENABLE();
+	__HAL_RCC_GPIOC_CLK_ENABLE();
+	__HAL_RCC_DMA2_CLK_ENABLE();
+	HAL_NVIC_SetPriority(DMA2_Stream1_IRQn, 1, 0);
+	HAL_NVIC_EnableIRQ(DMA2_Stream1_IRQn);
+
+	/* MX_SPI1_Init */
+	hspi1.Instance = SPI1;
+	hspi1.Init.Mode = SPI_MODE_MASTER;
+	hspi1.Init.Direction = SPI_DIRECTION_2LINES;
+	hspi1.Init.DataSize = SPI_DATASIZE_16BIT;
+	hspi1.Init.CLKPolarity = SPI_POLARITY_LOW;
+	hspi1.Init.CLKPhase = SPI_PHASE_1EDGE;
+	hspi1.Init.NSS = SPI_NSS_SOFT;
+	hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2;
+	hspi1.Init.FirstBit = SPI_FIRSTBIT_MSB;
+	hspi1.Init.TIMode = SPI_TIMODE_DISABLE;
+	hspi1.Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
+	hspi1.Init.CRCPolynomial = 10;
+	CHECK(HAL_SPI_Init(&hspi1) == HAL_OK);
+
+	/* MX_TIM8_Init: 1 us slot, CH2N latches after the word is shifted out */
+	htim8.Instance = TIM8;
+	htim8.Init.Prescaler = 0;
+	htim8.Init.CounterMode = TIM_COUNTERMODE_UP;
+	htim8.Init.Period = 83;
+	htim8.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	htim8.Init.RepetitionCounter = 0;
+	htim8.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+	CHECK(HAL_TIM_Base_Init(&htim8) == HAL_OK);
+	sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+	CHECK(HAL_TIM_ConfigClockSource(&htim8, &sClockSourceConfig) == HAL_OK);
+	CHECK(HAL_TIM_PWM_Init(&htim8) == HAL_OK);
+	sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+	sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+	CHECK(HAL_TIMEx_MasterConfigSynchronization(&htim8, &sMasterConfig) == HAL_OK);
+	sConfigOC.OCMode = TIM_OCMODE_PWM1;
+	sConfigOC.Pulse = 64;
+	sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+	sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+	sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+	sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
+	sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+	CHECK(HAL_TIM_PWM_ConfigChannel(&htim8, &sConfigOC, TIM_CHANNEL_2) == HAL_OK);
+	sBreakDeadTimeConfig.OffStateRunMode = TIM_OSSR_DISABLE;
+	sBreakDeadTimeConfig.OffStateIDLEMode = TIM_OSSI_DISABLE;
+	sBreakDeadTimeConfig.LockLevel = TIM_LOCKLEVEL_OFF;
+	sBreakDeadTimeConfig.DeadTime = 0;
+	sBreakDeadTimeConfig.BreakState = TIM_BREAK_DISABLE;
+	sBreakDeadTimeConfig.BreakPolarity = TIM_BREAKPOLARITY_HIGH;
+	sBreakDeadTimeConfig.AutomaticOutput = TIM_AUTOMATICOUTPUT_DISABLE;
+	CHECK(HAL_TIMEx_ConfigBreakDeadTime(&htim8, &sBreakDeadTimeConfig) == HAL_OK);
+	HAL_TIM_MspPostInit(&htim8);
+
+	CHECK(driver_7_seg_init(&hspi1, &htim8, SPI1_CS_GPIO_Port, SPI1_CS_Pin) == DRIVER_7_SEG_STATUS_OK);
+}
+
+/*
+ * scans per frame a brightness level is lit in: gamma 2.2, non-zero levels
+ * get at least one scan, the curve GAMMA_TABLE of driver_7_seg.c is built from
+ */
+static inline uint32_t display_gamma_scans(uint8_t level) {
+	if (level == 0) {
+		return 0;
+	}
+	uint32_t scans = (uint32_t)lround(255.0 * pow(level / 255.0, 2.2));
+	return scans == 0 ? 1U : scans;
+}
+
+/*
+ * a segment of duty d is lit in the scans whose bit-reversed index is below d
+ */
+static inline bool display_scan_lit(uint32_t scan, uint32_t scans) {
+	uint32_t reversed = 0;
+
+	for (uint8_t bit = 0; bit < 8; bit++) {
+		if (scan & (1U << bit)) {
+			reversed |= 1U << (7 - bit);
+		}
+	}
+	return reversed < scans;
+}
@@ -0,0 +1,186 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * bus recovery of a sensor holding SDA low: a slave released by fewer than 9
+ * clock pulses is clocked out without touching its power, one that keeps
+ * holding SDA is power cycled through I2C_VCC_Pin and calibrated again. after
+ * both the sensor measures normally
+ */
+
+#include "sim.h"
+#include "aht20.h"
+#include "main.h"
+#include "check.h"
+#include <stdio.h>
+
+/*
+ * scl pulses the sensor holds SDA for: released by the 9 pulses of the recovery, and not
+ */
+#define SHORT_HOLD_CLOCKS 5U
+#define LONG_HOLD_CLOCKS 20U
+
+/*
+ * power off time of the recovery and the power up wait of aht20_validate_calibration
+ */
+#define POWER_CYCLE_MIN_MS 50U
+
+/*
+ * clocking out the slave takes about 100 us
+ */
+#define CLOCK_OUT_MAX_MS 2U
+
+/*
+ * status bit of the sensor set once it is calibrated
+ */
+#define STATUS_CALIBRATED (1U << 3)
+
+/*
+ * clock setup of main.c
+ */
+void SystemClock_Config(void);
+
+/*
+ * handle of main.c, the I2C1 interrupt handlers use it
+ */
+extern I2C_HandleTypeDef hi2c1;
+
+/*
+ * what a recovery saw, checked by main
+ */
+typedef struct {
+	aht20_status_t stuck_status;
+	aht20_status_t recovery_status;
+	aht20_status_t measure_status;
+	aht20_recovery_stats_t recovery_stats;
+	sim_aht20_stats_t before;
+	sim_aht20_stats_t after;
+	uint32_t sda_clocks_left;
+	uint8_t frame[7];
+} recovery_run_t;
+
+static recovery_run_t clock_out_run;
+static recovery_run_t power_cycle_run;
+
+/*
+ * holds SDA for the given number of clocks, shows the bus is stuck, recovers it and measures
+ */
+static void run_recovery(uint32_t hold_clocks, recovery_run_t *run) {
+	sim_aht20_get_stats(&run->before);
+	sim_aht20()->hold_sda_clocks = hold_clocks;
+
+	run->stuck_status = aht20_measure(&hi2c1, run->frame, sizeof(run->frame));
+	run->recovery_status = aht20_bus_recovery(&hi2c1);
+	aht20_get_recovery_stats(&run->recovery_stats);
+	run->sda_clocks_left = sim_aht20()->hold_sda_clocks;
+	sim_aht20_get_stats(&run->after);
+
+	run->measure_status = aht20_measure(&hi2c1, run->frame, sizeof(run->frame));
+}
+
+static void recovery_entry(void) {
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	SystemInit();
+	HAL_Init();
+	SystemClock_Config();
+
+	/* sensor power pin set up as MX_GPIO_Init does */
+	__HAL_RCC_GPIOB_CLK_ENABLE();
+	__HAL_RCC_GPIOC_CLK_ENABLE();
+	HAL_GPIO_WritePin(I2C_VCC_GPIO_Port, I2C_VCC_Pin, GPIO_PIN_RESET);
+	GPIO_InitStruct.Pin = I2C_VCC_Pin;
+	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+	HAL_GPIO_Init(I2C_VCC_GPIO_Port, &GPIO_InitStruct);
+
+	hi2c1.Instance = I2C1;
+	hi2c1.Init.ClockSpeed = 100000;
+	hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
+	hi2c1.Init.OwnAddress1 = 0;
+	hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+	hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+	hi2c1.Init.OwnAddress2 = 0;
+	hi2c1.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+	hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+	HAL_StatusTypeDef hal_status = HAL_I2C_Init(&hi2c1);
+	CHECK(hal_status == HAL_OK);
+
+	aht20_status_t status = aht20_validate_calibration(&hi2c1);
+	CHECK(status == AHT20_STATUS_OK);
+
+	run_recovery(SHORT_HOLD_CLOCKS, &clock_out_run);
+
+	/* the sensor comes back from the power cycle without calibration */
+	sim_aht20()->calibrated = false;
+	run_recovery(LONG_HOLD_CLOCKS, &power_cycle_run);
+}
+
+/*
+ * checks a recovery and the measurment after it
+ */
+static void check_run(const char *name, const recovery_run_t *run) {
+	int32_t humidity = 0;
+	int32_t temperature = 0;
+
+	printf("%s: stuck status %d, recovery status %d in %u ms, %u recoveries, %u power cycles, %u failures\n",
+			name, run->stuck_status, run->recovery_status, run->recovery_stats.last_latency_ms,
+			run->recovery_stats.recoveries, run->recovery_stats.power_cycles, run->recovery_stats.failures);
+
+	CHECK(run->stuck_status == AHT20_STATUS_NOT_TRANSMITTED);
+	CHECK(run->recovery_status == AHT20_STATUS_OK);
+	CHECK(run->sda_clocks_left == 0);
+	CHECK(run->recovery_stats.failures == 0);
+	CHECK(run->recovery_stats.max_latency_ms >= run->recovery_stats.last_latency_ms);
+
+	CHECK(run->measure_status == AHT20_STATUS_OK);
+	CHECK(run->frame[0] & STATUS_CALIBRATED);
+	aht20_calculate_measurments_fixed((uint8_t *)run->frame, &humidity, &temperature);
+	CHECK(temperature >= sim_aht20()->temperature_centi - 1 && temperature <= sim_aht20()->temperature_centi + 1);
+	CHECK(humidity >= sim_aht20()->humidity_centi - 1 && humidity <= sim_aht20()->humidity_centi + 1);
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_start(recovery_entry);
+
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 10000 && state != SIM_STATE_RETURNED; ms += 10) {
+		state = sim_run_ms(10);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+
+	/* released within 9 pulses: clocked out, the sensor keeps its power */
+	check_run("clock out", &clock_out_run);
+	CHECK(clock_out_run.recovery_stats.recoveries == 1);
+	CHECK(clock_out_run.recovery_stats.power_cycles == 0);
+	CHECK(clock_out_run.recovery_stats.last_latency_ms <= CLOCK_OUT_MAX_MS);
+	CHECK(clock_out_run.after.power_cycles == clock_out_run.before.power_cycles);
+
+	/* still held after 9 pulses: power cycled, then calibrated by aht20_validate_calibration */
+	check_run("power cycle", &power_cycle_run);
+	CHECK(power_cycle_run.recovery_stats.recoveries == 2);
+	CHECK(power_cycle_run.recovery_stats.power_cycles == 1);
+	CHECK(power_cycle_run.recovery_stats.last_latency_ms >= POWER_CYCLE_MIN_MS);
+	CHECK(power_cycle_run.recovery_stats.max_latency_ms == power_cycle_run.recovery_stats.last_latency_ms);
+	CHECK(power_cycle_run.after.power_cycles == power_cycle_run.before.power_cycles + 1);
+
+	return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * callback order of background measurements: aht20_start_measurement returns
+ * while the command is still on the bus, the transmit complete callback starts
+ * the conversion time, the frame is read only after it and the result callback
+ * comes from the transfer complete interrupt once the whole frame is in. the
+ * frame is collected by the next poll, and the ACK sent after it pushes no
+ * result. a sensor that doesn't acknowledge reports through the error callback.
+ * the soft reset after a bad frame, and one queued by aht20_start_soft_reset,
+ * keep every driver call short and are finished by the polls 20 ms later
+ */
+
+#include "sim.h"
+#include "aht20.h"
+#include "main.h"
+#include "check.h"
+#include <stdio.h>
+
+/*
+ * measurment time of the driver, the frame can't be read earlier
+ */
+#define MEASURE_TIME_MS 80U
+
+/*
+ * polls are a millisecond apart, the conversion leaves room for most of them
+ */
+#define MIN_BUSY_POLLS 70U
+#define MAX_POLLS 1000U
+
+#define MAX_RESULTS 32U
+
+/*
+ * time the sensor needs after a soft reset
+ */
+#define SOFT_RESET_TIME_MS 20U
+
+/*
+ * exception number of an interrupt, as read from SCB->ICSR
+ */
+#define VECTOR(irqn) ((uint32_t)(irqn) + 16U)
+
+/*
+ * clock setup of main.c
+ */
+void SystemClock_Config(void);
+
+/*
+ * handle of main.c, the I2C1 interrupt handlers use it
+ */
+extern I2C_HandleTypeDef hi2c1;
+
+/*
+ * what the result callback saw when it was called
+ */
+typedef struct {
+	uint64_t time;
+	uint32_t vector;
+	uint32_t measurements;
+	uint32_t frames_read;
+	HAL_I2C_StateTypeDef i2c_state;
+} result_event_t;
+
+static result_event_t results[MAX_RESULTS];
+static volatile uint32_t result_count = 0;
+
+/*
+ * what each measurment run saw, checked by main
+ */
+typedef struct {
+	aht20_status_t status;
+	uint32_t measurements_at_start;
+	HAL_I2C_StateTypeDef i2c_state_at_start;
+	uint32_t busy_polls;
+	uint32_t first_result;
+	uint32_t result_count;
+	uint32_t result_count_after_ack;
+	aht20_status_t status_after_ack;
+	uint64_t start_time;
+	sim_aht20_stats_t before;
+	uint8_t frame[7];
+} measurement_run_t;
+
+/*
+ * what a soft reset run saw: the longest driver call and how long the polls stayed busy
+ */
+typedef struct {
+	aht20_status_t status;
+	aht20_status_t status_after_reset;
+	uint64_t longest_call;
+	uint64_t reset_time;
+	sim_aht20_stats_t before;
+	sim_aht20_stats_t after;
+} reset_run_t;
+
+static measurement_run_t it_run;
+static measurement_run_t dma_run;
+static measurement_run_t absent_run;
+static measurement_run_t recovered_run;
+static reset_run_t bad_frame_run;
+static reset_run_t queued_run;
+
+static void on_result(void) {
+	CHECK(result_count < MAX_RESULTS);
+	result_event_t *event = &results[result_count];
+	sim_aht20_stats_t stats;
+
+	sim_aht20_get_stats(&stats);
+	event->time = sim_time();
+	event->vector = SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk;
+	event->measurements = stats.measurements;
+	event->frames_read = stats.frames_read;
+	event->i2c_state = HAL_I2C_GetState(&hi2c1);
+	result_count++;
+}
+
+static void wait_for_tick(void) {
+	uint32_t tick = HAL_GetTick();
+	while (HAL_GetTick() == tick) {
+		__WFI();
+	}
+}
+
+/*
+ * one measurment with the given transport, polled once a millisecond
+ */
+static void run_measurement(aht20_transport_t transport, measurement_run_t *run) {
+	aht20_status_t status = aht20_set_transport(transport);
+	CHECK(status == AHT20_STATUS_OK);
+
+	sim_aht20_get_stats(&run->before);
+	run->first_result = result_count;
+	run->start_time = sim_time();
+	status = aht20_start_measurement(&hi2c1);
+	CHECK(status == AHT20_STATUS_OK);
+
+	sim_aht20_stats_t stats;
+	sim_aht20_get_stats(&stats);
+	run->measurements_at_start = stats.measurements;
+	run->i2c_state_at_start = HAL_I2C_GetState(&hi2c1);
+
+	uint32_t polls = 0;
+	do {
+		wait_for_tick();
+		status = aht20_poll_measurement(&hi2c1, run->frame, sizeof(run->frame));
+		if (status == AHT20_STATUS_BUSY) {
+			run->busy_polls++;
+		}
+	} while (status == AHT20_STATUS_BUSY && ++polls < MAX_POLLS);
+	run->status = status;
+	run->result_count = result_count - run->first_result;
+
+	/* the ACK after the frame finishes in background too */
+	for (uint32_t ms = 0; ms < 5; ms++) {
+		wait_for_tick();
+	}
+	uint8_t frame[sizeof(run->frame)];
+	run->result_count_after_ack = result_count - run->first_result;
+	run->status_after_ack = aht20_poll_measurement(&hi2c1, frame, sizeof(frame));
+}
+
+/*
+ * polls once after the next tick and keeps the longest call
+ */
+static aht20_status_t timed_poll(reset_run_t *run) {
+	uint8_t frame[7];
+
+	wait_for_tick();
+	uint64_t call_time = sim_time();
+	aht20_status_t status = aht20_poll_measurement(&hi2c1, frame, sizeof(frame));
+	uint64_t duration = sim_time() - call_time;
+	if (duration > run->longest_call) {
+		run->longest_call = duration;
+	}
+	return status;
+}
+
+/*
+ * polls the queued soft reset until the sensor is back
+ */
+static void finish_reset(reset_run_t *run) {
+	uint64_t reset_start = sim_time();
+	aht20_status_t status;
+	uint32_t polls = 0;
+
+	do {
+		status = timed_poll(run);
+	} while (status == AHT20_STATUS_BUSY && ++polls < MAX_POLLS);
+	run->status_after_reset = status;
+	run->reset_time = sim_time() - reset_start;
+	sim_aht20_get_stats(&run->after);
+}
+
+/*
+ * a frame with a wrong checksum on the blocking transport
+ */
+static void run_bad_frame(reset_run_t *run) {
+	aht20_status_t status = aht20_set_transport(AHT20_TRANSPORT_BLOCKING);
+	CHECK(status == AHT20_STATUS_OK);
+
+	sim_aht20_get_stats(&run->before);
+	sim_aht20()->bad_crc_frames = 1;
+	status = aht20_start_measurement(&hi2c1);
+	CHECK(status == AHT20_STATUS_OK);
+
+	uint32_t polls = 0;
+	do {
+		status = timed_poll(run);
+	} while (status == AHT20_STATUS_BUSY && ++polls < MAX_POLLS);
+	run->status = status;
+	finish_reset(run);
+}
+
+/*
+ * a soft reset queued by the application
+ */
+static void run_queued_reset(reset_run_t *run) {
+	aht20_status_t status = aht20_set_transport(AHT20_TRANSPORT_DMA);
+	CHECK(status == AHT20_STATUS_OK);
+
+	sim_aht20_get_stats(&run->before);
+	uint64_t call_time = sim_time();
+	run->status = aht20_start_soft_reset(&hi2c1);
+	run->longest_call = sim_time() - call_time;
+	finish_reset(run);
+}
+
+static void callbacks_entry(void) {
+	SystemInit();
+	HAL_Init();
+	SystemClock_Config();
+
+	/* DMA and I2C1 set up as MX_DMA_Init and MX_I2C1_Init do */
+	__HAL_RCC_DMA1_CLK_ENABLE();
+	HAL_NVIC_SetPriority(DMA1_Stream0_IRQn, 3, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+	HAL_NVIC_SetPriority(DMA1_Stream7_IRQn, 3, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+
+	hi2c1.Instance = I2C1;
+	hi2c1.Init.ClockSpeed = 100000;
+	hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
+	hi2c1.Init.OwnAddress1 = 0;
+	hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
+	hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+	hi2c1.Init.OwnAddress2 = 0;
+	hi2c1.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+	hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
+	HAL_StatusTypeDef hal_status = HAL_I2C_Init(&hi2c1);
+	CHECK(hal_status == HAL_OK);
+
+	aht20_status_t status = aht20_validate_calibration(&hi2c1);
+	CHECK(status == AHT20_STATUS_OK);
+	aht20_set_result_callback(on_result);
+
+	run_measurement(AHT20_TRANSPORT_IT, &it_run);
+	run_measurement(AHT20_TRANSPORT_DMA, &dma_run);
+
+	sim_aht20()->absent = true;
+	run_measurement(AHT20_TRANSPORT_DMA, &absent_run);
+	sim_aht20()->absent = false;
+	run_measurement(AHT20_TRANSPORT_DMA, &recovered_run);
+
+	aht20_set_result_callback(NULL);
+	run_bad_frame(&bad_frame_run);
+	run_queued_reset(&queued_run);
+}
+
+/*
+ * checks a measurment that returned a frame: every result callback came after
+ * the trigger reached the sensor and after a whole frame was read, from the
+ * interrupt completing the receive, and the ACK pushed nothing
+ */
+static void check_frame_run(const char *name, const measurement_run_t *run, uint32_t rx_vector) {
+	printf("%s: status %d, %u busy polls, %u results", name, run->status, run->busy_polls, run->result_count);
+	for (uint32_t i = 0; i < run->result_count; i++) {
+		const result_event_t *event = &results[run->first_result + i];
+		printf(", %.3f ms from vector %u", (double)(event->time - run->start_time) / SIM_UNITS_PER_MS, event->vector);
+	}
+	printf("\n");
+
+	CHECK(run->measurements_at_start == run->before.measurements);
+	CHECK(run->i2c_state_at_start == HAL_I2C_STATE_BUSY_TX);
+	CHECK(run->status == AHT20_STATUS_OK);
+	CHECK(run->busy_polls >= MIN_BUSY_POLLS);
+	CHECK(run->result_count >= 1);
+
+	for (uint32_t i = 0; i < run->result_count; i++) {
+		const result_event_t *event = &results[run->first_result + i];
+		CHECK(event->vector == rx_vector);
+		CHECK(event->measurements == run->before.measurements + 1);
+		CHECK(event->frames_read == run->before.frames_read + i + 1);
+		CHECK(event->i2c_state == HAL_I2C_STATE_READY);
+		CHECK(event->time - run->start_time >= (MEASURE_TIME_MS - 1U) * SIM_UNITS_PER_MS);
+	}
+
+	int32_t humidity = 0;
+	int32_t temperature = 0;
+	aht20_calculate_measurments_fixed((uint8_t *)run->frame, &humidity, &temperature);
+	CHECK(temperature >= sim_aht20()->temperature_centi - 1 && temperature <= sim_aht20()->temperature_centi + 1);
+	CHECK(humidity >= sim_aht20()->humidity_centi - 1 && humidity <= sim_aht20()->humidity_centi + 1);
+
+	CHECK(run->result_count_after_ack == run->result_count);
+	CHECK(run->status_after_ack == AHT20_STATUS_NOT_MEASURED);
+}
+
+/*
+ * checks a soft reset run: one reset reached the sensor, no driver call waited for it
+ * and the polls stayed busy for the whole 20 ms of the datasheet, the sensor answered after it
+ */
+static void check_reset_run(const char *name, const reset_run_t *run, aht20_status_t expected) {
+	printf("%s: status %d, %u soft resets, longest call %.3f ms, busy for %.3f ms\n", name, run->status,
+			run->after.soft_resets - run->before.soft_resets,
+			(double)run->longest_call / SIM_UNITS_PER_MS, (double)run->reset_time / SIM_UNITS_PER_MS);
+	CHECK(run->status == expected);
+	CHECK(run->status_after_reset == AHT20_STATUS_NOT_MEASURED);
+	CHECK(run->after.soft_resets == run->before.soft_resets + 1);
+	CHECK(run->longest_call < 2U * SIM_UNITS_PER_MS);
+	CHECK(run->reset_time >= SOFT_RESET_TIME_MS * SIM_UNITS_PER_MS);
+	CHECK(run->reset_time <= (SOFT_RESET_TIME_MS + 3U) * SIM_UNITS_PER_MS);
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_start(callbacks_entry);
+
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 10000 && state != SIM_STATE_RETURNED; ms += 10) {
+		state = sim_run_ms(10);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+
+	check_frame_run("interrupt", &it_run, VECTOR(I2C1_EV_IRQn));
+	check_frame_run("dma", &dma_run, VECTOR(DMA1_Stream0_IRQn));
+
+	/* the address isn't acknowledged: one error result once the HAL has aborted the TX stream */
+	printf("absent: status %d, %u results", absent_run.status, absent_run.result_count);
+	if (absent_run.result_count > 0) {
+		printf(" from vector %u", results[absent_run.first_result].vector);
+	}
+	printf("\n");
+	CHECK(absent_run.status == AHT20_STATUS_NOT_TRANSMITTED);
+	CHECK(absent_run.result_count == 1);
+	CHECK(results[absent_run.first_result].vector == VECTOR(DMA1_Stream7_IRQn));
+	CHECK(results[absent_run.first_result].i2c_state == HAL_I2C_STATE_READY);
+	CHECK(results[absent_run.first_result].measurements == absent_run.before.measurements);
+	CHECK(results[absent_run.first_result].frames_read == absent_run.before.frames_read);
+	CHECK(absent_run.result_count_after_ack == 1);
+
+	check_frame_run("after the error", &recovered_run, VECTOR(DMA1_Stream0_IRQn));
+
+	check_reset_run("bad frame", &bad_frame_run, AHT20_STATUS_BAD_CRC);
+	check_reset_run("queued reset", &queued_run, AHT20_STATUS_OK);
+
+	return 0;
+}
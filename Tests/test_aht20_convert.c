@@ -0,0 +1,114 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * fixed point conversion against the datasheet formulas in double: every one
+ * of the 2^20 raw humidity and temperature values is within 0.01 %RH and
+ * 0.01 C, the frame parser feeds the same values and the fahrenheit
+ * conversion rounds to the nearest hundredth
+ */
+
+#include "aht20.h"
+#include "check.h"
+#include <math.h>
+#include <stdio.h>
+
+#define RAW_VALUES (1UL << 20)
+
+/*
+ * allowed error in hundredths, the request asks for 0.01 %RH and 0.01 C
+ */
+#define MAX_ERROR_CENTI 1.0
+
+/*
+ * datasheet formulas, 6.1 and 6.2, in hundredths
+ */
+static double reference_humidity(uint32_t raw) {
+	return (double)raw / (double)RAW_VALUES * 100.0 * 100.0;
+}
+
+static double reference_temperature(uint32_t raw) {
+	return ((double)raw / (double)RAW_VALUES * 200.0 - 50.0) * 100.0;
+}
+
+/*
+ * frame carrying the raw values, status and crc don't matter to the parser
+ */
+static void build_frame(uint32_t raw_humidity, uint32_t raw_temperature, uint8_t frame[7]) {
+	frame[0] = 0x18;
+	frame[1] = (uint8_t)(raw_humidity >> 12);
+	frame[2] = (uint8_t)(raw_humidity >> 4);
+	frame[3] = (uint8_t)(((raw_humidity & 0x0FU) << 4) | (raw_temperature >> 16));
+	frame[4] = (uint8_t)(raw_temperature >> 8);
+	frame[5] = (uint8_t)raw_temperature;
+	frame[6] = 0;
+}
+
+int main(void) {
+	double max_humidity_error = 0.0;
+	double max_temperature_error = 0.0;
+	double max_fahrenheit_error = 0.0;
+
+	for (uint32_t raw = 0; raw < RAW_VALUES; ++raw) {
+		int32_t humidity = 0;
+		int32_t temperature = 0;
+
+		/* humidity and temperature swept in opposite directions through the same frames */
+		uint32_t raw_temperature = (uint32_t)(RAW_VALUES - 1U - raw);
+		uint8_t frame[7];
+		build_frame(raw, raw_temperature, frame);
+		aht20_calculate_measurments_fixed(frame, &humidity, &temperature);
+
+		double humidity_error = fabs(humidity - reference_humidity(raw));
+		double temperature_error = fabs(temperature - reference_temperature(raw_temperature));
+		if (humidity_error > MAX_ERROR_CENTI || temperature_error > MAX_ERROR_CENTI) {
+			printf("raw %lu/%lu: %ld %ld, expected %.3f %.3f\n", (unsigned long)raw, (unsigned long)raw_temperature,
+					(long)humidity, (long)temperature, reference_humidity(raw), reference_temperature(raw_temperature));
+			CHECK(!"conversion error");
+		}
+		max_humidity_error = fmax(max_humidity_error, humidity_error);
+		max_temperature_error = fmax(max_temperature_error, temperature_error);
+
+		int32_t humidity_direct = 0;
+		int32_t temperature_direct = 0;
+		aht20_convert_raw_fixed(raw, raw_temperature, &humidity_direct, &temperature_direct);
+		CHECK(humidity_direct == humidity);
+		CHECK(temperature_direct == temperature);
+
+		/* fahrenheit of the converted value, rounded half away from zero */
+		double fahrenheit = temperature * 9.0 / 5.0 + 3200.0;
+		double fahrenheit_error = fabs(aht20_celsius_to_fahrenheit_fixed(temperature) - fahrenheit);
+		CHECK(fahrenheit_error <= 0.5);
+		max_fahrenheit_error = fmax(max_fahrenheit_error, fahrenheit_error);
+	}
+
+	/* ends of the scale */
+	int32_t humidity = 0;
+	int32_t temperature = 0;
+	aht20_convert_raw_fixed(0, 0, &humidity, &temperature);
+	CHECK(humidity == 0);
+	CHECK(temperature == -5000);
+	aht20_convert_raw_fixed(RAW_VALUES - 1U, RAW_VALUES - 1U, &humidity, &temperature);
+	CHECK(humidity == 10000);
+	CHECK(temperature == 15000);
+
+	printf("%lu raw values: max error %.4f %%RH, %.4f C, fahrenheit rounding %.4f F\n", (unsigned long)RAW_VALUES,
+			max_humidity_error / 100.0, max_temperature_error / 100.0, max_fahrenheit_error / 100.0);
+
+	return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * crc8 of the AHT20 frames: built once per AHT20_CRC_IMPLEMENTATION, each
+ * build checks its variant against known vectors and against the bitwise
+ * loop of the datasheet on random frames, then reports the time per frame
+ * of both. together the three builds show that the variants agree
+ */
+
+#include "aht20_crc.h"
+#include "check.h"
+#include <stdio.h>
+#include <time.h>
+
+#define FRAME_DATA_SIZE 6U
+#define RANDOM_FRAMES 2000000U
+#define RANDOM_MAX_SIZE 16U
+#define TIMED_FRAMES 4000000U
+
+/*
+ * data and crc8 from the datasheet algorithm, "123456789" is the catalogue check value of CRC-8/NRSC-5
+ */
+typedef struct {
+	const char *name;
+	uint8_t data[9];
+	uint16_t size;
+	uint8_t crc;
+} crc_vector_t;
+
+static const crc_vector_t VECTORS[] = {
+	{"empty", {0}, 0, 0xFF},
+	{"one zero byte", {0x00}, 1, 0xAC},
+	{"check string", {'1', '2', '3', '4', '5', '6', '7', '8', '9'}, 9, 0xF7},
+	{"zero frame", {0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, FRAME_DATA_SIZE, 0x6A},
+	{"ones frame", {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, FRAME_DATA_SIZE, 0x22},
+	{"21.5 C 45 %RH frame", {0x18, 0x73, 0x33, 0x35, 0xB8, 0x51}, FRAME_DATA_SIZE, 0xBB},
+	{"busy frame", {0x1C, 0x6B, 0x85, 0x55, 0xE6, 0x4C}, FRAME_DATA_SIZE, 0x2A},
+};
+
+static const char *IMPLEMENTATION_NAMES[] = {
+	[AHT20_CRC_BITWISE] = "bitwise",
+	[AHT20_CRC_TABLE] = "table",
+	[AHT20_CRC_NIBBLE] = "nibble",
+};
+
+/*
+ * bitwise crc8 as the datasheet describes it
+ */
+static uint8_t reference_crc8(const uint8_t *data, uint16_t size) {
+	uint8_t crc = 0xFF;
+
+	for (uint16_t i = 0; i < size; i++) {
+		crc ^= data[i];
+		for (uint8_t bit = 0; bit < 8; bit++) {
+			crc = (uint8_t)((crc & 0x80U) ? ((uint32_t)crc << 1) ^ 0x31U : (uint32_t)crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint32_t random_state = 0x2545F491U;
+
+static uint32_t next_random(void) {
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/*
+ * time per frame of crc8 over frames that change every call, the sum keeps the calls
+ */
+static double frame_ns(uint8_t (*crc8)(const uint8_t *data, uint16_t size), volatile uint32_t *sum) {
+	uint8_t frame[FRAME_DATA_SIZE] = {0x1C, 0x6B, 0x85, 0x55, 0xE6, 0x4C};
+	uint32_t total = 0;
+
+	double start = now_ns();
+	for (uint32_t i = 0; i < TIMED_FRAMES; i++) {
+		frame[i % FRAME_DATA_SIZE] ^= (uint8_t)i;
+		total += crc8(frame, FRAME_DATA_SIZE);
+	}
+	double elapsed = now_ns() - start;
+
+	*sum = total;
+	return elapsed / TIMED_FRAMES;
+}
+
+int main(void) {
+	printf("implementation: %s\n", IMPLEMENTATION_NAMES[AHT20_CRC_IMPLEMENTATION]);
+
+	for (size_t i = 0; i < sizeof(VECTORS) / sizeof(VECTORS[0]); i++) {
+		uint8_t crc = aht20_crc8(VECTORS[i].data, VECTORS[i].size);
+		printf("%s: %02X\n", VECTORS[i].name, crc);
+		CHECK(crc == VECTORS[i].crc);
+		CHECK(reference_crc8(VECTORS[i].data, VECTORS[i].size) == VECTORS[i].crc);
+	}
+
+	/* random frames of the AHT20 size and of other sizes */
+	uint8_t data[RANDOM_MAX_SIZE];
+	for (uint32_t i = 0; i < RANDOM_FRAMES; i++) {
+		uint16_t size = (i % 4U == 0U) ? (uint16_t)(next_random() % (RANDOM_MAX_SIZE + 1U)) : FRAME_DATA_SIZE;
+		for (uint16_t j = 0; j < size; j++) {
+			data[j] = (uint8_t)next_random();
+		}
+		CHECK(aht20_crc8(data, size) == reference_crc8(data, size));
+	}
+	printf("%u random frames agree with the bitwise reference\n", RANDOM_FRAMES);
+
+	/* every single bit error of a frame is detected */
+	uint8_t frame[FRAME_DATA_SIZE] = {0x18, 0x73, 0x33, 0x35, 0xB8, 0x51};
+	uint8_t crc = aht20_crc8(frame, FRAME_DATA_SIZE);
+	for (uint32_t bit = 0; bit < FRAME_DATA_SIZE * 8U; bit++) {
+		frame[bit / 8U] ^= (uint8_t)(1U << (bit % 8U));
+		CHECK(aht20_crc8(frame, FRAME_DATA_SIZE) != crc);
+		frame[bit / 8U] ^= (uint8_t)(1U << (bit % 8U));
+	}
+
+	volatile uint32_t sum = 0;
+	double reference_ns = frame_ns(reference_crc8, &sum);
+	double implementation_ns = frame_ns(aht20_crc8, &sum);
+	printf("host time per frame: %s %.1f ns, bitwise reference %.1f ns\n",
+			IMPLEMENTATION_NAMES[AHT20_CRC_IMPLEMENTATION], implementation_ns, reference_ns);
+
+	return 0;
+}
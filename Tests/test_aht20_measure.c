@@ -0,0 +1,156 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * the AHT20 conversion no longer blocks the main loop: the sensor task returns
+ * within a few milliseconds while the virtual sensor converts, buttons are
+ * handled in the middle of a slow conversion, a bad checksum is followed by a
+ * soft reset that doesn't hold the task, and a sensor stuck busy is reset
+ * in background as well, without stalling the scheduler
+ */
+
+#include "sim.h"
+#include "scheduler.h"
+#include "check.h"
+#include <stdio.h>
+
+/*
+ * scheduler ids in the order bl_start_tasks adds the tasks
+ */
+#define TASK_BUTTONS 0
+#define TASK_SENSOR 1
+
+/*
+ * longest run of the sensor task: the old HAL_Delay(80) held the core for 80 ms
+ */
+#define SENSOR_TASK_BUDGET_MS 2
+
+#define CORE_CYCLES_PER_MS 84000U
+
+/*
+ * active-low segment codes of the unit digit, button A steps C, F, H
+ */
+#define CODE_C 0xC6
+#define CODE_F 0x8E
+#define CODE_H 0x89
+
+static uint8_t shown_unit(void) {
+	sim_display_t display;
+	sim_display_read(&display);
+	return display.code[0];
+}
+
+static uint32_t sensor_task_max_ms(void) {
+	scheduler_task_stats_t stats;
+	scheduler_status_t status = scheduler_get_stats(TASK_SENSOR, &stats);
+	CHECK(status == SCHEDULER_STATUS_OK);
+	return stats.max_cycles / CORE_CYCLES_PER_MS;
+}
+
+/*
+ * waits for the virtual sensor to start a conversion
+ */
+static void wait_for_measurement(void) {
+	sim_aht20_stats_t stats;
+	sim_aht20_get_stats(&stats);
+	uint32_t measurements = stats.measurements;
+
+	for (uint32_t ms = 0; ms < 5000; ms++) {
+		sim_run_ms(1);
+		sim_aht20_get_stats(&stats);
+		if (stats.measurements != measurements) {
+			return;
+		}
+	}
+	CHECK(!"no measurement started");
+}
+
+/*
+ * presses button A and returns the time until the display shows unit
+ */
+static uint32_t unit_switch_ms(uint8_t unit) {
+	sim_button_set(SIM_BUTTON_A, true);
+	sim_run_ms(60);
+	sim_button_set(SIM_BUTTON_A, false);
+
+	for (uint32_t ms = 0; ms < 1000; ms++) {
+		if (shown_unit() == unit) {
+			return ms;
+		}
+		sim_run_ms(1);
+	}
+	return UINT32_MAX;
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_boot();
+	sim_run_ms(3000);
+
+	sim_aht20_stats_t stats;
+	sim_aht20_get_stats(&stats);
+	printf("%u measurements, sensor task max %lu ms\n", stats.measurements, (unsigned long)sensor_task_max_ms());
+	CHECK(stats.measurements >= 2);
+	CHECK(sensor_task_max_ms() <= SENSOR_TASK_BUDGET_MS);
+	CHECK(shown_unit() == CODE_C);
+
+	/* a slow conversion: the button is handled while the sensor converts */
+	sim_aht20()->conversion_ms = 150;
+	wait_for_measurement();
+	sim_run_ms(20);
+	uint32_t switch_ms = unit_switch_ms(CODE_F);
+	sim_aht20_get_stats(&stats);
+	printf("unit switched %lu ms after release, mid-conversion\n", (unsigned long)switch_ms);
+	CHECK(switch_ms <= 50);
+	sim_run_ms(2000);
+	CHECK(sensor_task_max_ms() <= SENSOR_TASK_BUDGET_MS);
+	sim_aht20()->conversion_ms = 80;
+	sim_aht20_get_stats(&stats);
+
+	/* a frame with a wrong checksum is dropped, the sensor reset in background and the next one read */
+	uint32_t frames = stats.frames_read;
+	uint32_t soft_resets = stats.soft_resets;
+	sim_aht20()->temperature_centi = 3000;
+	sim_aht20()->bad_crc_frames = 1;
+	sim_run_ms(3000);
+	sim_aht20_get_stats(&stats);
+	printf("bad crc: %u soft resets, %u frames read after the bad one, sensor task max %lu ms\n",
+			stats.soft_resets - soft_resets, stats.frames_read - frames - 1, (unsigned long)sensor_task_max_ms());
+	CHECK(stats.soft_resets == soft_resets + 1);
+	CHECK(stats.frames_read > frames + 1);
+	CHECK(sensor_task_max_ms() <= SENSOR_TASK_BUDGET_MS);
+
+	/* a sensor that never clears its busy bit is reset without waiting the 20 ms in the task, buttons keep working */
+	sim_aht20_get_stats(&stats);
+	soft_resets = stats.soft_resets;
+	uint32_t resets = stats.soft_resets + stats.power_cycles;
+	sim_aht20()->stuck_busy = true;
+	sim_run_ms(3000);
+	switch_ms = unit_switch_ms(CODE_H);
+	sim_aht20()->stuck_busy = false;
+	sim_run_ms(3000);
+	sim_aht20_get_stats(&stats);
+	printf("stuck busy: %u resets, unit switched %lu ms after release, sensor task max %lu ms\n",
+			stats.soft_resets + stats.power_cycles - resets, (unsigned long)switch_ms, (unsigned long)sensor_task_max_ms());
+	CHECK(stats.soft_resets > soft_resets);
+	CHECK(switch_ms <= 50);
+	CHECK(sensor_task_max_ms() <= SENSOR_TASK_BUDGET_MS);
+
+	return 0;
+}
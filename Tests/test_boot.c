@@ -0,0 +1,97 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * boots the firmware in the host simulation: the display shows the virtual
+ * sensor, button A switches the unit, the display times out and the core stops
+ */
+
+#include "sim.h"
+#include "check.h"
+#include <stdio.h>
+
+/*
+ * active-low segment codes, digit 0 holds the unit
+ */
+#define CODE_C 0xC6
+#define CODE_F 0x8E
+#define CODE_BLANK 0xFF
+#define CODE_0 0xC0
+#define CODE_1 0xF9
+#define CODE_2 0xA4
+#define CODE_5 0x92
+#define CODE_7 0xF8
+#define DP 0x80
+
+static void press(sim_button_t button, uint32_t hold_ms) {
+	sim_button_set(button, true);
+	sim_run_ms(hold_ms);
+	sim_button_set(button, false);
+}
+
+static void expect_codes(uint8_t unit, uint8_t tens, uint8_t ones, uint8_t tenths) {
+	sim_display_t display;
+	sim_display_read(&display);
+	printf("%6lu ms: %02X %02X %02X %02X\n", (unsigned long)sim_time_ms(),
+			display.code[0], display.code[1], display.code[2], display.code[3]);
+	CHECK(display.refreshing);
+	CHECK(display.code[0] == unit);
+	CHECK(display.code[1] == tens);
+	CHECK(display.code[2] == (uint8_t)(ones & ~DP));
+	CHECK(display.code[3] == tenths);
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_aht20()->temperature_centi = 2150;
+	sim_boot();
+
+	sim_run_ms(2000);
+	expect_codes(CODE_C, CODE_2, CODE_1, CODE_5);
+
+	press(SIM_BUTTON_A, 80);
+	sim_run_ms(1000);
+	expect_codes(CODE_F, CODE_7, CODE_0, CODE_7);
+
+	/* no activity for the display timeout: blank display, the core sleeps in Stop */
+	sim_power_stats_t before;
+	sim_power_get_stats(&before);
+	sim_run_ms(40000);
+
+	sim_display_t display;
+	sim_display_read(&display);
+	CHECK(!display.refreshing);
+	for (int i = 0; i < 4; i++) {
+		CHECK(display.code[i] == CODE_BLANK);
+	}
+	sim_power_stats_t after;
+	sim_power_get_stats(&after);
+	printf("stop %.1f ms in %u entries, sleep %.1f ms, run %.1f ms\n",
+			(double)(after.stop - before.stop) / SIM_UNITS_PER_MS, after.stop_entries - before.stop_entries,
+			(double)(after.sleep - before.sleep) / SIM_UNITS_PER_MS, (double)(after.run - before.run) / SIM_UNITS_PER_MS);
+	CHECK(after.stop_entries > before.stop_entries);
+
+	/* the first press only wakes the display */
+	press(SIM_BUTTON_A, 80);
+	sim_run_ms(1000);
+	expect_codes(CODE_F, CODE_7, CODE_0, CODE_7);
+
+	return 0;
+}
@@ -0,0 +1,475 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * button sampling with the firmware built with PROFILING: the EXTI edge of a
+ * shield button starts TIM6 and the vertical counter toggles a pin after 4
+ * equal samples, a press shorter than that is dropped and a bouncing contact
+ * gives one EXTI interrupt and one event per press and per release. the user
+ * button of the nucleo board has no registered button, its interrupts reach
+ * read_button through the EXTI table as an unknown pin, are counted and never
+ * start sampling. the cycles of the EXTI callback for both are printed from
+ * the profiler, and the lookup of read_button is timed against the linked list
+ * walk it replaced, with the host time charged as cycles
+ */
+
+#include "sim.h"
+#include "buttons.h"
+#include "business_logic.h"
+#include "profiler.h"
+#include "check.h"
+#include <stdio.h>
+
+#ifndef PROFILING
+#error "the buttons test runs the firmware built with PROFILING"
+#endif
+
+/*
+ * samples of the vertical counter for a state change, 5 ms apart
+ */
+#define DEBOUNCE_SAMPLES 4U
+#define DEBOUNCE_MS (DEBOUNCE_SAMPLES * BUTTON_SAMPLE_PERIOD_MS)
+
+/*
+ * presses held for fewer samples than the vertical counter needs
+ */
+#define GLITCH_MS 2U
+#define SHORT_PRESS_MS 17U
+
+#define MAX_EVENTS 32U
+#define SETTLE_MS 100U
+#define STRAY_EDGES 5U
+
+/*
+ * contact bounce in us between toggles, starting with the first edge: a short one
+ * settling before the first sample and a long one seen by several samples
+ */
+static const uint32_t SHORT_BOUNCE_US[] = {200, 300, 150, 700, 100, 1200, 250, 600, 150};
+static const uint32_t LONG_BOUNCE_US[] = {1000, 2000, 1000, 3000, 1000, 1000, 2000, 4000, 1000};
+#define BOUNCE_TOGGLES (sizeof(SHORT_BOUNCE_US) / sizeof(SHORT_BOUNCE_US[0]))
+#define LONG_BOUNCE_TOTAL_MS 16U
+
+/*
+ * lookups timed for each dispatch, host time is charged at one cycle per ns while they run
+ */
+#define DISPATCH_ROUNDS 10000U
+#define HOST_CYCLES_PER_NS 1.0
+
+/*
+ * clock setup and sampling timer of main.c
+ */
+void SystemClock_Config(void);
+extern TIM_HandleTypeDef htim6;
+
+/*
+ * event taken by the firmware context with the profiler counts at that time
+ */
+typedef struct {
+	Button_Event event;
+	uint32_t samples;
+	uint32_t exti_irqs;
+} logged_t;
+
+/*
+ * what the firmware context saw, published every time it wakes up
+ */
+static struct {
+	volatile bool ready;
+	volatile bool finished;
+	volatile uint32_t tick;
+	volatile bool sampling;
+	volatile uint32_t samples;
+	volatile uint32_t exti_irqs;
+	volatile uint32_t unknown_pins;
+	uint32_t unknown_pins_direct;
+	profiler_stats_t callback;
+	profiler_stats_t exti;
+	profiler_stats_t tim6;
+	logged_t log[MAX_EVENTS];
+	volatile uint32_t logged;
+	uint32_t walk_head_cycles;
+	uint32_t walk_tail_cycles;
+	uint32_t walk_stray_cycles;
+	uint32_t table_stray_cycles;
+	uint32_t table_unknown_pins;
+} seen;
+
+/*
+ * button list and lookup of read_button before the EXTI table: button_init pushed
+ * each button to the front of the list, button B initialized last is the head,
+ * and check_interrupt_pin walked it, ending on the last node for a pin without a button
+ */
+typedef struct list_button {
+	uint16_t pin;
+	volatile struct list_button *next_button;
+} list_button_t;
+
+static volatile list_button_t list_button_a = {.pin = BUTTON_S1_Pin, .next_button = NULL};
+static volatile list_button_t list_button_b = {.pin = BUTTON_S2_Pin, .next_button = &list_button_a};
+static volatile list_button_t *const list_entry = &list_button_b;
+
+static volatile list_button_t *list_check_interrupt_pin(uint16_t gpio_pin) {
+	volatile list_button_t *button_to_return = list_entry;
+
+	while (button_to_return->next_button != NULL) {
+		if (button_to_return->pin != gpio_pin) {
+			button_to_return = button_to_return->next_button;
+		} else {
+			break;
+		}
+	}
+
+	return button_to_return;
+}
+
+/*
+ * cycles of DISPATCH_ROUNDS list walks for a pin, interrupts masked so only the walks are counted
+ */
+static uint32_t time_list_walk(uint16_t gpio_pin) {
+	volatile list_button_t *found = NULL;
+
+	__disable_irq();
+	uint32_t start = DWT->CYCCNT;
+	for (uint32_t i = 0; i < DISPATCH_ROUNDS; i++) {
+		found = list_check_interrupt_pin(gpio_pin);
+	}
+	uint32_t cycles = DWT->CYCCNT - start;
+	__enable_irq();
+
+	CHECK(found != NULL);
+	return cycles;
+}
+
+/*
+ * cycles of DISPATCH_ROUNDS calls of read_button through the EXTI table for a pin without a button,
+ * the only pin that doesn't start sampling
+ */
+static uint32_t time_table_dispatch(uint16_t gpio_pin) {
+	uint32_t unknown_pins = button_get_unknown_pin_count();
+
+	__disable_irq();
+	uint32_t start = DWT->CYCCNT;
+	for (uint32_t i = 0; i < DISPATCH_ROUNDS; i++) {
+		read_button(gpio_pin);
+	}
+	uint32_t cycles = DWT->CYCCNT - start;
+	__enable_irq();
+
+	seen.table_unknown_pins = button_get_unknown_pin_count() - unknown_pins;
+	return cycles;
+}
+
+/*
+ * line 13 of the user button, routed like the shield buttons but without a button behind it
+ */
+void EXTI15_10_IRQHandler(void) {
+	HAL_GPIO_EXTI_IRQHandler(B1_Pin);
+}
+
+static void publish(void) {
+	profiler_stats_t exti1;
+	profiler_stats_t exti4;
+	profiler_stats_t tim6;
+
+	profiler_get_stats(PROFILER_EXTI1_IRQ, &exti1);
+	profiler_get_stats(PROFILER_EXTI4_IRQ, &exti4);
+	profiler_get_stats(PROFILER_TIM6_IRQ, &tim6);
+	profiler_get_stats(PROFILER_GPIO_EXTI_CALLBACK, &seen.callback);
+
+	seen.samples = tim6.count;
+	seen.exti_irqs = exti1.count + exti4.count;
+	seen.unknown_pins = button_get_unknown_pin_count();
+	seen.sampling = button_is_sampling();
+	seen.tick = HAL_GetTick();
+}
+
+/*
+ * GPIO, EXTI and TIM6 of main.c, the user button with an interrupt on its falling edge
+ */
+static void buttons_setup(void) {
+	GPIO_InitTypeDef gpio = {0};
+	TIM_MasterConfigTypeDef master = {0};
+
+	SystemInit();
+	HAL_Init();
+	SystemClock_Config();
+	profiler_init();
+
+	__HAL_RCC_GPIOA_CLK_ENABLE();
+	__HAL_RCC_GPIOC_CLK_ENABLE();
+
+	gpio.Pin = BUTTON_S1_Pin | BUTTON_S2_Pin;
+	gpio.Mode = GPIO_MODE_IT_RISING_FALLING;
+	gpio.Pull = GPIO_PULLUP;
+	HAL_GPIO_Init(GPIOA, &gpio);
+
+	gpio.Pin = B1_Pin;
+	gpio.Mode = GPIO_MODE_IT_FALLING;
+	gpio.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(B1_GPIO_Port, &gpio);
+
+	HAL_NVIC_SetPriority(EXTI1_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+	HAL_NVIC_SetPriority(EXTI4_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(EXTI4_IRQn);
+	HAL_NVIC_SetPriority(EXTI15_10_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+
+	htim6.Instance = TIM6;
+	htim6.Init.Prescaler = 8399;
+	htim6.Init.CounterMode = TIM_COUNTERMODE_UP;
+	htim6.Init.Period = 49;
+	htim6.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+	CHECK(HAL_TIM_Base_Init(&htim6) == HAL_OK);
+	master.MasterOutputTrigger = TIM_TRGO_RESET;
+	master.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+	CHECK(HAL_TIMEx_MasterConfigSynchronization(&htim6, &master) == HAL_OK);
+
+	/* the events are taken here instead of by the gesture recognizer */
+	CHECK(bl_init_buttons(&htim6) == BL_STATUS_OK);
+	button_set_sample_callback(NULL);
+}
+
+static void buttons_entry(void) {
+	buttons_setup();
+
+	/* pins without a button and masks of several pins aren't dispatched */
+	read_button(GPIO_PIN_7);
+	read_button(BUTTON_S1_Pin | BUTTON_S2_Pin);
+	read_button(0);
+	seen.unknown_pins_direct = button_get_unknown_pin_count();
+	seen.ready = true;
+
+	while (!seen.finished) {
+		Button_Event event;
+		while (button_get_event(&event)) {
+			publish();
+			if (seen.logged < MAX_EVENTS) {
+				seen.log[seen.logged] = (logged_t) {
+					.event = event,
+					.samples = seen.samples,
+					.exti_irqs = seen.exti_irqs,
+				};
+			}
+			seen.logged++;
+		}
+		publish();
+		__WFI();
+	}
+
+	profiler_get_stats(PROFILER_EXTI1_IRQ, &seen.exti);
+	profiler_get_stats(PROFILER_TIM6_IRQ, &seen.tim6);
+
+	seen.walk_head_cycles = time_list_walk(BUTTON_S2_Pin);
+	seen.walk_tail_cycles = time_list_walk(BUTTON_S1_Pin);
+	seen.walk_stray_cycles = time_list_walk(B1_Pin);
+	seen.table_stray_cycles = time_table_dispatch(B1_Pin);
+}
+
+/*
+ * cycles of one lookup
+ */
+static double per_lookup(uint32_t cycles) {
+	return (double)cycles / DISPATCH_ROUNDS;
+}
+
+/*
+ * counts at the start of a step, taken while sampling is stopped
+ */
+typedef struct {
+	uint32_t logged;
+	uint32_t samples;
+	uint32_t exti_irqs;
+	uint32_t unknown_pins;
+	uint32_t tick;
+} mark_t;
+
+static bool ready(void) {
+	return seen.ready;
+}
+
+static bool sampling_stopped(void) {
+	return !seen.sampling;
+}
+
+static void settle(mark_t *mark) {
+	CHECK(sim_run_until(sampling_stopped, SETTLE_MS));
+	sim_run_ms(1);
+	mark->logged = seen.logged;
+	mark->samples = seen.samples;
+	mark->exti_irqs = seen.exti_irqs;
+	mark->unknown_pins = seen.unknown_pins;
+	mark->tick = seen.tick;
+}
+
+/*
+ * the event logged at index, of the expected type on line 1 of button A
+ */
+static const logged_t *logged(uint32_t index, Button_Event_Type type) {
+	CHECK(index < seen.logged);
+	const logged_t *entry = &seen.log[index];
+	CHECK(entry->event.line == POSITION_VAL(BUTTON_S1_Pin));
+	CHECK(entry->event.type == type);
+	return entry;
+}
+
+/*
+ * drives button A through the bounce, ends on the given level, returns the tick of the last edge
+ */
+static uint32_t bounce(bool pressed, const uint32_t *bounce_us) {
+	for (uint32_t i = 0; i < BOUNCE_TOGGLES; i++) {
+		sim_button_set(SIM_BUTTON_A, (i % 2U == 0) == pressed);
+		sim_run_us(bounce_us[i]);
+	}
+	sim_button_set(SIM_BUTTON_A, pressed);
+	return seen.tick;
+}
+
+int main(void) {
+	mark_t mark;
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_start(buttons_entry);
+	CHECK(sim_run_until(ready, 100));
+	CHECK(seen.unknown_pins_direct == 3);
+	settle(&mark);
+
+	/* clean press: one EXTI interrupt, the 4th sample after it reports the press */
+	sim_button_set(SIM_BUTTON_A, true);
+	uint32_t press_tick = seen.tick;
+	sim_run_ms(DEBOUNCE_MS + 2U * BUTTON_SAMPLE_PERIOD_MS);
+	CHECK(seen.sampling);
+	uint32_t press_index = mark.logged;
+	CHECK(seen.logged == press_index + 1U);
+	const logged_t *press = logged(press_index, BUTTON_EVENT_PRESS);
+	printf("clean press: reported after %lu samples, %lu ms\n", (unsigned long)(press->samples - mark.samples),
+			(unsigned long)(press->event.time - press_tick));
+	CHECK(press->samples - mark.samples == DEBOUNCE_SAMPLES);
+	CHECK(press->exti_irqs - mark.exti_irqs == 1U);
+	CHECK(press->event.time - press_tick >= DEBOUNCE_MS - 1U && press->event.time - press_tick <= DEBOUNCE_MS + 1U);
+
+	/* clean release: the first sample after the edge and 3 more */
+	sim_button_set(SIM_BUTTON_A, false);
+	uint32_t release_tick = seen.tick;
+	settle(&mark);
+	CHECK(mark.logged == press_index + 2U);
+	const logged_t *release = logged(press_index + 1U, BUTTON_EVENT_RELEASE);
+	printf("clean release: reported %lu ms after the edge\n", (unsigned long)(release->event.time - release_tick));
+	CHECK(release->event.time - release_tick > DEBOUNCE_MS - BUTTON_SAMPLE_PERIOD_MS - 1U);
+	CHECK(release->event.time - release_tick <= DEBOUNCE_MS + 1U);
+	CHECK(release->exti_irqs == press->exti_irqs);
+
+	/* presses held for less than 4 samples are dropped, the sampling stops again */
+	sim_button_set(SIM_BUTTON_A, true);
+	sim_run_ms(GLITCH_MS);
+	sim_button_set(SIM_BUTTON_A, false);
+	settle(&mark);
+	sim_button_set(SIM_BUTTON_A, true);
+	sim_run_ms(SHORT_PRESS_MS);
+	sim_button_set(SIM_BUTTON_A, false);
+	uint32_t logged_before = mark.logged;
+	uint32_t exti_before = mark.exti_irqs;
+	settle(&mark);
+	printf("presses of %u ms and %u ms: %lu events\n", GLITCH_MS, SHORT_PRESS_MS, (unsigned long)(mark.logged - logged_before));
+	CHECK(mark.logged == logged_before);
+	CHECK(mark.exti_irqs - exti_before == 1U);
+
+	/* bouncing press and release: EXTI is masked after the first edge, one event each after the contact settled */
+	uint32_t samples_before = mark.samples;
+	exti_before = mark.exti_irqs;
+	uint32_t settled_tick = bounce(true, SHORT_BOUNCE_US);
+	sim_run_ms(DEBOUNCE_MS + 2U * BUTTON_SAMPLE_PERIOD_MS);
+	press_index = mark.logged;
+	CHECK(seen.logged == press_index + 1U);
+	press = logged(press_index, BUTTON_EVENT_PRESS);
+	uint32_t press_delay = press->event.time - settled_tick;
+	settled_tick = bounce(false, LONG_BOUNCE_US);
+	settle(&mark);
+	CHECK(mark.logged == press_index + 2U);
+	release = logged(press_index + 1U, BUTTON_EVENT_RELEASE);
+	uint32_t release_delay = release->event.time - settled_tick;
+	printf("bouncing press and release, %u edges each: %lu EXTI interrupt, %lu samples, reported %lu ms and %lu ms after settling\n",
+			(unsigned)BOUNCE_TOGGLES + 1U, (unsigned long)(mark.exti_irqs - exti_before), (unsigned long)(mark.samples - samples_before),
+			(unsigned long)press_delay, (unsigned long)release_delay);
+	CHECK(mark.exti_irqs - exti_before == 1U);
+	CHECK(press_delay > DEBOUNCE_MS - BUTTON_SAMPLE_PERIOD_MS - 1U && press_delay <= DEBOUNCE_MS + 1U);
+	CHECK(release_delay > DEBOUNCE_MS - BUTTON_SAMPLE_PERIOD_MS - 1U && release_delay <= DEBOUNCE_MS + 1U);
+
+	/* a press bouncing past the first sample: sampling stops on a released sample and the next edge starts it again, still one event */
+	exti_before = mark.exti_irqs;
+	bounce(true, LONG_BOUNCE_US);
+	sim_run_ms(DEBOUNCE_MS + 2U * BUTTON_SAMPLE_PERIOD_MS);
+	press_index = mark.logged;
+	CHECK(seen.logged == press_index + 1U);
+	logged(press_index, BUTTON_EVENT_PRESS);
+	sim_button_set(SIM_BUTTON_A, false);
+	settle(&mark);
+	CHECK(mark.logged == press_index + 2U);
+	logged(press_index + 1U, BUTTON_EVENT_RELEASE);
+	printf("press bouncing for %u ms: %lu EXTI interrupts, one event\n", LONG_BOUNCE_TOTAL_MS,
+			(unsigned long)(mark.exti_irqs - exti_before));
+	CHECK(mark.exti_irqs - exti_before >= 1U);
+	profiler_stats_t known = seen.callback;
+
+	/* stray pin: every falling edge of the user button is counted, nothing is sampled or reported */
+	for (uint32_t i = 0; i < STRAY_EDGES; i++) {
+		sim_button_set(SIM_BUTTON_USER, true);
+		sim_run_ms(1);
+		CHECK(!seen.sampling);
+		sim_button_set(SIM_BUTTON_USER, false);
+		sim_run_ms(1);
+	}
+	mark_t stray;
+	settle(&stray);
+	printf("stray pin: %u edges, %lu unknown pin interrupts\n", STRAY_EDGES, (unsigned long)(stray.unknown_pins - mark.unknown_pins));
+	CHECK(stray.unknown_pins - mark.unknown_pins == STRAY_EDGES);
+	CHECK(stray.logged == mark.logged);
+	CHECK(stray.samples == mark.samples);
+	CHECK(stray.exti_irqs == mark.exti_irqs);
+	CHECK(seen.callback.count - known.count == STRAY_EDGES);
+
+	/* the lookups are pure C, they only cost cycles while host time is charged */
+	sim_set_cpu_scale(HOST_CYCLES_PER_NS);
+	seen.finished = true;
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 100 && state != SIM_STATE_RETURNED; ms++) {
+		state = sim_run_ms(1);
+	}
+	sim_set_cpu_scale(0);
+	CHECK(state == SIM_STATE_RETURNED);
+
+	/* cycles in the interrupts, the callback split between the button and the stray pin */
+	uint32_t stray_avg = (uint32_t)((seen.callback.total_cycles - known.total_cycles) / STRAY_EDGES);
+	printf("EXTI1 interrupt: %lu calls, min %lu, avg %lu, max %lu cycles\n", (unsigned long)seen.exti.count,
+			(unsigned long)seen.exti.min_cycles, (unsigned long)seen.exti.avg_cycles, (unsigned long)seen.exti.max_cycles);
+	printf("TIM6 interrupt: %lu calls, min %lu, avg %lu, max %lu cycles\n", (unsigned long)seen.tim6.count,
+			(unsigned long)seen.tim6.min_cycles, (unsigned long)seen.tim6.avg_cycles, (unsigned long)seen.tim6.max_cycles);
+	printf("EXTI callback: avg %lu cycles for a button, %lu for the stray pin\n", (unsigned long)known.avg_cycles,
+			(unsigned long)stray_avg);
+	CHECK(seen.exti.count == mark.exti_irqs);
+	CHECK(stray_avg <= known.avg_cycles);
+
+	/* dispatch before and after the table, same pins, host time at one cycle per ns */
+	printf("list walk: %.2f cycles for button B at the head, %.2f for button A, %.2f for the stray pin\n",
+			per_lookup(seen.walk_head_cycles), per_lookup(seen.walk_tail_cycles), per_lookup(seen.walk_stray_cycles));
+	printf("EXTI table: %.2f cycles for the stray pin through read_button\n", per_lookup(seen.table_stray_cycles));
+	CHECK(seen.table_unknown_pins == DISPATCH_ROUNDS);
+
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * char_gen_encode against the 17-entry linear scan it replaced: both agree on
+ * the characters the scan knew, the table also covers letters the scan showed
+ * blank, and the host time of both over the same frames is reported
+ */
+
+#include "character_generator.h"
+#include "check.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DIGITS 4
+#define ROUNDS 200000U
+
+/*
+ * glyph list and encoding loop of char_gen_transmit before the table
+ */
+static const struct {
+	char ch;
+	uint8_t code;
+} scan_mappings[] = {
+	{'0', 0xC0}, {'1', 0xF9}, {'2', 0xA4}, {'3', 0xB0}, {'4', 0x99},
+	{'5', 0x92}, {'6', 0x82}, {'7', 0xF8}, {'8', 0x80}, {'9', 0x90},
+	{'H', 0x89}, {'h', 0x89}, {'F', 0x8E}, {'f', 0x8E}, {'C', 0xC6},
+	{'c', 0xC6}, {'-', 0xBF},
+};
+
+static void scan_encode(const char *text, const period_status *periods, uint16_t *out) {
+	for (uint8_t i = 0; i < DIGITS; ++i) {
+		uint8_t code = 0xFF;
+		for (size_t j = 0; j < sizeof(scan_mappings) / sizeof(scan_mappings[0]); ++j) {
+			if (scan_mappings[j].ch == text[i]) {
+				code = scan_mappings[j].code;
+				break;
+			}
+		}
+		if (periods[i] == PERIOD_ON) {
+			code &= (uint8_t)~(1U << 7);
+		}
+		out[i] = (uint16_t)(code << 8) | (1U << i);
+	}
+}
+
+/*
+ * frames the business layer shows, the last characters of each are found late in the scan
+ */
+static const char *const FRAMES[] = {
+	"C215", "F707", "H450", "C-12", "F185", "c-99", "----", "h100",
+};
+#define FRAME_COUNT (sizeof(FRAMES) / sizeof(FRAMES[0]))
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int main(void) {
+	static const period_status periods[DIGITS] = {PERIOD_OFF, PERIOD_OFF, PERIOD_ON, PERIOD_OFF};
+	const uint8_t period_mask = 1U << 2;
+	uint16_t expected[DIGITS];
+	uint16_t encoded[DIGITS];
+	char_generator_status_t status;
+
+	/* same words for every character the scan knew */
+	for (size_t j = 0; j < sizeof(scan_mappings) / sizeof(scan_mappings[0]); ++j) {
+		char text[DIGITS + 1];
+		memset(text, scan_mappings[j].ch, DIGITS);
+		text[DIGITS] = '\0';
+		scan_encode(text, periods, expected);
+		status = char_gen_encode(text, period_mask, encoded, DIGITS);
+		CHECK(status == CHAR_GEN_STATUS_OK);
+		CHECK(memcmp(expected, encoded, sizeof(expected)) == 0);
+	}
+
+	/* letters the scan showed blank */
+	const char *const words[] = {"Err", "Lo", "Hi", "oPEn"};
+	for (size_t w = 0; w < sizeof(words) / sizeof(words[0]); ++w) {
+		for (const char *ch = words[w]; *ch != '\0'; ++ch) {
+			CHECK(char_gen_glyph(*ch) != 0xFF);
+		}
+	}
+	CHECK(char_gen_glyph(' ') == 0xFF);
+
+	/* short strings are padded blank */
+	status = char_gen_encode("Lo", 0, encoded, DIGITS);
+	CHECK(status == CHAR_GEN_STATUS_OK);
+	CHECK(encoded[2] == (0xFF00 | (1U << 2)) && encoded[3] == (0xFF00 | (1U << 3)));
+	status = char_gen_encode("Lo", 0, encoded, 9);
+	CHECK(status == CHAR_GEN_STATUS_INVALID_PARAMETERS);
+
+	volatile uint16_t sink = 0;
+
+	uint64_t start = now_ns();
+	for (uint32_t round = 0; round < ROUNDS; ++round) {
+		scan_encode(FRAMES[round % FRAME_COUNT], periods, encoded);
+		sink ^= encoded[round % DIGITS];
+	}
+	uint64_t scan_ns = now_ns() - start;
+
+	start = now_ns();
+	for (uint32_t round = 0; round < ROUNDS; ++round) {
+		char_gen_encode(FRAMES[round % FRAME_COUNT], period_mask, encoded, DIGITS);
+		sink ^= encoded[round % DIGITS];
+	}
+	uint64_t table_ns = now_ns() - start;
+
+	printf("linear scan %.1f ns/frame, table %.1f ns/frame (host)\n",
+			(double)scan_ns / ROUNDS, (double)table_ns / ROUNDS);
+	(void)sink;
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * master brightness of the display: every level of driver_7_seg_set_brightness
+ * is measured on the integrated segment duty of the display model. over the 256
+ * scans of a frame each segment is lit in the scans of the gamma curve, within
+ * one scan, the duty never decreases with the level and level 0 is dark
+ */
+
+#include "display_setup.h"
+#include <stdio.h>
+
+#define LEVELS 256U
+
+/*
+ * the new frame is shown within two frames, the last complete window of the model
+ * (four frames) lies entirely after it once two more windows passed
+ */
+#define SETTLE_MS 11U
+
+/*
+ * duty of the display model in 1/65536 of its window, each digit gets one slot of the 4 of a scan
+ */
+#define DUTY_PER_SCAN (65536U / (DISPLAY_DIGITS * DISPLAY_SCANS))
+
+/*
+ * every digit with all 8 segments on
+ */
+static const uint16_t DATA[DISPLAY_DIGITS] = {0x0001, 0x0002, 0x0004, 0x0008};
+static const driver_7_seg_brightness_t FULL[DISPLAY_DIGITS] = {255, 255, 255, 255};
+
+/*
+ * what each level showed, checked by main
+ */
+static driver_7_seg_status_t status[LEVELS];
+static sim_display_t shown[LEVELS];
+
+static void brightness_entry(void) {
+	display_setup();
+	CHECK(driver_7_seg_send_buffer(DATA, FULL, DISPLAY_DIGITS) == DRIVER_7_SEG_STATUS_OK);
+
+	for (uint32_t level = 0; level < LEVELS; level++) {
+		status[level] = driver_7_seg_set_brightness((uint8_t)level);
+		HAL_Delay(SETTLE_MS);
+		sim_display_read(&shown[level]);
+	}
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_start(brightness_entry);
+
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 10000 && state != SIM_STATE_RETURNED; ms += 10) {
+		state = sim_run_ms(10);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+
+	uint32_t worst_error = 0;
+	uint32_t previous_duty = 0;
+	for (uint32_t level = 0; level < LEVELS; level++) {
+		CHECK(status[level] == DRIVER_7_SEG_STATUS_OK);
+		CHECK(shown[level].refreshing);
+
+		uint32_t expected = display_gamma_scans((uint8_t)level) * DUTY_PER_SCAN;
+		for (uint32_t digit = 0; digit < DISPLAY_DIGITS; digit++) {
+			for (uint32_t segment = 0; segment < 8U; segment++) {
+				uint32_t duty = shown[level].duty[digit][segment];
+				uint32_t error = duty > expected ? duty - expected : expected - duty;
+				if (error > DUTY_PER_SCAN) {
+					printf("level %lu, digit %lu, segment %lu: duty %lu, expected %lu\n", (unsigned long)level,
+							(unsigned long)digit, (unsigned long)segment, (unsigned long)duty, (unsigned long)expected);
+					CHECK(!"duty off the gamma curve");
+				}
+				worst_error = error > worst_error ? error : worst_error;
+			}
+		}
+
+		uint32_t duty = shown[level].duty[0][0];
+		CHECK(duty >= previous_duty);
+		previous_duty = duty;
+		if (level % 32U == 0 || level == LEVELS - 1U) {
+			printf("level %3lu: %lu scans expected, %lu.%02lu measured\n", (unsigned long)level,
+					(unsigned long)display_gamma_scans((uint8_t)level), (unsigned long)(duty / DUTY_PER_SCAN),
+					(unsigned long)(duty % DUTY_PER_SCAN * 100U / DUTY_PER_SCAN));
+		}
+	}
+
+	/* level 0 turns the display dark while it keeps refreshing */
+	for (uint32_t digit = 0; digit < DISPLAY_DIGITS; digit++) {
+		CHECK(shown[0].code[digit] == 0xFF);
+	}
+	printf("worst error %lu/%u of a scan\n", (unsigned long)worst_error, DUTY_PER_SCAN);
+
+	return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * display_format_value against an snprintf reference: the whole sensor range,
+ * -40..+85 C (and the same readings in F) and 0..100 %RH in 0.01 steps plus a
+ * margin on both sides, gives the same segment codes. display_format_quantize
+ * changes exactly where the segment codes change. the host time of both
+ * formatters is reported
+ */
+
+#include "display_format.h"
+#include "character_generator.h"
+#include "aht20.h"
+#include "check.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define MARGIN_CENTI 200
+#define ROUNDS 200000U
+
+static const display_format_range_t TEMPERATURE_C_RANGE = {.min_centi = -4000, .max_centi = 8500};
+static const display_format_range_t TEMPERATURE_F_RANGE = {.min_centi = -4000, .max_centi = 18500};
+static const display_format_range_t HUMIDITY_RANGE = {.min_centi = 0, .max_centi = 10000};
+
+/*
+ * formats with snprintf and encodes the text, a '.' sets the decimal point of the digit before it
+ */
+static void reference_format(int32_t value_centi, char unit, const display_format_range_t *range, uint8_t codes[4]) {
+	char text[16];
+	long tenths = lround(value_centi / 10.0);
+	long units = lround(value_centi / 100.0);
+
+	if (value_centi > range->max_centi || units > 999) {
+		snprintf(text, sizeof(text), "%c Hi", unit);
+	} else if (value_centi < range->min_centi || units < -99) {
+		snprintf(text, sizeof(text), "%c Lo", unit);
+	} else if (tenths >= -99 && tenths <= 999) {
+		snprintf(text, sizeof(text), "%c%4.1f", unit, tenths / 10.0);
+	} else {
+		snprintf(text, sizeof(text), "%c%3ld", unit, units);
+	}
+
+	char digits[5] = {0};
+	uint8_t period_mask = 0;
+	uint8_t count = 0;
+	for (const char *ch = text; *ch != '\0' && count <= 4; ++ch) {
+		if (*ch == '.') {
+			period_mask |= (uint8_t)(1U << (count - 1));
+		} else {
+			digits[count++] = *ch;
+		}
+	}
+	CHECK(count == 4);
+
+	uint16_t words[4];
+	char_gen_encode(digits, period_mask, words, 4);
+	for (uint8_t i = 0; i < 4; ++i) {
+		codes[i] = (uint8_t)(words[i] >> 8);
+	}
+}
+
+static uint32_t sweep(char unit, const display_format_range_t *range, int32_t from, int32_t to, int32_t (*convert)(int32_t)) {
+	uint32_t checked = 0;
+	uint8_t previous_codes[4] = {0};
+	int32_t previous_quantized = 0;
+
+	for (int32_t centi = from; centi <= to; ++centi) {
+		int32_t value = convert != NULL ? convert(centi) : centi;
+		int32_t quantized = display_format_quantize(value, range);
+		uint8_t expected[4];
+		uint8_t codes[4];
+
+		reference_format(value, unit, range, expected);
+		display_format_value(value, unit, range, codes);
+		if (memcmp(expected, codes, sizeof(codes)) != 0) {
+			printf("%c %ld: %02X %02X %02X %02X, expected %02X %02X %02X %02X\n", unit, (long)value,
+					codes[0], codes[1], codes[2], codes[3], expected[0], expected[1], expected[2], expected[3]);
+			CHECK(!"mismatch");
+		}
+		if (centi != from && (quantized == previous_quantized) != (memcmp(codes, previous_codes, sizeof(codes)) == 0)) {
+			printf("%c %ld: quantized %ld after %ld\n", unit, (long)value, (long)quantized, (long)previous_quantized);
+			CHECK(!"quantize disagrees with the codes");
+		}
+		memcpy(previous_codes, codes, sizeof(codes));
+		previous_quantized = quantized;
+		checked++;
+	}
+	return checked;
+}
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int main(void) {
+	uint32_t checked = 0;
+
+	checked += sweep('C', &TEMPERATURE_C_RANGE, -4000 - MARGIN_CENTI, 8500 + MARGIN_CENTI, NULL);
+	checked += sweep('F', &TEMPERATURE_F_RANGE, -4000 - MARGIN_CENTI, 8500 + MARGIN_CENTI, aht20_celsius_to_fahrenheit_fixed);
+	checked += sweep('H', &HUMIDITY_RANGE, -MARGIN_CENTI, 10000 + MARGIN_CENTI, NULL);
+	printf("%lu values match the snprintf reference\n", (unsigned long)checked);
+
+	/* saturation and the error frame */
+	uint8_t codes[4];
+	display_format_status_t status = display_format_value(8501, 'C', &TEMPERATURE_C_RANGE, codes);
+	CHECK(status == DISPLAY_FORMAT_STATUS_HIGH);
+	status = display_format_value(-4001, 'C', &TEMPERATURE_C_RANGE, codes);
+	CHECK(status == DISPLAY_FORMAT_STATUS_LOW);
+	status = display_format_value(-50, 'C', &TEMPERATURE_C_RANGE, codes);
+	CHECK(status == DISPLAY_FORMAT_STATUS_OK);
+	/* integer display: "F100" and "C-10" whatever the tenths, next to one decimal values */
+	CHECK(display_format_quantize(10004, &TEMPERATURE_F_RANGE) == display_format_quantize(10044, &TEMPERATURE_F_RANGE));
+	CHECK(display_format_quantize(10044, &TEMPERATURE_F_RANGE) == 1000);
+	CHECK(display_format_quantize(10050, &TEMPERATURE_F_RANGE) == 1010);
+	CHECK(display_format_quantize(9994, &TEMPERATURE_F_RANGE) == 999);
+	CHECK(display_format_quantize(-1004, &TEMPERATURE_C_RANGE) == display_format_quantize(-1044, &TEMPERATURE_C_RANGE));
+	CHECK(display_format_quantize(-994, &TEMPERATURE_C_RANGE) == -99);
+	CHECK(display_format_quantize(8501, &TEMPERATURE_C_RANGE) == INT32_MAX);
+	CHECK(display_format_quantize(-4001, &TEMPERATURE_C_RANGE) == INT32_MIN);
+	display_format_dashes(codes);
+	for (uint8_t i = 0; i < 4; ++i) {
+		CHECK(codes[i] == char_gen_glyph('-'));
+	}
+
+	volatile uint8_t sink = 0;
+	const int32_t span = 8500 + 4000 + 1;
+
+	uint64_t start = now_ns();
+	for (uint32_t round = 0; round < ROUNDS; ++round) {
+		reference_format((int32_t)(round % span) - 4000, 'C', &TEMPERATURE_C_RANGE, codes);
+		sink ^= codes[3];
+	}
+	uint64_t reference_ns = now_ns() - start;
+
+	start = now_ns();
+	for (uint32_t round = 0; round < ROUNDS; ++round) {
+		display_format_value((int32_t)(round % span) - 4000, 'C', &TEMPERATURE_C_RANGE, codes);
+		sink ^= codes[3];
+	}
+	uint64_t format_ns = now_ns() - start;
+
+	printf("snprintf %.1f ns/value, display_format_value %.1f ns/value (host)\n",
+			(double)reference_ns / ROUNDS, (double)format_ns / ROUNDS);
+	(void)sink;
+
+	return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * DMA2 Stream1 double buffer refresh of the display: every word shifted into
+ * the 74HC595 chain is latched once, one per 1 us slot without a gap at the
+ * frame boundaries where the stream switches between M0AR and M1AR. each
+ * frame of latched words is the blank frame or one of the two patterns sent
+ * with driver_7_seg_send_buffer, digit by digit in the scans of its duty, and
+ * the second pattern replaces the first on a frame boundary
+ */
+
+#include "display_setup.h"
+#include <stdio.h>
+
+/*
+ * frames recorded, about one per millisecond
+ */
+#define RECORDED_FRAMES 32U
+
+/*
+ * refresh time before the first pattern, with each pattern and after the last one
+ */
+#define BLANK_MS 3U
+#define PATTERN_MS 8U
+
+/*
+ * patterns sent: segment codes with the digit select bit, and levels
+ * covering full, mid, dim, off and the dimmest visible one
+ */
+typedef struct {
+	uint16_t data[DISPLAY_DIGITS];
+	driver_7_seg_brightness_t level[DISPLAY_DIGITS];
+} pattern_t;
+
+static const pattern_t PATTERN_A = {
+	.data = {0xC001, 0xF902, 0xA404, 0xB008},
+	.level = {255, 128, 40, 1},
+};
+
+static const pattern_t PATTERN_B = {
+	.data = {0x9901, 0x9202, 0x8204, 0xF808},
+	.level = {0, 200, 255, 90},
+};
+
+/*
+ * what the sink saw
+ */
+static struct {
+	uint16_t latched[RECORDED_FRAMES * DISPLAY_FRAME_WORDS];
+	uint32_t latched_count;
+	uint32_t shifted_count;
+	uint32_t unpaired;          /* latched word different from the last shifted one, or shifted twice */
+	uint32_t gaps;              /* latches not one slot after the previous one */
+	bool shift_pending;
+	uint16_t shifted;
+	uint64_t last_latch;
+} seen;
+
+/*
+ * status of the sends, checked by main
+ */
+static driver_7_seg_status_t status_a;
+static driver_7_seg_status_t status_b;
+
+static void record(sim_display_event_t event, uint16_t word, uint64_t time, void *context) {
+	(void)context;
+
+	if (event == SIM_DISPLAY_SHIFTED) {
+		if (seen.shift_pending) {
+			seen.unpaired++;
+		}
+		seen.shift_pending = true;
+		seen.shifted = word;
+		seen.shifted_count++;
+		return;
+	}
+
+	if (!seen.shift_pending || word != seen.shifted) {
+		seen.unpaired++;
+	}
+	seen.shift_pending = false;
+	if (seen.latched_count != 0 && time - seen.last_latch != SIM_UNITS_PER_US) {
+		seen.gaps++;
+	}
+	seen.last_latch = time;
+	if (seen.latched_count < RECORDED_FRAMES * DISPLAY_FRAME_WORDS) {
+		seen.latched[seen.latched_count] = word;
+	}
+	seen.latched_count++;
+}
+
+static void refresh_entry(void) {
+	display_setup();
+
+	HAL_Delay(BLANK_MS);
+	status_a = driver_7_seg_send_buffer(PATTERN_A.data, PATTERN_A.level, DISPLAY_DIGITS);
+	HAL_Delay(PATTERN_MS);
+	status_b = driver_7_seg_send_buffer(PATTERN_B.data, PATTERN_B.level, DISPLAY_DIGITS);
+	HAL_Delay(PATTERN_MS);
+}
+
+/*
+ * true if the frame shows the pattern: each digit carries its word in the scans of its duty, blank in the others
+ */
+static bool frame_shows(const uint16_t *frame, const pattern_t *pattern) {
+	for (uint32_t digit = 0; digit < DISPLAY_DIGITS; digit++) {
+		uint32_t scans = display_gamma_scans(pattern->level[digit]);
+		for (uint32_t scan = 0; scan < DISPLAY_SCANS; scan++) {
+			uint16_t expected = display_scan_lit(scan, scans) ? pattern->data[digit] : 0x0000U;
+			if (frame[scan * DISPLAY_DIGITS + digit] != expected) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * scans of the frame in which the digit carries its word
+ */
+static uint32_t lit_scans(const uint16_t *frame, uint32_t digit, uint16_t word) {
+	uint32_t scans = 0;
+
+	for (uint32_t scan = 0; scan < DISPLAY_SCANS; scan++) {
+		scans += frame[scan * DISPLAY_DIGITS + digit] == word;
+	}
+	return scans;
+}
+
+int main(void) {
+	static const pattern_t BLANK = {.data = {0}, .level = {0}};
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_display_set_sink(record, NULL);
+	sim_start(refresh_entry);
+
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 1000 && state != SIM_STATE_RETURNED; ms++) {
+		state = sim_run_ms(1);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+	sim_display_set_sink(NULL, NULL);
+	CHECK(status_a == DRIVER_7_SEG_STATUS_OK);
+	CHECK(status_b == DRIVER_7_SEG_STATUS_OK);
+
+	/* one latch per shifted word, one word per slot across the whole run */
+	printf("%lu words shifted, %lu latched, %lu unpaired, %lu gaps\n", (unsigned long)seen.shifted_count,
+			(unsigned long)seen.latched_count, (unsigned long)seen.unpaired, (unsigned long)seen.gaps);
+	CHECK(seen.unpaired == 0);
+	CHECK(seen.gaps == 0);
+	CHECK(seen.latched_count >= seen.shifted_count - 1U);
+	CHECK(seen.latched_count <= RECORDED_FRAMES * DISPLAY_FRAME_WORDS);
+
+	/* whole frames only: blank until A, A until B, then B */
+	const pattern_t *order[] = {&BLANK, &PATTERN_A, &PATTERN_B};
+	uint32_t frames_of[3] = {0};
+	uint32_t shown = 0;
+	uint32_t frames = seen.latched_count / DISPLAY_FRAME_WORDS;
+	for (uint32_t frame = 0; frame < frames; frame++) {
+		const uint16_t *words = &seen.latched[frame * DISPLAY_FRAME_WORDS];
+		while (shown < 3 && !frame_shows(words, order[shown])) {
+			shown++;
+		}
+		if (shown == 3) {
+			printf("frame %lu is neither the blank frame nor a pattern in order\n", (unsigned long)frame);
+			CHECK(!"mixed frame");
+		}
+		frames_of[shown]++;
+	}
+	printf("%lu frames: %lu blank, %lu pattern A, %lu pattern B\n", (unsigned long)frames,
+			(unsigned long)frames_of[0], (unsigned long)frames_of[1], (unsigned long)frames_of[2]);
+
+	/* each pattern stays for several frames, streamed from both memory registers */
+	CHECK(frames_of[0] >= BLANK_MS - 1U);
+	CHECK(frames_of[1] >= PATTERN_MS - 1U);
+	CHECK(frames_of[2] >= PATTERN_MS - 1U);
+
+	/* per digit, the word is latched in as many scans as its gamma corrected level */
+	const uint16_t *last = &seen.latched[(frames - 1U) * DISPLAY_FRAME_WORDS];
+	const uint16_t *first_a = &seen.latched[frames_of[0] * DISPLAY_FRAME_WORDS];
+	for (uint32_t digit = 0; digit < DISPLAY_DIGITS; digit++) {
+		printf("digit %lu: A %lu scans, B %lu scans\n", (unsigned long)digit,
+				(unsigned long)lit_scans(first_a, digit, PATTERN_A.data[digit]),
+				(unsigned long)lit_scans(last, digit, PATTERN_B.data[digit]));
+		CHECK(lit_scans(first_a, digit, PATTERN_A.data[digit]) == display_gamma_scans(PATTERN_A.level[digit]));
+		CHECK(lit_scans(last, digit, PATTERN_B.data[digit]) == display_gamma_scans(PATTERN_B.level[digit]));
+	}
+
+	return 0;
+}
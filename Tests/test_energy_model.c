@@ -0,0 +1,140 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * energy model of the firmware: time the simulated core spends running, in
+ * Sleep and in Stop, the active share of each scheduler task and the average
+ * supply current from typical STM32F446 figures. the display is on for the
+ * first phase and times out in the second, where the core must mostly stop.
+ * HAL_GetTick has to stay on simulated time across the suppressed ticks.
+ * the simulation charges register accesses, not the code between them, so
+ * run time and task shares are lower bounds
+ */
+
+#include "sim.h"
+#include "power.h"
+#include "scheduler.h"
+#include "main.h"
+#include "check.h"
+#include <stdio.h>
+
+#define CORE_CYCLES_PER_MS 84000ULL
+
+/*
+ * HAL_GetTick may move away from simulated time by this much over the run
+ */
+#define TICK_DRIFT_MAX_MS 5
+
+/*
+ * typical supply current at 84 MHz from flash with the ART accelerator, in microamperes.
+ * stop is the low-power regulator with the flash in deep power down
+ */
+#define RUN_UA 14000.0
+#define SLEEP_UA 6000.0
+#define STOP_UA 200.0
+
+/*
+ * names in the order bl_start_tasks adds the tasks
+ */
+static const char *const TASK_NAMES[] = {"buttons", "sensor", "display", "frame", "flash"};
+#define TASK_COUNT (sizeof(TASK_NAMES) / sizeof(TASK_NAMES[0]))
+
+typedef struct {
+	sim_power_stats_t power;
+	uint64_t task_cycles[TASK_COUNT];
+} snapshot_t;
+
+static void take(snapshot_t *snapshot) {
+	sim_power_get_stats(&snapshot->power);
+	for (uint8_t id = 0; id < TASK_COUNT; ++id) {
+		scheduler_task_stats_t stats;
+		scheduler_status_t status = scheduler_get_stats(id, &stats);
+		CHECK(status == SCHEDULER_STATUS_OK);
+		snapshot->task_cycles[id] = stats.total_cycles;
+	}
+}
+
+/*
+ * prints the phase and returns the share of time in Stop
+ */
+static double report(const char *phase, const snapshot_t *from, const snapshot_t *to) {
+	double run = (double)(to->power.run - from->power.run);
+	double sleep = (double)(to->power.sleep - from->power.sleep);
+	double stop = (double)(to->power.stop - from->power.stop);
+	double total = run + sleep + stop;
+	double total_ms = total / SIM_UNITS_PER_MS;
+	double average_ua = (run * RUN_UA + sleep * SLEEP_UA + stop * STOP_UA) / total;
+
+	printf("%s: %.0f ms, run %.4f%%, sleep %.2f%% (%u), stop %.2f%% (%u), average %.0f uA\n", phase, total_ms,
+			100.0 * run / total, 100.0 * sleep / total, to->power.sleep_entries - from->power.sleep_entries,
+			100.0 * stop / total, to->power.stop_entries - from->power.stop_entries, average_ua);
+
+	for (uint8_t id = 0; id < TASK_COUNT; ++id) {
+		double cycles = (double)(to->task_cycles[id] - from->task_cycles[id]);
+		printf("  %-8s active %.4f%%\n", TASK_NAMES[id], 100.0 * cycles / (total_ms * CORE_CYCLES_PER_MS));
+	}
+
+	return stop / total;
+}
+
+/*
+ * HAL_GetTick minus simulated time, read when the tick moves: a sleeping core
+ * has its suppressed ticks added on wakeup
+ */
+static int32_t tick_drift(void) {
+	uint32_t tick = HAL_GetTick();
+
+	for (uint32_t ms = 0; ms < 2000 && HAL_GetTick() == tick; ms++) {
+		sim_run_ms(1);
+	}
+	return (int32_t)(HAL_GetTick() - sim_time_ms());
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_boot();
+	/* the first boot formats the flash log, the sector erase stalls the core for about a second */
+	sim_run_ms(2000);
+	int32_t drift = tick_drift();
+
+	snapshot_t start;
+	snapshot_t display_off;
+	snapshot_t end;
+
+	take(&start);
+	sim_run_ms(28000);
+	take(&display_off);
+	sim_run_ms(60000);
+	take(&end);
+
+	report("display on", &start, &display_off);
+	double stop_share = report("display off", &display_off, &end);
+	CHECK(stop_share > 0.9);
+
+	power_stats_t stats;
+	power_get_stats(&stats);
+	printf("firmware view: active %lu ms, sleep %lu ms, stop %lu ms, suppressed ticks %lu\n",
+			(unsigned long)stats.active_ms, (unsigned long)stats.sleep_ms, (unsigned long)stats.stop_ms,
+			(unsigned long)stats.suppressed_ticks);
+	drift = tick_drift() - drift;
+	printf("HAL_GetTick drift %ld ms\n", (long)drift);
+	CHECK(drift >= -TICK_DRIFT_MAX_MS && drift <= TICK_DRIFT_MAX_MS);
+
+	return 0;
+}
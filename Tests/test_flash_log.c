@@ -0,0 +1,283 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * flash log on the simulated flash: formats blank flash, sustains a stream of
+ * samples over every sector with the erases done ahead by flash_log_prepare,
+ * reads the log back after the oldest sector was recycled, mounts a full log
+ * in about the time of an empty one and survives a page torn by power loss.
+ * mount cost is host time, the simulation doesn't charge reads of flash
+ */
+
+#include "sim.h"
+#include "flash_log.h"
+#include "main.h"
+#include "check.h"
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * log area as placed by the linker script, see flash_log.c
+ */
+#define LOG_BASE 0x08020000U
+#define LOG_SECTOR_COUNT 3
+#define LOG_SECTOR_SIZE (128U * 1024U)
+#define PAGES_PER_SECTOR (LOG_SECTOR_SIZE / FLASH_LOG_PAGE_SIZE)
+#define PAGE_CRC_OFFSET (FLASH_LOG_PAGE_SIZE - 4U)
+#define ERASED_WORD 0xFFFFFFFFU
+
+/*
+ * enough samples to recycle the first sector
+ */
+#define SAMPLE_COUNT 240000U
+#define SAMPLE_PERIOD_MS 1000U
+
+/*
+ * samples lost with the torn page and written after the reset
+ */
+#define TORN_SAMPLES 50U
+#define AFTER_RESET_SAMPLES 10U
+
+/*
+ * a mount reads a few page headers and one page, a linear scan would read the whole log
+ */
+#define MOUNT_REPEATS 20
+#define MOUNT_BUDGET_NS 200000.0
+
+/*
+ * the device samples every few seconds, the log must keep up with far more
+ */
+#define MIN_SAMPLES_PER_S 5000.0
+
+#define CORE_CYCLES_PER_MS 84000.0
+
+/*
+ * clock setup of main.c
+ */
+void SystemClock_Config(void);
+
+static uint32_t humidity[SAMPLE_COUNT + TORN_SAMPLES + AFTER_RESET_SAMPLES];
+static uint32_t temperature[SAMPLE_COUNT + TORN_SAMPLES + AFTER_RESET_SAMPLES];
+#define TRACE_LENGTH (sizeof(humidity) / sizeof(humidity[0]))
+
+/*
+ * random walk of tens of LSB per sample around 45 %RH and 22 C, about the sensor noise
+ */
+static void make_trace(void) {
+	uint32_t seed = 12345;
+	uint32_t h = 0x73333;
+	uint32_t t = 0x5C28F;
+
+	for (uint32_t i = 0; i < TRACE_LENGTH; i++) {
+		seed = seed * 1103515245U + 12345U;
+		h += ((seed >> 16) % 63U) - 31U;
+		t += ((seed >> 24) % 31U) - 15U;
+		humidity[i] = h & 0xFFFFFU;
+		temperature[i] = t & 0xFFFFFU;
+	}
+}
+
+static uint32_t *flash_word(uint32_t address) {
+	return (uint32_t *)sim_flash_at(address);
+}
+
+/*
+ * address of the last programmed page of the newest sector
+ */
+static uint32_t last_page(void) {
+	uint32_t newest = 0;
+	uint32_t sequence = 0;
+
+	for (uint32_t s = 0; s < LOG_SECTOR_COUNT; s++) {
+		uint32_t header = LOG_BASE + s * LOG_SECTOR_SIZE;
+		if (*flash_word(header) != ERASED_WORD && *flash_word(header + 4) >= sequence) {
+			sequence = *flash_word(header + 4);
+			newest = s;
+		}
+	}
+
+	uint32_t page = PAGES_PER_SECTOR - 1;
+	while (page > 1 && *flash_word(LOG_BASE + newest * LOG_SECTOR_SIZE + page * FLASH_LOG_PAGE_SIZE) == ERASED_WORD) {
+		page--;
+	}
+	return LOG_BASE + newest * LOG_SECTOR_SIZE + page * FLASH_LOG_PAGE_SIZE;
+}
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/*
+ * shortest host time of a mount, the first one formats or repairs and isn't timed
+ */
+static double mount_ns(void) {
+	double best = 1e12;
+
+	for (int i = 0; i < MOUNT_REPEATS; i++) {
+		double start = now_ns();
+		flash_log_status_t status = flash_log_mount();
+		double elapsed = now_ns() - start;
+		CHECK(status == FLASH_LOG_STATUS_OK);
+		if (elapsed < best) {
+			best = elapsed;
+		}
+	}
+	return best;
+}
+
+/*
+ * walks the log, every sample must match the trace, consecutive from the first one read.
+ * returns the number read, first gets the trace index of the oldest
+ */
+static uint32_t read_back(uint32_t *first, uint16_t *last_boot) {
+	flash_log_iterator_t iterator;
+	flash_log_sample_t sample;
+	uint32_t count = 0;
+
+	flash_log_iterator_init(&iterator);
+	while (flash_log_next(&iterator, &sample)) {
+		uint32_t index = sample.time_ms / SAMPLE_PERIOD_MS;
+		if (count == 0) {
+			*first = index;
+		}
+		CHECK(index < TRACE_LENGTH);
+		CHECK(sample.raw_humidity == humidity[index]);
+		CHECK(sample.raw_temperature == temperature[index]);
+		*last_boot = sample.boot;
+		count++;
+	}
+	return count;
+}
+
+static void append(uint32_t from, uint32_t to) {
+	for (uint32_t i = from; i < to; i++) {
+		flash_log_status_t status = flash_log_append(humidity[i], temperature[i], i * SAMPLE_PERIOD_MS);
+		CHECK(status == FLASH_LOG_STATUS_OK);
+	}
+}
+
+static void log_entry(void) {
+	SystemInit();
+	HAL_Init();
+	SystemClock_Config();
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	flash_log_stats_t stats;
+	sim_flash_stats_t flash;
+	flash_log_status_t status;
+
+	/* blank flash is formatted */
+	status = flash_log_mount();
+	CHECK(status == FLASH_LOG_STATUS_OK);
+	flash_log_get_stats(&stats);
+	printf("format: %.1f ms\n", stats.mount_cycles / CORE_CYCLES_PER_MS);
+	double empty_ns = mount_ns();
+
+	/* sustained writing, the next sector is erased ahead like bl_flash_task does */
+	uint64_t append_units = 0;
+	uint64_t prepare_units = 0;
+	uint32_t max_program_cycles = 0;
+	uint32_t pages = 0;
+	for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+		uint64_t start = sim_time();
+		status = flash_log_append(humidity[i], temperature[i], i * SAMPLE_PERIOD_MS);
+		append_units += sim_time() - start;
+		CHECK(status == FLASH_LOG_STATUS_OK);
+
+		flash_log_get_stats(&stats);
+		if (stats.pages_written != pages) {
+			pages = stats.pages_written;
+			if (stats.last_program_cycles > max_program_cycles) {
+				max_program_cycles = stats.last_program_cycles;
+			}
+		}
+
+		start = sim_time();
+		status = flash_log_prepare();
+		prepare_units += sim_time() - start;
+		CHECK(status == FLASH_LOG_STATUS_OK);
+	}
+	status = flash_log_flush();
+	CHECK(status == FLASH_LOG_STATUS_OK);
+
+	flash_log_get_stats(&stats);
+	sim_flash_get_stats(&flash);
+	double append_s = (double)append_units / SIM_CLOCK_HZ;
+	double rate = SAMPLE_COUNT / append_s;
+	printf("append: %lu samples in %lu pages, %.2f bytes/sample, %.0f samples/s, %.1f KB/s, page program max %.2f ms\n",
+			(unsigned long)stats.samples_written, (unsigned long)stats.pages_written,
+			(double)stats.pages_written * FLASH_LOG_PAGE_SIZE / stats.samples_written, rate,
+			(double)stats.pages_written * FLASH_LOG_PAGE_SIZE / 1024.0 / append_s, max_program_cycles / CORE_CYCLES_PER_MS);
+	printf("erase: %lu sectors, %.0f ms of them in prepare, max erase count %lu, %lu words programmed\n",
+			(unsigned long)stats.erases, (double)prepare_units / SIM_UNITS_PER_MS,
+			(unsigned long)stats.max_erase_count, (unsigned long)flash.words_programmed);
+	CHECK(rate > MIN_SAMPLES_PER_S);
+	CHECK(stats.max_erase_count >= 2);
+	CHECK(flash.program_errors == 0);
+
+	/* the first sector was recycled, what is left reads back in order up to the last sample */
+	uint32_t first = 0;
+	uint16_t boot = 0;
+	uint32_t count = read_back(&first, &boot);
+	printf("read back: %lu samples from %lu\n", (unsigned long)count, (unsigned long)first);
+	CHECK(first > 0);
+	CHECK(first + count == SAMPLE_COUNT);
+
+	/* a full log mounts as fast as an empty one */
+	double full_ns = mount_ns();
+	printf("mount: empty %.1f us, full %.1f us\n", empty_ns / 1000.0, full_ns / 1000.0);
+	CHECK(full_ns < MOUNT_BUDGET_NS);
+
+	/* power is lost while the last page is programmed: its CRC never makes it */
+	append(SAMPLE_COUNT, SAMPLE_COUNT + TORN_SAMPLES);
+	status = flash_log_flush();
+	CHECK(status == FLASH_LOG_STATUS_OK);
+	*flash_word(last_page() + PAGE_CRC_OFFSET) = ERASED_WORD;
+
+	status = flash_log_mount();
+	CHECK(status == FLASH_LOG_STATUS_OK);
+	flash_log_get_stats(&stats);
+	uint16_t new_boot = stats.boot;
+	append(SAMPLE_COUNT + TORN_SAMPLES, TRACE_LENGTH);
+	status = flash_log_flush();
+	CHECK(status == FLASH_LOG_STATUS_OK);
+
+	uint32_t after_first = 0;
+	uint32_t after_count = read_back(&after_first, &boot);
+	printf("after power loss: %lu samples, boot %u\n", (unsigned long)after_count, boot);
+	CHECK(after_first == first);
+	CHECK(after_count == count + AFTER_RESET_SAMPLES);
+	CHECK(boot == new_boot);
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	make_trace();
+	sim_start(log_entry);
+
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t s = 0; s < 600 && state != SIM_STATE_RETURNED; s++) {
+		state = sim_run_ms(1000);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+
+	return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * hand-off of frames between driver_7_seg_send_buffer and the frame complete
+ * callback of DMA2 Stream1: a publish is started a little later on every
+ * trial, so the end of the frame and its callback land before, inside and
+ * after publish_frame and its LDREXB/STREXB exchange. this is done with a
+ * frame already in flight in the shared slot and with the refresh idle. no
+ * displayed frame mixes two publishes, no frame older than one already shown
+ * comes back and the last published frame is the one shown
+ */
+
+#include "display_setup.h"
+#include <stdio.h>
+
+/*
+ * publish delays swept, in __NOP of 2 cycles, past the 84 cycles of the last word of a frame
+ */
+#define DELAY_STEPS 64U
+
+/*
+ * time for a publish to reach the display and the refresh to go idle again
+ */
+#define SETTLE_MS 4U
+
+/*
+ * generations of frames recorded, the blank frame is generation 0
+ */
+#define MAX_GENERATIONS 256U
+#define MAX_FRAMES 2048U
+
+/*
+ * what the sink saw: the words of the open frame, the generation shown by every complete one
+ */
+static struct {
+	uint16_t frame[DISPLAY_FRAME_WORDS];
+	uint32_t words;
+	uint32_t frames;
+	int16_t generation[MAX_FRAMES];   /* -1: words of two publishes or of none */
+} seen;
+
+/*
+ * a trial, checked by main: frame shown once it settled and where its callbacks landed
+ */
+typedef struct {
+	uint8_t generation;
+	uint32_t settled_frame;
+} trial_t;
+
+static trial_t trials[2][DELAY_STEPS];
+
+/*
+ * callback times seen from the publish racing with the end of a frame
+ */
+static struct {
+	uint64_t publish_start;
+	uint64_t publish_end;
+	uint32_t before;
+	uint32_t inside;
+	uint32_t after;
+	uint64_t inside_offsets[16];
+	uint32_t distinct_inside;
+	bool racing;
+} landed;
+
+static void (*driver_callback)(DMA_HandleTypeDef *hdma);
+
+/*
+ * frame complete callback of the driver, recording when it runs
+ */
+static void timed_callback(DMA_HandleTypeDef *hdma) {
+	uint64_t now = sim_time();
+
+	if (landed.racing) {
+		if (landed.publish_start == 0) {
+			landed.before++;
+		} else if (landed.publish_end == 0) {
+			uint64_t offset = now - landed.publish_start;
+			bool known = false;
+			for (uint32_t i = 0; i < landed.distinct_inside; i++) {
+				known |= landed.inside_offsets[i] == offset;
+			}
+			if (!known && landed.distinct_inside < 16U) {
+				landed.inside_offsets[landed.distinct_inside++] = offset;
+			}
+			landed.inside++;
+		} else {
+			landed.after++;
+		}
+	}
+	driver_callback(hdma);
+}
+
+/*
+ * frame of a generation: all 4 digits on at full brightness, the generation in the segment byte
+ */
+static uint16_t generation_word(uint8_t generation, uint32_t digit) {
+	return (uint16_t)((generation << 8) | (1U << digit));
+}
+
+static int16_t classify(const uint16_t *frame) {
+	uint8_t generation = (uint8_t)(frame[0] >> 8);
+	uint32_t scans = generation == 0 ? 0 : display_gamma_scans(255);
+
+	for (uint32_t scan = 0; scan < DISPLAY_SCANS; scan++) {
+		for (uint32_t digit = 0; digit < DISPLAY_DIGITS; digit++) {
+			uint16_t expected = display_scan_lit(scan, scans) ? generation_word(generation, digit) : 0x0000U;
+			if (frame[scan * DISPLAY_DIGITS + digit] != expected) {
+				return -1;
+			}
+		}
+	}
+	return generation;
+}
+
+static void record(sim_display_event_t event, uint16_t word, uint64_t time, void *context) {
+	(void)time;
+	(void)context;
+
+	if (event != SIM_DISPLAY_LATCHED) {
+		return;
+	}
+	seen.frame[seen.words++] = word;
+	if (seen.words == DISPLAY_FRAME_WORDS) {
+		if (seen.frames < MAX_FRAMES) {
+			seen.generation[seen.frames] = classify(seen.frame);
+		}
+		seen.frames++;
+		seen.words = 0;
+	}
+}
+
+static void publish(uint8_t generation) {
+	static const driver_7_seg_brightness_t LEVELS[DISPLAY_DIGITS] = {255, 255, 255, 255};
+	uint16_t data[DISPLAY_DIGITS];
+
+	for (uint32_t digit = 0; digit < DISPLAY_DIGITS; digit++) {
+		data[digit] = generation_word(generation, digit);
+	}
+	CHECK(driver_7_seg_send_buffer(data, LEVELS, DISPLAY_DIGITS) == DRIVER_7_SEG_STATUS_OK);
+}
+
+/*
+ * publishes generation delay_steps __NOP after the last word of a frame was requested
+ */
+static void publish_racing(uint8_t generation, uint32_t delay_steps) {
+	/* the word before the last one was just transferred, the last one follows 1 us later */
+	while (DMA2_Stream1->NDTR != 2U) {}
+	while (DMA2_Stream1->NDTR != 1U) {}
+
+	landed.racing = true;
+	landed.publish_start = 0;
+	landed.publish_end = 0;
+	for (uint32_t i = 0; i < delay_steps; i++) {
+		__NOP();
+	}
+	landed.publish_start = sim_time();
+	publish(generation);
+	landed.publish_end = sim_time();
+}
+
+static void handoff_entry(void) {
+	uint8_t generation = 0;
+
+	display_setup();
+	driver_callback = hdma_tim8_up.XferCpltCallback;
+	hdma_tim8_up.XferCpltCallback = timed_callback;
+	hdma_tim8_up.XferM1CpltCallback = timed_callback;
+
+	for (uint32_t in_flight = 0; in_flight < 2; in_flight++) {
+		for (uint32_t step = 0; step < DELAY_STEPS; step++) {
+			if (in_flight) {
+				/* an earlier frame waits in the shared slot, the callback of the racing frame end takes one of the two */
+				while (DMA2_Stream1->NDTR < DISPLAY_FRAME_WORDS / 2U) {}
+				publish(++generation);
+			}
+			publish_racing(++generation, step);
+			HAL_Delay(SETTLE_MS);
+			landed.racing = false;
+
+			trials[in_flight][step].generation = generation;
+			trials[in_flight][step].settled_frame = seen.frames - 1U;
+		}
+	}
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_display_set_sink(record, NULL);
+	sim_start(handoff_entry);
+
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 10000 && state != SIM_STATE_RETURNED; ms += 10) {
+		state = sim_run_ms(10);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+	sim_display_set_sink(NULL, NULL);
+	CHECK(seen.frames <= MAX_FRAMES);
+
+	/* every frame shows one publish, generations never go back */
+	uint32_t shown[MAX_GENERATIONS] = {0};
+	int16_t newest = 0;
+	for (uint32_t frame = 0; frame < seen.frames; frame++) {
+		int16_t generation = seen.generation[frame];
+		if (generation < 0) {
+			printf("frame %lu mixes two publishes\n", (unsigned long)frame);
+			CHECK(!"mixed frame");
+		}
+		if (generation < newest) {
+			printf("frame %lu shows generation %d after %d\n", (unsigned long)frame, generation, newest);
+			CHECK(!"older frame shown again");
+		}
+		newest = generation;
+		shown[generation]++;
+	}
+
+	/* each trial ends on its last publish */
+	uint32_t skipped = 0;
+	for (uint32_t in_flight = 0; in_flight < 2; in_flight++) {
+		for (uint32_t step = 0; step < DELAY_STEPS; step++) {
+			const trial_t *trial = &trials[in_flight][step];
+			CHECK(seen.generation[trial->settled_frame] == trial->generation);
+			if (in_flight && shown[trial->generation - 1U] == 0) {
+				skipped++;
+			}
+		}
+	}
+
+	printf("%lu frames, %u trials\n", (unsigned long)seen.frames, 2U * DELAY_STEPS);
+	printf("racing callbacks: %lu before the publish, %lu inside at %lu offsets, %lu after\n", (unsigned long)landed.before,
+			(unsigned long)landed.inside, (unsigned long)landed.distinct_inside, (unsigned long)landed.after);
+	printf("frames in flight replaced before being shown: %lu of %u\n", (unsigned long)skipped, DELAY_STEPS);
+
+	/* the sweep covers every order of the callback and the exchange */
+	CHECK(landed.before > 0);
+	CHECK(landed.after > 0);
+	CHECK(landed.distinct_inside >= 2);
+	CHECK(skipped > 0 && skipped < DELAY_STEPS);
+
+	return 0;
+}
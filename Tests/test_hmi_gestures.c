@@ -0,0 +1,279 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * gestures recognized from the debounced events of button_sample with the
+ * configuration of business_logic.c, double click on button B only: a short
+ * press, a long press after 800 ms with repeats 400 ms later and every 200 ms,
+ * a double click within 300 ms, the short press of button B reported once the
+ * double click window passed, a second press of button B held into a long
+ * press, and a chord of presses starting within 150 ms
+ */
+
+#include "sim.h"
+#include "buttons.h"
+#include "business_logic.h"
+#include "hmi_gestures.h"
+#include "check.h"
+#include <stdio.h>
+
+#define MAX_GESTURES 32U
+#define SETTLE_MS 1000U
+
+/*
+ * a tap and the gap between the taps of a double click
+ */
+#define TAP_MS 100U
+#define TAP_GAP_MS 150U
+
+/*
+ * holds giving a long press with two repeats, and a second press held into one repeat
+ */
+#define HOLD_MS 1500U
+#define SECOND_HOLD_MS 1300U
+
+/*
+ * timeouts are checked on samples, BUTTON_SAMPLE_PERIOD_MS apart
+ */
+#define LATE_MS BUTTON_SAMPLE_PERIOD_MS
+
+/*
+ * clock setup and sampling timer of main.c
+ */
+void SystemClock_Config(void);
+extern TIM_HandleTypeDef htim6;
+
+/*
+ * what the firmware context saw, published every time it wakes up
+ */
+static struct {
+	volatile bool ready;
+	volatile bool finished;
+	volatile bool sampling;
+	HMI_Gesture_Event_t log[MAX_GESTURES];
+	volatile uint32_t logged;
+} seen;
+
+/*
+ * GPIO, EXTI and TIM6 of main.c
+ */
+static void gestures_setup(void) {
+	GPIO_InitTypeDef gpio = {0};
+	TIM_MasterConfigTypeDef master = {0};
+
+	SystemInit();
+	HAL_Init();
+	SystemClock_Config();
+
+	__HAL_RCC_GPIOA_CLK_ENABLE();
+	gpio.Pin = BUTTON_S1_Pin | BUTTON_S2_Pin;
+	gpio.Mode = GPIO_MODE_IT_RISING_FALLING;
+	gpio.Pull = GPIO_PULLUP;
+	HAL_GPIO_Init(GPIOA, &gpio);
+
+	HAL_NVIC_SetPriority(EXTI1_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+	HAL_NVIC_SetPriority(EXTI4_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(EXTI4_IRQn);
+
+	htim6.Instance = TIM6;
+	htim6.Init.Prescaler = 8399;
+	htim6.Init.CounterMode = TIM_COUNTERMODE_UP;
+	htim6.Init.Period = 49;
+	htim6.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+	CHECK(HAL_TIM_Base_Init(&htim6) == HAL_OK);
+	master.MasterOutputTrigger = TIM_TRGO_RESET;
+	master.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+	CHECK(HAL_TIMEx_MasterConfigSynchronization(&htim6, &master) == HAL_OK);
+
+	/* the gestures are taken here instead of by the scheduler */
+	CHECK(bl_init_buttons(&htim6) == BL_STATUS_OK);
+	hmi_gestures_set_callback(NULL);
+}
+
+static void gestures_entry(void) {
+	gestures_setup();
+	seen.ready = true;
+
+	while (!seen.finished) {
+		HMI_Gesture_Event_t gesture;
+		while (hmi_gestures_get_event(&gesture)) {
+			if (seen.logged < MAX_GESTURES) {
+				seen.log[seen.logged] = gesture;
+			}
+			seen.logged++;
+		}
+		seen.sampling = button_is_sampling();
+		__WFI();
+	}
+}
+
+static bool ready(void) {
+	return seen.ready;
+}
+
+static bool sampling_stopped(void) {
+	return !seen.sampling;
+}
+
+/*
+ * waits until nothing is pending, returns the number of gestures logged so far
+ */
+static uint32_t settle(void) {
+	CHECK(sim_run_until(sampling_stopped, SETTLE_MS));
+	sim_run_ms(1);
+	return seen.logged;
+}
+
+static void press(sim_button_t button, uint32_t ms) {
+	sim_button_set(button, true);
+	sim_run_ms(ms);
+	sim_button_set(button, false);
+}
+
+/*
+ * the gesture logged at index, of the expected type and pins
+ */
+static const HMI_Gesture_Event_t *logged(uint32_t index, HMI_Interact_Status_t type, uint16_t gpio_pins) {
+	CHECK(index < seen.logged);
+	const HMI_Gesture_Event_t *gesture = &seen.log[index];
+	CHECK(gesture->type == type);
+	CHECK(gesture->gpio_pins == gpio_pins);
+	return gesture;
+}
+
+/*
+ * a timeout of ms after start, seen by the first sample after it
+ */
+static void check_timeout(uint32_t time, uint32_t start, uint32_t ms) {
+	CHECK(time - start >= ms);
+	CHECK(time - start <= ms + LATE_MS);
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_start(gestures_entry);
+	CHECK(sim_run_until(ready, 100));
+	uint32_t first = settle();
+
+	/* short press of button A, reported on release */
+	press(SIM_BUTTON_A, TAP_MS);
+	uint32_t last = settle();
+	CHECK(last == first + 1U);
+	const HMI_Gesture_Event_t *gesture = logged(first, HMI_SHORT_EVENT, BUTTON_S1_Pin);
+	printf("short: held %lu ms\n", (unsigned long)(gesture->time - gesture->press_time));
+	CHECK(gesture->time - gesture->press_time >= TAP_MS - LATE_MS && gesture->time - gesture->press_time <= TAP_MS + LATE_MS);
+
+	/* long press of button A: long at 800 ms, repeats at 1200 and 1400 ms, nothing on release */
+	first = last;
+	press(SIM_BUTTON_A, HOLD_MS);
+	last = settle();
+	CHECK(last == first + 3U);
+	const HMI_Gesture_Event_t *long_press = logged(first, HMI_LONG_EVENT, BUTTON_S1_Pin);
+	const HMI_Gesture_Event_t *repeat_1 = logged(first + 1U, HMI_REPEAT_EVENT, BUTTON_S1_Pin);
+	const HMI_Gesture_Event_t *repeat_2 = logged(first + 2U, HMI_REPEAT_EVENT, BUTTON_S1_Pin);
+	printf("long: after %lu ms, repeats %lu ms and %lu ms later\n", (unsigned long)(long_press->time - long_press->press_time),
+			(unsigned long)(repeat_1->time - long_press->time), (unsigned long)(repeat_2->time - repeat_1->time));
+	check_timeout(long_press->time, long_press->press_time, HMI_GESTURE_LONG_MS);
+	check_timeout(repeat_1->time, long_press->time, HMI_GESTURE_REPEAT_DELAY_MS);
+	check_timeout(repeat_2->time, repeat_1->time, HMI_GESTURE_REPEAT_PERIOD_MS);
+	CHECK(repeat_1->repeat_count == 1U);
+	CHECK(repeat_2->repeat_count == 2U);
+	CHECK(repeat_1->press_time == long_press->press_time);
+
+	/* double click of button B: one gesture, no short press */
+	first = last;
+	press(SIM_BUTTON_B, TAP_MS);
+	sim_run_ms(TAP_GAP_MS);
+	press(SIM_BUTTON_B, TAP_MS);
+	last = settle();
+	CHECK(last == first + 1U);
+	gesture = logged(first, HMI_DOUBLE_EVENT, BUTTON_S2_Pin);
+	printf("double: %lu ms from the first press\n", (unsigned long)(gesture->time - gesture->press_time));
+
+	/* single click of button B: short once the double click window passed */
+	first = last;
+	press(SIM_BUTTON_B, TAP_MS);
+	last = settle();
+	CHECK(last == first + 1U);
+	gesture = logged(first, HMI_SHORT_EVENT, BUTTON_S2_Pin);
+	uint32_t release_time = gesture->press_time + TAP_MS;
+	printf("single click: reported %lu ms after the release\n", (unsigned long)(gesture->time - release_time));
+	CHECK(gesture->time - release_time >= HMI_GESTURE_DOUBLE_MS - LATE_MS);
+	CHECK(gesture->time - release_time <= HMI_GESTURE_DOUBLE_MS + 2U * LATE_MS);
+
+	/* click and a second press held: short for the click, then long and a repeat for the hold, no double */
+	first = last;
+	press(SIM_BUTTON_B, TAP_MS);
+	sim_run_ms(TAP_GAP_MS);
+	press(SIM_BUTTON_B, SECOND_HOLD_MS);
+	last = settle();
+	CHECK(last == first + 3U);
+	const HMI_Gesture_Event_t *click = logged(first, HMI_SHORT_EVENT, BUTTON_S2_Pin);
+	long_press = logged(first + 1U, HMI_LONG_EVENT, BUTTON_S2_Pin);
+	repeat_1 = logged(first + 2U, HMI_REPEAT_EVENT, BUTTON_S2_Pin);
+	uint32_t second_press = long_press->press_time;
+	printf("click and hold: second press %lu ms after the first, long after %lu ms, repeat %lu ms later\n",
+			(unsigned long)(second_press - click->press_time), (unsigned long)(long_press->time - second_press),
+			(unsigned long)(repeat_1->time - long_press->time));
+	CHECK(second_press - click->press_time >= TAP_MS + TAP_GAP_MS - LATE_MS);
+	CHECK(second_press - click->press_time <= TAP_MS + TAP_GAP_MS + LATE_MS);
+	CHECK(click->time == long_press->time);
+	check_timeout(long_press->time, second_press, HMI_GESTURE_LONG_MS);
+	check_timeout(repeat_1->time, long_press->time, HMI_GESTURE_REPEAT_DELAY_MS);
+	CHECK(repeat_1->repeat_count == 1U);
+
+	/* presses of both buttons 100 ms apart: one chord, the releases report nothing */
+	first = last;
+	sim_button_set(SIM_BUTTON_A, true);
+	sim_run_ms(HMI_GESTURE_CHORD_MS - 50U);
+	sim_button_set(SIM_BUTTON_B, true);
+	sim_run_ms(TAP_MS * 2U);
+	sim_button_set(SIM_BUTTON_A, false);
+	sim_button_set(SIM_BUTTON_B, false);
+	last = settle();
+	CHECK(last == first + 1U);
+	gesture = logged(first, HMI_CHORD_EVENT, BUTTON_S1_Pin | BUTTON_S2_Pin);
+	printf("chord: second press %lu ms after the first\n", (unsigned long)(gesture->time - gesture->press_time));
+	CHECK(gesture->time - gesture->press_time <= HMI_GESTURE_CHORD_MS);
+
+	/* 200 ms apart it is no chord: a short press of each button */
+	first = last;
+	sim_button_set(SIM_BUTTON_A, true);
+	sim_run_ms(HMI_GESTURE_CHORD_MS + 50U);
+	sim_button_set(SIM_BUTTON_B, true);
+	sim_run_ms(TAP_MS);
+	sim_button_set(SIM_BUTTON_A, false);
+	sim_button_set(SIM_BUTTON_B, false);
+	last = settle();
+	CHECK(last == first + 2U);
+	logged(first, HMI_SHORT_EVENT, BUTTON_S1_Pin);
+	logged(first + 1U, HMI_SHORT_EVENT, BUTTON_S2_Pin);
+	printf("presses %u ms apart: %lu gestures, no chord\n", HMI_GESTURE_CHORD_MS + 50U, (unsigned long)(last - first));
+	CHECK(hmi_gestures_get_dropped_events() == 0);
+
+	seen.finished = true;
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 100 && state != SIM_STATE_RETURNED; ms++) {
+		state = sim_run_ms(1);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * profiler statistics with the firmware built with PROFILING: the DWT cycle
+ * counter runs at the core clock once profiler_init enables it, recorded
+ * values give their count, min, max and average, and blocks measured with
+ * PROFILER_BEGIN/PROFILER_END across a wrap of CYCCNT give the right cycles
+ * and cpu load
+ */
+
+#include "sim.h"
+#include "profiler.h"
+#include "check.h"
+#include <stdio.h>
+
+#ifndef PROFILING
+#error "the profiler test runs the firmware built with PROFILING"
+#endif
+
+/*
+ * measured blocks of the load check and the time the load is measured over
+ */
+#define LONG_BLOCK_MS 20U
+#define SHORT_BLOCK_MS 10U
+#define LOAD_WINDOW_MS 100U
+
+/*
+ * the long block starts this long before CYCCNT wraps
+ */
+#define WRAP_AFTER_MS 5U
+
+/*
+ * clock setup of main.c
+ */
+void SystemClock_Config(void);
+
+/*
+ * what the firmware context saw, checked by main
+ */
+static struct {
+	uint32_t cycles_per_ms;
+	uint32_t delay_cycles;
+	uint32_t cyccnt_before_wrap;
+	uint32_t cyccnt_after_wrap;
+	profiler_stats_t recorded;
+	profiler_stats_t untouched;
+	profiler_stats_t blocks;
+	profiler_stats_t after_reset;
+} seen;
+
+/*
+ * waits with HAL_Delay, measured as one block
+ */
+static void measured_delay(uint32_t ms) {
+	PROFILER_BEGIN(start_cycles);
+	HAL_Delay(ms);
+	PROFILER_END(PROFILER_TIM6_IRQ, start_cycles);
+}
+
+static void profiler_entry(void) {
+	SystemInit();
+	HAL_Init();
+	SystemClock_Config();
+	profiler_init();
+	seen.cycles_per_ms = SystemCoreClock / 1000U;
+
+	/* the cycle counter follows the core clock */
+	uint32_t start = DWT->CYCCNT;
+	HAL_Delay(10);
+	seen.delay_cycles = DWT->CYCCNT - start;
+
+	/* known values */
+	profiler_reset();
+	profiler_record(PROFILER_SPI1_IRQ, 100);
+	profiler_record(PROFILER_SPI1_IRQ, 300);
+	profiler_record(PROFILER_SPI1_IRQ, 201);
+	profiler_get_stats(PROFILER_SPI1_IRQ, &seen.recorded);
+	profiler_get_stats(PROFILER_EXTI1_IRQ, &seen.untouched);
+
+	/* two measured blocks, the first one across the wrap of CYCCNT, in a window of LOAD_WINDOW_MS */
+	profiler_reset();
+	uint32_t reset_tick = HAL_GetTick();
+	DWT->CYCCNT = UINT32_MAX - WRAP_AFTER_MS * seen.cycles_per_ms;
+	seen.cyccnt_before_wrap = DWT->CYCCNT;
+	measured_delay(LONG_BLOCK_MS);
+	seen.cyccnt_after_wrap = DWT->CYCCNT;
+	measured_delay(SHORT_BLOCK_MS);
+	while (HAL_GetTick() - reset_tick < LOAD_WINDOW_MS) {
+		__WFI();
+	}
+	profiler_get_stats(PROFILER_TIM6_IRQ, &seen.blocks);
+
+	profiler_reset();
+	profiler_get_stats(PROFILER_TIM6_IRQ, &seen.after_reset);
+}
+
+/*
+ * a HAL_Delay of ms waits between ms and ms + 1 ticks
+ */
+static void check_delay_cycles(uint32_t cycles, uint32_t ms) {
+	CHECK(cycles >= ms * seen.cycles_per_ms);
+	CHECK(cycles <= (ms + 2U) * seen.cycles_per_ms);
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_start(profiler_entry);
+
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 10000 && state != SIM_STATE_RETURNED; ms += 10) {
+		state = sim_run_ms(10);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+
+	printf("HAL_Delay(10): %lu cycles at %lu cycles/ms\n", (unsigned long)seen.delay_cycles, (unsigned long)seen.cycles_per_ms);
+	check_delay_cycles(seen.delay_cycles, 10);
+
+	printf("recorded: count %lu, min %lu, avg %lu, max %lu\n", (unsigned long)seen.recorded.count,
+			(unsigned long)seen.recorded.min_cycles, (unsigned long)seen.recorded.avg_cycles, (unsigned long)seen.recorded.max_cycles);
+	CHECK(seen.recorded.count == 3);
+	CHECK(seen.recorded.min_cycles == 100);
+	CHECK(seen.recorded.max_cycles == 300);
+	CHECK(seen.recorded.total_cycles == 601);
+	CHECK(seen.recorded.avg_cycles == 200);
+	CHECK(seen.untouched.count == 0);
+	CHECK(seen.untouched.min_cycles == 0);
+	CHECK(seen.untouched.max_cycles == 0);
+	CHECK(seen.untouched.avg_cycles == 0);
+
+	/* CYCCNT wrapped during the long block, the unsigned difference still gives its length */
+	const profiler_stats_t *blocks = &seen.blocks;
+	printf("blocks across the wrap: count %lu, min %lu, avg %lu, max %lu, load %lu.%lu%%\n", (unsigned long)blocks->count,
+			(unsigned long)blocks->min_cycles, (unsigned long)blocks->avg_cycles, (unsigned long)blocks->max_cycles,
+			(unsigned long)(blocks->load_permille / 10U), (unsigned long)(blocks->load_permille % 10U));
+	CHECK(seen.cyccnt_after_wrap < seen.cyccnt_before_wrap);
+	CHECK(blocks->count == 2);
+	check_delay_cycles(blocks->max_cycles, LONG_BLOCK_MS);
+	check_delay_cycles(blocks->min_cycles, SHORT_BLOCK_MS);
+	CHECK(blocks->total_cycles == (uint64_t)blocks->min_cycles + blocks->max_cycles);
+	CHECK(blocks->avg_cycles == (uint32_t)(blocks->total_cycles / 2U));
+	CHECK(blocks->load_permille >= (LONG_BLOCK_MS + SHORT_BLOCK_MS) * 1000U / LOAD_WINDOW_MS);
+	CHECK(blocks->load_permille <= (LONG_BLOCK_MS + SHORT_BLOCK_MS + 4U) * 1000U / LOAD_WINDOW_MS);
+
+	CHECK(seen.after_reset.count == 0);
+	CHECK(seen.after_reset.total_cycles == 0);
+	CHECK(seen.after_reset.load_permille == 0);
+
+	return 0;
+}
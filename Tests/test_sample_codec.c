@@ -0,0 +1,243 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * compression of the sample codec on a day of synthetic indoor and outdoor
+ * traces: bits per sample against the 5 byte packed raw pair and the 9 bytes
+ * with a 32 bit time, samples per flash log page against the 40 fixed records,
+ * lossless round trip and host encode and decode time per sample. the codec
+ * touches no register, the simulation can't count its cycles, the target
+ * reports them in flash_log last_encode_cycles
+ */
+
+#include "sample_codec.h"
+#include "check.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#define DAY_S 86400U
+
+/*
+ * stream bytes of a flash log page and its sample limit, see flash_log.c
+ */
+#define PAGE_STREAM_SIZE 248U
+#define PAGE_MAX_SAMPLES 255U
+#define FIXED_PAGE_SAMPLES 40.0
+
+/*
+ * packed raw pair and the same with a 32 bit time, in bits
+ */
+#define RAW_PAIR_BITS 40.0
+#define RAW_RECORD_BITS 72.0
+
+#define MAX_SAMPLES 30000U
+#define TIMING_REPEATS 20
+
+/*
+ * sensor noise in raw LSB, about 0.01 C and 0.02 %RH
+ */
+#define TEMPERATURE_NOISE_LSB 50.0
+#define HUMIDITY_NOISE_LSB 200.0
+
+typedef struct {
+	const char *name;
+	uint32_t count;
+	uint32_t humidity[MAX_SAMPLES];
+	uint32_t temperature[MAX_SAMPLES];
+	uint32_t time_s[MAX_SAMPLES];
+} trace_t;
+
+static trace_t indoor = {.name = "indoor"};
+static trace_t outdoor = {.name = "outdoor"};
+
+static uint8_t stream[MAX_SAMPLES * 16];
+
+static uint32_t seed = 1;
+
+static double uniform(void) {
+	seed = seed * 1103515245U + 12345U;
+	return (double)(seed >> 8) / (double)(1U << 24);
+}
+
+/*
+ * approximately normal, sum of four uniforms
+ */
+static double noise(double sigma) {
+	return (uniform() + uniform() + uniform() + uniform() - 2.0) * sigma * sqrt(3.0);
+}
+
+static uint32_t raw_humidity(double percent) {
+	return (uint32_t)lround(percent / 100.0 * 1048576.0) & 0xFFFFFU;
+}
+
+static uint32_t raw_temperature(double celsius) {
+	return (uint32_t)lround((celsius + 50.0) / 200.0 * 1048576.0) & 0xFFFFFU;
+}
+
+static void add_sample(trace_t *trace, uint32_t time_s, double celsius, double percent) {
+	CHECK(trace->count < MAX_SAMPLES);
+	trace->time_s[trace->count] = time_s;
+	trace->temperature[trace->count] = (raw_temperature(celsius) + (uint32_t)lround(noise(TEMPERATURE_NOISE_LSB))) & 0xFFFFFU;
+	trace->humidity[trace->count] = (raw_humidity(percent) + (uint32_t)lround(noise(HUMIDITY_NOISE_LSB))) & 0xFFFFFU;
+	trace->count++;
+}
+
+/*
+ * heated room logged every 30 s: daily swing, a thermostat cycling every 40 minutes
+ */
+static void make_indoor(void) {
+	for (uint32_t t = 0; t < DAY_S; t += 30) {
+		double day = 2.0 * M_PI * t / DAY_S;
+		double cycle = (double)(t % 2400U) / 2400.0;
+		double celsius = 21.5 + 0.8 * sin(day) + 0.3 * (cycle < 0.5 ? cycle : 1.0 - cycle);
+		double percent = 45.0 - 3.0 * sin(day) - 1.5 * (cycle < 0.5 ? cycle : 1.0 - cycle);
+		add_sample(&indoor, t, celsius, percent);
+	}
+}
+
+/*
+ * outdoor weather drifting on top of the daily swing, a cold front of 20 minutes
+ * every 6 hours. sampled every 1-10 s: fast while it changes, slower while stable
+ */
+static void make_outdoor(void) {
+	double weather = 0.0;
+	double previous = 0.0;
+	uint32_t interval = 1;
+
+	for (uint32_t t = 0; t < DAY_S; t += interval) {
+		double day = 2.0 * M_PI * t / DAY_S;
+		bool front = t % 21600U < 1200U;
+		weather += (front ? -0.5 / 60.0 : 0.0) * interval + noise(0.002) * sqrt((double)interval);
+		double celsius = 12.0 + 6.0 * sin(day) + weather;
+		double percent = 70.0 - 2.5 * (celsius - 12.0);
+		add_sample(&outdoor, t, celsius, percent);
+
+		interval = fabs(celsius - previous) > 0.005 * interval ? 1U : (interval < 10U ? interval + 1U : 10U);
+		previous = celsius;
+	}
+}
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/*
+ * encodes the trace as one stream, returns its length
+ */
+static uint32_t encode(const trace_t *trace) {
+	sample_codec_encoder_t encoder;
+	sample_codec_encoder_init(&encoder, stream, sizeof(stream));
+	for (uint32_t i = 0; i < trace->count; i++) {
+		bool encoded = sample_codec_encode(&encoder, trace->humidity[i], trace->temperature[i], trace->time_s[i]);
+		CHECK(encoded);
+	}
+	return sample_codec_finish(&encoder);
+}
+
+/*
+ * decodes the stream and compares it with the trace
+ */
+static uint32_t decode(const trace_t *trace, uint32_t length) {
+	sample_codec_decoder_t decoder;
+	uint32_t mismatches = 0;
+	sample_codec_decoder_init(&decoder, stream, length);
+	for (uint32_t i = 0; i < trace->count; i++) {
+		uint32_t humidity = 0;
+		uint32_t temperature = 0;
+		uint32_t time_s = 0;
+		bool decoded = sample_codec_decode(&decoder, &humidity, &temperature, &time_s);
+		CHECK(decoded);
+		if (humidity != trace->humidity[i] || temperature != trace->temperature[i] || time_s != trace->time_s[i]) {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+/*
+ * average samples per flash log page, every page starts a new stream
+ */
+static double page_samples(const trace_t *trace) {
+	uint8_t page[PAGE_STREAM_SIZE];
+	sample_codec_encoder_t encoder;
+	uint32_t pages = 0;
+	uint32_t in_page = 0;
+
+	sample_codec_encoder_init(&encoder, page, sizeof(page));
+	for (uint32_t i = 0; i < trace->count; i++) {
+		if (in_page == PAGE_MAX_SAMPLES || !sample_codec_encode(&encoder, trace->humidity[i], trace->temperature[i], trace->time_s[i])) {
+			pages++;
+			in_page = 0;
+			sample_codec_encoder_init(&encoder, page, sizeof(page));
+			bool encoded = sample_codec_encode(&encoder, trace->humidity[i], trace->temperature[i], trace->time_s[i]);
+			CHECK(encoded);
+		}
+		in_page++;
+	}
+	/* the last, partly filled page counts by how full it is */
+	sample_codec_finish(&encoder);
+	return trace->count / (pages + (double)encoder.position / PAGE_STREAM_SIZE);
+}
+
+/*
+ * reports the trace, returns bits per sample
+ */
+static double report(const trace_t *trace) {
+	uint32_t length = encode(trace);
+	uint32_t mismatches = decode(trace, length);
+	CHECK(mismatches == 0);
+
+	double encode_ns = 1e12;
+	double decode_ns = 1e12;
+	for (int r = 0; r < TIMING_REPEATS; r++) {
+		double start = now_ns();
+		encode(trace);
+		double middle = now_ns();
+		decode(trace, length);
+		double end = now_ns();
+		encode_ns = fmin(encode_ns, (middle - start) / trace->count);
+		decode_ns = fmin(decode_ns, (end - middle) / trace->count);
+	}
+
+	double bits = 8.0 * length / trace->count;
+	double per_page = page_samples(trace);
+	printf("%-8s %5lu samples: %.1f bits/sample, %.2fx against raw values, %.2fx with time, "
+			"%.0f samples/page (%.1fx), encode %.0f ns, decode %.0f ns\n",
+			trace->name, (unsigned long)trace->count, bits, RAW_PAIR_BITS / bits, RAW_RECORD_BITS / bits,
+			per_page, per_page / FIXED_PAGE_SAMPLES, encode_ns, decode_ns);
+	CHECK(per_page > FIXED_PAGE_SAMPLES * 1.5);
+
+	return bits;
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	make_indoor();
+	make_outdoor();
+
+	double indoor_bits = report(&indoor);
+	double outdoor_bits = report(&outdoor);
+	CHECK(indoor_bits < RAW_PAIR_BITS / 1.6);
+	CHECK(outdoor_bits < RAW_PAIR_BITS / 1.6);
+
+	return 0;
+}
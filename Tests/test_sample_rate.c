@@ -0,0 +1,215 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * sampling cadence replayed on step and ramp traces with the configuration of
+ * business_logic.c: a flat trace doubles the interval after every
+ * stable_samples up to max_interval_ms, a step above the noise band drops to
+ * min_interval_ms on the very next sample and one inside it doesn't, a ramp
+ * below the slope threshold slows down while a faster one keeps coming back
+ * to the fastest interval. sample_rate_set_max_interval clamps the current
+ * interval and bus_saved_ms counts the samples saved against the baseline
+ */
+
+#include "sample_rate.h"
+#include "check.h"
+#include <stdio.h>
+
+static const sample_rate_config_t CONFIG = {
+		.min_interval_ms = 1000,
+		.max_interval_ms = 10000,
+		.temperature_slope_centi = 30,
+		.humidity_slope_centi = 100,
+		.temperature_noise_centi = 10,
+		.humidity_noise_centi = 30,
+		.stable_samples = 5,
+		.bus_us_per_sample = 1400,
+		.baseline_interval_ms = 180,
+};
+
+#define TEMPERATURE_CENTI 2150
+#define HUMIDITY_CENTI 4500
+
+/*
+ * intervals of the doubling from the fastest to the slowest one
+ */
+static const uint32_t DOUBLING[] = {1000, 2000, 4000, 8000, 10000};
+#define DOUBLING_STEPS (sizeof(DOUBLING) / sizeof(DOUBLING[0]))
+
+/*
+ * a replayed trace: time of the next sample and the controller
+ */
+typedef struct {
+	sample_rate_t rate;
+	uint32_t now;
+	uint32_t samples;
+} replay_t;
+
+static void replay_init(replay_t *replay) {
+	replay->now = 0;
+	replay->samples = 0;
+	CHECK(sample_rate_init(&replay->rate, &CONFIG, replay->now) == SAMPLE_RATE_STATUS_OK);
+}
+
+/*
+ * takes a sample at the current time and moves to the next one, returns the interval
+ */
+static uint32_t sample(replay_t *replay, int32_t temperature_centi, int32_t humidity_centi) {
+	uint32_t interval = sample_rate_update(&replay->rate, temperature_centi, humidity_centi, replay->now);
+	replay->now += interval;
+	replay->samples++;
+	return interval;
+}
+
+/*
+ * samples a flat trace until the interval reaches max_interval_ms, checks every step of the doubling
+ */
+static void settle(replay_t *replay, int32_t temperature_centi, int32_t humidity_centi) {
+	for (uint32_t step = 0; step < DOUBLING_STEPS - 1U; step++) {
+		for (uint8_t i = 0; i < CONFIG.stable_samples - 1U; i++) {
+			CHECK(sample(replay, temperature_centi, humidity_centi) == DOUBLING[step]);
+		}
+		CHECK(sample(replay, temperature_centi, humidity_centi) == DOUBLING[step + 1U]);
+	}
+}
+
+/*
+ * replays a ramp of slope_centi per minute for duration_ms, returns the slowest interval used
+ * and counts the drops to the fastest one
+ */
+static uint32_t ramp(replay_t *replay, int32_t slope_centi, uint32_t duration_ms, uint32_t *drops) {
+	uint32_t start = replay->now;
+	uint32_t slowest = 0;
+	uint32_t previous = replay->rate.interval_ms;
+
+	*drops = 0;
+	while (replay->now - start < duration_ms) {
+		int32_t temperature = TEMPERATURE_CENTI + (int32_t)((int64_t)slope_centi * (replay->now - start) / 60000);
+		uint32_t interval = sample(replay, temperature, HUMIDITY_CENTI);
+		if (interval == CONFIG.min_interval_ms && previous != CONFIG.min_interval_ms) {
+			(*drops)++;
+		}
+		slowest = interval > slowest ? interval : slowest;
+		previous = interval;
+	}
+	return slowest;
+}
+
+int main(void) {
+	replay_t replay;
+
+	/* flat: the first sample is the reference, then every stable_samples double the interval */
+	replay_init(&replay);
+	CHECK(sample(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI) == CONFIG.min_interval_ms);
+	settle(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI);
+	printf("flat: %lu ms reached after %lu samples, %lu s\n", (unsigned long)replay.rate.interval_ms,
+			(unsigned long)replay.samples, (unsigned long)(replay.now / 1000U));
+	for (uint32_t i = 0; i < 20; i++) {
+		CHECK(sample(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI) == CONFIG.max_interval_ms);
+	}
+
+	/* noise inside the bands never speeds up, whichever sample starts the window */
+	for (uint32_t i = 0; i < 20; i++) {
+		int32_t temperature_noise = (i % 2U) ? (int32_t)CONFIG.temperature_noise_centi : 0;
+		int32_t humidity_noise = (i % 3U) ? (int32_t)CONFIG.humidity_noise_centi : 0;
+		CHECK(sample(&replay, TEMPERATURE_CENTI + temperature_noise, HUMIDITY_CENTI + humidity_noise) == CONFIG.max_interval_ms);
+	}
+
+	/* temperature step: the next sample drops to the fastest interval, the new level settles again */
+	int32_t stepped = TEMPERATURE_CENTI + 100;
+	CHECK(sample(&replay, stepped, HUMIDITY_CENTI) == CONFIG.min_interval_ms);
+	settle(&replay, stepped, HUMIDITY_CENTI);
+
+	/* humidity step, downwards */
+	int32_t humidity = HUMIDITY_CENTI - 200;
+	CHECK(sample(&replay, stepped, humidity) == CONFIG.min_interval_ms);
+	settle(&replay, stepped, humidity);
+
+	/* a step just above the noise band at the slowest interval: 11 centi in 10 s is 66 per minute */
+	CHECK(sample(&replay, stepped + (int32_t)CONFIG.temperature_noise_centi + 1, humidity) == CONFIG.min_interval_ms);
+
+	/* ramps: 20 centi per minute stays below the 30 of the threshold, 50 doesn't */
+	uint32_t drops = 0;
+	replay_init(&replay);
+	uint32_t slowest = ramp(&replay, 20, 600000, &drops);
+	printf("ramp 0.20 C/min: slowest %lu ms, %lu drops to the fastest interval\n", (unsigned long)slowest, (unsigned long)drops);
+	CHECK(slowest == CONFIG.max_interval_ms);
+	CHECK(drops == 0);
+
+	replay_init(&replay);
+	slowest = ramp(&replay, 50, 600000, &drops);
+	printf("ramp 0.50 C/min: slowest %lu ms, %lu drops to the fastest interval\n", (unsigned long)slowest, (unsigned long)drops);
+	CHECK(slowest < CONFIG.max_interval_ms);
+	CHECK(drops >= 10);
+
+	/* max interval: the current one is clamped, a value below min_interval_ms is refused */
+	replay_init(&replay);
+	sample(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI);
+	settle(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI);
+	CHECK(sample_rate_set_max_interval(&replay.rate, CONFIG.min_interval_ms - 1U) == SAMPLE_RATE_STATUS_INVALID_PARAMETERS);
+	CHECK(replay.rate.interval_ms == CONFIG.max_interval_ms);
+	CHECK(sample_rate_set_max_interval(&replay.rate, 2000) == SAMPLE_RATE_STATUS_OK);
+	CHECK(replay.rate.interval_ms == 2000);
+	for (uint32_t i = 0; i < 20; i++) {
+		CHECK(sample(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI) == 2000);
+	}
+
+	/* raised again: doubling goes on from the clamped interval, 4000 then the new slowest 5000 */
+	CHECK(sample_rate_set_max_interval(&replay.rate, 5000) == SAMPLE_RATE_STATUS_OK);
+	CHECK(replay.rate.interval_ms == 2000);
+	uint32_t interval = 0;
+	uint32_t samples = 0;
+	while ((interval = sample(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI)) == 2000) {
+		samples++;
+	}
+	CHECK(samples < CONFIG.stable_samples);
+	CHECK(interval == 4000);
+	for (uint8_t i = 0; i < CONFIG.stable_samples - 1U; i++) {
+		CHECK(sample(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI) == 4000);
+	}
+	CHECK(sample(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI) == 5000);
+
+	/* bus time saved: samples of the 180 ms baseline minus the samples taken, 1.4 ms each */
+	sample_rate_stats_t stats;
+	replay_init(&replay);
+	sample_rate_get_stats(&replay.rate, replay.now, &stats);
+	CHECK(stats.samples == 0);
+	CHECK(stats.samples_per_hour == 0);
+	CHECK(stats.bus_saved_ms == 0);
+
+	sample(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI);
+	settle(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI);
+	while (replay.now < 3600000U) {
+		sample(&replay, TEMPERATURE_CENTI, HUMIDITY_CENTI);
+	}
+	sample_rate_get_stats(&replay.rate, replay.now, &stats);
+	uint32_t baseline_samples = replay.now / CONFIG.baseline_interval_ms;
+	printf("flat hour: %lu samples, %lu per hour, %lu ms of bus time saved against %lu baseline samples\n",
+			(unsigned long)stats.samples, (unsigned long)stats.samples_per_hour, (unsigned long)stats.bus_saved_ms,
+			(unsigned long)baseline_samples);
+	CHECK(stats.samples == replay.samples);
+	CHECK(stats.interval_ms == CONFIG.max_interval_ms);
+	CHECK(stats.samples_per_hour == (uint32_t)((uint64_t)replay.samples * 3600000U / replay.now));
+	CHECK(stats.bus_saved_ms == (baseline_samples - replay.samples) * CONFIG.bus_us_per_sample / 1000U);
+
+	/* sampling faster than the baseline saves nothing */
+	sample_rate_get_stats(&replay.rate, replay.rate.start_time + CONFIG.baseline_interval_ms, &stats);
+	CHECK(stats.bus_saved_ms == 0);
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * releases of a task that is both periodic and subscribed to an event: an
+ * event landing on a due period gives one run and the next period starts from
+ * it, an event between periods runs the task without moving the period, and a
+ * task left alone runs once a period
+ */
+
+#include "sim.h"
+#include "scheduler.h"
+#include "main.h"
+#include "check.h"
+#include <stdio.h>
+
+#define PERIOD_MS 10U
+#define EVENT 0U
+
+/*
+ * periods run without events at the end
+ */
+#define QUIET_PERIODS 10U
+
+/*
+ * clock setup of main.c
+ */
+void SystemClock_Config(void);
+
+/*
+ * what the firmware context saw, checked by main
+ */
+static struct {
+	uint32_t first_release;
+	uint32_t runs_on_due_event;
+	uint32_t runs_after_due_event;
+	uint32_t idle_after_due_event;
+	uint32_t runs_after_next_period;
+	uint32_t next_period_tick;
+	uint32_t runs_between_periods;
+	uint32_t period_tick_after_event;
+	uint32_t quiet_last_tick;
+} seen;
+
+static volatile uint32_t runs = 0;
+static volatile uint32_t last_run_tick = 0;
+static volatile uint32_t idle_calls = 0;
+
+static void task_run(void) {
+	runs++;
+	last_run_tick = HAL_GetTick();
+}
+
+static void count_idle(void) {
+	idle_calls++;
+	__WFI();
+}
+
+static void wait_until(uint32_t tick) {
+	while ((int32_t)(HAL_GetTick() - tick) < 0) {
+		__WFI();
+	}
+}
+
+/*
+ * runs the scheduler until the task has run count more times
+ */
+static void run_until_runs(uint32_t count) {
+	uint32_t target = runs + count;
+	while (runs < target) {
+		scheduler_run_once();
+	}
+}
+
+static void scheduler_entry(void) {
+	SystemInit();
+	HAL_Init();
+	SystemClock_Config();
+	scheduler_init();
+	scheduler_set_idle_hook(count_idle);
+
+	scheduler_task_config_t config = {
+			.name = "both",
+			.run = task_run,
+			.period_ms = PERIOD_MS,
+			.deadline_ms = 0,
+			.event_mask = SCHEDULER_EVENT_BIT(EVENT),
+	};
+	CHECK(scheduler_add_task(&config, NULL) == SCHEDULER_STATUS_OK);
+
+	/* the first period is due right away */
+	run_until_runs(1);
+	seen.first_release = last_run_tick;
+
+	/* an event posted on the tick the next period is due: one run, then nothing is ready */
+	wait_until(seen.first_release + PERIOD_MS);
+	CHECK(scheduler_post_event(EVENT) == SCHEDULER_STATUS_OK);
+	uint32_t before = runs;
+	scheduler_run_once();
+	seen.runs_on_due_event = runs - before;
+	uint32_t idle_before = idle_calls;
+	scheduler_run_once();
+	seen.runs_after_due_event = runs - before;
+	seen.idle_after_due_event = idle_calls - idle_before;
+
+	/* the period after it comes one period later */
+	run_until_runs(1);
+	seen.next_period_tick = last_run_tick;
+	seen.runs_after_next_period = runs - before;
+
+	/* an event half way through a period runs the task, the period stays where it was */
+	wait_until(seen.next_period_tick + PERIOD_MS / 2U);
+	before = runs;
+	CHECK(scheduler_post_event(EVENT) == SCHEDULER_STATUS_OK);
+	scheduler_run_once();
+	seen.runs_between_periods = runs - before;
+	run_until_runs(1);
+	seen.period_tick_after_event = last_run_tick;
+
+	/* no events: one run a period */
+	run_until_runs(QUIET_PERIODS);
+	seen.quiet_last_tick = last_run_tick;
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_start(scheduler_entry);
+
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 10000 && state != SIM_STATE_RETURNED; ms += 10) {
+		state = sim_run_ms(10);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+
+	printf("event on a due period: %lu run, %lu after the next pass, next period %lu ms later\n",
+			(unsigned long)seen.runs_on_due_event, (unsigned long)seen.runs_after_due_event,
+			(unsigned long)(seen.next_period_tick - seen.first_release - PERIOD_MS));
+	CHECK(seen.runs_on_due_event == 1);
+	CHECK(seen.runs_after_due_event == 1);
+	CHECK(seen.idle_after_due_event == 1);
+	CHECK(seen.runs_after_next_period == 2);
+	CHECK(seen.next_period_tick == seen.first_release + 2U * PERIOD_MS);
+
+	printf("event between periods: %lu run, next period at +%lu ms\n", (unsigned long)seen.runs_between_periods,
+			(unsigned long)(seen.period_tick_after_event - seen.next_period_tick));
+	CHECK(seen.runs_between_periods == 1);
+	CHECK(seen.period_tick_after_event == seen.next_period_tick + PERIOD_MS);
+
+	printf("quiet: %u runs in %lu ms\n", QUIET_PERIODS, (unsigned long)(seen.quiet_last_tick - seen.period_tick_after_event));
+	CHECK(seen.quiet_last_tick == seen.period_tick_after_event + QUIET_PERIODS * PERIOD_MS);
+
+	return 0;
+}
@@ -0,0 +1,322 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * sensor filter against direct references on a synthetic noisy trace: a slow
+ * temperature ramp with gaussian noise and spikes, humidity flat with noise.
+ * moving average and median are recomputed from the last samples, the ema in
+ * double, through the window fill-up, a window change and a reset. the noise
+ * left by each filter and the host time per sample are reported
+ */
+
+#include "sensor_filter.h"
+#include "check.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_SAMPLES 4000U
+
+/*
+ * raw units, 2^20 / 200 C: about 52 per 0.01 C. noise of a single shot around 0.02 C
+ */
+#define NOISE_SIGMA 100.0
+#define SPIKE_HEIGHT 5000.0
+#define SPIKE_PERIOD 37U
+
+/*
+ * a ramp of ~1 C over the trace, slow against every window
+ */
+#define RAMP_PER_SAMPLE 1.25
+#define TEMPERATURE_START 370000.0
+#define HUMIDITY_LEVEL 470000.0
+
+/*
+ * noise left by the filters relative to the raw trace, at most.
+ * white noise gives 1/sqrt(8) for a window of 8 and sqrt(alpha / (2 - alpha)) for the ema
+ */
+#define MOVING_AVERAGE_NOISE_RATIO 0.5
+#define MEDIAN_NOISE_RATIO 0.6
+#define EMA_NOISE_RATIO 0.5
+
+/*
+ * the ema state keeps 8 fraction bits, the rounding of each step adds up to about one raw unit
+ */
+#define EMA_TOLERANCE 2.0
+
+#define BENCH_ROUNDS 20U
+
+typedef struct {
+	uint32_t humidity[TRACE_SAMPLES];
+	uint32_t temperature[TRACE_SAMPLES];
+	double true_humidity[TRACE_SAMPLES];
+	double true_temperature[TRACE_SAMPLES];
+} trace_t;
+
+static trace_t trace;
+
+static uint32_t random_state = 0x9E3779B9U;
+
+static double next_uniform(void) {
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return ((double)random_state + 0.5) / 4294967296.0;
+}
+
+/*
+ * Box-Muller
+ */
+static double next_gaussian(void) {
+	double u1 = next_uniform();
+	double u2 = next_uniform();
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static void build_trace(void) {
+	for (uint32_t i = 0; i < TRACE_SAMPLES; ++i) {
+		trace.true_temperature[i] = TEMPERATURE_START + RAMP_PER_SAMPLE * i;
+		trace.true_humidity[i] = HUMIDITY_LEVEL;
+
+		double temperature = trace.true_temperature[i] + NOISE_SIGMA * next_gaussian();
+		if (i % SPIKE_PERIOD == SPIKE_PERIOD - 1U) {
+			temperature += SPIKE_HEIGHT;
+		}
+		trace.temperature[i] = (uint32_t)lround(temperature);
+		trace.humidity[i] = (uint32_t)lround(trace.true_humidity[i] + NOISE_SIGMA * next_gaussian());
+	}
+}
+
+static int compare_u32(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * moving average of the last count samples ending at end, rounded half up
+ */
+static uint32_t reference_average(const uint32_t *samples, uint32_t end, uint32_t count) {
+	uint64_t sum = 0;
+	for (uint32_t i = end + 1U - count; i <= end; ++i) {
+		sum += samples[i];
+	}
+	return (uint32_t)((sum + count / 2U) / count);
+}
+
+/*
+ * median of the last count samples ending at end, an even count rounds the mean of the middle two up
+ */
+static uint32_t reference_median(const uint32_t *samples, uint32_t end, uint32_t count) {
+	uint32_t sorted[SENSOR_FILTER_MAX_SAMPLES];
+	memcpy(sorted, &samples[end + 1U - count], count * sizeof(sorted[0]));
+	qsort(sorted, count, sizeof(sorted[0]), compare_u32);
+
+	if (count % 2U) {
+		return sorted[count / 2U];
+	}
+	return (sorted[count / 2U - 1U] + sorted[count / 2U] + 1U) / 2U;
+}
+
+/*
+ * rms difference to the noise-free trace, the first samples are skipped while the filter fills
+ */
+typedef struct {
+	double humidity_sq;
+	double temperature_sq;
+	uint32_t count;
+} noise_t;
+
+static void add_noise(noise_t *noise, uint32_t i, uint32_t humidity, uint32_t temperature) {
+	if (i < SENSOR_FILTER_MAX_SAMPLES * 4U) {
+		return;
+	}
+	/* the filters lag behind the ramp, the lag isn't noise */
+	noise->humidity_sq += pow(humidity - trace.true_humidity[i], 2.0);
+	noise->temperature_sq += pow(temperature - trace.true_temperature[i], 2.0);
+	noise->count++;
+}
+
+static double rms(double sum_sq, uint32_t count) {
+	return sqrt(sum_sq / count);
+}
+
+/*
+ * runs the whole trace through a filter and checks every output against the reference.
+ * the window is halved at a third of the trace and the filter reset at two thirds
+ */
+static void check_mode(const char *name, sensor_filter_mode_t mode, noise_t *noise) {
+	const sensor_filter_config_t config = {.mode = mode, .window = 8, .ema_alpha = 32};
+	const sensor_filter_config_t narrow = {.mode = mode, .window = 4, .ema_alpha = 64};
+	const uint32_t narrow_at = TRACE_SAMPLES / 3U;
+	const uint32_t reset_at = 2U * TRACE_SAMPLES / 3U;
+
+	sensor_filter_t filter;
+	sensor_filter_status_t status = sensor_filter_init(&filter, &config);
+	CHECK(status == SENSOR_FILTER_STATUS_OK);
+
+	const sensor_filter_config_t *current = &config;
+	uint32_t start = 0;
+	double ema_humidity = 0.0;
+	double ema_temperature = 0.0;
+	double max_ema_error = 0.0;
+
+	memset(noise, 0, sizeof(*noise));
+	for (uint32_t i = 0; i < TRACE_SAMPLES; ++i) {
+		if (i == narrow_at) {
+			/* the newest samples that fit stay, the ema keeps its state */
+			status = sensor_filter_set_config(&filter, &narrow);
+			CHECK(status == SENSOR_FILTER_STATUS_OK);
+			current = &narrow;
+		}
+		if (i == reset_at) {
+			sensor_filter_reset(&filter);
+			start = i;
+		}
+
+		uint32_t humidity = 0;
+		uint32_t temperature = 0;
+		sensor_filter_push(&filter, trace.humidity[i], trace.temperature[i], &humidity, &temperature);
+
+		uint32_t available = i + 1U - start;
+		uint32_t count = (available < current->window) ? available : current->window;
+		CHECK(filter.count == count);
+
+		switch (mode) {
+		case SENSOR_FILTER_MOVING_AVERAGE:
+			CHECK(humidity == reference_average(trace.humidity, i, count));
+			CHECK(temperature == reference_average(trace.temperature, i, count));
+			break;
+		case SENSOR_FILTER_MEDIAN:
+			CHECK(humidity == reference_median(trace.humidity, i, count));
+			CHECK(temperature == reference_median(trace.temperature, i, count));
+			break;
+		case SENSOR_FILTER_EMA: {
+			double alpha = current->ema_alpha / 256.0;
+			if (available == 1U) {
+				ema_humidity = trace.humidity[i];
+				ema_temperature = trace.temperature[i];
+			} else {
+				ema_humidity += alpha * (trace.humidity[i] - ema_humidity);
+				ema_temperature += alpha * (trace.temperature[i] - ema_temperature);
+			}
+			double error = fmax(fabs(humidity - ema_humidity), fabs(temperature - ema_temperature));
+			max_ema_error = fmax(max_ema_error, error);
+			CHECK(error <= EMA_TOLERANCE);
+			break;
+		}
+		case SENSOR_FILTER_NONE:
+		default:
+			CHECK(humidity == trace.humidity[i]);
+			CHECK(temperature == trace.temperature[i]);
+			break;
+		}
+
+		/* the first output after a reset is the sample itself */
+		if (available == 1U) {
+			CHECK(humidity == trace.humidity[i]);
+			CHECK(temperature == trace.temperature[i]);
+		}
+
+		if (i < narrow_at) {
+			add_noise(noise, i, humidity, temperature);
+		}
+	}
+
+	printf("%s: rms noise %.1f humidity, %.1f temperature", name,
+			rms(noise->humidity_sq, noise->count), rms(noise->temperature_sq, noise->count));
+	if (mode == SENSOR_FILTER_EMA) {
+		printf(", max ema error %.2f", max_ema_error);
+	}
+	printf("\n");
+}
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/*
+ * host time per sample of a filter with a window of SENSOR_FILTER_MAX_SAMPLES
+ */
+static double sample_ns(sensor_filter_mode_t mode) {
+	const sensor_filter_config_t config = {.mode = mode, .window = SENSOR_FILTER_MAX_SAMPLES, .ema_alpha = 32};
+	sensor_filter_t filter;
+	volatile uint32_t sink = 0;
+
+	sensor_filter_status_t status = sensor_filter_init(&filter, &config);
+	CHECK(status == SENSOR_FILTER_STATUS_OK);
+
+	double start = now_ns();
+	for (uint32_t round = 0; round < BENCH_ROUNDS; ++round) {
+		for (uint32_t i = 0; i < TRACE_SAMPLES; ++i) {
+			uint32_t humidity = 0;
+			uint32_t temperature = 0;
+			sensor_filter_push(&filter, trace.humidity[i], trace.temperature[i], &humidity, &temperature);
+			sink ^= humidity ^ temperature;
+		}
+	}
+	(void)sink;
+
+	return (now_ns() - start) / (BENCH_ROUNDS * TRACE_SAMPLES);
+}
+
+int main(void) {
+	build_trace();
+
+	noise_t raw;
+	noise_t average;
+	noise_t median;
+	noise_t ema;
+	check_mode("none", SENSOR_FILTER_NONE, &raw);
+	check_mode("moving average", SENSOR_FILTER_MOVING_AVERAGE, &average);
+	check_mode("median", SENSOR_FILTER_MEDIAN, &median);
+	check_mode("ema", SENSOR_FILTER_EMA, &ema);
+
+	/* humidity has white noise only, every filter must reduce it */
+	double raw_humidity = rms(raw.humidity_sq, raw.count);
+	CHECK(rms(average.humidity_sq, average.count) <= MOVING_AVERAGE_NOISE_RATIO * raw_humidity);
+	CHECK(rms(median.humidity_sq, median.count) <= MEDIAN_NOISE_RATIO * raw_humidity);
+	CHECK(rms(ema.humidity_sq, ema.count) <= EMA_NOISE_RATIO * raw_humidity);
+
+	/* temperature has spikes on top, the median drops them */
+	double raw_temperature = rms(raw.temperature_sq, raw.count);
+	CHECK(rms(average.temperature_sq, average.count) < raw_temperature);
+	CHECK(rms(median.temperature_sq, median.count) <= MEDIAN_NOISE_RATIO * rms(average.temperature_sq, average.count));
+	CHECK(rms(ema.temperature_sq, ema.count) < raw_temperature);
+
+	/* invalid configurations are refused */
+	sensor_filter_t filter;
+	const sensor_filter_config_t no_window = {.mode = SENSOR_FILTER_MOVING_AVERAGE, .window = 0};
+	const sensor_filter_config_t wide = {.mode = SENSOR_FILTER_MEDIAN, .window = SENSOR_FILTER_MAX_SAMPLES + 1};
+	const sensor_filter_config_t no_alpha = {.mode = SENSOR_FILTER_EMA, .window = 1, .ema_alpha = 0};
+	const sensor_filter_config_t big_alpha = {.mode = SENSOR_FILTER_EMA, .window = 1, .ema_alpha = 257};
+	CHECK(sensor_filter_init(&filter, &no_window) == SENSOR_FILTER_STATUS_INVALID_PARAMETERS);
+	CHECK(sensor_filter_init(&filter, &wide) == SENSOR_FILTER_STATUS_INVALID_PARAMETERS);
+	CHECK(sensor_filter_init(&filter, &no_alpha) == SENSOR_FILTER_STATUS_INVALID_PARAMETERS);
+	CHECK(sensor_filter_init(&filter, &big_alpha) == SENSOR_FILTER_STATUS_INVALID_PARAMETERS);
+
+	printf("host time per sample, window %u: moving average %.1f ns, median %.1f ns, ema %.1f ns\n",
+			SENSOR_FILTER_MAX_SAMPLES, sample_ns(SENSOR_FILTER_MOVING_AVERAGE), sample_ns(SENSOR_FILTER_MEDIAN),
+			sample_ns(SENSOR_FILTER_EMA));
+
+	return 0;
+}
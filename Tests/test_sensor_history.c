@@ -0,0 +1,299 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * raw sample history against a brute-force model: a trace three times the
+ * capacity with jittered 30 s samples and gaps longer than the 255 s a delta
+ * holds. every kept sample reads back with its raw values and rebuilt time,
+ * the oldest block is dropped whole once full and windowed queries match a
+ * scan of the model, at block boundaries, over the physical wrap and on the
+ * partial newest block. host time of sensor_history_get at the first and last
+ * offset of a block shows the cost of its delta walk
+ */
+
+#include "sensor_history.h"
+#include "check.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#define CAPACITY SENSOR_HISTORY_CAPACITY
+#define BLOCK SENSOR_HISTORY_BLOCK_SIZE
+
+#define TRACE_SAMPLES (3U * CAPACITY + BLOCK / 2U)
+#define RANDOM_QUERIES 2000U
+#define TIMING_REPEATS 20
+
+#define RAW_MASK 0xFFFFFU
+
+/*
+ * period of the business layer, its jitter and the delta unit with the largest stored delta
+ */
+#define PERIOD_MS 30000U
+#define JITTER_MS 400U
+#define DELTA_UNIT_MS 1000U
+#define MAX_DELTA_MS (255U * DELTA_UNIT_MS)
+
+/*
+ * model of every sample appended: raw values masked to 20 bits, time as appended and as stored
+ */
+static struct {
+	uint32_t humidity[TRACE_SAMPLES];
+	uint32_t temperature[TRACE_SAMPLES];
+	uint32_t time_ms[TRACE_SAMPLES];
+	uint32_t stored_ms[TRACE_SAMPLES];
+	bool capped[TRACE_SAMPLES];       /* a capped delta in the block up to this sample */
+	uint32_t appended;
+	uint32_t oldest;
+} model;
+
+static uint32_t seed = 1;
+
+static uint32_t random_below(uint32_t limit) {
+	seed = seed * 1103515245U + 12345U;
+	return (seed >> 8) % limit;
+}
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void model_reset(void) {
+	model.appended = 0;
+	model.oldest = 0;
+	sensor_history_reset();
+}
+
+/*
+ * appends to the history and the model, the first sample of a block keeps its time,
+ * the others the previous stored time plus the rounded delta capped at 255 s
+ */
+static void append(uint32_t raw_humidity, uint32_t raw_temperature, uint32_t time_ms) {
+	uint32_t i = model.appended;
+
+	sensor_history_append(raw_humidity, raw_temperature, time_ms);
+
+	if (i - model.oldest == CAPACITY) {
+		model.oldest += BLOCK;
+	}
+	model.humidity[i] = raw_humidity & RAW_MASK;
+	model.temperature[i] = raw_temperature & RAW_MASK;
+	model.time_ms[i] = time_ms;
+	if (i % BLOCK == 0) {
+		model.stored_ms[i] = time_ms;
+		model.capped[i] = false;
+	} else {
+		uint32_t delta_ms = (time_ms - model.stored_ms[i - 1U] + DELTA_UNIT_MS / 2U) / DELTA_UNIT_MS * DELTA_UNIT_MS;
+		model.capped[i] = model.capped[i - 1U] || delta_ms > MAX_DELTA_MS;
+		model.stored_ms[i] = model.stored_ms[i - 1U] + (delta_ms > MAX_DELTA_MS ? MAX_DELTA_MS : delta_ms);
+	}
+	model.appended++;
+}
+
+static uint32_t model_count(void) {
+	return model.appended - model.oldest;
+}
+
+/*
+ * every kept sample reads back as modeled, the times of blocks without a capped delta within half a second
+ */
+static void check_samples(void) {
+	sensor_history_sample_t sample;
+
+	CHECK(sensor_history_count() == model_count());
+	for (uint32_t index = 0; index < model_count(); index++) {
+		uint32_t i = model.oldest + index;
+		CHECK(sensor_history_get(index, &sample) == SENSOR_HISTORY_STATUS_OK);
+		CHECK(sample.raw_humidity == model.humidity[i]);
+		CHECK(sample.raw_temperature == model.temperature[i]);
+		CHECK(sample.time_ms == model.stored_ms[i]);
+		if (!model.capped[i]) {
+			uint32_t error = sample.time_ms > model.time_ms[i] ? sample.time_ms - model.time_ms[i] : model.time_ms[i] - sample.time_ms;
+			CHECK(error <= DELTA_UNIT_MS / 2U);
+		}
+	}
+	CHECK(sensor_history_get(model_count(), &sample) == SENSOR_HISTORY_STATUS_INVALID_PARAMETERS);
+}
+
+/*
+ * a window of the history against a scan of the model
+ */
+static void check_query(uint32_t first, uint32_t length) {
+	sensor_history_summary_t summary;
+	uint64_t sum_humidity = 0;
+	uint64_t sum_temperature = 0;
+	uint32_t min_humidity = RAW_MASK;
+	uint32_t max_humidity = 0;
+	uint32_t min_temperature = RAW_MASK;
+	uint32_t max_temperature = 0;
+
+	for (uint32_t i = model.oldest + first; i < model.oldest + first + length; i++) {
+		min_humidity = model.humidity[i] < min_humidity ? model.humidity[i] : min_humidity;
+		max_humidity = model.humidity[i] > max_humidity ? model.humidity[i] : max_humidity;
+		min_temperature = model.temperature[i] < min_temperature ? model.temperature[i] : min_temperature;
+		max_temperature = model.temperature[i] > max_temperature ? model.temperature[i] : max_temperature;
+		sum_humidity += model.humidity[i];
+		sum_temperature += model.temperature[i];
+	}
+
+	CHECK(sensor_history_query(first, length, &summary) == SENSOR_HISTORY_STATUS_OK);
+	CHECK(summary.count == length);
+	CHECK(summary.min_humidity == min_humidity);
+	CHECK(summary.max_humidity == max_humidity);
+	CHECK(summary.mean_humidity == (uint32_t)(sum_humidity / length));
+	CHECK(summary.min_temperature == min_temperature);
+	CHECK(summary.max_temperature == max_temperature);
+	CHECK(summary.mean_temperature == (uint32_t)(sum_temperature / length));
+}
+
+/*
+ * windows starting, ending and crossing at block boundaries, the newest partial block and random ones
+ */
+static void check_queries(void) {
+	uint32_t count = model_count();
+	sensor_history_summary_t summary;
+
+	CHECK(sensor_history_query(0, 0, &summary) == SENSOR_HISTORY_STATUS_INVALID_PARAMETERS);
+	CHECK(sensor_history_query(count, 1, &summary) == SENSOR_HISTORY_STATUS_INVALID_PARAMETERS);
+	CHECK(sensor_history_query(1, count, &summary) == SENSOR_HISTORY_STATUS_INVALID_PARAMETERS);
+
+	check_query(0, count);
+	check_query(count - 1U, 1);
+	for (uint32_t boundary = 0; boundary + BLOCK <= count; boundary += BLOCK) {
+		check_query(boundary, BLOCK);
+		if (boundary + BLOCK + 1U <= count) {
+			check_query(boundary + BLOCK - 1U, 2);
+			check_query(boundary + 1U, BLOCK);
+		}
+		if (boundary + 3U * BLOCK <= count) {
+			check_query(boundary, 3U * BLOCK);
+			check_query(boundary + 1U, 3U * BLOCK - 2U);
+		}
+	}
+	check_query(count - count % BLOCK - (count >= BLOCK ? BLOCK : 0), count % BLOCK + (count >= BLOCK ? BLOCK : 0));
+	for (uint32_t i = 0; i < RANDOM_QUERIES; i++) {
+		uint32_t first = random_below(count);
+		check_query(first, 1U + random_below(count - first));
+	}
+}
+
+/*
+ * host time of a get at the block offset, averaged over every block, best of the repeats
+ */
+static double get_ns(uint32_t offset) {
+	sensor_history_sample_t sample;
+	double best = 1e12;
+	volatile uint32_t sink = 0;
+
+	for (int repeat = 0; repeat < TIMING_REPEATS; repeat++) {
+		double start = now_ns();
+		for (uint32_t index = offset; index < sensor_history_count(); index += BLOCK) {
+			sensor_history_get(index, &sample);
+			sink += sample.time_ms;
+		}
+		double elapsed = (now_ns() - start) / (sensor_history_count() / BLOCK);
+		best = elapsed < best ? elapsed : best;
+	}
+	(void)sink;
+	return best;
+}
+
+static double query_ns(uint32_t first, uint32_t length) {
+	sensor_history_summary_t summary;
+	double best = 1e12;
+
+	for (int repeat = 0; repeat < TIMING_REPEATS; repeat++) {
+		double start = now_ns();
+		sensor_history_query(first, length, &summary);
+		double elapsed = now_ns() - start;
+		best = elapsed < best ? elapsed : best;
+	}
+	return best;
+}
+
+int main(void) {
+	sensor_history_sample_t sample;
+	uint32_t time_ms = 0;
+
+	/* deltas: rounded to the second from the stored time, capped at 255 s, exact again at the next block */
+	model_reset();
+	CHECK(sensor_history_get(0, &sample) == SENSOR_HISTORY_STATUS_INVALID_PARAMETERS);
+	append(0xFFFFFFFFU, 0x12345678U, 1000);
+	append(1, 2, 2499);
+	append(3, 4, 4000);
+	append(5, 6, 4000 + 1000U * DELTA_UNIT_MS);
+	append(7, 8, 4000 + 1000U * DELTA_UNIT_MS + 254499U);
+	while (model.appended < BLOCK) {
+		append(model.appended, model.appended, 4000 + 1000U * DELTA_UNIT_MS + 254499U + model.appended * PERIOD_MS);
+	}
+	append(9, 10, 4000 + 1000U * DELTA_UNIT_MS + 254499U + BLOCK * PERIOD_MS + 123U);
+	CHECK(model.stored_ms[1] == 2000U);
+	CHECK(model.stored_ms[2] == 4000U);
+	CHECK(model.stored_ms[3] == 4000U + MAX_DELTA_MS);
+	CHECK(model.stored_ms[4] == 4000U + 2U * MAX_DELTA_MS);
+	CHECK(model.stored_ms[BLOCK] == model.time_ms[BLOCK]);
+	check_samples();
+	CHECK(sensor_history_get(0, &sample) == SENSOR_HISTORY_STATUS_OK);
+	CHECK(sample.raw_humidity == RAW_MASK && sample.raw_temperature == 0x45678U);
+	CHECK(sensor_history_get(3, &sample) == SENSOR_HISTORY_STATUS_OK);
+	printf("gap of 1000 s stored as %lu s, %lu s behind until the capped deltas after it catch up\n",
+			(unsigned long)((sample.time_ms - 4000U) / DELTA_UNIT_MS),
+			(unsigned long)((model.time_ms[3] - sample.time_ms) / DELTA_UNIT_MS));
+	CHECK(model.time_ms[BLOCK - 1U] - model.stored_ms[BLOCK - 1U] <= DELTA_UNIT_MS / 2U);
+	check_queries();
+
+	/* a trace three times the capacity, checked around the fills and wraps of the ring */
+	model_reset();
+	uint32_t long_gaps = 0;
+	for (uint32_t i = 0; i < TRACE_SAMPLES; i++) {
+		uint32_t gap = PERIOD_MS - JITTER_MS + random_below(2U * JITTER_MS);
+		if (random_below(200) == 0) {
+			gap = MAX_DELTA_MS + random_below(4U * MAX_DELTA_MS);
+			long_gaps++;
+		}
+		time_ms += gap;
+		append(random_below(RAW_MASK + 1U), random_below(RAW_MASK + 1U), time_ms);
+
+		uint32_t appended = model.appended;
+		if (appended == 1U || appended == BLOCK - 1U || appended == BLOCK || appended == BLOCK + 1U
+				|| appended % CAPACITY == CAPACITY - 1U || appended % CAPACITY == 0U || appended % CAPACITY == 1U
+				|| appended % CAPACITY == BLOCK / 2U || appended == TRACE_SAMPLES) {
+			check_samples();
+			check_queries();
+		}
+		if (appended > CAPACITY) {
+			CHECK(sensor_history_count() > CAPACITY - BLOCK && sensor_history_count() <= CAPACITY);
+		}
+	}
+	printf("%u samples appended with %lu gaps over 255 s, %lu kept\n", TRACE_SAMPLES, (unsigned long)long_gaps,
+			(unsigned long)sensor_history_count());
+
+	/* benchmark: a get walks the deltas before the sample in its block, a query scans only the partial blocks */
+	double first_ns = get_ns(0);
+	double last_ns = get_ns(BLOCK - 1U);
+	printf("get: %.1f ns at block offset 0, %.1f ns at offset %u, %.2f ns per delta\n", first_ns, last_ns,
+			BLOCK - 1U, (last_ns - first_ns) / (BLOCK - 1U));
+	uint32_t count = sensor_history_count();
+	printf("query: %.0f ns for all %lu samples, %.0f ns off the block boundaries, %.0f ns within one block\n",
+			query_ns(0, count - count % BLOCK), (unsigned long)(count - count % BLOCK),
+			query_ns(1, count - count % BLOCK - 2U), query_ns(1, BLOCK - 2U));
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * a sensor lost for a while: holding SDA through the clock out and gone after
+ * the power cycle, the display shows dashes and the firmware keeps trying to
+ * recover it at a slow pace. once the sensor answers again the mode shown
+ * before the error comes back with the reading
+ */
+
+#include "sim.h"
+#include "check.h"
+#include <stdio.h>
+
+/*
+ * active-low segment codes, digit 0 holds the unit
+ */
+#define CODE_C 0xC6
+#define CODE_F 0x8E
+#define CODE_DASH 0xBF
+
+/*
+ * scl pulses the sensor holds SDA for, more than the 9 of the clock out
+ */
+#define HOLD_CLOCKS 20U
+
+/*
+ * time the sensor stays away, and the retry period of the sensor task with the sample after it
+ */
+#define LOST_MS 12000U
+#define RETRY_MS 5000U
+#define SAMPLE_MS 1000U
+
+static void read_display(sim_display_t *display) {
+	sim_display_read(display);
+	printf("%6lu ms: %02X %02X %02X %02X\n", (unsigned long)sim_time_ms(),
+			display->code[0], display->code[1], display->code[2], display->code[3]);
+}
+
+static bool dashes_shown(void) {
+	sim_display_t display;
+	sim_display_read(&display);
+	for (uint8_t i = 0; i < 4; i++) {
+		if (display.code[i] != CODE_DASH) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool fahrenheit_shown(void) {
+	sim_display_t display;
+	sim_display_read(&display);
+	return display.code[0] == CODE_F;
+}
+
+int main(void) {
+	sim_display_t display;
+	sim_aht20_stats_t stats;
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+	sim_init();
+	sim_boot();
+	sim_run_ms(3000);
+	read_display(&display);
+	CHECK(display.code[0] == CODE_C);
+
+	/* the error hides a mode other than the one shown at boot */
+	sim_button_set(SIM_BUTTON_A, true);
+	sim_run_ms(60);
+	sim_button_set(SIM_BUTTON_A, false);
+	CHECK(sim_run_until(fahrenheit_shown, 1000));
+	sim_display_t before;
+	sim_run_ms(100);
+	read_display(&before);
+
+	/* the power cycle of the recovery finds no sensor */
+	sim_aht20()->hold_sda_clocks = HOLD_CLOCKS;
+	sim_aht20()->absent = true;
+	CHECK(sim_run_until(dashes_shown, 2000));
+	read_display(&display);
+
+	sim_aht20_get_stats(&stats);
+	uint32_t power_cycles = stats.power_cycles;
+	uint32_t nacks = stats.nacks;
+	sim_run_ms(LOST_MS);
+	CHECK(dashes_shown());
+	sim_aht20_get_stats(&stats);
+	printf("sensor lost for %u ms: %u nacks, %u power cycles\n", LOST_MS, stats.nacks - nacks, stats.power_cycles - power_cycles);
+	CHECK(stats.power_cycles == power_cycles);
+
+	/* the sda hold is gone with the first power cycle, each retry clocks out the bus and is refused at the address */
+	CHECK(stats.nacks - nacks >= LOST_MS / RETRY_MS - 1U);
+	CHECK(stats.nacks - nacks <= LOST_MS / RETRY_MS + 1U);
+
+	/* the next retry finds it, its first sample brings back fahrenheit */
+	sim_aht20()->absent = false;
+	uint32_t found_ms = sim_time_ms();
+	CHECK(sim_run_until(fahrenheit_shown, RETRY_MS + SAMPLE_MS));
+	printf("mode back %lu ms after the sensor answered\n", (unsigned long)(sim_time_ms() - found_ms));
+	sim_run_ms(100);
+	read_display(&display);
+	for (uint8_t i = 0; i < 4; i++) {
+		CHECK(display.code[i] == before.code[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,294 @@
+/*
+ * digital_thermomether
+ * digital thermometer built using stm32f446ret, AHT20 sensor and multi-function shield
+ * Copyright (C) 2025 Andrew Kushyk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ * telemetry loopback: the simulated USART2 feeds a pseudo-terminal standing in
+ * for the USB serial port and the host decoder reads the other end, as it would
+ * read the board. frames offered below the line rate all arrive intact and in
+ * order, offered above it the line stays saturated at 921600 baud and the
+ * frames dropped by the device show up as sequence gaps. queueing a frame
+ * never waits for the serial port
+ */
+
+#define _XOPEN_SOURCE 600
+#include "sim.h"
+#include "telemetry.h"
+#include "telemetry_decoder.h"
+#include "main.h"
+#include "check.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BAUD_RATE 921600U
+
+/*
+ * APB1 clocks per bit are whole, 42 MHz / 46 is 0.93 % below 921600
+ */
+#define LINE_BYTES_PER_S (42000000.0 / 46.0 / 10.0)
+
+/*
+ * phases: frames offered every millisecond and for how long.
+ * a frame is 23 bytes, the line carries about 4 per millisecond
+ */
+#define LOSSLESS_FRAMES_PER_MS 3
+#define LOSSLESS_MS 2000
+#define SATURATED_FRAMES_PER_MS 6
+#define SATURATED_MS 1000
+
+/*
+ * DMA reloads from the other buffer in the interrupt, the line is only idle that long
+ */
+#define MIN_LINE_USE 0.98
+
+/*
+ * queueing copies a frame, it never waits for the line
+ */
+#define SEND_BUDGET_CYCLES 840U
+
+/*
+ * clock setup of main.c
+ */
+void SystemClock_Config(void);
+
+/*
+ * pseudo-terminal: bytes from the USART wait in pending until written to the master side
+ */
+static int master = -1;
+static int port = -1;
+static uint8_t pending[65536];
+static size_t pending_length = 0;
+
+/*
+ * line timing of the saturated phase, from the first to the last byte sent in it
+ */
+static bool saturated = false;
+static uint64_t saturated_first = 0;
+static uint64_t saturated_last = 0;
+static uint32_t saturated_bytes = 0;
+
+/*
+ * what the device did, filled by the firmware entry
+ */
+static uint32_t lossless_frames = 0;
+static uint32_t max_send_cycles = 0;
+static telemetry_stats_t device_after_lossless;
+static telemetry_stats_t device_stats;
+
+/*
+ * what the host received
+ */
+static uint32_t received = 0;
+static uint32_t mismatches = 0;
+static uint32_t lossless_received = 0;
+
+/*
+ * frame contents follow the sequence, the host checks them against it
+ */
+static void fill_sample(telemetry_sample_t *sample, uint32_t index) {
+	sample->time_ms = index * 7U;
+	for (uint32_t i = 0; i < TELEMETRY_RAW_FRAME_SIZE; i++) {
+		/* zeros included, COBS has to carry them */
+		sample->raw[i] = (uint8_t)(index * 13U + i * 41U);
+	}
+	sample->temperature_centi = (int16_t)((int32_t)(index % 9000U) - 4000);
+	sample->humidity_centi = (int16_t)(index % 10001U);
+	sample->flags = (uint8_t)(index & 0x0FU);
+}
+
+static void on_sample(const telemetry_sample_t *sample, void *context) {
+	(void)context;
+	telemetry_sample_t expected;
+
+	fill_sample(&expected, sample->sequence);
+	if (sample->time_ms != expected.time_ms || memcmp(sample->raw, expected.raw, sizeof(expected.raw)) != 0
+			|| sample->temperature_centi != expected.temperature_centi
+			|| sample->humidity_centi != expected.humidity_centi || sample->flags != expected.flags) {
+		mismatches++;
+	}
+	received++;
+	if (sample->sequence < lossless_frames || lossless_frames == 0) {
+		lossless_received++;
+	}
+}
+
+static void uart_sink(uint8_t byte, uint64_t time, void *context) {
+	(void)context;
+
+	CHECK(pending_length < sizeof(pending));
+	pending[pending_length++] = byte;
+	if (saturated) {
+		if (saturated_bytes == 0) {
+			saturated_first = time;
+		}
+		saturated_last = time;
+		saturated_bytes++;
+	}
+}
+
+static void read_port(telemetry_decoder_t *decoder) {
+	uint8_t data[4096];
+	ssize_t length;
+
+	while ((length = read(port, data, sizeof(data))) > 0) {
+		telemetry_decoder_feed(decoder, data, (size_t)length);
+	}
+	CHECK(length == 0 || errno == EAGAIN);
+}
+
+/*
+ * moves the USART output through the pseudo-terminal into the decoder
+ */
+static void pump(telemetry_decoder_t *decoder) {
+	size_t written = 0;
+
+	while (written < pending_length) {
+		ssize_t length = write(master, pending + written, pending_length - written);
+		if (length > 0) {
+			written += (size_t)length;
+		} else {
+			CHECK(errno == EAGAIN);
+		}
+		read_port(decoder);
+	}
+	pending_length = 0;
+	read_port(decoder);
+}
+
+static void wait_for_tick(void) {
+	uint32_t tick = HAL_GetTick();
+	while (HAL_GetTick() == tick) {
+		__WFI();
+	}
+}
+
+/*
+ * offers frames_per_ms frames every millisecond for duration_ms
+ */
+static void offer(uint32_t *index, uint32_t frames_per_ms, uint32_t duration_ms) {
+	telemetry_sample_t sample;
+
+	for (uint32_t ms = 0; ms < duration_ms; ms++) {
+		for (uint32_t i = 0; i < frames_per_ms; i++) {
+			fill_sample(&sample, (*index)++);
+			uint32_t start = DWT->CYCCNT;
+			telemetry_send_sample(&sample);
+			uint32_t cycles = DWT->CYCCNT - start;
+			if (cycles > max_send_cycles) {
+				max_send_cycles = cycles;
+			}
+		}
+		wait_for_tick();
+	}
+}
+
+static void telemetry_entry(void) {
+	SystemInit();
+	HAL_Init();
+	SystemClock_Config();
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	telemetry_status_t status = telemetry_init(BAUD_RATE);
+	CHECK(status == TELEMETRY_STATUS_OK);
+
+	uint32_t index = 0;
+	offer(&index, LOSSLESS_FRAMES_PER_MS, LOSSLESS_MS);
+	lossless_frames = index;
+	while (telemetry_is_busy()) {
+		wait_for_tick();
+	}
+	telemetry_get_stats(&device_after_lossless);
+
+	saturated = true;
+	offer(&index, SATURATED_FRAMES_PER_MS, SATURATED_MS);
+	saturated = false;
+	while (telemetry_is_busy()) {
+		wait_for_tick();
+	}
+
+	/* one frame on the idle line ends the last gap, the host can't see a gap at the end */
+	offer(&index, 1, 1);
+	while (telemetry_is_busy()) {
+		wait_for_tick();
+	}
+	telemetry_get_stats(&device_stats);
+}
+
+int main(void) {
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	CHECK(master >= 0);
+	int granted = grantpt(master);
+	int unlocked = unlockpt(master);
+	CHECK(granted == 0 && unlocked == 0);
+	telemetry_decoder_status_t status = telemetry_decoder_open_port(ptsname(master), BAUD_RATE, &port);
+	CHECK(status == TELEMETRY_DECODER_STATUS_OK);
+
+	telemetry_decoder_t decoder;
+	status = telemetry_decoder_init(&decoder, on_sample, NULL);
+	CHECK(status == TELEMETRY_DECODER_STATUS_OK);
+	/* the port is opened before the device starts, the first frame has a delimiter in front */
+	telemetry_decoder_feed(&decoder, (const uint8_t[]) {0}, 1);
+
+	sim_start(telemetry_entry);
+	sim_uart_set_sink(uart_sink, NULL);
+
+	sim_state_t state = SIM_STATE_RUNNING;
+	for (uint32_t ms = 0; ms < 60000 && state != SIM_STATE_RETURNED; ms += 5) {
+		state = sim_run_ms(5);
+		pump(&decoder);
+	}
+	CHECK(state == SIM_STATE_RETURNED);
+	sim_run_ms(5);
+	pump(&decoder);
+
+	telemetry_decoder_stats_t host;
+	telemetry_decoder_get_stats(&decoder, &host);
+	double line_use = saturated_bytes / ((double)(saturated_last - saturated_first) / SIM_CLOCK_HZ) / LINE_BYTES_PER_S;
+
+	printf("lossless: %lu frames offered, %lu received, %lu dropped by the device\n",
+			(unsigned long)lossless_frames, (unsigned long)lossless_received,
+			(unsigned long)device_after_lossless.frames_dropped);
+	printf("saturated: %lu bytes at %.0f bytes/s, %.1f %% of the line, %lu dropped by the device, %lu lost on the host\n",
+			(unsigned long)saturated_bytes, saturated_bytes / ((double)(saturated_last - saturated_first) / SIM_CLOCK_HZ),
+			line_use * 100.0, (unsigned long)device_stats.frames_dropped, (unsigned long)host.lost_frames);
+	printf("host: %lu bytes, %lu frames, %lu mismatches, %lu bad crc, %lu bad framing; send max %lu cycles, buffer max %u\n",
+			(unsigned long)host.bytes, (unsigned long)host.frames, (unsigned long)mismatches,
+			(unsigned long)host.bad_crc, (unsigned long)host.bad_framing, (unsigned long)max_send_cycles,
+			device_stats.max_fill);
+
+	CHECK(device_after_lossless.frames_dropped == 0);
+	CHECK(lossless_received == lossless_frames);
+	CHECK(mismatches == 0);
+	CHECK(host.bad_crc == 0 && host.bad_framing == 0 && host.bad_type == 0 && host.oversized == 0);
+	CHECK(host.bytes == device_stats.bytes_sent + 1);
+	CHECK(device_stats.frames_dropped > 0);
+	CHECK(host.lost_frames == device_stats.frames_dropped);
+	CHECK(received == device_stats.frames_queued);
+	CHECK(line_use > MIN_LINE_USE && line_use < 1.001);
+	CHECK(max_send_cycles < SEND_BUDGET_CYCLES);
+
+	close(port);
+	close(master);
+
+	return 0;
+}
@@ -0,0 +1,37 @@
+# generates the vector table of the host simulation from the startup file, so
+# the simulated NVIC dispatches to the same handlers as the firmware.
+# entries that are 0 or the initial stack pointer become NULL, handlers are
+# weak references: a vector without a handler is NULL instead of Default_Handler
+
+function(sim_generate_vectors startup output)
+	file(READ ${startup} text)
+	string(FIND "${text}" "g_pfnVectors:" table_start)
+	string(SUBSTRING "${text}" ${table_start} -1 text)
+	string(REGEX MATCHALL "\\.word[ \t]+[A-Za-z0-9_]+" words "${text}")
+
+	set(declarations "")
+	set(entries "")
+	set(count 0)
+	foreach(word IN LISTS words)
+		string(REGEX REPLACE "\\.word[ \t]+" "" name "${word}")
+		if(name STREQUAL "0" OR name STREQUAL "_estack")
+			string(APPEND entries "\t0,\n")
+		else()
+			string(APPEND declarations "extern void ${name}(void) __attribute__((weak));\n")
+			string(APPEND entries "\t${name},\n")
+		endif()
+		math(EXPR count "${count} + 1")
+	endforeach()
+
+	set(content "/* generated from ${startup}, do not edit */\n\n")
+	string(APPEND content "${declarations}\n")
+	string(APPEND content "void (*const sim_vectors[${count}])(void) = {\n${entries}};\n")
+
+	if(EXISTS ${output})
+		file(READ ${output} previous)
+	endif()
+	if(NOT previous STREQUAL content)
+		file(WRITE ${output} "${content}")
+	endif()
+	set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${startup})
+endfunction()